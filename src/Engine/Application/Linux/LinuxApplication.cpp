@@ -0,0 +1,77 @@
+#include "Common/Log.h"
+
+#include "Engine.h"
+#include "LinuxApplication.h"
+
+#include <memory>
+
+std::shared_ptr<LinuxApplication> G_CurrentPlatformApplication = nullptr;
+
+LinuxApplication::LinuxApplication()
+    : m_Window(nullptr)
+{
+
+}
+
+LinuxApplication::~LinuxApplication()
+{
+    if (m_Window != nullptr)
+    {
+        MLOGE("Window not shutdown.");
+    }
+}
+
+void LinuxApplication::SetMessageHandler(GenericApplicationMessageHandler* messageHandler)
+{
+    GenericApplication::SetMessageHandler(messageHandler);
+}
+
+void LinuxApplication::PumpMessages()
+{
+
+}
+
+void LinuxApplication::Tick(float time, float delta)
+{
+
+}
+
+std::shared_ptr<GenericWindow> LinuxApplication::MakeWindow(int32 width, int32 height, const char* title)
+{
+    return LinuxWindow::Make(width, height, title);
+}
+
+std::shared_ptr<GenericWindow> LinuxApplication::GetWindow()
+{
+    return m_Window;
+}
+
+void LinuxApplication::InitializeWindow(const std::shared_ptr<GenericWindow> window, const bool showImmediately)
+{
+    m_Window = std::dynamic_pointer_cast<LinuxWindow>(window);
+
+    if (showImmediately)
+    {
+        m_Window->Show();
+    }
+}
+
+void LinuxApplication::Destroy()
+{
+    if (m_Window != nullptr)
+    {
+        m_Window->Destroy();
+        m_Window = nullptr;
+    }
+}
+
+std::shared_ptr<GenericApplication> GenericApplication::Create()
+{
+    G_CurrentPlatformApplication = std::make_shared<LinuxApplication>();
+    return G_CurrentPlatformApplication;
+}
+
+GenericApplication& GenericApplication::GetApplication()
+{
+    return *G_CurrentPlatformApplication;
+}
@@ -0,0 +1,49 @@
+#include "LinuxWindow.h"
+
+LinuxWindow::LinuxWindow(int32 width, int32 height, const char* title)
+    : GenericWindow(width, height)
+    , m_Title(title)
+{
+
+}
+
+LinuxWindow::~LinuxWindow()
+{
+
+}
+
+std::shared_ptr<LinuxWindow> LinuxWindow::Make(int32 width, int32 height, const char* title)
+{
+    return std::shared_ptr<LinuxWindow>(new LinuxWindow(width, height, title));
+}
+
+const char* LinuxWindow::GetTitle() const
+{
+    return m_Title.c_str();
+}
+
+void LinuxWindow::SetText(const char* const text)
+{
+    m_Title = text;
+}
+
+bool LinuxWindow::IsForegroundWindow() const
+{
+    return false;
+}
+
+void* LinuxWindow::GetOSWindowHandle() const
+{
+    return nullptr;
+}
+
+void LinuxWindow::CreateVKSurface(VkInstance instance, VkSurfaceKHR* outSurface)
+{
+    *outSurface = VK_NULL_HANDLE;
+}
+
+const char** LinuxWindow::GetRequiredInstanceExtensions(uint32_t* count)
+{
+    *count = 0;
+    return nullptr;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Common/Common.h"
+#include "Application/GenericWindow.h"
+
+#include <memory>
+#include <string>
+
+// 无窗口的离屏"窗口"，只记录尺寸与标题，不创建VkSurfaceKHR。
+// 渲染结果写入VulkanSwapChain的离屏backbuffer，用于CI与性能测试。
+class LinuxWindow : public GenericWindow
+{
+public:
+    virtual ~LinuxWindow();
+
+    static std::shared_ptr<LinuxWindow> Make(int32 width, int32 height, const char* title);
+
+    virtual const char* GetTitle() const override;
+
+    virtual void SetText(const char* const text) override;
+
+    virtual bool IsForegroundWindow() const override;
+
+    virtual void* GetOSWindowHandle() const override;
+
+    virtual void CreateVKSurface(VkInstance instance, VkSurfaceKHR* outSurface) override;
+
+    virtual const char** GetRequiredInstanceExtensions(uint32_t* count) override;
+
+private:
+    LinuxWindow(int32 width, int32 height, const char* title);
+
+private:
+    std::string     m_Title;
+};
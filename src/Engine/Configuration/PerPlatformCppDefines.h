@@ -2,4 +2,9 @@
 
 #ifndef MONKEY_DEBUG
     #define MONKEY_DEBUG 0
-#endif // !MONKEY_DEBUG
\ No newline at end of file
+#endif // !MONKEY_DEBUG
+
+// CPU分段计时，为0时CPU_PROFILE_SCOPE不产生任何代码
+#ifndef ENABLE_CPU_PROFILER
+    #define ENABLE_CPU_PROFILER 1
+#endif // !ENABLE_CPU_PROFILER
\ No newline at end of file
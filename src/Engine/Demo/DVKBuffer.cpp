@@ -5,7 +5,7 @@
 #include "Vulkan/VulkanGlobals.h"
 #include "vulkan/vulkan_core.h"
 #include <stdint.h>
-#include <vcruntime_string.h>
+#include <string.h>
 
 
 
@@ -18,10 +18,7 @@ namespace vk_demo
 
         VkDevice vkDevice= vulkanDevice->GetInstanceHandle();
 
-        uint32 memoryTypeIndex = 0;
         VkMemoryRequirements memReqs = {};
-        VkMemoryAllocateInfo memAlloc;
-        ZeroVulkanStruct(memAlloc,VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
 
         VkBufferCreateInfo bufferCreateInfo;
         ZeroVulkanStruct(bufferCreateInfo,VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO);
@@ -29,18 +26,23 @@ namespace vk_demo
         bufferCreateInfo.size = size;
         vkCreateBuffer(vkDevice,&bufferCreateInfo,nullptr,&(dvkBuffer->buffer));
 
+        // 从按内存类型划分的heap里子分配，只有新建page时才会调用vkAllocateMemory
         vkGetBufferMemoryRequirements(vkDevice,dvkBuffer->buffer,&memReqs);
-        vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits,memoryPropertyFlags,&memoryTypeIndex);
-        memAlloc.allocationSize = memReqs.size;
-        memAlloc.memoryTypeIndex = memoryTypeIndex;
-
-
-        vkAllocateMemory(vkDevice,&memAlloc,nullptr,&dvkBuffer->memory);
+        dvkBuffer->allocation = vulkanDevice->GetResourceHeapManager().AllocateBufferMemory(memReqs, memoryPropertyFlags, __FILE__, __LINE__);
+        if(dvkBuffer->allocation==nullptr)
+        {
+            delete dvkBuffer;
+            return nullptr;
+        }
+        dvkBuffer->allocation->AddRef();
 
-        dvkBuffer->size = memAlloc.allocationSize;
+        dvkBuffer->memory = dvkBuffer->allocation->GetHandle();
+        dvkBuffer->size = memReqs.size;
+        dvkBuffer->requestedSize = size;
         dvkBuffer->alignment = memReqs.alignment;
         dvkBuffer->usageFlags = usageFlags;
         dvkBuffer->memoryPropertyFlags = memoryPropertyFlags;
+        dvkBuffer->nonCoherentAtomSize = vulkanDevice->GetLimits().nonCoherentAtomSize;
         
         if(data!=nullptr)
         {
@@ -63,7 +65,18 @@ namespace vk_demo
         {
             return VK_SUCCESS;
         }
-        return vkMapMemory(device,memory,offset,size,0,&mapped);
+        // page在分配时已经常驻映射，这里只需要加上偏移
+        VulkanDeviceMemoryAllocation* deviceMemory = allocation->GetDeviceMemoryAllocation();
+        if(!deviceMemory->IsMapped())
+        {
+            if(!deviceMemory->CanBeMapped())
+            {
+                return VK_ERROR_MEMORY_MAP_FAILED;
+            }
+            deviceMemory->Map(VK_WHOLE_SIZE, 0);
+        }
+        mapped = (uint8*)allocation->GetMappedPointer() + offset;
+        return VK_SUCCESS;
     }
 
     void DVKBuffer::UnMap()
@@ -72,13 +85,12 @@ namespace vk_demo
         {
             return ;
         }
-        vkUnmapMemory(device,memory);
         mapped = nullptr;
     }
 
     VkResult DVKBuffer::Bind(VkDeviceSize offset)
     {
-        return vkBindBufferMemory(device,buffer,memory,offset);
+        return vkBindBufferMemory(device,buffer,memory,allocation->GetOffset()+offset);
     }
 
     void DVKBuffer::SetupDescriptor(VkDeviceSize size, VkDeviceSize offset)
@@ -97,13 +109,118 @@ namespace vk_demo
         memcpy(mapped,data,size);
     }
 
+    void DVKBuffer::GetMappedRange(VkDeviceSize size, VkDeviceSize offset, VkMappedMemoryRange& outRange)
+    {
+        // 其它buffer可能共享同一块VkDeviceMemory，范围必须限制在自己的子分配内并按nonCoherentAtomSize对齐
+        VkDeviceSize pageSize = allocation->GetDeviceMemoryAllocation()->GetSize();
+        VkDeviceSize begin    = allocation->GetOffset() + offset;
+        VkDeviceSize end      = size == VK_WHOLE_SIZE ? allocation->GetOffset() + this->size : begin + size;
+        begin = begin / nonCoherentAtomSize * nonCoherentAtomSize;
+        end   = (end + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize;
+
+        ZeroVulkanStruct(outRange, VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE);
+        outRange.memory = memory;
+        outRange.offset = begin;
+        outRange.size   = end >= pageSize ? VK_WHOLE_SIZE : end - begin;
+    }
+
     VkResult DVKBuffer::Flush(VkDeviceSize size,VkDeviceSize offset)
     {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
+        VkMappedMemoryRange mappedRange;
+        GetMappedRange(size, offset, mappedRange);
         return vkFlushMappedMemoryRanges(device,1,&mappedRange);
     }
+
+    VkResult DVKBuffer::Invalidate(VkDeviceSize size,VkDeviceSize offset)
+    {
+        VkMappedMemoryRange mappedRange;
+        GetMappedRange(size, offset, mappedRange);
+        return vkInvalidateMappedMemoryRanges(device,1,&mappedRange);
+    }
+
+    bool DVKBuffer::SetMovable(bool movable)
+    {
+        if(allocation==nullptr)
+        {
+            return false;
+        }
+        if(!movable)
+        {
+            allocation->SetMover(nullptr);
+            return true;
+        }
+        // host可见的page常驻映射，CPU随时可能写入，不参与整理
+        if((memoryPropertyFlags&VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)!=0||(usageFlags&VK_BUFFER_USAGE_TRANSFER_SRC_BIT)==0)
+        {
+            return false;
+        }
+        allocation->SetMover(this);
+        return true;
+    }
+
+    bool DVKBuffer::BeginMove(VkCommandBuffer cmdBuffer, VulkanResourceAllocation* newAllocation)
+    {
+        // 上一次搬迁的旧buffer还没有释放
+        if(moveBuffer!=VK_NULL_HANDLE||retiredBuffer!=VK_NULL_HANDLE)
+        {
+            return false;
+        }
+
+        VkBufferCreateInfo bufferCreateInfo;
+        ZeroVulkanStruct(bufferCreateInfo,VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO);
+        bufferCreateInfo.usage = usageFlags|VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferCreateInfo.size  = requestedSize;
+        if(vkCreateBuffer(device,&bufferCreateInfo,nullptr,&moveBuffer)!=VK_SUCCESS)
+        {
+            moveBuffer = VK_NULL_HANDLE;
+            return false;
+        }
+
+        VkMemoryRequirements memReqs = {};
+        vkGetBufferMemoryRequirements(device,moveBuffer,&memReqs);
+        if(memReqs.size>newAllocation->GetSize()||newAllocation->GetOffset()%memReqs.alignment!=0||vkBindBufferMemory(device,moveBuffer,newAllocation->GetHandle(),newAllocation->GetOffset())!=VK_SUCCESS)
+        {
+            vkDestroyBuffer(device,moveBuffer,nullptr);
+            moveBuffer = VK_NULL_HANDLE;
+            return false;
+        }
+
+        VkBufferCopy copyRegion = {};
+        copyRegion.size = requestedSize;
+        vkCmdCopyBuffer(cmdBuffer,buffer,moveBuffer,1,&copyRegion);
+        return true;
+    }
+
+    void DVKBuffer::CommitMove(VulkanResourceAllocation* newAllocation)
+    {
+        newAllocation->AddRef();
+
+        retiredBuffer     = buffer;
+        retiredAllocation = allocation;
+
+        buffer            = moveBuffer;
+        moveBuffer        = VK_NULL_HANDLE;
+        allocation        = newAllocation;
+        memory            = newAllocation->GetHandle();
+        descriptor.buffer = buffer;
+
+        if(onMoved)
+        {
+            onMoved(this);
+        }
+    }
+
+    void DVKBuffer::FinishMove(VulkanResourceAllocation* oldAllocation)
+    {
+        if(retiredBuffer!=VK_NULL_HANDLE)
+        {
+            vkDestroyBuffer(device,retiredBuffer,nullptr);
+            retiredBuffer = VK_NULL_HANDLE;
+        }
+        if(retiredAllocation==oldAllocation)
+        {
+            retiredAllocation->Release();
+            retiredAllocation = nullptr;
+        }
+    }
 }
\ No newline at end of file
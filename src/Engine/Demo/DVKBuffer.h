@@ -2,18 +2,20 @@
 
 #include "Engine.h"
 #include "Common/Common.h"
+#include "Vulkan/VulkanMemory.h"
 #include "vulkan/vulkan_core.h"
 
 #include <string.h>
 #include <cstring>
 #include <vector>
 #include <memory>
+#include <functional>
 
 class VulkanDevice;
 
 namespace vk_demo
 {
-    class DVKBuffer
+    class DVKBuffer : public VulkanResourceMover
     {
         private:
             DVKBuffer()
@@ -23,11 +25,36 @@ namespace vk_demo
         public:
             ~DVKBuffer()
             {
+                // 碎片整理过程中被销毁，新旧两份资源都要清理
+                if(moveBuffer!=VK_NULL_HANDLE)
+                {
+                    vkDestroyBuffer(device,moveBuffer,nullptr);
+                    moveBuffer = VK_NULL_HANDLE;
+                }
+                if(retiredBuffer!=VK_NULL_HANDLE)
+                {
+                    vkDestroyBuffer(device,retiredBuffer,nullptr);
+                    retiredBuffer = VK_NULL_HANDLE;
+                }
+                if(retiredAllocation!=nullptr)
+                {
+                    retiredAllocation->SetMover(nullptr);
+                    retiredAllocation->Release();
+                    retiredAllocation = nullptr;
+                }
                 if(buffer!=VK_NULL_HANDLE)
                 {
                     vkDestroyBuffer(device,buffer,nullptr);
                     buffer = VK_NULL_HANDLE;
                 }
+                if(allocation!=nullptr)
+                {
+                    // 内存来自VulkanResourceHeapManager的page，归还即可
+                    allocation->SetMover(nullptr);
+                    allocation->Release();
+                    allocation = nullptr;
+                    memory = VK_NULL_HANDLE;
+                }
                 if(memory!=VK_NULL_HANDLE)
                 {
                     vkFreeMemory(device,memory,nullptr);
@@ -38,16 +65,29 @@ namespace vk_demo
            VkDevice   device = VK_NULL_HANDLE;
            VkBuffer   buffer = VK_NULL_HANDLE;
            VkDeviceMemory memory = VK_NULL_HANDLE;
+           VulkanResourceAllocation* allocation = nullptr;
+           VkDeviceSize nonCoherentAtomSize = 1;
 
            VkDescriptorBufferInfo descriptor;
 
            VkDeviceSize size=0;
+           VkDeviceSize requestedSize=0;
            VkDeviceSize alignment=0;
 
            void* mapped = nullptr;
 
            VkBufferUsageFlags usageFlags;
            VkMemoryPropertyFlags memoryPropertyFlags;
+
+           // 碎片整理把buffer搬到新的位置后回调，引用旧handle的descriptor与command buffer需要在这里更新
+           std::function<void(DVKBuffer*)> onMoved;
+
+           VkBuffer moveBuffer = VK_NULL_HANDLE;
+           VkBuffer retiredBuffer = VK_NULL_HANDLE;
+           VulkanResourceAllocation* retiredAllocation = nullptr;
+        private:
+        void GetMappedRange(VkDeviceSize size, VkDeviceSize offset, VkMappedMemoryRange& outRange);
+
         public:
         static DVKBuffer* CreateBuffer(std::shared_ptr<VulkanDevice> device, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, void *data = nullptr);
 
@@ -64,5 +104,14 @@ namespace vk_demo
         VkResult Flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 
         VkResult Invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+        // 允许碎片整理移动该buffer，只支持device local且带TRANSFER_SRC的buffer
+        bool SetMovable(bool movable);
+
+        virtual bool BeginMove(VkCommandBuffer cmdBuffer, VulkanResourceAllocation* newAllocation) override;
+
+        virtual void CommitMove(VulkanResourceAllocation* newAllocation) override;
+
+        virtual void FinishMove(VulkanResourceAllocation* oldAllocation) override;
     };
 }
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include "DVKDescriptorAllocator.h"
+
+#include "Common/Log.h"
+#include "Math/Math.h"
+#include "Vulkan/VulkanDevice.h"
+
+namespace vk_demo
+{
+    DVKDescriptorAllocator::~DVKDescriptorAllocator()
+    {
+        for (int32 i = 0; i < allPools.size(); ++i)
+        {
+            vkDestroyDescriptorPool(device, allPools[i], VULKAN_CPU_ALLOCATOR);
+        }
+        allPools.clear();
+        freePools.clear();
+        framePools.clear();
+    }
+
+    DVKDescriptorAllocator* DVKDescriptorAllocator::Create(std::shared_ptr<VulkanDevice> vulkanDevice, int32 numFrames, uint32 setsPerPool)
+    {
+        DVKDescriptorAllocator* allocator = new DVKDescriptorAllocator();
+        allocator->device      = vulkanDevice->GetInstanceHandle();
+        allocator->setsPerPool = MMath::Clamp<uint32>(setsPerPool, 16, MaxSetsPerPool);
+        allocator->framePools.resize(MMath::Max(numFrames, 1));
+        allocator->frameSets.resize(MMath::Max(numFrames, 1), 0);
+        return allocator;
+    }
+
+    void DVKDescriptorAllocator::RegisterLayouts(const DVKDescriptorSetLayoutsInfo& setLayoutsInfo)
+    {
+        if (registered.find(&setLayoutsInfo) != registered.end())
+        {
+            return;
+        }
+        registered.insert(&setLayoutsInfo);
+
+        for (int32 i = 0; i < setLayoutsInfo.setLayouts.size(); ++i)
+        {
+            const DVKDescriptorSetLayoutInfo& setLayoutInfo = setLayoutsInfo.setLayouts[i];
+            for (int32 j = 0; j < setLayoutInfo.bindings.size(); ++j)
+            {
+                const VkDescriptorSetLayoutBinding& binding = setLayoutInfo.bindings[j];
+                if ((uint32)binding.descriptorType < (uint32)DescriptorTypeCount)
+                {
+                    descriptorCounts[binding.descriptorType] += binding.descriptorCount;
+                }
+            }
+        }
+        numSets += (uint32)setLayoutsInfo.setLayouts.size();
+    }
+
+    void DVKDescriptorAllocator::BeginFrame(int32 inFrameIndex)
+    {
+        frameIndex = inFrameIndex % (int32)framePools.size();
+
+        std::vector<VkDescriptorPool>& pools = framePools[frameIndex];
+        peakFramePools = MMath::Max(peakFramePools, (uint32)pools.size());
+        peakFrameSets  = MMath::Max(peakFrameSets, frameSets[frameIndex]);
+
+        // 一帧用了多个pool说明单个pool太小，之后新建的pool翻倍
+        if (pools.size() > 1 && setsPerPool < MaxSetsPerPool)
+        {
+            setsPerPool = MMath::Min<uint32>(setsPerPool * 2, MaxSetsPerPool);
+            numGrows   += 1;
+            MLOG("Descriptor allocator grow : %d pools in one frame, %d sets per pool", (int32)pools.size(), setsPerPool);
+        }
+
+        for (int32 i = 0; i < pools.size(); ++i)
+        {
+            VERIFYVULKANRESULT(vkResetDescriptorPool(device, pools[i], 0));
+            freePools.push_back(pools[i]);
+            numResets += 1;
+        }
+        pools.clear();
+        frameSets[frameIndex] = 0;
+    }
+
+    VkDescriptorPool DVKDescriptorAllocator::CreatePool(uint32 maxSets, const DVKDescriptorSetLayoutsInfo* required)
+    {
+        uint32 counts[DescriptorTypeCount] = {};
+
+        if (numSets > 0)
+        {
+            for (int32 type = 0; type < DescriptorTypeCount; ++type)
+            {
+                counts[type] = (uint32)(((uint64)descriptorCounts[type] * maxSets + numSets - 1) / numSets);
+            }
+        }
+        else
+        {
+            counts[VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER]         = maxSets * 2;
+            counts[VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC] = maxSets;
+            counts[VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER] = maxSets * 4;
+            counts[VK_DESCRIPTOR_TYPE_STORAGE_BUFFER]         = maxSets;
+            counts[VK_DESCRIPTOR_TYPE_STORAGE_IMAGE]          = maxSets;
+            counts[VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT]       = maxSets;
+        }
+
+        // 按比例分配的pool装不下时，保证单独用这组layout也能分配满maxSets个set
+        if (required && required->setLayouts.size() > 0)
+        {
+            uint32 needs[DescriptorTypeCount] = {};
+            for (int32 i = 0; i < required->setLayouts.size(); ++i)
+            {
+                const DVKDescriptorSetLayoutInfo& setLayoutInfo = required->setLayouts[i];
+                for (int32 j = 0; j < setLayoutInfo.bindings.size(); ++j)
+                {
+                    const VkDescriptorSetLayoutBinding& binding = setLayoutInfo.bindings[j];
+                    if ((uint32)binding.descriptorType < (uint32)DescriptorTypeCount)
+                    {
+                        needs[binding.descriptorType] += binding.descriptorCount;
+                    }
+                }
+            }
+
+            uint32 numRequiredSets = (uint32)required->setLayouts.size();
+            for (int32 type = 0; type < DescriptorTypeCount; ++type)
+            {
+                uint32 count = (uint32)(((uint64)needs[type] * maxSets + numRequiredSets - 1) / numRequiredSets);
+                counts[type] = MMath::Max(counts[type], count);
+            }
+        }
+
+        std::vector<VkDescriptorPoolSize> poolSizes;
+        for (int32 type = 0; type < DescriptorTypeCount; ++type)
+        {
+            if (counts[type] > 0)
+            {
+                VkDescriptorPoolSize poolSize = {};
+                poolSize.type            = (VkDescriptorType)type;
+                poolSize.descriptorCount = counts[type];
+                poolSizes.push_back(poolSize);
+            }
+        }
+
+        VkDescriptorPoolCreateInfo descriptorPoolInfo;
+        ZeroVulkanStruct(descriptorPoolInfo, VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO);
+        descriptorPoolInfo.poolSizeCount = (uint32_t)poolSizes.size();
+        descriptorPoolInfo.pPoolSizes    = poolSizes.data();
+        descriptorPoolInfo.maxSets       = maxSets;
+
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        VERIFYVULKANRESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, VULKAN_CPU_ALLOCATOR, &descriptorPool));
+        allPools.push_back(descriptorPool);
+
+        return descriptorPool;
+    }
+
+    VkDescriptorPool DVKDescriptorAllocator::AcquirePool()
+    {
+        if (freePools.size() > 0)
+        {
+            VkDescriptorPool descriptorPool = freePools.back();
+            freePools.pop_back();
+            return descriptorPool;
+        }
+        return CreatePool(setsPerPool, nullptr);
+    }
+
+    VkResult DVKDescriptorAllocator::TryAllocate(VkDescriptorPool pool, const std::vector<VkDescriptorSetLayout>& layouts, VkDescriptorSet* outSets)
+    {
+        VkDescriptorSetAllocateInfo allocInfo;
+        ZeroVulkanStruct(allocInfo, VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO);
+        allocInfo.descriptorPool     = pool;
+        allocInfo.descriptorSetCount = (uint32_t)layouts.size();
+        allocInfo.pSetLayouts        = layouts.data();
+        return vkAllocateDescriptorSets(device, &allocInfo, outSets);
+    }
+
+    bool DVKDescriptorAllocator::Allocate(const DVKDescriptorSetLayoutsInfo& setLayoutsInfo, const std::vector<VkDescriptorSetLayout>& layouts, VkDescriptorSet* outSets)
+    {
+        if (layouts.size() == 0)
+        {
+            return true;
+        }
+
+        RegisterLayouts(setLayoutsInfo);
+
+        std::vector<VkDescriptorPool>& pools = framePools[frameIndex];
+        numAllocations        += 1;
+        frameSets[frameIndex] += (uint32)layouts.size();
+
+        // 先在当前pool中分配，满了换一个空pool，仍失败则按这组layout单独建pool
+        if (pools.size() > 0 && TryAllocate(pools.back(), layouts, outSets) == VK_SUCCESS)
+        {
+            return true;
+        }
+
+        if (pools.size() > 0)
+        {
+            numRetries += 1;
+        }
+
+        pools.push_back(AcquirePool());
+        if (TryAllocate(pools.back(), layouts, outSets) == VK_SUCCESS)
+        {
+            return true;
+        }
+
+        numRetries += 1;
+        pools.push_back(CreatePool(setsPerPool, &setLayoutsInfo));
+        if (TryAllocate(pools.back(), layouts, outSets) == VK_SUCCESS)
+        {
+            return true;
+        }
+
+        numFailures += 1;
+        MLOGE("Failed allocate %d transient descriptor sets.", (int32)layouts.size());
+        return false;
+    }
+
+    void DVKDescriptorAllocator::PrintStats()
+    {
+        MLOG("Descriptor allocator stats : %d allocations, %d pools (%d sets per pool, %d grows), peak %d sets / %d pools per frame, %d resets, %d retries, %d failures",
+            numAllocations,
+            (int32)allPools.size(),
+            setsPerPool,
+            numGrows,
+            peakFrameSets,
+            peakFramePools,
+            numResets,
+            numRetries,
+            numFailures
+        );
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Common/Common.h"
+#include "DVKShader.h"
+
+#include "Vulkan/VulkanCommon.h"
+#include "vulkan/vulkan_core.h"
+
+#include <memory>
+#include <vector>
+#include <unordered_set>
+
+class VulkanDevice;
+
+namespace vk_demo
+{
+    // 每帧使用的临时descriptor set分配器。
+    // 每帧一组pool，从中线性分配，该帧的fence等待之后通过vkResetDescriptorPool整体回收。
+    // pool中各类型descriptor的数量按已注册shader的反射统计按比例分配。
+    class DVKDescriptorAllocator
+    {
+    private:
+        DVKDescriptorAllocator()
+        {
+
+        }
+
+    public:
+        ~DVKDescriptorAllocator();
+
+        static DVKDescriptorAllocator* Create(std::shared_ptr<VulkanDevice> vulkanDevice, int32 numFrames, uint32 setsPerPool = 256);
+
+        // 把shader的descriptor数量计入统计，之后新建的pool按新的比例分配
+        void RegisterLayouts(const DVKDescriptorSetLayoutsInfo& setLayoutsInfo);
+
+        // 必须在frameIndex对应的fence等待之后调用
+        void BeginFrame(int32 frameIndex);
+
+        bool Allocate(const DVKDescriptorSetLayoutsInfo& setLayoutsInfo, const std::vector<VkDescriptorSetLayout>& layouts, VkDescriptorSet* outSets);
+
+        void PrintStats();
+
+    private:
+
+        VkDescriptorPool CreatePool(uint32 maxSets, const DVKDescriptorSetLayoutsInfo* required);
+
+        VkDescriptorPool AcquirePool();
+
+        VkResult TryAllocate(VkDescriptorPool pool, const std::vector<VkDescriptorSetLayout>& layouts, VkDescriptorSet* outSets);
+
+    public:
+
+        enum
+        {
+            // VK_DESCRIPTOR_TYPE_SAMPLER ~ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT
+            DescriptorTypeCount = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT + 1,
+            MaxSetsPerPool      = 4096,
+        };
+
+        VkDevice                                        device = VK_NULL_HANDLE;
+        uint32                                          setsPerPool = 256;
+        int32                                           frameIndex = 0;
+
+        std::vector<std::vector<VkDescriptorPool>>      framePools;
+        std::vector<uint32>                             frameSets;
+        std::vector<VkDescriptorPool>                   freePools;
+        std::vector<VkDescriptorPool>                   allPools;
+
+        std::unordered_set<const DVKDescriptorSetLayoutsInfo*> registered;
+        uint32                                          numSets = 0;
+        uint32                                          descriptorCounts[DescriptorTypeCount] = {};
+
+        uint32                                          numAllocations = 0;
+        uint32                                          numRetries = 0;
+        uint32                                          numFailures = 0;
+        uint32                                          numGrows = 0;
+        uint32                                          numResets = 0;
+        uint32                                          peakFrameSets = 0;
+        uint32                                          peakFramePools = 0;
+    };
+}
@@ -0,0 +1,308 @@
+#include "DVKFrustumCuller.h"
+
+#include "Common/Log.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "HAL/ThreadPool.h"
+#include "Math/MathSIMD.h"
+#include "Utils/CPUProfiler.h"
+
+#include <cstring>
+
+namespace vk_demo
+{
+    bool   DVKFrustumCuller::simd              = true;
+    bool   DVKFrustumCuller::parallel          = true;
+    int32  DVKFrustumCuller::parallelThreshold = 32768;
+    uint32 DVKFrustumCuller::numCulls          = 0;
+    uint64 DVKFrustumCuller::numTested         = 0;
+    uint64 DVKFrustumCuller::numVisible        = 0;
+    double DVKFrustumCuller::cullTime          = 0.0;
+
+    void DVKFrustum::Set(const Matrix4x4& viewProjection)
+    {
+        bool valid[NumPlanes] = {
+            viewProjection.GetFrustumLeftPlane(planes[0]),
+            viewProjection.GetFrustumRightPlane(planes[1]),
+            viewProjection.GetFrustumBottomPlane(planes[2]),
+            viewProjection.GetFrustumTopPlane(planes[3]),
+            viewProjection.GetFrustumNearPlane(planes[4]),
+            viewProjection.GetFrustumFarPlane(planes[5]),
+        };
+
+        // 退化的平面(例如无限远的远平面)不剔除任何东西
+        for (int32 i = 0; i < NumPlanes; ++i)
+        {
+            if (!valid[i])
+            {
+                // Plane有自定义的拷贝构造，赋值会触发-Wdeprecated-copy，直接清零分量
+                planes[i].x = 0.0f;
+                planes[i].y = 0.0f;
+                planes[i].z = 0.0f;
+                planes[i].w = 0.0f;
+            }
+        }
+    }
+
+    void DVKCullingBounds::Resize(int32 inCount)
+    {
+        count = inCount;
+
+        int32 capacity = (inCount + Alignment - 1) / Alignment * Alignment;
+        centerX.resize(capacity, 0.0f);
+        centerY.resize(capacity, 0.0f);
+        centerZ.resize(capacity, 0.0f);
+        extentX.resize(capacity, 0.0f);
+        extentY.resize(capacity, 0.0f);
+        extentZ.resize(capacity, 0.0f);
+        radius.resize(capacity, 0.0f);
+    }
+
+    void DVKCullingBounds::SetBox(int32 index, const DVKBoundingBox& bounding, const Matrix4x4& world)
+    {
+        Vector3 center = (bounding.min + bounding.max) * 0.5f;
+        Vector3 extent = (bounding.max - bounding.min) * 0.5f;
+
+        // 行向量：p' = p * world，世界空间半长为|M|与半长相乘
+        Vector3 worldCenter = world.TransformPosition(center);
+        Vector3 worldExtent(
+            MMath::Abs(world.m[0][0]) * extent.x + MMath::Abs(world.m[1][0]) * extent.y + MMath::Abs(world.m[2][0]) * extent.z,
+            MMath::Abs(world.m[0][1]) * extent.x + MMath::Abs(world.m[1][1]) * extent.y + MMath::Abs(world.m[2][1]) * extent.z,
+            MMath::Abs(world.m[0][2]) * extent.x + MMath::Abs(world.m[1][2]) * extent.y + MMath::Abs(world.m[2][2]) * extent.z
+        );
+
+        SetBox(index, worldCenter - worldExtent, worldCenter + worldExtent);
+    }
+
+    void DVKCullingBounds::SetBox(int32 index, const Vector3& min, const Vector3& max)
+    {
+        Vector3 extent = (max - min) * 0.5f;
+
+        centerX[index] = (min.x + max.x) * 0.5f;
+        centerY[index] = (min.y + max.y) * 0.5f;
+        centerZ[index] = (min.z + max.z) * 0.5f;
+        extentX[index] = extent.x;
+        extentY[index] = extent.y;
+        extentZ[index] = extent.z;
+        radius[index]  = extent.Size();
+    }
+
+    void DVKCullingBounds::SetSphere(int32 index, const Vector3& center, float inRadius)
+    {
+        centerX[index] = center.x;
+        centerY[index] = center.y;
+        centerZ[index] = center.z;
+        extentX[index] = inRadius;
+        extentY[index] = inRadius;
+        extentZ[index] = inRadius;
+        radius[index]  = inRadius;
+    }
+
+    void DVKVisibleList::SetAllVisible(int32 inCount)
+    {
+        changed = count != inCount;
+        count   = inCount;
+
+        indices.resize(MMath::Max<int32>((int32)indices.size(), inCount));
+        for (int32 i = 0; i < inCount; ++i)
+        {
+            indices[i] = i;
+        }
+    }
+
+#if PLATFORM_MATH_SIMD
+
+    // 每个平面的分量各复制到一个寄存器
+    struct FrustumRegisters
+    {
+        FrustumRegisters(const DVKFrustum& frustum)
+        {
+            for (int32 i = 0; i < DVKFrustum::NumPlanes; ++i)
+            {
+                const Plane& plane = frustum.planes[i];
+                x[i]    = VectorSetFloat1(plane.x);
+                y[i]    = VectorSetFloat1(plane.y);
+                z[i]    = VectorSetFloat1(plane.z);
+                negW[i] = VectorSetFloat1(-plane.w);
+                absX[i] = VectorSetFloat1(MMath::Abs(plane.x));
+                absY[i] = VectorSetFloat1(MMath::Abs(plane.y));
+                absZ[i] = VectorSetFloat1(MMath::Abs(plane.z));
+            }
+        }
+
+        VectorRegister x[DVKFrustum::NumPlanes];
+        VectorRegister y[DVKFrustum::NumPlanes];
+        VectorRegister z[DVKFrustum::NumPlanes];
+        VectorRegister negW[DVKFrustum::NumPlanes];
+        VectorRegister absX[DVKFrustum::NumPlanes];
+        VectorRegister absY[DVKFrustum::NumPlanes];
+        VectorRegister absZ[DVKFrustum::NumPlanes];
+    };
+
+    // 返回被剔除的4位掩码
+    static FORCE_INLINE int32 CullBoxes4(const FrustumRegisters& frustum, const DVKCullingBounds& bounds, int32 index)
+    {
+        const VectorRegister cx = VectorLoad(bounds.centerX.data() + index);
+        const VectorRegister cy = VectorLoad(bounds.centerY.data() + index);
+        const VectorRegister cz = VectorLoad(bounds.centerZ.data() + index);
+        const VectorRegister ex = VectorLoad(bounds.extentX.data() + index);
+        const VectorRegister ey = VectorLoad(bounds.extentY.data() + index);
+        const VectorRegister ez = VectorLoad(bounds.extentZ.data() + index);
+
+        VectorRegister outside = VectorSetFloat1(0.0f);
+        for (int32 i = 0; i < DVKFrustum::NumPlanes; ++i)
+        {
+            VectorRegister distance = VectorMultiplyAdd(frustum.x[i], cx, VectorMultiplyAdd(frustum.y[i], cy, VectorMultiplyAdd(frustum.z[i], cz, frustum.negW[i])));
+            VectorRegister radius   = VectorMultiplyAdd(frustum.absX[i], ex, VectorMultiplyAdd(frustum.absY[i], ey, VectorMultiply(frustum.absZ[i], ez)));
+            outside = VectorBitwiseOr(outside, VectorCompareGT(distance, radius));
+        }
+
+        return VectorMaskBits(outside);
+    }
+
+    static FORCE_INLINE int32 CullSpheres4(const FrustumRegisters& frustum, const DVKCullingBounds& bounds, int32 index)
+    {
+        const VectorRegister cx = VectorLoad(bounds.centerX.data() + index);
+        const VectorRegister cy = VectorLoad(bounds.centerY.data() + index);
+        const VectorRegister cz = VectorLoad(bounds.centerZ.data() + index);
+        const VectorRegister r  = VectorLoad(bounds.radius.data() + index);
+
+        VectorRegister outside = VectorSetFloat1(0.0f);
+        for (int32 i = 0; i < DVKFrustum::NumPlanes; ++i)
+        {
+            VectorRegister distance = VectorMultiplyAdd(frustum.x[i], cx, VectorMultiplyAdd(frustum.y[i], cy, VectorMultiplyAdd(frustum.z[i], cz, frustum.negW[i])));
+            outside = VectorBitwiseOr(outside, VectorCompareGT(distance, r));
+        }
+
+        return VectorMaskBits(outside);
+    }
+
+    template<int32 (*CullFunc)(const FrustumRegisters&, const DVKCullingBounds&, int32)>
+    static int32 CullRangeSIMD(const DVKFrustum& frustum, const DVKCullingBounds& bounds, int32 begin, int32 end, int32* outIndices)
+    {
+        const FrustumRegisters registers(frustum);
+
+        int32 num = 0;
+        for (int32 i = begin; i < end; i += DVKCullingBounds::Alignment)
+        {
+            int32 visible = ~(CullFunc(registers, bounds, i) | (CullFunc(registers, bounds, i + 4) << 4)) & 0xFF;
+
+            // 去掉补齐的部分
+            if (i + 8 > bounds.count)
+            {
+                visible &= (1 << MMath::Max(bounds.count - i, 0)) - 1;
+            }
+
+            // 无分支地写入：每一位都写，只有可见时才前进。num <= i - begin + bit，不会写出本块的范围
+            for (int32 bit = 0; bit < 8; ++bit)
+            {
+                outIndices[num] = i + bit;
+                num += (visible >> bit) & 1;
+            }
+        }
+
+        return num;
+    }
+
+#endif
+
+    int32 DVKFrustumCuller::CullRangeScalar(const DVKFrustum& frustum, const DVKCullingBounds& bounds, int32 begin, int32 end, Shape shape, int32* outIndices)
+    {
+        end = MMath::Min(end, bounds.count);
+
+        int32 num = 0;
+        for (int32 i = begin; i < end; ++i)
+        {
+            Vector3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+            bool visible = shape == Shape_Box ?
+                frustum.IntersectBox(center, Vector3(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i])) :
+                frustum.IntersectSphere(center, bounds.radius[i]);
+            if (visible)
+            {
+                outIndices[num++] = i;
+            }
+        }
+
+        return num;
+    }
+
+    int32 DVKFrustumCuller::CullRange(const DVKFrustum& frustum, const DVKCullingBounds& bounds, int32 begin, int32 end, Shape shape, int32* outIndices)
+    {
+#if PLATFORM_MATH_SIMD
+        if (simd)
+        {
+            return shape == Shape_Box ?
+                CullRangeSIMD<CullBoxes4>(frustum, bounds, begin, end, outIndices) :
+                CullRangeSIMD<CullSpheres4>(frustum, bounds, begin, end, outIndices);
+        }
+#endif
+        return CullRangeScalar(frustum, bounds, begin, end, shape, outIndices);
+    }
+
+    int32 DVKFrustumCuller::Cull(const DVKFrustum& frustum, const DVKCullingBounds& bounds, DVKVisibleList& outVisible, Shape shape)
+    {
+        CPU_PROFILE_SCOPE("DVKFrustumCuller::Cull");
+
+        double beginTime = GenericPlatformTime::Seconds();
+
+        // 上一次的结果换到previous，两块内存交替使用
+        int32 capacity      = bounds.GetCapacity();
+        int32 previousCount = outVisible.count;
+        outVisible.previous.swap(outVisible.indices);
+        outVisible.indices.resize(capacity);
+
+        int32* indices = outVisible.indices.data();
+        int32  count   = 0;
+
+        int32 numChunks = (capacity + ChunkSize - 1) / ChunkSize;
+        if (parallel && numChunks > 1 && bounds.count >= parallelThreshold && ThreadPool::Get().GetNumThreads() > 0)
+        {
+            // 每块写到indices中与自己对应的区间，再依次前移合并
+            outVisible.chunkCounts.resize(numChunks);
+            ThreadPool::Get().ParallelFor(numChunks, [&](int32 chunk)
+            {
+                int32 begin = chunk * ChunkSize;
+                int32 end   = MMath::Min(begin + (int32)ChunkSize, capacity);
+                outVisible.chunkCounts[chunk] = CullRange(frustum, bounds, begin, end, shape, indices + begin);
+            });
+
+            for (int32 chunk = 0; chunk < numChunks; ++chunk)
+            {
+                int32 begin = chunk * ChunkSize;
+                if (begin != count)
+                {
+                    memmove(indices + count, indices + begin, outVisible.chunkCounts[chunk] * sizeof(int32));
+                }
+                count += outVisible.chunkCounts[chunk];
+            }
+        }
+        else
+        {
+            count = CullRange(frustum, bounds, 0, capacity, shape, indices);
+        }
+
+        outVisible.count   = count;
+        outVisible.changed = count != previousCount || (count > 0 && memcmp(indices, outVisible.previous.data(), count * sizeof(int32)) != 0);
+
+        numCulls   += 1;
+        numTested  += bounds.count;
+        numVisible += count;
+        cullTime   += GenericPlatformTime::Seconds() - beginTime;
+
+        return count;
+    }
+
+    void DVKFrustumCuller::PrintStats()
+    {
+        if (numCulls == 0)
+        {
+            return;
+        }
+
+        MLOG("Frustum culling stats : %d culls, %lld tested, %.1f%% visible, %.3fms/cull",
+            numCulls,
+            (long long)numTested,
+            numTested > 0 ? numVisible * 100.0 / numTested : 0.0,
+            cullTime * 1000.0 / numCulls
+        );
+    }
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "DVKModel.h"
+
+#include "Common/Common.h"
+#include "Math/Math.h"
+#include "Math/Plane.h"
+#include "Math/Vector3.h"
+#include "Math/Matrix4x4.h"
+
+#include <vector>
+
+namespace vk_demo
+{
+    // 视锥体的6个平面，法线朝外并已归一化，PlaneDot > 0 在平面外侧
+    struct DVKFrustum
+    {
+        enum
+        {
+            NumPlanes = 6,
+        };
+
+        // viewProjection = View * Projection，与DVKCamera::GetViewProjection一致；传入World * View * Projection时平面在模型空间
+        void Set(const Matrix4x4& viewProjection);
+
+        FORCE_INLINE bool IntersectBox(const Vector3& center, const Vector3& extent) const
+        {
+            for (int32 i = 0; i < NumPlanes; ++i)
+            {
+                const Plane& plane = planes[i];
+                float distance = plane.PlaneDot(center);
+                float radius   = MMath::Abs(plane.x) * extent.x + MMath::Abs(plane.y) * extent.y + MMath::Abs(plane.z) * extent.z;
+                if (distance > radius)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        FORCE_INLINE bool IntersectSphere(const Vector3& center, float radius) const
+        {
+            for (int32 i = 0; i < NumPlanes; ++i)
+            {
+                if (planes[i].PlaneDot(center) > radius)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        Plane planes[NumPlanes];
+    };
+
+    // 世界空间包围体，按分量分开存放(SoA)，数量补齐到8的倍数，一次测试4~8个。
+    // SetBox同时写入包围盒的外接球，SetSphere同时写入球的外接盒，任意一种测试都是保守的。
+    class DVKCullingBounds
+    {
+    public:
+        enum
+        {
+            Alignment = 8,
+        };
+
+        // 补齐部分的包围体在原点，结果中会被去掉
+        void Resize(int32 inCount);
+
+        // 局部包围盒经world变换后的世界空间AABB
+        void SetBox(int32 index, const DVKBoundingBox& bounding, const Matrix4x4& world);
+
+        void SetBox(int32 index, const Vector3& min, const Vector3& max);
+
+        void SetSphere(int32 index, const Vector3& center, float radius);
+
+        FORCE_INLINE int32 GetCapacity() const
+        {
+            return (int32)centerX.size();
+        }
+
+    public:
+        int32               count = 0;
+
+        std::vector<float>  centerX;
+        std::vector<float>  centerY;
+        std::vector<float>  centerZ;
+        std::vector<float>  extentX;
+        std::vector<float>  extentY;
+        std::vector<float>  extentZ;
+        std::vector<float>  radius;
+    };
+
+    // 可见的包围体索引，按升序紧密排列。内存在帧之间复用，changed表示与上一次结果不同(需要重新录制绘制命令)。
+    struct DVKVisibleList
+    {
+        // 不剔除，0 ... inCount - 1全部可见
+        void SetAllVisible(int32 inCount);
+
+        FORCE_INLINE int32 operator[](int32 index) const
+        {
+            return indices[index];
+        }
+
+        std::vector<int32>  indices;
+        int32               count = 0;
+        bool                changed = true;
+
+        // 上一次的结果与多线程时各块的计数
+        std::vector<int32>  previous;
+        std::vector<int32>  chunkCounts;
+    };
+
+    // 批量视锥剔除：SSE/NEON一次处理两组各4个包围体，其余平台使用标量实现。
+    // 数量不少于parallelThreshold时按ChunkSize分块交给ThreadPool，各块写到自己的区间后再合并。
+    class DVKFrustumCuller
+    {
+    public:
+        enum
+        {
+            ChunkSize = 4096,
+        };
+
+        enum Shape
+        {
+            Shape_Box = 0,
+            Shape_Sphere,
+        };
+
+        // 剔除bounds中的全部包围体，结果写入outVisible，返回可见数量
+        static int32 Cull(const DVKFrustum& frustum, const DVKCullingBounds& bounds, DVKVisibleList& outVisible, Shape shape = Shape_Box);
+
+        // 测试[begin, end)，可见的索引写入outIndices，返回数量。begin为8的倍数
+        static int32 CullRange(const DVKFrustum& frustum, const DVKCullingBounds& bounds, int32 begin, int32 end, Shape shape, int32* outIndices);
+
+        static int32 CullRangeScalar(const DVKFrustum& frustum, const DVKCullingBounds& bounds, int32 begin, int32 end, Shape shape, int32* outIndices);
+
+        static void PrintStats();
+
+    public:
+        static bool     simd;
+        static bool     parallel;
+        static int32    parallelThreshold;
+
+        static uint32   numCulls;
+        static uint64   numTested;
+        static uint64   numVisible;
+        static double   cullTime;
+    };
+}
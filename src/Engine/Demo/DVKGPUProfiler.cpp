@@ -0,0 +1,389 @@
+#include "DVKGPUProfiler.h"
+#include "FileManager.h"
+
+#include "Common/Log.h"
+#include "Math/Math.h"
+#include "Vulkan/VulkanDevice.h"
+#include "Vulkan/VulkanQueue.h"
+
+#include "imgui.h"
+
+#include <cstdio>
+
+namespace vk_demo
+{
+    static const VkQueryPipelineStatisticFlags StatisticFlags =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+    // 与StatisticFlags的位顺序一致
+    static const char* StatisticNames[DVKGPUTiming::NumStatistics] = {
+        "ia_vertices",
+        "ia_primitives",
+        "vs_invocations",
+        "clip_primitives",
+        "fs_invocations",
+        "cs_invocations",
+    };
+
+    DVKGPUProfiler::~DVKGPUProfiler()
+    {
+        for (int32 i = 0; i < timestampPool.size(); ++i)
+        {
+            vkDestroyQueryPool(device, timestampPool[i], VULKAN_CPU_ALLOCATOR);
+        }
+        for (int32 i = 0; i < statisticsPool.size(); ++i)
+        {
+            vkDestroyQueryPool(device, statisticsPool[i], VULKAN_CPU_ALLOCATOR);
+        }
+        timestampPool.clear();
+        statisticsPool.clear();
+    }
+
+    DVKGPUProfiler* DVKGPUProfiler::Create(std::shared_ptr<VulkanDevice> vulkanDevice, int32 numSlots, int32 maxScopes)
+    {
+        DVKGPUProfiler* profiler = new DVKGPUProfiler();
+        profiler->device    = vulkanDevice->GetInstanceHandle();
+        profiler->maxScopes = MMath::Max(maxScopes, 1);
+        profiler->slots.resize(MMath::Max(numSlots, 1));
+
+        uint32 familyIndex = vulkanDevice->GetGraphicsQueue()->GetFamilyIndex();
+        uint32 validBits   = vulkanDevice->GetQueueFamilyProperties()[familyIndex].timestampValidBits;
+        if (validBits == 0)
+        {
+            MLOG("GPU profiler : timestamp not supported.");
+            return profiler;
+        }
+
+        profiler->timestampMask   = validBits >= 64 ? MAX_uint64 : ((uint64)1 << validBits) - 1;
+        profiler->timestampPeriod = vulkanDevice->GetLimits().timestampPeriod;
+
+        VkQueryPoolCreateInfo queryPoolInfo;
+        ZeroVulkanStruct(queryPoolInfo, VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO);
+        queryPoolInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = profiler->maxScopes * 2;
+
+        profiler->timestampPool.resize(profiler->slots.size());
+        for (int32 i = 0; i < profiler->timestampPool.size(); ++i)
+        {
+            VERIFYVULKANRESULT(vkCreateQueryPool(profiler->device, &queryPoolInfo, VULKAN_CPU_ALLOCATOR, &(profiler->timestampPool[i])));
+        }
+
+        // pipeline statistics是可选特性，不支持时只记录耗时
+        if (vulkanDevice->GetPhysicalFeatures().pipelineStatisticsQuery)
+        {
+            ZeroVulkanStruct(queryPoolInfo, VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO);
+            queryPoolInfo.queryType          = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            queryPoolInfo.queryCount         = profiler->maxScopes;
+            queryPoolInfo.pipelineStatistics = StatisticFlags;
+
+            profiler->statisticsPool.resize(profiler->slots.size());
+            for (int32 i = 0; i < profiler->statisticsPool.size(); ++i)
+            {
+                VERIFYVULKANRESULT(vkCreateQueryPool(profiler->device, &queryPoolInfo, VULKAN_CPU_ALLOCATOR, &(profiler->statisticsPool[i])));
+            }
+        }
+
+        MLOG("GPU profiler : %d slots, %d scopes, period %.2fns, %d valid bits, pipeline statistics %s",
+            (int32)profiler->slots.size(),
+            profiler->maxScopes,
+            profiler->timestampPeriod,
+            validBits,
+            profiler->statisticsPool.size() > 0 ? "supported" : "not supported"
+        );
+
+        return profiler;
+    }
+
+    void DVKGPUProfiler::Readback(int32 slot)
+    {
+        if (!IsSupported())
+        {
+            return;
+        }
+
+        SlotInfo& slotInfo = slots[slot % slots.size()];
+        VkQueryPool timestamps = timestampPool[slot % slots.size()];
+
+        // 第一次调用发生在该slot首次提交之前，query还未被重置过
+        if (!slotInfo.submitted)
+        {
+            slotInfo.submitted = true;
+            return;
+        }
+
+        if (slotInfo.scopes.size() == 0)
+        {
+            return;
+        }
+
+        int32 numScopes = (int32)slotInfo.scopes.size();
+        std::vector<uint64> values(numScopes * 2);
+
+        // 不带WAIT标记，结果未就绪时保留上一次的数据
+        VkResult result = vkGetQueryPoolResults(device, timestamps, 0, numScopes * 2, values.size() * sizeof(uint64), values.data(), sizeof(uint64), VK_QUERY_RESULT_64_BIT);
+        if (result != VK_SUCCESS)
+        {
+            numNotReady += 1;
+            return;
+        }
+
+        std::vector<uint64> statistics;
+        if (slotInfo.numStatistics > 0)
+        {
+            statistics.resize(slotInfo.numStatistics * DVKGPUTiming::NumStatistics);
+            result = vkGetQueryPoolResults(device, statisticsPool[slot % slots.size()], 0, slotInfo.numStatistics, statistics.size() * sizeof(uint64), statistics.data(), DVKGPUTiming::NumStatistics * sizeof(uint64), VK_QUERY_RESULT_64_BIT);
+            if (result != VK_SUCCESS)
+            {
+                statistics.clear();
+            }
+        }
+
+        // scope布局不变时沿用平滑值，否则重新开始
+        bool sameLayout = timings.size() == numScopes;
+        timings.resize(numScopes);
+        frameTime = 0.0;
+
+        for (int32 i = 0; i < numScopes; ++i)
+        {
+            const ScopeInfo& scope = slotInfo.scopes[i];
+            DVKGPUTiming& timing   = timings[i];
+
+            if (!sameLayout || timing.name != scope.name)
+            {
+                timing.name    = scope.name;
+                timing.avgTime = -1.0;
+            }
+
+            uint64 ticks = ((values[i * 2 + 1] & timestampMask) - (values[i * 2 + 0] & timestampMask)) & timestampMask;
+
+            timing.depth   = scope.depth;
+            timing.parent  = scope.parent;
+            timing.time    = (double)ticks * timestampPeriod / 1000000.0;
+            timing.avgTime = timing.avgTime < 0.0 ? timing.time : timing.avgTime * 0.9 + timing.time * 0.1;
+
+            timing.hasStatistics = scope.statisticsQuery >= 0 && statistics.size() > 0;
+            for (int32 j = 0; j < DVKGPUTiming::NumStatistics; ++j)
+            {
+                timing.statistics[j] = timing.hasStatistics ? statistics[scope.statisticsQuery * DVKGPUTiming::NumStatistics + j] : 0;
+            }
+
+            if (scope.depth == 0)
+            {
+                frameTime += timing.time;
+            }
+        }
+
+        numReadbacks += 1;
+
+        if (capture)
+        {
+            CaptureTimings();
+        }
+    }
+
+    void DVKGPUProfiler::BeginRecord(VkCommandBuffer commandBuffer, int32 slot)
+    {
+        if (!IsSupported())
+        {
+            return;
+        }
+
+        if (scopeStack.size() > 0)
+        {
+            MLOGE("GPU profiler : %d scopes not ended.", (int32)scopeStack.size());
+            scopeStack.clear();
+        }
+
+        recordSlot       = slot % slots.size();
+        activeStatistics = -1;
+
+        SlotInfo& slotInfo = slots[recordSlot];
+        slotInfo.scopes.clear();
+        slotInfo.numStatistics = 0;
+
+        vkCmdResetQueryPool(commandBuffer, timestampPool[recordSlot], 0, maxScopes * 2);
+        if (statisticsPool.size() > 0)
+        {
+            vkCmdResetQueryPool(commandBuffer, statisticsPool[recordSlot], 0, maxScopes);
+        }
+    }
+
+    void DVKGPUProfiler::BeginScope(VkCommandBuffer commandBuffer, const char* name, bool pipelineStatistics)
+    {
+        if (recordSlot < 0)
+        {
+            return;
+        }
+
+        SlotInfo& slotInfo = slots[recordSlot];
+        if (slotInfo.scopes.size() >= maxScopes)
+        {
+            numOverflows += 1;
+            scopeStack.push_back(-1);
+            return;
+        }
+
+        int32 index = (int32)slotInfo.scopes.size();
+
+        ScopeInfo scope;
+        scope.name   = name;
+        scope.depth  = (int32)scopeStack.size();
+        scope.parent = -1;
+        for (int32 i = (int32)scopeStack.size() - 1; i >= 0 && scope.parent < 0; --i)
+        {
+            scope.parent = scopeStack[i];
+        }
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool[recordSlot], index * 2 + 0);
+
+        if (pipelineStatistics && statisticsPool.size() > 0 && activeStatistics < 0)
+        {
+            scope.statisticsQuery = slotInfo.numStatistics++;
+            activeStatistics      = index;
+            vkCmdBeginQuery(commandBuffer, statisticsPool[recordSlot], scope.statisticsQuery, 0);
+        }
+
+        slotInfo.scopes.push_back(scope);
+        scopeStack.push_back(index);
+    }
+
+    void DVKGPUProfiler::EndScope(VkCommandBuffer commandBuffer)
+    {
+        if (recordSlot < 0)
+        {
+            return;
+        }
+
+        if (scopeStack.size() == 0)
+        {
+            MLOGE("GPU profiler : EndScope without BeginScope.");
+            return;
+        }
+
+        int32 index = scopeStack.back();
+        scopeStack.pop_back();
+        if (index < 0)
+        {
+            return;
+        }
+
+        const ScopeInfo& scope = slots[recordSlot].scopes[index];
+        if (activeStatistics == index)
+        {
+            vkCmdEndQuery(commandBuffer, statisticsPool[recordSlot], scope.statisticsQuery);
+            activeStatistics = -1;
+        }
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool[recordSlot], index * 2 + 1);
+    }
+
+    void DVKGPUProfiler::DrawOverlay()
+    {
+        ImGuiIO& io = ImGui::GetIO();
+        ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x - 10.0f, 10.0f), ImGuiSetCond_FirstUseEver, ImVec2(1.0f, 0.0f));
+        ImGui::Begin("GPU Profiler", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+        if (!IsSupported())
+        {
+            ImGui::Text("Timestamp not supported");
+            ImGui::End();
+            return;
+        }
+
+        ImGui::Text("GPU %.3f ms", frameTime);
+
+        double maxTime = 0.0;
+        for (int32 i = 0; i < timings.size(); ++i)
+        {
+            maxTime = MMath::Max(maxTime, timings[i].avgTime);
+        }
+
+        char overlay[64];
+        for (int32 i = 0; i < timings.size(); ++i)
+        {
+            const DVKGPUTiming& timing = timings[i];
+
+            ImGui::Indent(timing.depth * 12.0f + 1.0f);
+            sprintf(overlay, "%.3f ms", timing.avgTime);
+            ImGui::ProgressBar(maxTime > 0.0 ? (float)(timing.avgTime / maxTime) : 0.0f, ImVec2(100.0f, 0.0f), overlay);
+            ImGui::SameLine();
+            ImGui::Text("%s", timing.name.c_str());
+            if (timing.hasStatistics && ImGui::IsItemHovered())
+            {
+                ImGui::BeginTooltip();
+                for (int32 j = 0; j < DVKGPUTiming::NumStatistics; ++j)
+                {
+                    ImGui::Text("%-16s %llu", StatisticNames[j], (unsigned long long)timing.statistics[j]);
+                }
+                ImGui::EndTooltip();
+            }
+            ImGui::Unindent(timing.depth * 12.0f + 1.0f);
+        }
+
+        ImGui::End();
+    }
+
+    void DVKGPUProfiler::SetCapture(bool enable)
+    {
+        capture = enable;
+    }
+
+    void DVKGPUProfiler::CaptureTimings()
+    {
+        if (numCaptured >= MaxCaptureFrames)
+        {
+            return;
+        }
+
+        // scope名字带上父节点，例如 Frame/GBuffer
+        std::vector<std::string> paths(timings.size());
+        char line[512];
+        for (int32 i = 0; i < timings.size(); ++i)
+        {
+            const DVKGPUTiming& timing = timings[i];
+            paths[i] = timing.parent >= 0 ? paths[timing.parent] + "/" + timing.name : timing.name;
+
+            int32 length = snprintf(line, sizeof(line), "%d,%s,%d,%.6f", numReadbacks, paths[i].c_str(), timing.depth, timing.time);
+            captureData.append(line, MMath::Min<int32>(length, sizeof(line) - 1));
+            for (int32 j = 0; j < DVKGPUTiming::NumStatistics; ++j)
+            {
+                if (timing.hasStatistics) {
+                    length = snprintf(line, sizeof(line), ",%llu", (unsigned long long)timing.statistics[j]);
+                    captureData.append(line, length);
+                }
+                else {
+                    captureData.append(",");
+                }
+            }
+            captureData.append("\n");
+        }
+
+        numCaptured += 1;
+    }
+
+    bool DVKGPUProfiler::WriteCSV(const std::string& filename)
+    {
+        std::string content = "frame,scope,depth,time_ms";
+        for (int32 j = 0; j < DVKGPUTiming::NumStatistics; ++j)
+        {
+            content += ",";
+            content += StatisticNames[j];
+        }
+        content += "\n";
+        content += captureData;
+
+        if (!FileManager::WriteFile(filename, (const uint8*)content.data(), content.size()))
+        {
+            MLOGE("GPU profiler : failed write %s", filename.c_str());
+            return false;
+        }
+
+        MLOG("GPU profiler : %d frames written to %s, %d readbacks, %d not ready, %d overflows", numCaptured, filename.c_str(), numReadbacks, numNotReady, numOverflows);
+        return true;
+    }
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "Common/Common.h"
+
+#include "Vulkan/VulkanCommon.h"
+#include "vulkan/vulkan_core.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class VulkanDevice;
+
+namespace vk_demo
+{
+    struct DVKGPUTiming
+    {
+        enum
+        {
+            // input assembly vertices/primitives, vertex shader, clipping primitives, fragment shader, compute shader
+            NumStatistics = 6,
+        };
+
+        std::string     name;
+        int32           depth = 0;
+        int32           parent = -1;
+        double          time = 0.0;         // ms
+        double          avgTime = 0.0;      // ms，指数平滑，用于界面显示
+        bool            hasStatistics = false;
+        uint64          statistics[NumStatistics] = {};
+    };
+
+    // GPU分段计时。每个slot一组query pool，对应一个command buffer。
+    // 录制时用BeginScope/EndScope包住一段命令，前后各写一个timestamp，可嵌套；
+    // 读回在slot的fence等待之后进行，取的是该slot上一次提交的结果，不会等待GPU。
+    // 按帧槽位使用时结果落后N个在途帧，按swapchain image使用时落后image数量帧。
+    class DVKGPUProfiler
+    {
+    private:
+        DVKGPUProfiler()
+        {
+
+        }
+
+    public:
+        ~DVKGPUProfiler();
+
+        static DVKGPUProfiler* Create(std::shared_ptr<VulkanDevice> vulkanDevice, int32 numSlots, int32 maxScopes = 64);
+
+        // 必须在slot对应的fence等待之后、再次提交之前调用
+        void Readback(int32 slot);
+
+        // 录制command buffer开头调用，必须在render pass之外
+        void BeginRecord(VkCommandBuffer commandBuffer, int32 slot);
+
+        // pipelineStatistics为true时同时统计这段命令的pipeline statistics。
+        // 统计query不能嵌套，在render pass内时必须在同一个subpass中结束。
+        void BeginScope(VkCommandBuffer commandBuffer, const char* name, bool pipelineStatistics = false);
+
+        void EndScope(VkCommandBuffer commandBuffer);
+
+        // 在ImageGUIContext的StartFrame与EndFrame之间调用
+        void DrawOverlay();
+
+        // 开启后每次读回的结果都会记录下来，用于WriteCSV
+        void SetCapture(bool enable);
+
+        bool WriteCSV(const std::string& filename);
+
+        FORCE_INLINE bool IsSupported() const
+        {
+            return timestampPool.size() > 0;
+        }
+
+    private:
+
+        struct ScopeInfo
+        {
+            std::string name;
+            int32       depth = 0;
+            int32       parent = -1;
+            int32       statisticsQuery = -1;
+        };
+
+        struct SlotInfo
+        {
+            std::vector<ScopeInfo>  scopes;
+            int32                   numStatistics = 0;
+            bool                    submitted = false;
+        };
+
+        void CaptureTimings();
+
+    public:
+
+        enum
+        {
+            MaxCaptureFrames = 10000,
+        };
+
+        VkDevice                        device = VK_NULL_HANDLE;
+        std::vector<VkQueryPool>        timestampPool;
+        std::vector<VkQueryPool>        statisticsPool;
+        std::vector<SlotInfo>           slots;
+
+        int32                           maxScopes = 64;
+        uint64                          timestampMask = 0;
+        double                          timestampPeriod = 1.0;  // ns per tick
+
+        int32                           recordSlot = -1;
+        std::vector<int32>              scopeStack;
+        int32                           activeStatistics = -1;
+
+        std::vector<DVKGPUTiming>       timings;
+        double                          frameTime = 0.0;        // 顶层scope耗时之和，ms
+
+        bool                            capture = false;
+        int32                           numCaptured = 0;
+        std::string                     captureData;
+
+        uint32                          numReadbacks = 0;
+        uint32                          numNotReady = 0;
+        uint32                          numOverflows = 0;
+    };
+
+    class DVKGPUScope
+    {
+    public:
+        DVKGPUScope(DVKGPUProfiler* inProfiler, VkCommandBuffer inCommandBuffer, const char* name, bool pipelineStatistics = false)
+            : profiler(inProfiler)
+            , commandBuffer(inCommandBuffer)
+        {
+            if (profiler)
+            {
+                profiler->BeginScope(commandBuffer, name, pipelineStatistics);
+            }
+        }
+
+        ~DVKGPUScope()
+        {
+            if (profiler)
+            {
+                profiler->EndScope(commandBuffer);
+            }
+        }
+
+    private:
+        DVKGPUProfiler*     profiler;
+        VkCommandBuffer     commandBuffer;
+    };
+}
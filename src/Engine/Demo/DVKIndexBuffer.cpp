@@ -21,7 +21,7 @@ namespace vk_demo
         indices.size()*sizeof(uint32),
         indices.data());
 
-        indexBuffer->dvkBuffer = vk_demo::DVKBuffer::CreateBuffer(vulkanDevice,VK_BUFFER_USAGE_INDEX_BUFFER_BIT|VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        indexBuffer->dvkBuffer = vk_demo::DVKBuffer::CreateBuffer(vulkanDevice,VK_BUFFER_USAGE_INDEX_BUFFER_BIT|VK_BUFFER_USAGE_TRANSFER_DST_BIT|VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         indices.size()*sizeof(uint32));
 
@@ -58,7 +58,7 @@ namespace vk_demo
 
         indexBuffer->dvkBuffer = vk_demo::DVKBuffer::CreateBuffer(
             vulkanDevice,
-            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
             indices.size() * sizeof(uint16)
         );
@@ -78,5 +78,51 @@ namespace vk_demo
         return indexBuffer;
      }
 
- 
-}
\ No newline at end of file
+    DVKIndexBuffer* DVKIndexBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const std::vector<uint16>& indices)
+    {
+        return Create(vulkanDevice, uploader, indices.data(), (int32)indices.size());
+    }
+
+    DVKIndexBuffer* DVKIndexBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const uint16* indices, int32 count)
+    {
+        DVKIndexBuffer* indexBuffer = new DVKIndexBuffer();
+        indexBuffer->device     = vulkanDevice->GetInstanceHandle();
+        indexBuffer->indexCount = count;
+        indexBuffer->indexType  = VK_INDEX_TYPE_UINT16;
+
+        indexBuffer->dvkBuffer = vk_demo::DVKBuffer::CreateBuffer(
+            vulkanDevice,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            count * sizeof(uint16)
+        );
+
+        uploader->UploadBuffer(indexBuffer->dvkBuffer, indices, count * sizeof(uint16));
+
+        return indexBuffer;
+    }
+
+    DVKIndexBuffer* DVKIndexBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const std::vector<uint32>& indices)
+    {
+        return Create(vulkanDevice, uploader, indices.data(), (int32)indices.size());
+    }
+
+    DVKIndexBuffer* DVKIndexBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const uint32* indices, int32 count)
+    {
+        DVKIndexBuffer* indexBuffer = new DVKIndexBuffer();
+        indexBuffer->device     = vulkanDevice->GetInstanceHandle();
+        indexBuffer->indexCount = count;
+        indexBuffer->indexType  = VK_INDEX_TYPE_UINT32;
+
+        indexBuffer->dvkBuffer = vk_demo::DVKBuffer::CreateBuffer(
+            vulkanDevice,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            count * sizeof(uint32)
+        );
+
+        uploader->UploadBuffer(indexBuffer->dvkBuffer, indices, count * sizeof(uint32));
+
+        return indexBuffer;
+    }
+}
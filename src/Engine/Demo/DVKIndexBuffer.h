@@ -3,6 +3,7 @@
 #include "Engine.h"
 #include "DVKBuffer.h"
 #include "DVKCommand.h"
+#include "DVKUploadQueue.h"
 
 #include "Common/Common.h"
 #include "Math/Math.h"
@@ -40,6 +41,10 @@ namespace vk_demo
         }
         static DVKIndexBuffer* Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, std::vector<uint16> indices);
         static DVKIndexBuffer* Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, std::vector<uint32> indices);
+        static DVKIndexBuffer* Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const std::vector<uint16>& indices);
+        static DVKIndexBuffer* Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const std::vector<uint32>& indices);
+        static DVKIndexBuffer* Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const uint16* indices, int32 count);
+        static DVKIndexBuffer* Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const uint32* indices, int32 count);
         
         public:
         VkDevice        device = VK_NULL_HANDLE;
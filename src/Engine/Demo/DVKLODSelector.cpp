@@ -0,0 +1,105 @@
+#include "DVKLODSelector.h"
+
+#include "Common/Log.h"
+#include "Math/Math.h"
+#include "Math/Vector3.h"
+
+#include <cstring>
+
+namespace vk_demo
+{
+    bool   DVKLODSelector::enabled            = true;
+    float  DVKLODSelector::pixelError         = 1.0f;
+    int32  DVKLODSelector::forceLOD           = -1;
+    uint32 DVKLODSelector::frameMeshes        = 0;
+    uint64 DVKLODSelector::frameTriangles     = 0;
+    uint64 DVKLODSelector::frameBaseTriangles = 0;
+    uint32 DVKLODSelector::frameLODs[DVKMeshSimplifier::MaxLODs + 1] = {};
+
+    void DVKLODSelector::BeginFrame()
+    {
+        frameMeshes        = 0;
+        frameTriangles     = 0;
+        frameBaseTriangles = 0;
+        memset(frameLODs, 0, sizeof(frameLODs));
+    }
+
+    float DVKLODSelector::ProjectError(float error, const Matrix4x4& world, const DVKBoundingBox& bounding, DVKCamera& camera, float viewportHeight)
+    {
+        const Matrix4x4& projection = camera.GetProjection();
+
+        float scale  = world.GetMaximumAxisScale();
+        float pixels = error * scale * projection.m[1][1] * viewportHeight * 0.5f;
+
+        // Perspective时m[2][3]为1，Orthographic为0
+        if (projection.m[2][3] != 0.0f)
+        {
+            Vector3 center   = world.TransformPosition((bounding.min + bounding.max) * 0.5f);
+            float   radius   = (bounding.max - bounding.min).Size() * 0.5f * scale;
+            float   distance = (center - camera.GetTransform().GetOrigin()).Size() - radius;
+            pixels /= MMath::Max(distance, camera.GetNear());
+        }
+
+        return pixels;
+    }
+
+    bool DVKLODSelector::Select(DVKMesh* mesh, const Matrix4x4& world, DVKCamera& camera, float viewportHeight)
+    {
+        int32 lodCount = mesh->GetLODCount();
+        int32 lod      = 0;
+
+        if (forceLOD >= 0)
+        {
+            lod = MMath::Min(forceLOD, lodCount - 1);
+        }
+        else if (enabled)
+        {
+            // 误差单调递增，从最粗的一级往回找
+            for (lod = lodCount - 1; lod > 0; --lod)
+            {
+                if (ProjectError(mesh->lodErrors[lod], world, mesh->bounding, camera, viewportHeight) <= pixelError)
+                {
+                    break;
+                }
+            }
+        }
+
+        bool changed = mesh->lodIndex != lod;
+        mesh->SetLOD(lod);
+
+        frameMeshes        += 1;
+        frameTriangles     += mesh->GetTriangleCount(lod);
+        frameBaseTriangles += mesh->GetTriangleCount(0);
+        frameLODs[MMath::Min<int32>(lod, DVKMeshSimplifier::MaxLODs)] += 1;
+
+        return changed;
+    }
+
+    float DVKLODSelector::GetReduction()
+    {
+        if (frameBaseTriangles == 0)
+        {
+            return 0.0f;
+        }
+        return 1.0f - (float)((double)frameTriangles / frameBaseTriangles);
+    }
+
+    void DVKLODSelector::PrintStats()
+    {
+        if (frameMeshes == 0)
+        {
+            return;
+        }
+
+        MLOG("LOD stats : %d meshes, %d -> %d triangles (-%.1f%%), LOD0-3 %d/%d/%d/%d",
+            frameMeshes,
+            (int32)frameBaseTriangles,
+            (int32)frameTriangles,
+            GetReduction() * 100.0f,
+            frameLODs[0],
+            frameLODs[1],
+            frameLODs[2],
+            frameLODs[3]
+        );
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "DVKModel.h"
+#include "DVKCamera.h"
+#include "DVKMeshSimplifier.h"
+
+#include "Common/Common.h"
+#include "Math/Matrix4x4.h"
+
+namespace vk_demo
+{
+    // 按屏幕空间误差选择LOD：mesh空间误差乘以世界矩阵的最大缩放，除以相机到包围球最近点的距离，
+    // 再乘以投影矩阵的y缩放与视口半高换算为像素，选择不超过pixelError的最粗一级。正交投影不除距离。
+    class DVKLODSelector
+    {
+    public:
+        // 每帧选择之前清空当前帧的统计
+        static void BeginFrame();
+
+        // 选择并设置mesh的LOD，返回是否发生变化(需要重新录制绘制命令)
+        static bool Select(DVKMesh* mesh, const Matrix4x4& world, DVKCamera& camera, float viewportHeight);
+
+        // mesh空间的误差在屏幕上对应的像素
+        static float ProjectError(float error, const Matrix4x4& world, const DVKBoundingBox& bounding, DVKCamera& camera, float viewportHeight);
+
+        // 当前帧相对全部使用LOD0减少的三角形比例
+        static float GetReduction();
+
+        static void PrintStats();
+
+    public:
+        static bool     enabled;
+        static float    pixelError;
+        static int32    forceLOD;       // 不小于0时所有mesh固定使用该级
+
+        static uint32   frameMeshes;
+        static uint64   frameTriangles;
+        static uint64   frameBaseTriangles;
+        static uint32   frameLODs[DVKMeshSimplifier::MaxLODs + 1];
+    };
+}
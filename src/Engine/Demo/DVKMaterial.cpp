@@ -0,0 +1,593 @@
+#include "DVKMaterial.h"
+
+#include "Common/Log.h"
+#include "Vulkan/VulkanDevice.h"
+
+namespace vk_demo
+{
+    DVKRingBuffer*  DVKMaterial::ringBuffer = nullptr;
+    int32           DVKMaterial::ringBufferRefCount = 0;
+
+    // -------------------------------------------- DVKRingBuffer --------------------------------------------
+
+    DVKRingBuffer::~DVKRingBuffer()
+    {
+        for (int32 i = 0; i < retiredBuffers.size(); ++i)
+        {
+            retiredBuffers[i].buffer->UnMap();
+            delete retiredBuffers[i].buffer;
+        }
+        retiredBuffers.clear();
+
+        if (realBuffer)
+        {
+            realBuffer->UnMap();
+            delete realBuffer;
+            realBuffer = nullptr;
+        }
+    }
+
+    DVKRingBuffer* DVKRingBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, uint64 size)
+    {
+        DVKRingBuffer* ringBuffer = new DVKRingBuffer();
+        ringBuffer->vulkanDevice = vulkanDevice;
+        ringBuffer->device       = vulkanDevice->GetInstanceHandle();
+        ringBuffer->minAlignment = (uint32)MMath::Max<VkDeviceSize>(vulkanDevice->GetLimits().minUniformBufferOffsetAlignment, 16);
+        ringBuffer->bufferSize   = Align<uint64>(size, ringBuffer->minAlignment);
+        // 初始化阶段的上传算作第一帧
+        ringBuffer->frameNumber  = 1;
+        ringBuffer->realBuffer   = DVKBuffer::CreateBuffer(
+            vulkanDevice,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            ringBuffer->bufferSize
+        );
+        ringBuffer->realBuffer->Map();
+        return ringBuffer;
+    }
+
+    void DVKRingBuffer::BeginFrame(int32 frameIndex)
+    {
+        // 结束上一帧
+        frameRegions.push_back({ frameNumber, bufferOffset });
+        lastFrameBytes = frameBytes;
+        peakFrameBytes = MMath::Max(peakFrameBytes, frameBytes);
+        frameBytes     = 0;
+
+        // 该槽位上一次提交的帧已经完成，帧按顺序完成，之前的帧也都完成了
+        if (frameIndex >= slotFrames.size())
+        {
+            slotFrames.resize(frameIndex + 1, 0);
+        }
+        completedFrame = MMath::Max(completedFrame, slotFrames[frameIndex]);
+        frameNumber   += 1;
+        slotFrames[frameIndex] = frameNumber;
+
+        int32 numReleased = 0;
+        while (numReleased < frameRegions.size() && frameRegions[numReleased].frameNumber <= completedFrame)
+        {
+            bufferTail   = frameRegions[numReleased].end;
+            numReleased += 1;
+        }
+        frameRegions.erase(frameRegions.begin(), frameRegions.begin() + numReleased);
+
+        for (int32 i = (int32)retiredBuffers.size() - 1; i >= 0; --i)
+        {
+            if (retiredBuffers[i].frameNumber <= completedFrame)
+            {
+                retiredBuffers[i].buffer->UnMap();
+                delete retiredBuffers[i].buffer;
+                retiredBuffers.erase(retiredBuffers.begin() + i);
+            }
+        }
+    }
+
+    uint64 DVKRingBuffer::AllocateMemory(uint64 size)
+    {
+        uint64 position = Align<uint64>(bufferOffset, minAlignment);
+        uint64 offset   = position % bufferSize;
+
+        // 不能跨越buffer末尾，剩余的部分直接跳过
+        if (offset + size > bufferSize)
+        {
+            position += bufferSize - offset;
+            offset    = 0;
+        }
+
+        // 会覆盖GPU可能仍在读取的数据，换一个更大的buffer
+        if (position + size - bufferTail > bufferSize)
+        {
+            Grow(size);
+            position = 0;
+            offset   = 0;
+        }
+
+        bufferOffset = position + size;
+        frameBytes  += size;
+        totalBytes  += size;
+
+        return offset;
+    }
+
+    void DVKRingBuffer::Grow(uint64 size)
+    {
+        uint64 newSize = bufferSize * 2;
+        while (newSize < size)
+        {
+            newSize *= 2;
+        }
+
+        // 旧buffer中还有当前帧以及在途帧的数据，等当前帧完成后再释放
+        retiredBuffers.push_back({ realBuffer, frameNumber });
+
+        realBuffer = DVKBuffer::CreateBuffer(
+            vulkanDevice,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            newSize
+        );
+        realBuffer->Map();
+
+        MLOG("Uniform ring buffer grow : %lluKB -> %lluKB, %lluKB used this frame", bufferSize / 1024, newSize / 1024, frameBytes / 1024);
+
+        bufferSize   = newSize;
+        bufferOffset = 0;
+        bufferTail   = 0;
+        version     += 1;
+        numGrows    += 1;
+        frameRegions.clear();
+    }
+
+    void DVKRingBuffer::PrintStats()
+    {
+        MLOG("Uniform ring buffer stats : %lluKB, %d grows, %lluKB last frame, %lluKB peak frame, %lluKB total", bufferSize / 1024, numGrows, lastFrameBytes / 1024, peakFrameBytes / 1024, totalBytes / 1024);
+    }
+
+    // -------------------------------------------- DVKMaterial --------------------------------------------
+
+    void DVKMaterial::InitRingBuffer(std::shared_ptr<VulkanDevice> vulkanDevice)
+    {
+        ringBuffer = DVKRingBuffer::Create(vulkanDevice, 8 * 1024 * 1024);
+        ringBufferRefCount = 0;
+    }
+
+    void DVKMaterial::DestroyRingBuffer()
+    {
+        ringBuffer->PrintStats();
+        delete ringBuffer;
+        ringBuffer = nullptr;
+    }
+
+    void DVKMaterial::BeginRingBufferFrame(int32 frameIndex)
+    {
+        if (ringBuffer)
+        {
+            ringBuffer->BeginFrame(frameIndex);
+        }
+    }
+
+    uint64 DVKMaterial::GetFrameUploadBytes()
+    {
+        return ringBuffer ? ringBuffer->lastFrameBytes : 0;
+    }
+
+    DVKMaterial::~DVKMaterial()
+    {
+        shader = nullptr;
+
+        if (pipeline)
+        {
+            delete pipeline;
+            pipeline = nullptr;
+        }
+
+        ReleaseRetiredSets(true);
+
+        if (descriptorSet)
+        {
+            delete descriptorSet;
+            descriptorSet = nullptr;
+        }
+
+        uniformBuffers.clear();
+        storageBuffers.clear();
+        textures.clear();
+
+        ringBufferRefCount -= 1;
+        if (ringBufferRefCount == 0)
+        {
+            DestroyRingBuffer();
+        }
+    }
+
+    DVKMaterial* DVKMaterial::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKRenderTarget* renderTarget, VkPipelineCache pipelineCache, DVKShader* shader)
+    {
+        DVKMaterial* material = Create(vulkanDevice, renderTarget->GetRenderPass(), pipelineCache, shader);
+        material->pipelineInfo.colorAttachmentCount = renderTarget->rtLayout.numColorAttachments;
+        return material;
+    }
+
+    DVKMaterial* DVKMaterial::Create(std::shared_ptr<VulkanDevice> vulkanDevice, VkRenderPass renderPass, VkPipelineCache pipelineCache, DVKShader* shader)
+    {
+        // 所有material共用一个ring buffer
+        if (ringBufferRefCount == 0)
+        {
+            InitRingBuffer(vulkanDevice);
+        }
+        ringBufferRefCount += 1;
+
+        DVKMaterial* material   = new DVKMaterial();
+        material->vulkanDevice  = vulkanDevice;
+        material->shader        = shader;
+        material->renderPass    = renderPass;
+        material->pipelineCache = pipelineCache;
+        material->Prepare();
+
+        return material;
+    }
+
+    void DVKMaterial::Prepare()
+    {
+        descriptorSet     = shader->AllocateDescriptorSet();
+        ringBufferVersion = ringBuffer->version;
+
+        // 从Shader获取Buffer信息
+        for (auto it = shader->bufferParams.begin(); it != shader->bufferParams.end(); ++it)
+        {
+            DVKSimulateBuffer simulateBuffer = {};
+            simulateBuffer.set            = it->second.set;
+            simulateBuffer.binding        = it->second.binding;
+            simulateBuffer.dataSize       = it->second.bufferSize;
+            simulateBuffer.descriptorType = it->second.descriptorType;
+            simulateBuffer.stageFlags     = it->second.stageFlags;
+            simulateBuffer.bufferInfo     = {};
+
+            if (it->second.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
+            {
+                simulateBuffer.dataContent.resize(simulateBuffer.dataSize, 0);
+                uniformBuffers.insert(std::make_pair(it->first, simulateBuffer));
+            }
+            else if (it->second.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+            {
+                storageBuffers.insert(std::make_pair(it->first, simulateBuffer));
+            }
+            else
+            {
+                // uniform数据都放在ring buffer中，需要dynamic offset
+                MLOGE("Material uniform %s must be dynamic, create shader with dynamicUBO.", it->first.c_str());
+            }
+        }
+
+        // 设置Offset的索引，dynamic offset按照set以及binding的顺序排列
+        dynamicOffsetCount = 0;
+        std::vector<DVKDescriptorSetLayoutInfo>& setLayouts = shader->setLayoutsInfo.setLayouts;
+        for (int32 i = 0; i < setLayouts.size(); ++i)
+        {
+            std::vector<VkDescriptorSetLayoutBinding>& bindings = setLayouts[i].bindings;
+            for (int32 j = 0; j < bindings.size(); ++j)
+            {
+                for (auto it = uniformBuffers.begin(); it != uniformBuffers.end(); ++it)
+                {
+                    if (it->second.set == setLayouts[i].set && it->second.binding == bindings[j].binding)
+                    {
+                        it->second.dynamicIndex = dynamicOffsetCount;
+                        dynamicOffsetCount += 1;
+                        break;
+                    }
+                }
+            }
+        }
+        dynamicOffsets.resize(dynamicOffsetCount, 0);
+
+        // 从Shader中获取Texture信息，包含attachment信息
+        for (auto it = shader->imageParams.begin(); it != shader->imageParams.end(); ++it)
+        {
+            DVKSimulateTexture simulateTexture = {};
+            simulateTexture.set            = it->second.set;
+            simulateTexture.binding        = it->second.binding;
+            simulateTexture.descriptorType = it->second.descriptorType;
+            simulateTexture.stageFlag      = it->second.stageFlags;
+            simulateTexture.texture        = nullptr;
+            textures.insert(std::make_pair(it->first, simulateTexture));
+        }
+
+        WriteDescriptors(descriptorSet);
+
+        pipelineInfo.shader = shader;
+    }
+
+    void DVKMaterial::WriteDescriptors(DVKDescriptorSet* dstSet)
+    {
+        for (auto it = uniformBuffers.begin(); it != uniformBuffers.end(); ++it)
+        {
+            it->second.bufferInfo.buffer = ringBuffer->realBuffer->buffer;
+            it->second.bufferInfo.offset = 0;
+            it->second.bufferInfo.range  = it->second.dataSize;
+            dstSet->WriteBuffer(it->first, &(it->second.bufferInfo));
+        }
+
+        for (auto it = storageBuffers.begin(); it != storageBuffers.end(); ++it)
+        {
+            if (it->second.bufferInfo.buffer != VK_NULL_HANDLE)
+            {
+                dstSet->WriteBuffer(it->first, &(it->second.bufferInfo));
+            }
+        }
+
+        for (auto it = textures.begin(); it != textures.end(); ++it)
+        {
+            if (it->second.texture)
+            {
+                dstSet->WriteImage(it->first, it->second.texture);
+            }
+        }
+    }
+
+    void DVKMaterial::SwitchDescriptorSet()
+    {
+        // 之前的object以及在途帧仍在使用旧set，等当前帧完成后再释放
+        if (descriptorSet->IsDirty())
+        {
+            descriptorSet->Flush();
+        }
+        retiredSets.push_back({ descriptorSet, ringBuffer->frameNumber });
+
+        descriptorSet     = shader->AllocateDescriptorSet();
+        ringBufferVersion = ringBuffer->version;
+        WriteDescriptors(descriptorSet);
+    }
+
+    void DVKMaterial::ReleaseRetiredSets(bool immediately)
+    {
+        for (int32 i = (int32)retiredSets.size() - 1; i >= 0; --i)
+        {
+            if (immediately || retiredSets[i].frameNumber <= ringBuffer->completedFrame)
+            {
+                delete retiredSets[i].descriptorSet;
+                retiredSets.erase(retiredSets.begin() + i);
+            }
+        }
+    }
+
+    void DVKMaterial::PreparePipeline()
+    {
+        if (pipeline)
+        {
+            delete pipeline;
+            pipeline = nullptr;
+        }
+
+        pipeline = DVKGfxPipeline::Create(
+            vulkanDevice,
+            pipelineCache,
+            pipelineInfo,
+            shader->inputBindings,
+            shader->inputAttributes,
+            shader->pipelineLayout,
+            renderPass
+        );
+    }
+
+    void DVKMaterial::BeginFrame()
+    {
+        ReleaseRetiredSets(false);
+
+        perObjectIndexes.clear();
+        perObjectSets.clear();
+        globalOffsets.clear();
+
+        // 其它material让ring buffer换了buffer
+        if (ringBufferVersion != ringBuffer->version)
+        {
+            SwitchDescriptorSet();
+        }
+    }
+
+    void DVKMaterial::EndFrame()
+    {
+        if (descriptorSet->IsDirty())
+        {
+            descriptorSet->Flush();
+        }
+    }
+
+    void DVKMaterial::BeginObject()
+    {
+        perObjectIndexes.push_back((uint32)globalOffsets.size());
+        perObjectSets.push_back(descriptorSet);
+        globalOffsets.resize(globalOffsets.size() + dynamicOffsetCount, 0);
+    }
+
+    void DVKMaterial::EndObject()
+    {
+        if (perObjectIndexes.size() == 0)
+        {
+            MLOGE("EndObject called without BeginObject.");
+            return;
+        }
+
+        // local uniform每个object都上传，global uniform每帧只上传一次，
+        // 所有数据放在一段连续的空间中，保证同一个object的数据都在同一个buffer里
+        uint64 uploadSize = 0;
+        uint64 baseOffset = 0;
+        while (true)
+        {
+            uploadSize = 0;
+            for (auto it = uniformBuffers.begin(); it != uniformBuffers.end(); ++it)
+            {
+                const DVKSimulateBuffer& buffer = it->second;
+                if (!buffer.global || buffer.uploadFrame != ringBuffer->frameNumber || buffer.uploadVersion != ringBuffer->version)
+                {
+                    uploadSize = Align<uint64>(uploadSize, ringBuffer->minAlignment) + buffer.dataSize;
+                }
+            }
+
+            if (uploadSize == 0)
+            {
+                break;
+            }
+
+            baseOffset = ringBuffer->AllocateMemory(uploadSize);
+            if (ringBufferVersion == ringBuffer->version)
+            {
+                break;
+            }
+
+            // ring buffer换了buffer，后续object改用指向新buffer的set
+            SwitchDescriptorSet();
+        }
+
+        uint8* ringData   = ringBuffer->GetMappedData();
+        uint64 dataOffset = 0;
+        for (auto it = uniformBuffers.begin(); it != uniformBuffers.end(); ++it)
+        {
+            DVKSimulateBuffer& buffer = it->second;
+            if (buffer.global && buffer.uploadFrame == ringBuffer->frameNumber && buffer.uploadVersion == ringBuffer->version)
+            {
+                continue;
+            }
+
+            dataOffset = Align<uint64>(dataOffset, ringBuffer->minAlignment);
+            uint64 ringOffset = baseOffset + dataOffset;
+            memcpy(ringData + ringOffset, buffer.dataContent.data(), buffer.dataSize);
+            dataOffset += buffer.dataSize;
+
+            dynamicOffsets[buffer.dynamicIndex] = (uint32)ringOffset;
+            if (buffer.global)
+            {
+                buffer.uploadFrame   = ringBuffer->frameNumber;
+                buffer.uploadVersion = ringBuffer->version;
+            }
+        }
+
+        if (dynamicOffsetCount > 0)
+        {
+            uint32 index = perObjectIndexes.back();
+            memcpy(globalOffsets.data() + index, dynamicOffsets.data(), dynamicOffsetCount * sizeof(uint32));
+        }
+        perObjectSets.back() = descriptorSet;
+    }
+
+    void DVKMaterial::BindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, int32 objIndex)
+    {
+        DVKDescriptorSet* bindSet = descriptorSet;
+        uint32* bindOffsets = nullptr;
+
+        if (objIndex >= 0 && objIndex < perObjectIndexes.size())
+        {
+            bindSet     = perObjectSets[objIndex];
+            bindOffsets = globalOffsets.data() + perObjectIndexes[objIndex];
+        }
+        else if (dynamicOffsetCount > 0)
+        {
+            MLOGE("Material bind failed, invalid object index %d.", objIndex);
+            return;
+        }
+
+        if (bindSet->IsDirty())
+        {
+            bindSet->Flush();
+        }
+
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            bindPoint,
+            shader->pipelineLayout,
+            0,
+            (uint32)bindSet->descriptorSets.size(),
+            bindSet->descriptorSets.data(),
+            dynamicOffsetCount,
+            bindOffsets
+        );
+    }
+
+    void DVKMaterial::SetLocalUniform(const std::string& name, void* dataPtr, uint32 size)
+    {
+        auto it = uniformBuffers.find(name);
+        if (it == uniformBuffers.end())
+        {
+            MLOGE("Uniform %s not found.", name.c_str());
+            return;
+        }
+
+        if (it->second.dataSize != size)
+        {
+            MLOGE("Uniform %s size not match, dst=%u src=%u", name.c_str(), it->second.dataSize, size);
+            return;
+        }
+
+        it->second.global = false;
+        memcpy(it->second.dataContent.data(), dataPtr, size);
+    }
+
+    void DVKMaterial::SetGlobalUniform(const std::string& name, void* dataPtr, uint32 size)
+    {
+        auto it = uniformBuffers.find(name);
+        if (it == uniformBuffers.end())
+        {
+            MLOGE("Uniform %s not found.", name.c_str());
+            return;
+        }
+
+        if (it->second.dataSize != size)
+        {
+            MLOGE("Uniform %s size not match, dst=%u src=%u", name.c_str(), it->second.dataSize, size);
+            return;
+        }
+
+        // 数据变化后在下一个EndObject重新上传
+        it->second.global      = true;
+        it->second.uploadFrame = 0;
+        memcpy(it->second.dataContent.data(), dataPtr, size);
+    }
+
+    void DVKMaterial::SetTexture(const std::string& name, DVKTexture* texture)
+    {
+        auto it = textures.find(name);
+        if (it == textures.end())
+        {
+            MLOGE("Texture %s not found.", name.c_str());
+            return;
+        }
+
+        if (texture == nullptr)
+        {
+            MLOGE("Texture %s can't be null.", name.c_str());
+            return;
+        }
+
+        if (it->second.texture != texture)
+        {
+            it->second.texture = texture;
+            descriptorSet->WriteImage(name, texture);
+        }
+    }
+
+    void DVKMaterial::SetStorageBuffer(const std::string& name, DVKBuffer* buffer)
+    {
+        auto it = storageBuffers.find(name);
+        if (it == storageBuffers.end())
+        {
+            MLOGE("StorageBuffer %s not found.", name.c_str());
+            return;
+        }
+
+        if (buffer == nullptr)
+        {
+            MLOGE("StorageBuffer %s can't be null.", name.c_str());
+            return;
+        }
+
+        if (it->second.bufferInfo.buffer != buffer->buffer)
+        {
+            it->second.dataSize   = (uint32)buffer->size;
+            it->second.bufferInfo = buffer->descriptor;
+            descriptorSet->WriteBuffer(name, &(it->second.bufferInfo));
+        }
+    }
+
+    void DVKMaterial::SetInputAttachment(const std::string& name, DVKTexture* texture)
+    {
+        SetTexture(name, texture);
+    }
+}
@@ -5,7 +5,6 @@
 #include <memory>
 #include <unordered_map>
 #include <vector>
-#include <winnt.h>
 
 #include "Common/Common.h"
 #include "DVKUtils.h"
@@ -32,6 +31,9 @@ namespace vk_demo
         uint32 set = 0;
         uint32 binding = 0;
         uint32 dynamicIndex = 0;
+        // 最近一次写入ring buffer时的帧号与buffer版本，global uniform每帧只上传一次
+        uint64 uploadFrame = 0;
+        uint32 uploadVersion = 0;
         VkDescriptorType        descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         VkShaderStageFlags      stageFlags = 0;
         VkDescriptorBufferInfo  bufferInfo;
@@ -46,38 +48,74 @@ namespace vk_demo
         DVKTexture* texture = nullptr;
     };
 
+    // 按帧划分的uniform环形缓冲，常驻映射。
+    // 每帧结束时记录写到的位置，只有该帧的fence等待之后(BeginFrame传入同一个帧槽位)才回收这段空间。
+    // 空间不足时创建翻倍大小的新buffer，旧buffer在当前帧完成后释放，已分配的offset仍然指向旧buffer。
     class DVKRingBuffer
     {
-      public:
-        DVKRingBuffer()
+    private:
+        struct FrameRegion
         {
+            uint64      frameNumber;
+            uint64      end;
+        };
 
-        }
-        virtual ~DVKRingBuffer()
+        struct RetiredBuffer
+        {
+            DVKBuffer*  buffer;
+            uint64      frameNumber;
+        };
+
+    public:
+        DVKRingBuffer()
         {
-            realBuffer->UnMap();
-            delete realBuffer;
-            realBuffer = nullptr;
+
         }
 
-        uint64 AllocateMemory(uint64 size)
+        virtual ~DVKRingBuffer();
+
+        static DVKRingBuffer* Create(std::shared_ptr<VulkanDevice> vulkanDevice, uint64 size);
+
+        // 必须在frameIndex对应的fence等待之后调用
+        void BeginFrame(int32 frameIndex);
+
+        // 返回realBuffer中的offset，空间不足时会切换realBuffer，调用者需要检查version
+        uint64 AllocateMemory(uint64 size);
+
+        FORCE_INLINE uint8* GetMappedData() const
         {
-            uint64 allocationOffset = Align<uint64>(bufferOffset,minAlignment);
-            if(allocationOffset+size<=bufferSize)
-            {
-                bufferOffset = allocationOffset+size;
-                return allocationOffset;
-            }
-
-            bufferOffset = 0;
-            return bufferOffset;
+            return (uint8*)(realBuffer->mapped);
         }
-      public:
+
+        void PrintStats();
+
+    private:
+
+        void Grow(uint64 size);
+
+    public:
+        std::shared_ptr<VulkanDevice>   vulkanDevice = nullptr;
         VkDevice        device = VK_NULL_HANDLE;
         uint64          bufferSize = 0;
+        // head与tail为单调递增的位置，对bufferSize取模得到offset
         uint64          bufferOffset = 0;
+        uint64          bufferTail = 0;
         uint32          minAlignment = 0;
         DVKBuffer*      realBuffer = nullptr;
+        // realBuffer每切换一次加1
+        uint32          version = 0;
+
+        uint64          frameNumber = 0;
+        uint64          completedFrame = 0;
+        std::vector<uint64>         slotFrames;
+        std::vector<FrameRegion>    frameRegions;
+        std::vector<RetiredBuffer>  retiredBuffers;
+
+        uint64          frameBytes = 0;
+        uint64          lastFrameBytes = 0;
+        uint64          peakFrameBytes = 0;
+        uint64          totalBytes = 0;
+        uint32          numGrows = 0;
     };
 
 
@@ -136,13 +174,31 @@ namespace vk_demo
             return descriptorSet->descriptorSets;
         }
 
+        // 由DemoBase在每帧的fence等待之后调用，回收已完成帧占用的ring buffer空间
+        static void BeginRingBufferFrame(int32 frameIndex);
+
+        // 上一帧写入ring buffer的字节数
+        static uint64 GetFrameUploadBytes();
+
     private:
+        struct RetiredDescriptorSet
+        {
+            DVKDescriptorSet*   descriptorSet;
+            uint64              frameNumber;
+        };
+
         static void InitRingBuffer(std::shared_ptr<VulkanDevice> vulkanDevice);
 
         static void DestroyRingBuffer();
 
         void Prepare();
 
+        void WriteDescriptors(DVKDescriptorSet* dstSet);
+
+        void SwitchDescriptorSet();
+
+        void ReleaseRetiredSets(bool immediately);
+
     private:
 
         static DVKRingBuffer*   ringBuffer;
@@ -159,11 +215,17 @@ namespace vk_demo
         DVKGfxPipelineInfo      pipelineInfo;
         DVKGfxPipeline*         pipeline = nullptr;
         DVKDescriptorSet*       descriptorSet = nullptr;
+        // ring buffer切换后旧的set仍被之前的object与在途帧引用
+        std::vector<RetiredDescriptorSet>   retiredSets;
+        uint32                  ringBufferVersion = 0;
 
-        uint32                  dynamicOffsetCount;
+        uint32                  dynamicOffsetCount = 0;
+        // 每个object的dynamic offset，object i使用globalOffsets[perObjectIndexes[i]]开始的dynamicOffsetCount个
         std::vector<uint32>     globalOffsets;
+        // 各uniform最近一次上传的offset，按dynamicIndex索引
         std::vector<uint32>     dynamicOffsets;
         std::vector<uint32>     perObjectIndexes;
+        std::vector<DVKDescriptorSet*>  perObjectSets;
 
         BuffersMap              uniformBuffers;
         BuffersMap              storageBuffers;
@@ -0,0 +1,649 @@
+#include "DVKMeshCook.h"
+#include "DVKMeshOptimizer.h"
+#include "DVKMeshSimplifier.h"
+#include "DVKVertexQuantizer.h"
+#include "FileManager.h"
+
+#include "Common/Log.h"
+#include "Utils/Alignment.h"
+#include "Utils/Crc.h"
+#include "Utils/SecureHash.h"
+#include "Utils/StringUtils.h"
+#include "Vulkan/VulkanDevice.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+
+#include <cstring>
+#include <vector>
+
+namespace vk_demo
+{
+    struct MeshCookHeader
+    {
+        uint32  magic;
+        uint32  version;
+        uint8   sourceHash[16];
+        uint64  sourceSize;
+        uint64  sourceTime;
+        uint32  numAttributes;
+        int32   attributes[VertexAttribute::VA_Count];
+        uint8   quantization[VertexAttribute::VA_Count];
+        uint32  optimized;
+        int32   lodCount;
+        float   lodRatio;
+        float   lodError;
+        uint32  dataSize;
+        uint32  dataCrc;
+    };
+
+    static const uint32 MESH_COOK_MAGIC   = 0x534D4B4D; // MKMS
+    static const uint32 MESH_COOK_VERSION = 7;
+
+    // 顶点与索引按16字节对齐，方便直接拷贝
+    static const uint64 MESH_COOK_ALIGNMENT = 16;
+
+    uint32 DVKMeshCook::numCookedLoads = 0;
+    uint32 DVKMeshCook::numAssimpLoads = 0;
+    double DVKMeshCook::cookedTime     = 0.0;
+    double DVKMeshCook::assimpTime     = 0.0;
+
+    class MeshCookWriter
+    {
+    public:
+        template<typename T>
+        void Write(const T& value)
+        {
+            WriteBytes(&value, sizeof(T));
+        }
+
+        void WriteBytes(const void* src, uint64 size)
+        {
+            uint64 offset = data.size();
+            data.resize(offset + size);
+            if (size > 0)
+            {
+                memcpy(data.data() + offset, src, size);
+            }
+        }
+
+        void WriteString(const std::string& str)
+        {
+            Write<uint32>((uint32)str.size());
+            WriteBytes(str.data(), str.size());
+        }
+
+        void WriteMatrix(const Matrix4x4& matrix)
+        {
+            for (int32 i = 0; i < 4; ++i)
+            {
+                for (int32 j = 0; j < 4; ++j)
+                {
+                    Write<float>(matrix.m[i][j]);
+                }
+            }
+        }
+
+        void WriteVector3(const Vector3& vec)
+        {
+            Write<float>(vec.x);
+            Write<float>(vec.y);
+            Write<float>(vec.z);
+        }
+
+        // 数组先写数量，再对齐写内容
+        template<typename T>
+        void WriteArray(const T* src, uint32 count)
+        {
+            Write<uint32>(count);
+            data.resize(AlignArbitrary((uint64)data.size(), MESH_COOK_ALIGNMENT), 0);
+            WriteBytes(src, count * sizeof(T));
+        }
+
+    public:
+        std::vector<uint8> data;
+    };
+
+    class MeshCookReader
+    {
+    public:
+        MeshCookReader(const uint8* inData, uint64 inSize)
+            : data(inData)
+            , size(inSize)
+        {
+
+        }
+
+        const uint8* ReadBytes(uint64 bytes)
+        {
+            if (!valid || offset + bytes > size)
+            {
+                valid = false;
+                return nullptr;
+            }
+            const uint8* ptr = data + offset;
+            offset += bytes;
+            return ptr;
+        }
+
+        template<typename T>
+        T Read()
+        {
+            T value = {};
+            const uint8* ptr = ReadBytes(sizeof(T));
+            if (ptr)
+            {
+                memcpy(&value, ptr, sizeof(T));
+            }
+            return value;
+        }
+
+        std::string ReadString()
+        {
+            uint32 length = Read<uint32>();
+            const uint8* ptr = ReadBytes(length);
+            return ptr ? std::string((const char*)ptr, length) : std::string();
+        }
+
+        void ReadMatrix(Matrix4x4& matrix)
+        {
+            for (int32 i = 0; i < 4; ++i)
+            {
+                for (int32 j = 0; j < 4; ++j)
+                {
+                    matrix.m[i][j] = Read<float>();
+                }
+            }
+        }
+
+        Vector3 ReadVector3()
+        {
+            float x = Read<float>();
+            float y = Read<float>();
+            float z = Read<float>();
+            return Vector3(x, y, z);
+        }
+
+        // 返回指向映射内存的指针，不做拷贝
+        template<typename T>
+        const T* ReadArray(uint32& outCount)
+        {
+            outCount = Read<uint32>();
+            uint64 aligned = AlignArbitrary(offset, MESH_COOK_ALIGNMENT);
+            if (aligned > size)
+            {
+                valid = false;
+                return nullptr;
+            }
+            offset = aligned;
+            return (const T*)ReadBytes(outCount * sizeof(T));
+        }
+
+    public:
+        const uint8*    data;
+        uint64          size;
+        uint64          offset = 0;
+        bool            valid = true;
+    };
+
+    template<typename T>
+    static void WriteChannel(MeshCookWriter& writer, const DVKAnimChannel<T>& channel)
+    {
+        writer.WriteArray(channel.keys.data(), (uint32)channel.keys.size());
+        writer.WriteArray(channel.values.data(), (uint32)channel.values.size());
+    }
+
+    template<typename T>
+    static void ReadChannel(MeshCookReader& reader, DVKAnimChannel<T>& channel)
+    {
+        uint32 numKeys = 0;
+        const float* keys = reader.ReadArray<float>(numKeys);
+        if (keys)
+        {
+            channel.keys.assign(keys, keys + numKeys);
+        }
+
+        uint32 numValues = 0;
+        const T* values = reader.ReadArray<T>(numValues);
+        if (values)
+        {
+            channel.values.assign(values, values + numValues);
+        }
+
+        channel.UpdateSampling();
+    }
+
+    static void HashSource(const uint8* data, uint64 size, uint8* outHash)
+    {
+        MD5 md5;
+        // MD5::Update的长度是int32，大文件分段处理
+        const uint64 blockSize = 64 * 1024 * 1024;
+        for (uint64 offset = 0; offset < size; offset += blockSize)
+        {
+            uint64 length = MMath::Min(blockSize, size - offset);
+            md5.Update(data + offset, (int32)length);
+        }
+        md5.Final(outHash);
+    }
+
+    static void WriteNode(MeshCookWriter& writer, DVKNode* node)
+    {
+        writer.WriteString(node->name);
+        writer.WriteMatrix(node->localMatrix);
+
+        writer.Write<uint32>((uint32)node->meshes.size());
+        for (int32 i = 0; i < node->meshes.size(); ++i)
+        {
+            DVKMesh* mesh = node->meshes[i];
+            writer.WriteString(mesh->material.diffuse);
+            writer.WriteString(mesh->material.normalmap);
+            writer.WriteString(mesh->material.specular);
+            writer.Write<uint8>(mesh->isSkin ? 1 : 0);
+            writer.WriteArray(mesh->bones.data(), (uint32)mesh->bones.size());
+            writer.WriteVector3(mesh->bounding.min);
+            writer.WriteVector3(mesh->bounding.max);
+            writer.Write<int32>(mesh->vertexCount);
+            writer.Write<int32>(mesh->triangleCount);
+
+            writer.Write<uint32>((uint32)mesh->primitives.size());
+            for (int32 j = 0; j < mesh->primitives.size(); ++j)
+            {
+                DVKPrimitive* primitive = mesh->primitives[j];
+                writer.Write<int32>(primitive->vertexCount);
+                writer.Write<int32>(primitive->triangleNum);
+                writer.WriteArray(primitive->vertices.data(), (uint32)primitive->vertices.size());
+                writer.WriteArray(primitive->indices.data(), (uint32)primitive->indices.size());
+
+                writer.Write<uint32>((uint32)primitive->lods.size());
+                for (int32 k = 0; k < primitive->lods.size(); ++k)
+                {
+                    writer.Write<float>(primitive->lods[k].error);
+                    writer.WriteArray(primitive->lods[k].indices.data(), (uint32)primitive->lods[k].indices.size());
+                }
+            }
+        }
+
+        writer.Write<uint32>((uint32)node->children.size());
+        for (int32 i = 0; i < node->children.size(); ++i)
+        {
+            WriteNode(writer, node->children[i]);
+        }
+    }
+
+    std::string DVKMeshCook::GetCookedPath(const std::string& filename, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization)
+    {
+        // 每个attribute的存储格式也计入布局，不同的压缩方式各自cook
+        std::vector<int32> layout;
+        for (int32 i = 0; i < attributes.size(); ++i)
+        {
+            layout.push_back(attributes[i]);
+            if (quantization.IsQuantized(attributes[i]))
+            {
+                layout.push_back(quantization.GetElementType(attributes[i]) << 16);
+            }
+        }
+        uint32 layoutCrc = Crc::MemCrc32(layout.data(), (int32)(layout.size() * sizeof(int32)));
+        return StringUtils::Printf("%s.%08x.dvkmesh", filename.c_str(), layoutCrc);
+    }
+
+    bool DVKMeshCook::Save(DVKModel* model, const std::string& filename, const uint8* sourceData, uint64 sourceSize)
+    {
+        if (model->attributes.size() > VertexAttribute::VA_Count)
+        {
+            return false;
+        }
+
+        MeshCookWriter writer;
+
+        // bones
+        writer.Write<uint32>((uint32)model->bones.size());
+        for (int32 i = 0; i < model->bones.size(); ++i)
+        {
+            DVKBone* bone = model->bones[i];
+            writer.WriteString(bone->name);
+            writer.Write<int32>(bone->index);
+            writer.Write<int32>(bone->parent);
+            writer.WriteMatrix(bone->inverseBindPose);
+        }
+
+        // nodes，按LoadNode的先序顺序写出
+        writer.Write<uint8>(model->rootNode ? 1 : 0);
+        if (model->rootNode)
+        {
+            WriteNode(writer, model->rootNode);
+        }
+
+        // animations
+        writer.Write<uint32>((uint32)model->animations.size());
+        for (int32 i = 0; i < model->animations.size(); ++i)
+        {
+            DVKAnimation& animation = model->animations[i];
+            writer.WriteString(animation.name);
+            writer.Write<float>(animation.duration);
+            writer.Write<float>(animation.speed);
+            writer.Write<uint32>((uint32)animation.clips.size());
+            for (int32 j = 0; j < animation.clips.size(); ++j)
+            {
+                DVKAnimationClip& clip = animation.clips[j];
+                writer.WriteString(clip.nodeName);
+                writer.Write<float>(clip.duration);
+                WriteChannel(writer, clip.positions);
+                WriteChannel(writer, clip.scales);
+                WriteChannel(writer, clip.rotations);
+            }
+        }
+
+        MeshCookHeader header = {};
+        header.magic         = MESH_COOK_MAGIC;
+        header.version       = MESH_COOK_VERSION;
+        header.sourceSize    = sourceSize;
+        header.numAttributes = (uint32)model->attributes.size();
+        header.optimized     = DVKMeshOptimizer::enabled ? 1 : 0;
+        header.lodCount      = DVKMeshSimplifier::lodCount;
+        header.lodRatio      = DVKMeshSimplifier::lodRatio;
+        header.lodError      = DVKMeshSimplifier::maxError;
+        header.dataSize      = (uint32)writer.data.size();
+        header.dataCrc       = Crc::MemCrc32(writer.data.data(), (int32)writer.data.size());
+        for (int32 i = 0; i < model->attributes.size(); ++i)
+        {
+            header.attributes[i]   = model->attributes[i];
+            header.quantization[i] = model->quantization.GetElementType(model->attributes[i]);
+        }
+        HashSource(sourceData, sourceSize, header.sourceHash);
+
+        // 修改时间取不到或与内容大小对不上时记为0，下次加载总是比较hash
+        uint64 statSize = 0;
+        uint64 statTime = 0;
+        if (FileManager::GetFileStat(filename, statSize, statTime) && statSize == sourceSize)
+        {
+            header.sourceTime = statTime;
+        }
+
+        // 头部按对齐大小占位，保证数据区内的偏移对齐关系在文件中保持不变
+        uint64 headerSize = AlignArbitrary((uint64)sizeof(MeshCookHeader), MESH_COOK_ALIGNMENT);
+        std::vector<uint8> fileData(headerSize + writer.data.size(), 0);
+        memcpy(fileData.data(), &header, sizeof(MeshCookHeader));
+        memcpy(fileData.data() + headerSize, writer.data.data(), writer.data.size());
+
+        std::string cookedPath = GetCookedPath(filename, model->attributes, model->quantization);
+        if (!FileManager::WriteFile(cookedPath, fileData.data(), fileData.size()))
+        {
+            return false;
+        }
+
+        MLOG("Mesh cooked : %s (%d bytes)", cookedPath.c_str(), (int32)fileData.size());
+        return true;
+    }
+
+    DVKModel* DVKMeshCook::Load(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& inQuantization)
+    {
+        double beginTime = GenericPlatformTime::Seconds();
+
+        DVKVertexQuantization quantization = DVKVertexQuantizer::Validate(attributes, inQuantization);
+
+        std::string cookedPath = GetCookedPath(filename, attributes, quantization);
+        MappedFile cookedFile;
+        if (!FileManager::MapFile(cookedPath, cookedFile))
+        {
+            return nullptr;
+        }
+
+        uint64 headerSize = AlignArbitrary((uint64)sizeof(MeshCookHeader), MESH_COOK_ALIGNMENT);
+        if (cookedFile.size < headerSize)
+        {
+            FileManager::UnmapFile(cookedFile);
+            return nullptr;
+        }
+
+        MeshCookHeader header;
+        memcpy(&header, cookedFile.data, sizeof(MeshCookHeader));
+
+        bool valid = header.magic == MESH_COOK_MAGIC && header.version == MESH_COOK_VERSION;
+        valid = valid && header.numAttributes == attributes.size();
+        valid = valid && header.optimized == (DVKMeshOptimizer::enabled ? 1 : 0);
+        valid = valid && header.lodCount == DVKMeshSimplifier::lodCount && header.lodRatio == DVKMeshSimplifier::lodRatio && header.lodError == DVKMeshSimplifier::maxError;
+        valid = valid && header.dataSize == cookedFile.size - headerSize;
+        for (int32 i = 0; valid && i < attributes.size(); ++i)
+        {
+            valid = header.attributes[i] == attributes[i] && header.quantization[i] == quantization.GetElementType(attributes[i]);
+        }
+
+        const uint8* data = cookedFile.data + headerSize;
+        valid = valid && Crc::MemCrc32(data, (int32)header.dataSize) == header.dataCrc;
+
+        // 源文件存在时校验，只发布cooked文件时跳过。
+        // 大小与修改时间都一致时认为未变化，只有修改时间不同(例如重新checkout)时才读入源文件比较content hash
+        uint64 sourceSize = 0;
+        uint64 sourceTime = 0;
+        if (valid && FileManager::GetFileStat(filename, sourceSize, sourceTime))
+        {
+            valid = sourceSize == header.sourceSize;
+            MappedFile sourceFile;
+            if (valid && (sourceTime == 0 || sourceTime != header.sourceTime) && FileManager::MapFile(filename, sourceFile))
+            {
+                uint8 sourceHash[16];
+                HashSource(sourceFile.data, sourceFile.size, sourceHash);
+                valid = sourceFile.size == header.sourceSize && memcmp(sourceHash, header.sourceHash, sizeof(sourceHash)) == 0;
+                FileManager::UnmapFile(sourceFile);
+            }
+        }
+
+        if (!valid)
+        {
+            MLOG("Mesh cook outdated : %s", cookedPath.c_str());
+            FileManager::UnmapFile(cookedFile);
+            return nullptr;
+        }
+
+        MeshCookReader reader(data, header.dataSize);
+
+        DVKModel* model     = new DVKModel();
+        model->device       = vulkanDevice;
+        model->attributes   = attributes;
+        model->quantization = quantization;
+
+        // bones
+        uint32 numBones = reader.Read<uint32>();
+        for (uint32 i = 0; i < numBones && reader.valid; ++i)
+        {
+            DVKBone* bone = new DVKBone();
+            bone->name   = reader.ReadString();
+            bone->index  = reader.Read<int32>();
+            bone->parent = reader.Read<int32>();
+            reader.ReadMatrix(bone->inverseBindPose);
+            model->bones.push_back(bone);
+            model->bonesMap.insert(std::make_pair(bone->name, bone));
+        }
+
+        // nodes，先序展开，用栈记录每个节点剩余的子节点数量
+        std::vector<std::pair<DVKNode*, uint32>> stack;
+        uint8 hasRoot = reader.Read<uint8>();
+        uint32 pending = hasRoot ? 1 : 0;
+        while (pending > 0 && reader.valid)
+        {
+            DVKNode* node = new DVKNode();
+            node->name = reader.ReadString();
+            reader.ReadMatrix(node->localMatrix);
+
+            if (stack.size() > 0)
+            {
+                node->parent = stack.back().first;
+                node->parent->children.push_back(node);
+                stack.back().second -= 1;
+            }
+            else
+            {
+                model->rootNode = node;
+            }
+
+            uint32 numMeshes = reader.Read<uint32>();
+            for (uint32 i = 0; i < numMeshes && reader.valid; ++i)
+            {
+                DVKMesh* mesh = new DVKMesh();
+                mesh->material.diffuse   = reader.ReadString();
+                mesh->material.normalmap = reader.ReadString();
+                mesh->material.specular  = reader.ReadString();
+                mesh->isSkin = reader.Read<uint8>() != 0;
+
+                uint32 numMeshBones = 0;
+                const int32* meshBones = reader.ReadArray<int32>(numMeshBones);
+                if (meshBones)
+                {
+                    mesh->bones.assign(meshBones, meshBones + numMeshBones);
+                }
+
+                mesh->bounding.min = reader.ReadVector3();
+                mesh->bounding.max = reader.ReadVector3();
+                mesh->bounding.UpdateCorners();
+                DVKVertexQuantizer::GetPositionTransform(quantization.GetElementType(VertexAttribute::VA_Position), mesh->bounding.min, mesh->bounding.max, mesh->dequantizeOffset, mesh->dequantizeScale);
+                mesh->vertexCount   = reader.Read<int32>();
+                mesh->triangleCount = reader.Read<int32>();
+
+                uint32 numPrimitives = reader.Read<uint32>();
+                for (uint32 j = 0; j < numPrimitives && reader.valid; ++j)
+                {
+                    DVKPrimitive* primitive = new DVKPrimitive();
+                    primitive->vertexCount = reader.Read<int32>();
+                    primitive->triangleNum = reader.Read<int32>();
+
+                    uint32 numVertices = 0;
+                    const float* vertices = reader.ReadArray<float>(numVertices);
+                    uint32 numIndices = 0;
+                    const uint16* indices = reader.ReadArray<uint16>(numIndices);
+
+                    if (vertices && indices)
+                    {
+                        primitive->vertices.assign(vertices, vertices + numVertices);
+                        primitive->indices.assign(indices, indices + numIndices);
+                    }
+
+                    uint32 numLODs = reader.Read<uint32>();
+                    for (uint32 k = 0; k < numLODs && reader.valid; ++k)
+                    {
+                        DVKPrimitiveLOD lod;
+                        lod.error = reader.Read<float>();
+
+                        uint32 numLODIndices = 0;
+                        const uint16* lodIndices = reader.ReadArray<uint16>(numLODIndices);
+                        if (lodIndices)
+                        {
+                            lod.indices.assign(lodIndices, lodIndices + numLODIndices);
+                            lod.triangleNum = (int32)numLODIndices / 3;
+                        }
+                        primitive->lods.push_back(lod);
+                    }
+
+                    mesh->primitives.push_back(primitive);
+                }
+
+                mesh->UpdateLODErrors();
+
+                mesh->linkNode = node;
+                node->meshes.push_back(mesh);
+                model->meshes.push_back(mesh);
+            }
+
+            model->nodesMap.insert(std::make_pair(node->name, node));
+            model->linearNodes.push_back(node);
+
+            pending -= 1;
+
+            uint32 numChildren = reader.Read<uint32>();
+            stack.push_back(std::make_pair(node, numChildren));
+            pending += numChildren;
+
+            // 子节点都已读完的节点出栈
+            while (stack.size() > 0 && stack.back().second == 0)
+            {
+                stack.pop_back();
+            }
+        }
+
+        // animations
+        uint32 numAnimations = reader.Read<uint32>();
+        for (uint32 i = 0; i < numAnimations && reader.valid; ++i)
+        {
+            model->animations.push_back(DVKAnimation());
+            DVKAnimation& animation = model->animations.back();
+            animation.name     = reader.ReadString();
+            animation.duration = reader.Read<float>();
+            animation.speed    = reader.Read<float>();
+
+            uint32 numClips = reader.Read<uint32>();
+            for (uint32 j = 0; j < numClips && reader.valid; ++j)
+            {
+                animation.clips.push_back(DVKAnimationClip());
+                DVKAnimationClip& clip = animation.clips.back();
+                clip.nodeName = reader.ReadString();
+                clip.duration = reader.Read<float>();
+                ReadChannel(reader, clip.positions);
+                ReadChannel(reader, clip.scales);
+                ReadChannel(reader, clip.rotations);
+            }
+        }
+
+        FileManager::UnmapFile(cookedFile);
+
+        if (!reader.valid)
+        {
+            // crc已通过但内容不完整，通常是版本号未更新的格式改动
+            MLOGE("Mesh cook corrupted : %s", cookedPath.c_str());
+            delete model;
+            return nullptr;
+        }
+
+        // 整个文件解析成功后才创建GPU资源，失败时uploader中不会留下指向已释放buffer的拷贝
+        if (uploader)
+        {
+            for (int32 i = 0; i < model->meshes.size(); ++i)
+            {
+                DVKMesh* mesh = model->meshes[i];
+                for (int32 j = 0; j < mesh->primitives.size(); ++j)
+                {
+                    DVKPrimitive* primitive = mesh->primitives[j];
+                    if (primitive->vertices.size() > 0 && primitive->indices.size() > 0)
+                    {
+                        primitive->vertexBuffer = DVKVertexBuffer::Create(vulkanDevice, uploader, primitive->vertices.data(), (int32)primitive->vertices.size(), attributes, quantization);
+                        primitive->indexBuffer  = DVKIndexBuffer::Create(vulkanDevice, uploader, primitive->indices.data(), (int32)primitive->indices.size());
+                    }
+                    for (int32 k = 0; k < primitive->lods.size(); ++k)
+                    {
+                        DVKPrimitiveLOD& lod = primitive->lods[k];
+                        if (lod.indices.size() > 0)
+                        {
+                            lod.indexBuffer = DVKIndexBuffer::Create(vulkanDevice, uploader, lod.indices.data(), (int32)lod.indices.size());
+                        }
+                    }
+                }
+            }
+        }
+
+        model->BuildSkeleton();
+
+        numCookedLoads += 1;
+        cookedTime     += GenericPlatformTime::Seconds() - beginTime;
+
+        return model;
+    }
+
+    bool DVKMeshCook::Cook(const std::string& filename, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization)
+    {
+        MappedFile sourceFile;
+        if (!FileManager::MapFile(filename, sourceFile))
+        {
+            MLOGE("Failed load mesh : %s", filename.c_str());
+            return false;
+        }
+
+        DVKModel* model = DVKModel::LoadFromAssimp(filename, nullptr, nullptr, attributes, quantization);
+        bool cooked = model != nullptr && Save(model, filename, sourceFile.data, sourceFile.size);
+
+        delete model;
+        FileManager::UnmapFile(sourceFile);
+
+        return cooked;
+    }
+
+    void DVKMeshCook::PrintStats()
+    {
+        MLOG("Mesh cook stats : %d cooked loads %.3fms, %d assimp loads %.3fms", numCookedLoads, cookedTime * 1000.0, numAssimpLoads, assimpTime * 1000.0);
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Engine.h"
+#include "DVKModel.h"
+#include "DVKUploadQueue.h"
+
+#include "Common/Common.h"
+#include "Vulkan/RHIDefinitions.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+
+class VulkanDevice;
+
+namespace vk_demo
+{
+    // 离线烘焙的模型格式：节点、mesh、骨骼、动画以及按attributes交错好的顶点/索引。
+    // 文件通过mmap加载，整个文件校验、解析完成后才把顶点与索引拷入staging。
+    // 文件名包含attributes布局与压缩格式的crc，文件头记录源文件的大小、修改时间、MD5以及重排、LOD等导入设置，任一变化后自动失效。
+    // 修改时间一致时不再计算MD5。
+    // 简化生成的各级LOD只保存索引，与LOD0共用顶点。
+    class DVKMeshCook
+    {
+    public:
+        // 读取cooked文件，不存在、格式不符或源文件已变化时返回nullptr
+        static DVKModel* Load(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization = DVKVertexQuantization());
+
+        // sourceData为源文件内容，用于计算content hash
+        static bool Save(DVKModel* model, const std::string& filename, const uint8* sourceData, uint64 sourceSize);
+
+        // 经Assimp加载并写出cooked文件，不创建GPU资源
+        static bool Cook(const std::string& filename, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization = DVKVertexQuantization());
+
+        static std::string GetCookedPath(const std::string& filename, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization = DVKVertexQuantization());
+
+        static void PrintStats();
+
+    public:
+        static uint32   numCookedLoads;
+        static uint32   numAssimpLoads;
+        static double   cookedTime;
+        static double   assimpTime;
+    };
+}
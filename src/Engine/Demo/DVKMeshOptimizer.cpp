@@ -0,0 +1,416 @@
+#include "DVKMeshOptimizer.h"
+
+#include "Common/Log.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "Math/Math.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vk_demo
+{
+    bool   DVKMeshOptimizer::enabled           = false;
+    uint32 DVKMeshOptimizer::numMeshes         = 0;
+    uint64 DVKMeshOptimizer::numTriangles      = 0;
+    uint64 DVKMeshOptimizer::numVertices       = 0;
+    uint64 DVKMeshOptimizer::transformedBefore = 0;
+    uint64 DVKMeshOptimizer::transformedAfter  = 0;
+    double DVKMeshOptimizer::optimizeTime      = 0.0;
+
+    static const uint32 InvalidIndex = 0xFFFFFFFF;
+
+    // 过小的cluster在排序后会打断cache连续性，ACMR上升明显
+    static const uint32 MinClusterTriangles = 128;
+
+    // 用时间戳模拟FIFO cache：顶点进入cache时记录时间戳，时间戳之差不超过cacheSize即仍在cache中
+    class VertexCacheSimulator
+    {
+    public:
+        VertexCacheSimulator(uint32 vertexCount, uint32 inCacheSize)
+            : cacheTime(vertexCount, 0)
+            , cacheSize(inCacheSize)
+            , timestamp(inCacheSize + 1)
+        {
+
+        }
+
+        FORCE_INLINE uint32 Triangle(const uint32* triangle)
+        {
+            uint32 misses = 0;
+            for (int32 i = 0; i < 3; ++i)
+            {
+                uint32 vertex = triangle[i];
+                if (timestamp - cacheTime[vertex] > cacheSize)
+                {
+                    cacheTime[vertex] = timestamp++;
+                    misses += 1;
+                }
+            }
+            return misses;
+        }
+
+        // 让当前cache中的所有顶点失效
+        FORCE_INLINE void Flush()
+        {
+            timestamp += cacheSize + 1;
+        }
+
+    public:
+        std::vector<uint32> cacheTime;
+        uint32              cacheSize;
+        uint32              timestamp;
+    };
+
+    DVKMeshOptimizer::CacheStats DVKMeshOptimizer::AnalyzeVertexCache(const uint32* indices, uint32 indexCount, uint32 vertexCount, uint32 cacheSize)
+    {
+        CacheStats stats;
+        stats.triangles = indexCount / 3;
+
+        VertexCacheSimulator cache(vertexCount, cacheSize);
+        std::vector<uint8> referenced(vertexCount, 0);
+        for (uint32 i = 0; i < stats.triangles * 3; i += 3)
+        {
+            stats.transformed += cache.Triangle(indices + i);
+            for (int32 j = 0; j < 3; ++j)
+            {
+                stats.vertices += referenced[indices[i + j]] ? 0 : 1;
+                referenced[indices[i + j]] = 1;
+            }
+        }
+
+        stats.acmr = stats.triangles > 0 ? (float)stats.transformed / stats.triangles : 0.0f;
+        stats.atvr = stats.vertices  > 0 ? (float)stats.transformed / stats.vertices  : 0.0f;
+        return stats;
+    }
+
+    // Sander et al. 2007, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+    void DVKMeshOptimizer::OptimizeVertexCache(uint32* dst, const uint32* indices, uint32 indexCount, uint32 vertexCount, uint32 cacheSize)
+    {
+        uint32 triangleCount = indexCount / 3;
+        if (triangleCount == 0 || vertexCount == 0)
+        {
+            return;
+        }
+
+        // 顶点到三角形的邻接表
+        std::vector<uint32> offsets(vertexCount + 1, 0);
+        for (uint32 i = 0; i < triangleCount * 3; ++i)
+        {
+            offsets[indices[i] + 1] += 1;
+        }
+        for (uint32 i = 0; i < vertexCount; ++i)
+        {
+            offsets[i + 1] += offsets[i];
+        }
+
+        std::vector<uint32> liveCount(vertexCount, 0);
+        std::vector<uint32> adjacency(triangleCount * 3);
+        for (uint32 i = 0; i < triangleCount * 3; ++i)
+        {
+            uint32 vertex = indices[i];
+            adjacency[offsets[vertex] + liveCount[vertex]] = i / 3;
+            liveCount[vertex] += 1;
+        }
+
+        std::vector<uint32> cacheTime(vertexCount, 0);
+        std::vector<uint8>  emitted(triangleCount, 0);
+        std::vector<uint32> deadEnd;
+        std::vector<uint32> candidates;
+        deadEnd.reserve(triangleCount * 3);
+
+        uint32 timestamp   = cacheSize + 1;
+        uint32 cursor      = 0;
+        uint32 outputCount = 0;
+        uint32 fanning     = indices[0];
+
+        while (fanning != InvalidIndex)
+        {
+            // 输出fanning顶点周围所有未输出的三角形
+            candidates.clear();
+            for (uint32 i = offsets[fanning]; i < offsets[fanning + 1]; ++i)
+            {
+                uint32 triangle = adjacency[i];
+                if (emitted[triangle])
+                {
+                    continue;
+                }
+                emitted[triangle] = 1;
+
+                for (int32 j = 0; j < 3; ++j)
+                {
+                    uint32 vertex = indices[triangle * 3 + j];
+                    dst[outputCount++] = vertex;
+                    deadEnd.push_back(vertex);
+                    candidates.push_back(vertex);
+                    liveCount[vertex] -= 1;
+                    if (timestamp - cacheTime[vertex] > cacheSize)
+                    {
+                        cacheTime[vertex] = timestamp++;
+                    }
+                }
+            }
+
+            // 优先选仍在cache中、且输出其剩余三角形后不会被挤出cache的顶点里最早进入的那个
+            uint32 next = InvalidIndex;
+            int64  best = -1;
+            for (int32 i = 0; i < candidates.size(); ++i)
+            {
+                uint32 vertex = candidates[i];
+                if (liveCount[vertex] == 0)
+                {
+                    continue;
+                }
+
+                int64 priority = 0;
+                if (timestamp - cacheTime[vertex] + 2 * liveCount[vertex] <= cacheSize)
+                {
+                    priority = timestamp - cacheTime[vertex];
+                }
+                if (priority > best)
+                {
+                    best = priority;
+                    next = vertex;
+                }
+            }
+
+            // 死胡同：先回溯最近输出过的顶点，再按顶点顺序找下一个
+            while (next == InvalidIndex && deadEnd.size() > 0)
+            {
+                uint32 vertex = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveCount[vertex] > 0)
+                {
+                    next = vertex;
+                }
+            }
+            while (next == InvalidIndex && cursor < vertexCount)
+            {
+                if (liveCount[cursor] > 0)
+                {
+                    next = cursor;
+                }
+                cursor += 1;
+            }
+
+            fanning = next;
+        }
+    }
+
+    void DVKMeshOptimizer::OptimizeOverdraw(uint32* dst, const uint32* indices, uint32 indexCount, const float* positions, uint32 positionStride, uint32 vertexCount, float threshold, uint32 cacheSize)
+    {
+        uint32 triangleCount = indexCount / 3;
+        if (triangleCount == 0)
+        {
+            return;
+        }
+
+        // 硬边界：三个顶点全部miss的位置，说明cache优化在此处跳到了新的区域。
+        // 第一个三角形可能是退化或共享顶点的，不一定3次miss，0总是作为第一个边界，保证所有三角形都被输出。
+        VertexCacheSimulator cache(vertexCount, cacheSize);
+        std::vector<uint32> hardBoundaries;
+        hardBoundaries.push_back(0);
+        for (uint32 i = 0; i < triangleCount; ++i)
+        {
+            if (cache.Triangle(indices + i * 3) == 3 && i > 0)
+            {
+                hardBoundaries.push_back(i);
+            }
+        }
+        hardBoundaries.push_back(triangleCount);
+
+        // 软边界：在硬边界内部继续切分，只要切分后前一段的ACMR不超过整段ACMR的threshold倍
+        std::vector<uint32> clusters;
+        for (int32 c = 0; c + 1 < hardBoundaries.size(); ++c)
+        {
+            uint32 start = hardBoundaries[c];
+            uint32 end   = hardBoundaries[c + 1];
+
+            cache.Flush();
+            uint32 clusterMisses = 0;
+            for (uint32 i = start; i < end; ++i)
+            {
+                clusterMisses += cache.Triangle(indices + i * 3);
+            }
+            float clusterThreshold = threshold * clusterMisses / (end - start);
+
+            cache.Flush();
+            clusters.push_back(start);
+            uint32 clusterStart = start;
+            uint32 misses       = 0;
+            for (uint32 i = start; i < end; ++i)
+            {
+                misses += cache.Triangle(indices + i * 3);
+                if (i + 1 < end && i + 1 - clusterStart >= MinClusterTriangles && misses <= (i - clusterStart + 1) * clusterThreshold)
+                {
+                    clusters.push_back(i + 1);
+                    clusterStart = i + 1;
+                    misses       = 0;
+                    cache.Flush();
+                }
+            }
+        }
+        clusters.push_back(triangleCount);
+
+        int32 numClusters = (int32)clusters.size() - 1;
+
+        // 每个cluster的面积加权中心与法线
+        std::vector<float> clusterData(numClusters * 6, 0.0f);
+        float meshCenter[3] = { 0.0f, 0.0f, 0.0f };
+        float meshArea      = 0.0f;
+        for (int32 c = 0; c < numClusters; ++c)
+        {
+            float* data = &clusterData[c * 6];
+            float area  = 0.0f;
+            for (uint32 i = clusters[c]; i < clusters[c + 1]; ++i)
+            {
+                const float* p0 = positions + indices[i * 3 + 0] * positionStride;
+                const float* p1 = positions + indices[i * 3 + 1] * positionStride;
+                const float* p2 = positions + indices[i * 3 + 2] * positionStride;
+
+                float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+                float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+                float n[3]  = {
+                    e1[1] * e2[2] - e1[2] * e2[1],
+                    e1[2] * e2[0] - e1[0] * e2[2],
+                    e1[0] * e2[1] - e1[1] * e2[0]
+                };
+                float triangleArea = MMath::Sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+                for (int32 j = 0; j < 3; ++j)
+                {
+                    data[j]     += (p0[j] + p1[j] + p2[j]) / 3.0f * triangleArea;
+                    data[3 + j] += n[j];
+                }
+                area += triangleArea;
+            }
+
+            for (int32 j = 0; j < 3; ++j)
+            {
+                meshCenter[j] += data[j];
+                data[j] = area > 0.0f ? data[j] / area : 0.0f;
+            }
+            meshArea += area;
+        }
+
+        for (int32 j = 0; j < 3; ++j)
+        {
+            meshCenter[j] = meshArea > 0.0f ? meshCenter[j] / meshArea : 0.0f;
+        }
+
+        // 越朝外的cluster越先绘制，内部与背面的cluster更容易被深度测试剔除
+        std::vector<float> sortKeys(numClusters);
+        std::vector<int32> order(numClusters);
+        for (int32 c = 0; c < numClusters; ++c)
+        {
+            const float* data = &clusterData[c * 6];
+            float length = MMath::Sqrt(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+            float dot    = 0.0f;
+            for (int32 j = 0; j < 3; ++j)
+            {
+                dot += (data[j] - meshCenter[j]) * data[3 + j];
+            }
+            sortKeys[c] = length > 0.0f ? dot / length : 0.0f;
+            order[c]    = c;
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&sortKeys](int32 a, int32 b)
+        {
+            return sortKeys[a] > sortKeys[b];
+        });
+
+        uint32 outputCount = 0;
+        for (int32 c = 0; c < numClusters; ++c)
+        {
+            uint32 start = clusters[order[c]] * 3;
+            uint32 count = clusters[order[c] + 1] * 3 - start;
+            memcpy(dst + outputCount, indices + start, count * sizeof(uint32));
+            outputCount += count;
+        }
+    }
+
+    uint32 DVKMeshOptimizer::OptimizeVertexFetch(float* dstVertices, uint32* indices, uint32 indexCount, const float* vertices, uint32 vertexCount, uint32 vertexStride)
+    {
+        std::vector<uint32> remap(vertexCount, InvalidIndex);
+        uint32 numReferenced = 0;
+        for (uint32 i = 0; i < indexCount; ++i)
+        {
+            uint32 vertex = indices[i];
+            if (remap[vertex] == InvalidIndex)
+            {
+                remap[vertex] = numReferenced++;
+                memcpy(dstVertices + remap[vertex] * vertexStride, vertices + vertex * vertexStride, vertexStride * sizeof(float));
+            }
+            indices[i] = remap[vertex];
+        }
+
+        // 保持顶点总数不变，调用方可能依赖顶点数量推导stride
+        uint32 numVertices = numReferenced;
+        for (uint32 i = 0; i < vertexCount; ++i)
+        {
+            if (remap[i] == InvalidIndex)
+            {
+                memcpy(dstVertices + numVertices * vertexStride, vertices + i * vertexStride, vertexStride * sizeof(float));
+                numVertices += 1;
+            }
+        }
+
+        return numReferenced;
+    }
+
+    void DVKMeshOptimizer::Optimize(std::vector<float>& vertices, std::vector<uint32>& indices, uint32 vertexStride, int32 positionOffset)
+    {
+        uint32 vertexCount = vertexStride > 0 ? (uint32)(vertices.size() / vertexStride) : 0;
+        uint32 indexCount  = (uint32)(indices.size() / 3 * 3);
+        if (vertexCount == 0 || indexCount == 0)
+        {
+            return;
+        }
+
+        double beginTime = GenericPlatformTime::Seconds();
+
+        CacheStats before = AnalyzeVertexCache(indices.data(), indexCount, vertexCount);
+
+        std::vector<uint32> cacheOptimized(indices.size());
+        OptimizeVertexCache(cacheOptimized.data(), indices.data(), indexCount, vertexCount);
+
+        if (positionOffset >= 0)
+        {
+            OptimizeOverdraw(indices.data(), cacheOptimized.data(), indexCount, vertices.data() + positionOffset, vertexStride, vertexCount);
+        }
+        else
+        {
+            memcpy(indices.data(), cacheOptimized.data(), indexCount * sizeof(uint32));
+        }
+
+        std::vector<float> fetchOptimized(vertices.size());
+        OptimizeVertexFetch(fetchOptimized.data(), indices.data(), indexCount, vertices.data(), vertexCount, vertexStride);
+        vertices.swap(fetchOptimized);
+
+        CacheStats after = AnalyzeVertexCache(indices.data(), indexCount, vertexCount);
+
+        numMeshes         += 1;
+        numTriangles      += before.triangles;
+        numVertices       += before.vertices;
+        transformedBefore += before.transformed;
+        transformedAfter  += after.transformed;
+        optimizeTime      += GenericPlatformTime::Seconds() - beginTime;
+    }
+
+    void DVKMeshOptimizer::PrintStats()
+    {
+        if (numMeshes == 0)
+        {
+            return;
+        }
+
+        MLOG("Mesh optimizer stats : %d meshes, %d triangles, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %.2fms",
+            numMeshes,
+            (int32)numTriangles,
+            (double)transformedBefore / MMath::Max<uint64>(numTriangles, 1),
+            (double)transformedAfter  / MMath::Max<uint64>(numTriangles, 1),
+            (double)transformedBefore / MMath::Max<uint64>(numVertices, 1),
+            (double)transformedAfter  / MMath::Max<uint64>(numVertices, 1),
+            optimizeTime * 1000.0
+        );
+    }
+}
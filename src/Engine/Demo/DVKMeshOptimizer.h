@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Common/Common.h"
+
+#include <vector>
+
+namespace vk_demo
+{
+    // 导入阶段的索引/顶点重排，不改变网格的几何，只改变三角形与顶点的顺序：
+    // 1. Tipsify三角形重排，提高post-transform cache命中率
+    // 2. 在cache优化结果上切分cluster，按cluster朝外程度排序，先画外侧减少overdraw
+    // 3. 按首次使用的顺序重排顶点，提高vertex fetch的局部性
+    class DVKMeshOptimizer
+    {
+    public:
+        enum
+        {
+            DefaultCacheSize = 16,
+        };
+
+        struct CacheStats
+        {
+            uint32  transformed = 0;    // 模拟FIFO cache下顶点着色次数
+            uint32  triangles = 0;
+            uint32  vertices = 0;       // 被引用的顶点数
+            float   acmr = 0.0f;        // transformed / triangles，理想值约0.5
+            float   atvr = 0.0f;        // transformed / vertices，理想值1.0
+        };
+
+        static CacheStats AnalyzeVertexCache(const uint32* indices, uint32 indexCount, uint32 vertexCount, uint32 cacheSize = DefaultCacheSize);
+
+        // dst不能与indices相同
+        static void OptimizeVertexCache(uint32* dst, const uint32* indices, uint32 indexCount, uint32 vertexCount, uint32 cacheSize = DefaultCacheSize);
+
+        // indices应为OptimizeVertexCache的结果；threshold为允许的ACMR上升比例
+        static void OptimizeOverdraw(uint32* dst, const uint32* indices, uint32 indexCount, const float* positions, uint32 positionStride, uint32 vertexCount, float threshold = 1.05f, uint32 cacheSize = DefaultCacheSize);
+
+        // 顶点按首次使用的顺序写入dstVertices并原地改写indices，未被引用的顶点排在最后，返回被引用的顶点数
+        static uint32 OptimizeVertexFetch(float* dstVertices, uint32* indices, uint32 indexCount, const float* vertices, uint32 vertexCount, uint32 vertexStride);
+
+        // 完整的导入阶段。vertexStride以float为单位，positionOffset小于0时跳过overdraw排序
+        static void Optimize(std::vector<float>& vertices, std::vector<uint32>& indices, uint32 vertexStride, int32 positionOffset);
+
+        static void PrintStats();
+
+    public:
+        // 可选的导入阶段，默认关闭，DVKModel导入Assimp模型时只在开启后重排
+        static bool     enabled;
+
+        static uint32   numMeshes;
+        static uint64   numTriangles;
+        static uint64   numVertices;
+        static uint64   transformedBefore;
+        static uint64   transformedAfter;
+        static double   optimizeTime;
+    };
+}
@@ -0,0 +1,442 @@
+#include "DVKMeshSimplifier.h"
+#include "DVKMeshOptimizer.h"
+
+#include "Common/Log.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "Math/Math.h"
+#include "Math/Vector3.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace vk_demo
+{
+    int32  DVKMeshSimplifier::lodCount        = 0;
+    float  DVKMeshSimplifier::lodRatio        = 0.5f;
+    float  DVKMeshSimplifier::maxError        = 0.05f;
+    uint32 DVKMeshSimplifier::numMeshes       = 0;
+    uint32 DVKMeshSimplifier::numLODs         = 0;
+    uint64 DVKMeshSimplifier::numTriangles    = 0;
+    uint64 DVKMeshSimplifier::numLODTriangles = 0;
+    double DVKMeshSimplifier::simplifyTime    = 0.0;
+
+    // 坍缩后相邻三角形法线变化超过约75度视为翻转
+    static const float FlipThreshold = 0.25f;
+
+    // 三角形数减少不足该比例时不再生成下一级
+    static const float MinLODReduction = 0.9f;
+
+    // 对称矩阵形式的平面二次误差，按三角形面积加权
+    struct Quadric
+    {
+        double a2 = 0.0, b2 = 0.0, c2 = 0.0;
+        double ab = 0.0, ac = 0.0, bc = 0.0;
+        double ad = 0.0, bd = 0.0, cd = 0.0;
+        double d2 = 0.0;
+        double w  = 0.0;
+
+        FORCE_INLINE void operator+=(const Quadric& q)
+        {
+            a2 += q.a2; b2 += q.b2; c2 += q.c2;
+            ab += q.ab; ac += q.ac; bc += q.bc;
+            ad += q.ad; bd += q.bd; cd += q.cd;
+            d2 += q.d2;
+            w  += q.w;
+        }
+
+        // 到各平面距离平方的加权平均
+        FORCE_INLINE float Error(const Vector3& p) const
+        {
+            double x = p.x;
+            double y = p.y;
+            double z = p.z;
+            double r = a2 * x * x + b2 * y * y + c2 * z * z;
+            r += 2.0 * (ab * x * y + ac * x * z + bc * y * z);
+            r += 2.0 * (ad * x + bd * y + cd * z);
+            r += d2;
+            return w > 0.0 ? (float)(MMath::Abs(r) / w) : 0.0f;
+        }
+    };
+
+    struct Collapse
+    {
+        uint32  v0;
+        uint32  v1;
+        float   error;
+    };
+
+    static void QuadricFromTriangle(Quadric& outQuadric, const Vector3& p0, const Vector3& p1, const Vector3& p2)
+    {
+        Vector3 normal = (p1 - p0) ^ (p2 - p0);
+        float   length = normal.Size();
+        if (length <= 0.0f)
+        {
+            return;
+        }
+
+        normal = normal * (1.0f / length);
+        double a = normal.x;
+        double b = normal.y;
+        double c = normal.z;
+        double d = -(normal | p0);
+        double w = length * 0.5;
+
+        outQuadric.a2 = a * a * w; outQuadric.b2 = b * b * w; outQuadric.c2 = c * c * w;
+        outQuadric.ab = a * b * w; outQuadric.ac = a * c * w; outQuadric.bc = b * c * w;
+        outQuadric.ad = a * d * w; outQuadric.bd = b * d * w; outQuadric.cd = c * d * w;
+        outQuadric.d2 = d * d * w;
+        outQuadric.w  = w;
+    }
+
+    float DVKMeshSimplifier::GetErrorScale(const float* positions, uint32 positionStride, uint32 vertexCount)
+    {
+        Vector3 mmin( MAX_FLT,  MAX_FLT,  MAX_FLT);
+        Vector3 mmax(-MAX_FLT, -MAX_FLT, -MAX_FLT);
+        for (uint32 i = 0; i < vertexCount; ++i)
+        {
+            const float* position = positions + i * positionStride;
+            mmin = Vector3(MMath::Min(mmin.x, position[0]), MMath::Min(mmin.y, position[1]), MMath::Min(mmin.z, position[2]));
+            mmax = Vector3(MMath::Max(mmax.x, position[0]), MMath::Max(mmax.y, position[1]), MMath::Max(mmax.z, position[2]));
+        }
+
+        if (vertexCount == 0)
+        {
+            return 1.0f;
+        }
+
+        Vector3 extent = mmax - mmin;
+        float scale = MMath::Max(extent.x, MMath::Max(extent.y, extent.z));
+        return scale > 0.0f ? scale : 1.0f;
+    }
+
+    uint32 DVKMeshSimplifier::Simplify(uint32* dst, const uint32* indices, uint32 indexCount, const float* positions, uint32 positionStride, uint32 vertexCount, uint32 targetIndexCount, float targetError, float* outError)
+    {
+        indexCount = indexCount / 3 * 3;
+        if (dst != indices)
+        {
+            memcpy(dst, indices, indexCount * sizeof(uint32));
+        }
+
+        if (outError)
+        {
+            *outError = 0.0f;
+        }
+
+        if (indexCount <= targetIndexCount || vertexCount == 0)
+        {
+            return indexCount;
+        }
+
+        // 归一化到包围盒最大边长，误差与模型尺寸无关
+        float scale = GetErrorScale(positions, positionStride, vertexCount);
+        std::vector<Vector3> points(vertexCount);
+        {
+            Vector3 mmin(MAX_FLT, MAX_FLT, MAX_FLT);
+            for (uint32 i = 0; i < vertexCount; ++i)
+            {
+                const float* position = positions + i * positionStride;
+                mmin = Vector3(MMath::Min(mmin.x, position[0]), MMath::Min(mmin.y, position[1]), MMath::Min(mmin.z, position[2]));
+            }
+            for (uint32 i = 0; i < vertexCount; ++i)
+            {
+                const float* position = positions + i * positionStride;
+                points[i] = (Vector3(position[0], position[1], position[2]) - mmin) * (1.0f / scale);
+            }
+        }
+
+        // 只被一个三角形使用或方向不一致的边视为边界，两端的顶点固定
+        std::vector<uint8> locked(vertexCount, 0);
+        {
+            std::unordered_map<uint64, uint32> edges;
+            edges.reserve(indexCount);
+            for (uint32 i = 0; i < indexCount; ++i)
+            {
+                uint32 a = dst[i];
+                uint32 b = dst[i - i % 3 + (i + 1) % 3];
+                edges[((uint64)a << 32) | b] += 1;
+            }
+            for (auto it = edges.begin(); it != edges.end(); ++it)
+            {
+                uint32 a = (uint32)(it->first >> 32);
+                uint32 b = (uint32)(it->first & 0xFFFFFFFF);
+                auto reverse = edges.find(((uint64)b << 32) | a);
+                if (it->second != 1 || reverse == edges.end() || reverse->second != 1)
+                {
+                    locked[a] = 1;
+                    locked[b] = 1;
+                }
+            }
+        }
+
+        std::vector<Quadric> quadrics(vertexCount);
+        for (uint32 i = 0; i < indexCount; i += 3)
+        {
+            Quadric quadric;
+            QuadricFromTriangle(quadric, points[dst[i + 0]], points[dst[i + 1]], points[dst[i + 2]]);
+            quadrics[dst[i + 0]] += quadric;
+            quadrics[dst[i + 1]] += quadric;
+            quadrics[dst[i + 2]] += quadric;
+        }
+
+        std::vector<uint32>   adjacencyOffsets(vertexCount + 1);
+        std::vector<uint32>   adjacency(indexCount);
+        std::vector<uint32>   remap(vertexCount);
+        std::vector<uint8>    touched(vertexCount);
+        std::vector<Collapse> collapses;
+
+        for (uint32 i = 0; i < vertexCount; ++i)
+        {
+            remap[i] = i;
+        }
+
+        float errorLimit    = targetError * targetError;
+        float resultError   = 0.0f;
+        uint32 targetCount  = targetIndexCount / 3;
+
+        while (indexCount > targetIndexCount)
+        {
+            uint32 triangleCount = indexCount / 3;
+
+            // 顶点到三角形的邻接表，每一轮坍缩后重建
+            std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+            for (uint32 i = 0; i < indexCount; ++i)
+            {
+                adjacencyOffsets[dst[i] + 1] += 1;
+            }
+            for (uint32 i = 0; i < vertexCount; ++i)
+            {
+                adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+            }
+            for (uint32 i = 0; i < indexCount; ++i)
+            {
+                adjacency[adjacencyOffsets[dst[i]]++] = i / 3;
+            }
+            for (uint32 i = vertexCount; i > 0; --i)
+            {
+                adjacencyOffsets[i] = adjacencyOffsets[i - 1];
+            }
+            adjacencyOffsets[0] = 0;
+
+            // 内部边在两个三角形中方向相反各出现一次，只在a < b的一侧记录两个方向的坍缩
+            collapses.clear();
+            for (uint32 i = 0; i < indexCount; ++i)
+            {
+                uint32 a = dst[i];
+                uint32 b = dst[i - i % 3 + (i + 1) % 3];
+                if (a >= b || (locked[a] && locked[b]))
+                {
+                    continue;
+                }
+
+                Quadric quadric = quadrics[a];
+                quadric += quadrics[b];
+                if (!locked[a])
+                {
+                    collapses.push_back({ a, b, quadric.Error(points[b]) });
+                }
+                if (!locked[b])
+                {
+                    collapses.push_back({ b, a, quadric.Error(points[a]) });
+                }
+            }
+
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+            std::fill(touched.begin(), touched.end(), 0);
+            uint32 removed   = 0;
+            uint32 collapsed = 0;
+
+            for (int32 i = 0; i < collapses.size(); ++i)
+            {
+                const Collapse& collapse = collapses[i];
+                if (collapse.error > errorLimit || triangleCount - removed <= targetCount)
+                {
+                    break;
+                }
+
+                uint32 v0 = collapse.v0;
+                uint32 v1 = collapse.v1;
+                if (touched[v0] || touched[v1])
+                {
+                    continue;
+                }
+
+                // 共享v0v1边的三角形坍缩后被删除，记录它们的对顶点
+                uint32 removing = 0;
+                uint32 opposites[2] = { v0, v0 };
+                for (uint32 j = adjacencyOffsets[v0]; j < adjacencyOffsets[v0 + 1]; ++j)
+                {
+                    const uint32* triangle = dst + adjacency[j] * 3;
+                    if (triangle[0] == v1 || triangle[1] == v1 || triangle[2] == v1)
+                    {
+                        if (removing < 2)
+                        {
+                            opposites[removing] = triangle[0] ^ triangle[1] ^ triangle[2] ^ v0 ^ v1;
+                        }
+                        removing += 1;
+                    }
+                }
+
+                // 两个顶点的公共邻点只能是这些对顶点，否则坍缩后网格会粘连
+                bool valid = removing > 0 && removing <= 2;
+                for (uint32 j = adjacencyOffsets[v0]; valid && j < adjacencyOffsets[v0 + 1]; ++j)
+                {
+                    const uint32* triangle = dst + adjacency[j] * 3;
+                    if (triangle[0] == v1 || triangle[1] == v1 || triangle[2] == v1)
+                    {
+                        continue;
+                    }
+
+                    for (int32 k = 0; valid && k < 3; ++k)
+                    {
+                        uint32 neighbor = triangle[k];
+                        if (neighbor == v0 || neighbor == opposites[0] || neighbor == opposites[1])
+                        {
+                            continue;
+                        }
+
+                        for (uint32 l = adjacencyOffsets[v1]; l < adjacencyOffsets[v1 + 1]; ++l)
+                        {
+                            const uint32* other = dst + adjacency[l] * 3;
+                            if (other[0] == neighbor || other[1] == neighbor || other[2] == neighbor)
+                            {
+                                valid = false;
+                                break;
+                            }
+                        }
+                    }
+
+                    // v0移动到v1之后法线方向不能翻转
+                    uint32 k  = triangle[0] == v0 ? 0 : (triangle[1] == v0 ? 1 : 2);
+                    Vector3 p1 = points[triangle[(k + 1) % 3]];
+                    Vector3 p2 = points[triangle[(k + 2) % 3]];
+                    Vector3 before = (p1 - points[v0]) ^ (p2 - points[v0]);
+                    Vector3 after  = (p1 - points[v1]) ^ (p2 - points[v1]);
+                    if ((before | after) < FlipThreshold * before.Size() * after.Size())
+                    {
+                        valid = false;
+                    }
+                }
+
+                if (!valid)
+                {
+                    continue;
+                }
+
+                remap[v0] = v1;
+                quadrics[v1] += quadrics[v0];
+                resultError = MMath::Max(resultError, collapse.error);
+                removed    += removing;
+                collapsed  += 1;
+
+                // 一环邻域内的三角形已改变，本轮不再处理
+                for (uint32 j = adjacencyOffsets[v0]; j < adjacencyOffsets[v0 + 1]; ++j)
+                {
+                    const uint32* triangle = dst + adjacency[j] * 3;
+                    touched[triangle[0]] = 1;
+                    touched[triangle[1]] = 1;
+                    touched[triangle[2]] = 1;
+                }
+            }
+
+            if (collapsed == 0)
+            {
+                break;
+            }
+
+            // 重映射并去掉退化的三角形
+            uint32 count = 0;
+            for (uint32 i = 0; i < indexCount; i += 3)
+            {
+                uint32 a = remap[dst[i + 0]];
+                uint32 b = remap[dst[i + 1]];
+                uint32 c = remap[dst[i + 2]];
+                if (a != b && b != c && c != a)
+                {
+                    dst[count + 0] = a;
+                    dst[count + 1] = b;
+                    dst[count + 2] = c;
+                    count += 3;
+                }
+            }
+            indexCount = count;
+        }
+
+        if (outError)
+        {
+            *outError = MMath::Sqrt(resultError);
+        }
+
+        return indexCount;
+    }
+
+    void DVKMeshSimplifier::BuildLODs(std::vector<std::vector<uint32>>& outLODs, std::vector<float>& outErrors, const uint32* indices, uint32 indexCount, const float* positions, uint32 positionStride, uint32 vertexCount)
+    {
+        outLODs.clear();
+        outErrors.clear();
+
+        int32 levels = MMath::Min<int32>(lodCount, MaxLODs);
+        if (levels <= 0 || indexCount < 3 || vertexCount == 0)
+        {
+            return;
+        }
+
+        double beginTime = GenericPlatformTime::Seconds();
+
+        float scale = GetErrorScale(positions, positionStride, vertexCount);
+        float error = 0.0f;
+
+        std::vector<uint32> current(indices, indices + indexCount / 3 * 3);
+        std::vector<uint32> simplified;
+        for (int32 level = 0; level < levels; ++level)
+        {
+            uint32 targetIndexCount = (uint32)(current.size() / 3 * lodRatio) * 3;
+
+            // 每一级在上一级的基础上简化，误差按各级之和累计
+            float lodError = 0.0f;
+            simplified.resize(current.size());
+            uint32 count = Simplify(simplified.data(), current.data(), (uint32)current.size(), positions, positionStride, vertexCount, targetIndexCount, maxError, &lodError);
+            if (count == 0 || count > current.size() * MinLODReduction)
+            {
+                break;
+            }
+            simplified.resize(count);
+
+            if (DVKMeshOptimizer::enabled)
+            {
+                std::vector<uint32> optimized(count);
+                DVKMeshOptimizer::OptimizeVertexCache(optimized.data(), simplified.data(), count, vertexCount);
+                simplified.swap(optimized);
+            }
+
+            error += lodError * scale;
+            outLODs.push_back(simplified);
+            outErrors.push_back(error);
+            current = simplified;
+
+            numLODTriangles += count / 3;
+        }
+
+        numMeshes    += 1;
+        numLODs      += (uint32)outLODs.size();
+        numTriangles += indexCount / 3;
+        simplifyTime += GenericPlatformTime::Seconds() - beginTime;
+    }
+
+    void DVKMeshSimplifier::PrintStats()
+    {
+        if (numMeshes == 0)
+        {
+            return;
+        }
+
+        MLOG("Mesh simplifier stats : %d meshes, %d LODs, %d triangles, %d LOD triangles, %.2fms",
+            numMeshes,
+            numLODs,
+            (int32)numTriangles,
+            (int32)numLODTriangles,
+            simplifyTime * 1000.0
+        );
+    }
+}
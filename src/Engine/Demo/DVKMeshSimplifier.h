@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Common/Common.h"
+
+#include <vector>
+
+namespace vk_demo
+{
+    // 基于二次误差度量(QEM)的网格简化。每次把一个顶点坍缩到相邻的已有顶点上，
+    // 只删除三角形、不新增顶点，简化结果仍索引原来的顶点数组，各级LOD可以共用一个顶点缓冲。
+    // 开放边界(包括UV接缝拆开的顶点)上的顶点固定不动，简化后不会出现裂缝。
+    class DVKMeshSimplifier
+    {
+    public:
+        enum
+        {
+            MaxLODs = 8,
+        };
+
+        // 简化到targetIndexCount个索引以内，或坍缩误差超过targetError为止，返回dst中的索引数。
+        // targetError与outError都是相对于模型包围盒最大边长的比例；dst可以与indices相同。
+        static uint32 Simplify(uint32* dst, const uint32* indices, uint32 indexCount, const float* positions, uint32 positionStride, uint32 vertexCount, uint32 targetIndexCount, float targetError, float* outError = nullptr);
+
+        // Simplify的相对误差乘以该值为mesh空间的距离
+        static float GetErrorScale(const float* positions, uint32 positionStride, uint32 vertexCount);
+
+        // 依次按lodRatio简化，生成最多lodCount级LOD，不含原始的LOD0。
+        // outErrors为各级相对原始网格的mesh空间误差，单调递增；减少不足或误差超过maxError时提前结束
+        static void BuildLODs(std::vector<std::vector<uint32>>& outLODs, std::vector<float>& outErrors, const uint32* indices, uint32 indexCount, const float* positions, uint32 positionStride, uint32 vertexCount);
+
+        static void PrintStats();
+
+    public:
+        // 导入时生成的LOD级数，0为不生成
+        static int32    lodCount;
+        static float    lodRatio;
+        static float    maxError;
+
+        static uint32   numMeshes;
+        static uint32   numLODs;
+        static uint64   numTriangles;
+        static uint64   numLODTriangles;
+        static double   simplifyTime;
+    };
+}
@@ -0,0 +1,376 @@
+#include "DVKMeshlet.h"
+
+#include "Common/Log.h"
+#include "Math/Math.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "Vulkan/VulkanDevice.h"
+
+#include <cmath>
+
+namespace vk_demo
+{
+    // 当前簇没有相邻三角形时，从索引顺序上之后的这些三角形中选最近的一个
+    static const uint32 SEED_WINDOW = 256;
+
+    // 三角形法线与锥轴的最小夹角余弦低于该值时锥太宽，不做背面剔除
+    static const float CONE_MIN_DOT = 0.1f;
+
+    uint32 DVKMeshletBuilder::numMeshlets  = 0;
+    uint64 DVKMeshletBuilder::numTriangles = 0;
+    uint64 DVKMeshletBuilder::numVertices  = 0;
+    double DVKMeshletBuilder::buildTime    = 0.0;
+
+    static FORCE_INLINE Vector3 GetPosition(const float* positions, uint32 positionStride, uint32 index)
+    {
+        const float* position = positions + index * positionStride;
+        return Vector3(position[0], position[1], position[2]);
+    }
+
+    void DVKMeshletData::Upload(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader)
+    {
+        Release();
+
+        if (meshlets.size() == 0)
+        {
+            return;
+        }
+
+        auto CreateStorage = [&](const void* data, VkDeviceSize size) -> DVKBuffer*
+        {
+            DVKBuffer* buffer = DVKBuffer::CreateBuffer(
+                vulkanDevice,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                size
+            );
+            uploader->UploadBuffer(buffer, data, size);
+            return buffer;
+        };
+
+        meshletBuffer  = CreateStorage(meshlets.data(),  meshlets.size()  * sizeof(DVKMeshlet));
+        sphereBuffer   = CreateStorage(spheres.data(),   spheres.size()   * sizeof(Vector4));
+        coneBuffer     = CreateStorage(cones.data(),     cones.size()     * sizeof(Vector4));
+        vertexBuffer   = CreateStorage(vertices.data(),  vertices.size()  * sizeof(uint32));
+        triangleBuffer = CreateStorage(triangles.data(), triangles.size() * sizeof(uint8));
+    }
+
+    void DVKMeshletData::Release()
+    {
+        delete meshletBuffer;
+        delete sphereBuffer;
+        delete coneBuffer;
+        delete vertexBuffer;
+        delete triangleBuffer;
+
+        meshletBuffer  = nullptr;
+        sphereBuffer   = nullptr;
+        coneBuffer     = nullptr;
+        vertexBuffer   = nullptr;
+        triangleBuffer = nullptr;
+    }
+
+    void DVKMeshletBuilder::Build(DVKMeshletData& outData, const uint32* indices, uint32 indexCount, const float* positions, uint32 positionStride, uint32 vertexCount, uint32 maxVertices, uint32 maxTriangles)
+    {
+        double beginTime = GenericPlatformTime::Seconds();
+
+        outData.meshlets.clear();
+        outData.vertices.clear();
+        outData.triangles.clear();
+
+        // 局部索引是uint8
+        maxVertices  = MMath::Clamp<uint32>(maxVertices, 3, 255);
+        maxTriangles = MMath::Max<uint32>(maxTriangles, 1);
+
+        uint32 triangleCount = indexCount / 3;
+
+        // 顶点到三角形的邻接表
+        std::vector<uint32> adjacencyOffsets(vertexCount + 1, 0);
+        std::vector<uint32> adjacency(triangleCount * 3);
+        for (uint32 i = 0; i < triangleCount * 3; ++i)
+        {
+            adjacencyOffsets[indices[i] + 1] += 1;
+        }
+        for (uint32 i = 0; i < vertexCount; ++i)
+        {
+            adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+        }
+        // adjacencyCounts为尚未输出的三角形数，输出后从列表中移除，之后的查找只遍历剩下的
+        std::vector<uint32> adjacencyCounts(vertexCount, 0);
+        for (uint32 i = 0; i < triangleCount * 3; ++i)
+        {
+            uint32 vertex = indices[i];
+            adjacency[adjacencyOffsets[vertex] + adjacencyCounts[vertex]++] = i / 3;
+        }
+
+        std::vector<Vector3> centroids(triangleCount);
+        for (uint32 i = 0; i < triangleCount; ++i)
+        {
+            Vector3 p0 = GetPosition(positions, positionStride, indices[i * 3 + 0]);
+            Vector3 p1 = GetPosition(positions, positionStride, indices[i * 3 + 1]);
+            Vector3 p2 = GetPosition(positions, positionStride, indices[i * 3 + 2]);
+            centroids[i] = (p0 + p1 + p2) * (1.0f / 3.0f);
+        }
+
+        std::vector<uint8>  emitted(triangleCount, 0);
+        std::vector<uint8>  localIndices(vertexCount, 0xFF);
+        std::vector<uint32> meshletVertices;
+        std::vector<uint8>  meshletTriangles;
+        meshletVertices.reserve(maxVertices);
+        meshletTriangles.reserve(maxTriangles * 3);
+
+        Vector3 centroidSum(0.0f, 0.0f, 0.0f);
+        uint32  seedCursor = 0;
+
+        auto FinishMeshlet = [&]()
+        {
+            if (meshletTriangles.size() == 0)
+            {
+                return;
+            }
+
+            DVKMeshlet meshlet;
+            meshlet.vertexOffset   = (uint32)outData.vertices.size();
+            meshlet.triangleOffset = (uint32)outData.triangles.size();
+            meshlet.vertexCount    = (uint32)meshletVertices.size();
+            meshlet.triangleCount  = (uint32)meshletTriangles.size() / 3;
+            outData.meshlets.push_back(meshlet);
+
+            outData.vertices.insert(outData.vertices.end(), meshletVertices.begin(), meshletVertices.end());
+            outData.triangles.insert(outData.triangles.end(), meshletTriangles.begin(), meshletTriangles.end());
+            outData.triangles.resize((outData.triangles.size() + 3) & ~3, 0);
+
+            for (int32 i = 0; i < meshletVertices.size(); ++i)
+            {
+                localIndices[meshletVertices[i]] = 0xFF;
+            }
+            meshletVertices.clear();
+            meshletTriangles.clear();
+            centroidSum = Vector3(0.0f, 0.0f, 0.0f);
+        };
+
+        auto GetExtraVertices = [&](uint32 triangle) -> uint32
+        {
+            return (localIndices[indices[triangle * 3 + 0]] == 0xFF ? 1 : 0) +
+                   (localIndices[indices[triangle * 3 + 1]] == 0xFF ? 1 : 0) +
+                   (localIndices[indices[triangle * 3 + 2]] == 0xFF ? 1 : 0);
+        };
+
+        for (uint32 numEmitted = 0; numEmitted < triangleCount; ++numEmitted)
+        {
+            int32  best      = -1;
+            uint32 bestExtra = 4;
+            float  bestDist  = MAX_FLT;
+
+            uint32 numTriangles = (uint32)meshletTriangles.size() / 3;
+            Vector3 center = numTriangles > 0 ? centroidSum * (1.0f / numTriangles) : Vector3(0.0f, 0.0f, 0.0f);
+
+            // 优先共享顶点最多的相邻三角形，相同时取离簇中心最近的
+            for (int32 i = 0; i < meshletVertices.size(); ++i)
+            {
+                uint32 vertex = meshletVertices[i];
+                for (uint32 j = 0; j < adjacencyCounts[vertex]; ++j)
+                {
+                    uint32 triangle = adjacency[adjacencyOffsets[vertex] + j];
+                    uint32 extra = GetExtraVertices(triangle);
+                    if (extra > bestExtra)
+                    {
+                        continue;
+                    }
+
+                    float dist = (centroids[triangle] - center).SizeSquared();
+                    if (extra < bestExtra || dist < bestDist)
+                    {
+                        best      = (int32)triangle;
+                        bestExtra = extra;
+                        bestDist  = dist;
+                    }
+                }
+            }
+
+            if (best < 0)
+            {
+                while (emitted[seedCursor])
+                {
+                    seedCursor += 1;
+                }
+
+                // 簇为空时直接取索引顺序上的下一个，否则在之后的窗口内找最近的
+                best = (int32)seedCursor;
+                if (numTriangles > 0)
+                {
+                    bestDist = (centroids[seedCursor] - center).SizeSquared();
+                    uint32 windowEnd = MMath::Min(seedCursor + SEED_WINDOW, triangleCount);
+                    for (uint32 i = seedCursor + 1; i < windowEnd; ++i)
+                    {
+                        if (emitted[i])
+                        {
+                            continue;
+                        }
+
+                        float dist = (centroids[i] - center).SizeSquared();
+                        if (dist < bestDist)
+                        {
+                            best     = (int32)i;
+                            bestDist = dist;
+                        }
+                    }
+                }
+                bestExtra = GetExtraVertices(best);
+            }
+
+            if (meshletVertices.size() + bestExtra > maxVertices || numTriangles + 1 > maxTriangles)
+            {
+                FinishMeshlet();
+            }
+
+            for (int32 i = 0; i < 3; ++i)
+            {
+                uint32 vertex = indices[best * 3 + i];
+                if (localIndices[vertex] == 0xFF)
+                {
+                    localIndices[vertex] = (uint8)meshletVertices.size();
+                    meshletVertices.push_back(vertex);
+                }
+                meshletTriangles.push_back(localIndices[vertex]);
+
+                uint32* list = adjacency.data() + adjacencyOffsets[vertex];
+                uint32  last = adjacencyCounts[vertex] - 1;
+                for (uint32 j = 0; j <= last; ++j)
+                {
+                    if (list[j] == (uint32)best)
+                    {
+                        list[j] = list[last];
+                        adjacencyCounts[vertex] = last;
+                        break;
+                    }
+                }
+            }
+
+            emitted[best] = 1;
+            centroidSum  += centroids[best];
+        }
+
+        FinishMeshlet();
+
+        ComputeBounds(outData, positions, positionStride);
+
+        numMeshlets  += (uint32)outData.meshlets.size();
+        numTriangles += triangleCount;
+        numVertices  += outData.vertices.size();
+        buildTime    += GenericPlatformTime::Seconds() - beginTime;
+    }
+
+    void DVKMeshletBuilder::ComputeBounds(DVKMeshletData& outData, const float* positions, uint32 positionStride)
+    {
+        outData.spheres.resize(outData.meshlets.size());
+        outData.cones.resize(outData.meshlets.size());
+
+        std::vector<Vector3> normals;
+
+        for (int32 i = 0; i < outData.meshlets.size(); ++i)
+        {
+            const DVKMeshlet& meshlet = outData.meshlets[i];
+            const uint32* vertices    = outData.vertices.data() + meshlet.vertexOffset;
+            const uint8*  triangles   = outData.triangles.data() + meshlet.triangleOffset;
+
+            // Ritter包围球：先取相距较远的两点作为直径，再把球外的点依次包进来
+            Vector3 p0 = GetPosition(positions, positionStride, vertices[0]);
+            Vector3 p1 = p0;
+            float maxDist = -1.0f;
+            for (uint32 j = 0; j < meshlet.vertexCount; ++j)
+            {
+                Vector3 p = GetPosition(positions, positionStride, vertices[j]);
+                float dist = (p - p0).SizeSquared();
+                if (dist > maxDist)
+                {
+                    maxDist = dist;
+                    p1 = p;
+                }
+            }
+
+            Vector3 p2 = p1;
+            maxDist = -1.0f;
+            for (uint32 j = 0; j < meshlet.vertexCount; ++j)
+            {
+                Vector3 p = GetPosition(positions, positionStride, vertices[j]);
+                float dist = (p - p1).SizeSquared();
+                if (dist > maxDist)
+                {
+                    maxDist = dist;
+                    p2 = p;
+                }
+            }
+
+            Vector3 center = (p1 + p2) * 0.5f;
+            float   radius = (p2 - p1).Size() * 0.5f;
+            for (uint32 j = 0; j < meshlet.vertexCount; ++j)
+            {
+                Vector3 p = GetPosition(positions, positionStride, vertices[j]);
+                float dist = (p - center).Size();
+                if (dist > radius)
+                {
+                    float newRadius = (radius + dist) * 0.5f;
+                    center = center + (p - center) * ((newRadius - radius) / dist);
+                    radius = newRadius;
+                }
+            }
+
+            outData.spheres[i] = Vector4(center.x, center.y, center.z, radius);
+
+            // 法线锥：轴为单位法线的平均方向，张角由偏离最大的三角形决定
+            normals.clear();
+            Vector3 normalSum(0.0f, 0.0f, 0.0f);
+            for (uint32 j = 0; j < meshlet.triangleCount; ++j)
+            {
+                Vector3 a = GetPosition(positions, positionStride, vertices[triangles[j * 3 + 0]]);
+                Vector3 b = GetPosition(positions, positionStride, vertices[triangles[j * 3 + 1]]);
+                Vector3 c = GetPosition(positions, positionStride, vertices[triangles[j * 3 + 2]]);
+                // 细长三角形的叉积可能很小，只跳过面积为0的
+                Vector3 normal = (b - a) ^ (c - a);
+                if (!normal.Normalize(0.0f))
+                {
+                    continue;
+                }
+                normals.push_back(normal);
+                normalSum += normal;
+            }
+
+            Vector3 axis = normalSum;
+            float   cutoff = 1.0f;
+            if (normals.size() > 0 && axis.Normalize())
+            {
+                float minDot = 1.0f;
+                for (int32 j = 0; j < normals.size(); ++j)
+                {
+                    minDot = MMath::Min(minDot, Vector3::DotProduct(normals[j], axis));
+                }
+                if (minDot > CONE_MIN_DOT)
+                {
+                    cutoff = std::sqrt(1.0f - minDot * minDot);
+                }
+            }
+            else
+            {
+                axis = Vector3(0.0f, 0.0f, 1.0f);
+            }
+
+            outData.cones[i] = Vector4(axis.x, axis.y, axis.z, cutoff);
+        }
+    }
+
+    void DVKMeshletBuilder::PrintStats()
+    {
+        if (numMeshlets == 0)
+        {
+            return;
+        }
+
+        MLOG("Meshlet stats : %d meshlets, %.1f triangles, %.1f vertices per meshlet, %.3fms, %.2fM triangles/s",
+            numMeshlets,
+            (double)numTriangles / numMeshlets,
+            (double)numVertices / numMeshlets,
+            buildTime * 1000.0,
+            buildTime > 0.0 ? numTriangles / buildTime / 1000000.0 : 0.0
+        );
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "DVKBuffer.h"
+#include "DVKUploadQueue.h"
+
+#include "Common/Common.h"
+#include "Math/Vector3.h"
+#include "Math/Vector4.h"
+
+#include <vector>
+#include <memory>
+
+class VulkanDevice;
+
+namespace vk_demo
+{
+    // 与shader中的uvec4对应
+    struct DVKMeshlet
+    {
+        uint32  vertexOffset = 0;       // meshletVertices中的起始位置
+        uint32  triangleOffset = 0;     // meshletTriangles中的起始字节，按4字节对齐
+        uint32  vertexCount = 0;
+        uint32  triangleCount = 0;
+    };
+
+    // 一个primitive的全部meshlet。除meshlets外每个meshlet的数据分别连续存放(SoA)，
+    // 上传后都是storage buffer，compute shader中按meshlet索引直接读取：
+    // meshlets  : uvec4(vertexOffset, triangleOffset, vertexCount, triangleCount)
+    // spheres   : vec4(center, radius)
+    // cones     : vec4(axis, cutoff)，cutoff为1时不做背面剔除
+    // vertices  : uint，meshlet局部索引到primitive顶点
+    // triangles : 每个三角形3个uint8局部索引，按uint读取
+    struct DVKMeshletData
+    {
+        DVKMeshletData()
+        {
+
+        }
+
+        ~DVKMeshletData()
+        {
+            Release();
+        }
+
+        // 记录到uploader，使用前需Flush/Wait
+        void Upload(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader);
+
+        void Release();
+
+        std::vector<DVKMeshlet>     meshlets;
+        std::vector<Vector4>        spheres;
+        std::vector<Vector4>        cones;
+        std::vector<uint32>         vertices;
+        std::vector<uint8>          triangles;
+
+        DVKBuffer*                  meshletBuffer = nullptr;
+        DVKBuffer*                  sphereBuffer = nullptr;
+        DVKBuffer*                  coneBuffer = nullptr;
+        DVKBuffer*                  vertexBuffer = nullptr;
+        DVKBuffer*                  triangleBuffer = nullptr;
+    };
+
+    // 把索引缓冲划分为小的三角形簇。从一个三角形开始，每次加入与当前簇共享顶点最多、
+    // 离簇中心最近的相邻三角形，顶点或三角形数达到上限时开始新的簇。
+    // 输入最好已经过DVKMeshOptimizer重排，种子按索引顺序选取。
+    class DVKMeshletBuilder
+    {
+    public:
+        enum
+        {
+            MaxVertices  = 64,
+            MaxTriangles = 124,
+        };
+
+        // positions按positionStride(以float为单位)间隔存放xyz
+        static void Build(DVKMeshletData& outData, const uint32* indices, uint32 indexCount, const float* positions, uint32 positionStride, uint32 vertexCount, uint32 maxVertices = MaxVertices, uint32 maxTriangles = MaxTriangles);
+
+        // 包围球与法线锥，同时写入outData的spheres与cones
+        static void ComputeBounds(DVKMeshletData& outData, const float* positions, uint32 positionStride);
+
+        // 簇中所有三角形都背对相机时返回true
+        static FORCE_INLINE bool IsBackfacing(const Vector4& sphere, const Vector4& cone, const Vector3& cameraPosition)
+        {
+            Vector3 direction(sphere.x - cameraPosition.x, sphere.y - cameraPosition.y, sphere.z - cameraPosition.z);
+            float   distance = direction.Size();
+            return direction.x * cone.x + direction.y * cone.y + direction.z * cone.z >= cone.w * distance + sphere.w;
+        }
+
+        static void PrintStats();
+
+    public:
+        static uint32   numMeshlets;
+        static uint64   numTriangles;
+        static uint64   numVertices;
+        static double   buildTime;
+    };
+}
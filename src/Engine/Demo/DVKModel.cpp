@@ -1,8 +1,14 @@
 #include "DVKModel.h"
+#include "DVKMeshCook.h"
+#include "DVKMeshOptimizer.h"
+#include "DVKMeshSimplifier.h"
+#include "DVKVertexQuantizer.h"
 #include "Common/Common.h"
 #include "Demo/DVKIndexBuffer.h"
 #include "Demo/DVKVertexBuffer.h"
 #include "FileManager.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "Utils/CPUProfiler.h"
 #include "Math/Math.h"
 #include "Math/Matrix4x4.h"
 
@@ -25,6 +31,8 @@
 
 namespace vk_demo
 {
+    static const float ANIM_SAMPLE_RATE = 30.0f;
+
     void SimplifyTexturePath(std::string& path)
     {
         const size_t lastSlashIdx = path.find_last_of("\\/");
@@ -67,6 +75,21 @@ namespace vk_demo
         }
     }
 
+    // 整数格式时直接写入位模式，float只能精确表示2^24以内的整数
+    static void PushSkinPack(std::vector<float>& vertices, bool integer, uint32 packIndex, uint32 packWeight0, uint32 packWeight1)
+    {
+        uint32 packed[3] = { packIndex, packWeight0, packWeight1 };
+        for (int32 i = 0; i < 3; ++i)
+        {
+            float value = (float)packed[i];
+            if (integer)
+            {
+                memcpy(&value, &packed[i], sizeof(float));
+            }
+            vertices.push_back(value);
+        }
+    }
+
     void FillMatrixWithAiMatrix(Matrix4x4& matrix, const aiMatrix4x4& aiMatrix)
     {
         matrix.m[0][0] = aiMatrix.a1;
@@ -89,11 +112,32 @@ namespace vk_demo
     }
 
     DVKModel* DVKModel::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, const std::vector<float>& vertices, const std::vector<uint16>& indices, const std::vector<VertexAttribute>& attributes)
+    {
+        DVKModel* model  = Create(vulkanDevice, (DVKUploadQueue*)nullptr, vertices, indices, attributes);
+        model->cmdBuffer = cmdBuffer;
+
+        // 单独创建时直接经cmdBuffer同步上传，批量加载使用uploader版本
+        if (cmdBuffer)
+        {
+            DVKPrimitive* primitive = model->meshes[0]->primitives[0];
+            if (vertices.size() > 0)
+            {
+                primitive->vertexBuffer = DVKVertexBuffer::Create(vulkanDevice, cmdBuffer, primitive->vertices, attributes);
+            }
+            if (indices.size() > 0)
+            {
+                primitive->indexBuffer = DVKIndexBuffer::Create(vulkanDevice, cmdBuffer, primitive->indices);
+            }
+        }
+
+        return model;
+    }
+
+    DVKModel* DVKModel::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const std::vector<float>& vertices, const std::vector<uint16>& indices, const std::vector<VertexAttribute>& attributes)
     {
         DVKModel* model   = new DVKModel();
         model->device     = vulkanDevice;
         model->attributes = attributes;
-        model->cmdBuffer  = cmdBuffer;
 
         int32 stride = 0;
         for (int32 i = 0; i < attributes.size(); ++i)
@@ -106,15 +150,15 @@ namespace vk_demo
         primitive->indices      = indices;
         primitive->vertexCount  = (int32)vertices.size() / stride * 4;
 
-        if (cmdBuffer)
+        if (uploader)
         {
             if (vertices.size() > 0)
             {
-                primitive->vertexBuffer = DVKVertexBuffer::Create(vulkanDevice, cmdBuffer, primitive->vertices, attributes);
+                primitive->vertexBuffer = DVKVertexBuffer::Create(vulkanDevice, uploader, primitive->vertices, attributes);
             }
             if (indices.size() > 0)
             {
-                primitive->indexBuffer = DVKIndexBuffer::Create(vulkanDevice, cmdBuffer, primitive->indices);
+                primitive->indexBuffer = DVKIndexBuffer::Create(vulkanDevice, uploader, primitive->indices);
             }
         }
 
@@ -131,19 +175,99 @@ namespace vk_demo
 
         model->rootNode = rootNode;
         model->meshes.push_back(mesh);
+        model->BuildSkeleton();
 
         return model;
     }
 
-    DVKModel* DVKModel::LoadFromFile(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, const std::vector<VertexAttribute>& attributes)
+    DVKModel* DVKModel::LoadFromFile(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization)
     {
-        DVKModel* model   = new DVKModel();
-        model->device     = vulkanDevice;
-        model->attributes = attributes;
-        model->cmdBuffer  = cmdBuffer;
+        if (cmdBuffer == nullptr)
+        {
+            return LoadFromFileAsync(filename, vulkanDevice, nullptr, attributes, quantization);
+        }
+
+        // 所有mesh共用一个uploader，整个模型只需要少量几次提交
+        DVKUploadQueue* uploader = DVKUploadQueue::Create(vulkanDevice);
+        DVKModel* model  = LoadFromFileAsync(filename, vulkanDevice, uploader, attributes, quantization);
+        model->cmdBuffer = cmdBuffer;
+        uploader->WaitIdle();
+        uploader->PrintStats();
+        delete uploader;
+
+        return model;
+    }
+
+    DVKModel* DVKModel::LoadFromFileAsync(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization)
+    {
+        CPU_PROFILE_SCOPE("DVKModel::LoadFromFile");
+
+        DVKModel* model = DVKMeshCook::Load(filename, vulkanDevice, uploader, attributes, quantization);
+        if (!model)
+        {
+            model = LoadFromAssimp(filename, vulkanDevice, uploader, attributes, quantization);
+
+            // 写出cooked文件，下次启动跳过Assimp
+            MappedFile sourceFile;
+            if (model->rootNode && FileManager::MapFile(filename, sourceFile))
+            {
+                DVKMeshCook::Save(model, filename, sourceFile.data, sourceFile.size);
+                FileManager::UnmapFile(sourceFile);
+            }
+        }
+
+        if (model->quantization.IsQuantized())
+        {
+            uint64 bytes      = 0;
+            uint64 floatBytes = 0;
+            model->GetVertexMemory(bytes, floatBytes);
+            MLOG("Vertex quantized : %s, %.1fKB -> %.1fKB, saved %.1fKB (%.1f%%)",
+                filename.c_str(),
+                floatBytes / 1024.0,
+                bytes / 1024.0,
+                (floatBytes - bytes) / 1024.0,
+                floatBytes > 0 ? (floatBytes - bytes) * 100.0 / floatBytes : 0.0
+            );
+        }
+
+        int32 lodCount        = 1;
+        int32 triangles       = 0;
+        int32 lowestTriangles = 0;
+        for (int32 i = 0; i < model->meshes.size(); ++i)
+        {
+            DVKMesh* mesh    = model->meshes[i];
+            lodCount         = MMath::Max(lodCount, mesh->GetLODCount());
+            triangles       += mesh->GetTriangleCount(0);
+            lowestTriangles += mesh->GetTriangleCount(mesh->GetLODCount() - 1);
+        }
+        if (lodCount > 1)
+        {
+            MLOG("Mesh LODs : %s, %d levels, %d -> %d triangles", filename.c_str(), lodCount, triangles, lowestTriangles);
+        }
+
+        return model;
+    }
+
+    DVKModel* DVKModel::LoadFromAssimp(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization)
+    {
+        CPU_PROFILE_SCOPE("DVKModel::LoadFromAssimp");
+
+        double beginTime = GenericPlatformTime::Seconds();
+
+        DVKModel* model     = new DVKModel();
+        model->device       = vulkanDevice;
+        model->attributes   = attributes;
+        model->quantization = DVKVertexQuantizer::Validate(attributes, quantization);
+        model->uploader     = uploader;
 
         int assimpFlags = aiProcess_Triangulate | aiProcess_FlipUVs;
 
+        // 不合并重复顶点时每个三角形都有独立的顶点，cache重排与简化都没有意义
+        if (DVKMeshOptimizer::enabled || DVKMeshSimplifier::lodCount > 0)
+        {
+            assimpFlags = assimpFlags | aiProcess_JoinIdenticalVertices;
+        }
+
         for (int32 i = 0; i < attributes.size(); ++i)
         {
             if (attributes[i] == VertexAttribute::VA_Tangent)
@@ -182,12 +306,36 @@ namespace vk_demo
         Assimp::Importer importer;
         const aiScene* scene = importer.ReadFileFromMemory(dataPtr, dataSize, assimpFlags);
 
+        uint64 transformedBefore = DVKMeshOptimizer::transformedBefore;
+        uint64 transformedAfter  = DVKMeshOptimizer::transformedAfter;
+        uint64 numTriangles      = DVKMeshOptimizer::numTriangles;
+        uint64 numVertices       = DVKMeshOptimizer::numVertices;
+
         model->LoadBones(scene);
         model->LoadNode(scene->mRootNode, scene);
+
+        numTriangles = DVKMeshOptimizer::numTriangles - numTriangles;
+        numVertices  = DVKMeshOptimizer::numVertices - numVertices;
+        if (numTriangles > 0)
+        {
+            MLOG("Mesh optimized : %s, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+                filename.c_str(),
+                (double)(DVKMeshOptimizer::transformedBefore - transformedBefore) / numTriangles,
+                (double)(DVKMeshOptimizer::transformedAfter  - transformedAfter)  / numTriangles,
+                (double)(DVKMeshOptimizer::transformedBefore - transformedBefore) / MMath::Max<uint64>(numVertices, 1),
+                (double)(DVKMeshOptimizer::transformedAfter  - transformedAfter)  / MMath::Max<uint64>(numVertices, 1)
+            );
+        }
         model->LoadAnim(scene);
+        model->BuildSkeleton();
 
         delete[] dataPtr;
 
+        model->uploader = nullptr;
+
+        DVKMeshCook::numAssimpLoads += 1;
+        DVKMeshCook::assimpTime     += GenericPlatformTime::Seconds() - beginTime;
+
         return model;
     }
 
@@ -290,6 +438,8 @@ namespace vk_demo
             MMath::RandRange(0.0f, 1.0f)
         );
 
+        bool integerSkinPack = quantization.GetElementType(VertexAttribute::VA_SkinPack) == VET_UInt3;
+
         for (int32 i = 0; i < (int32)aiMesh->mNumVertices; ++i)
         {
             for (int32 j = 0; j < attributes.size(); ++j)
@@ -384,15 +534,11 @@ namespace vk_demo
                         uint32 packWeight0 = (weight0 << 16) + weight1;
                         uint32 packWeight1 = (weight2 << 16) + weight3;
 
-                        vertices.push_back((float)packIndex);
-                        vertices.push_back((float)packWeight0);
-                        vertices.push_back((float)packWeight1);
+                        PushSkinPack(vertices, integerSkinPack, packIndex, packWeight0, packWeight1);
                     }
                     else
                     {
-                        vertices.push_back(0);
-                        vertices.push_back(65535);
-                        vertices.push_back(0);
+                        PushSkinPack(vertices, integerSkinPack, 0, 65535, 0);
                     }
                 }
                 else if (attributes[j] == VertexAttribute::VA_SkinIndex)
@@ -496,16 +642,6 @@ namespace vk_demo
                     primitive = nullptr;
                 }
             }
-
-            if (cmdBuffer)
-            {
-                for (int32 i = 0; i < mesh->primitives.size(); ++i)
-                {
-                    primitive = mesh->primitives[i];
-                    primitive->vertexBuffer = DVKVertexBuffer::Create(device, cmdBuffer, primitive->vertices, attributes);
-                    primitive->indexBuffer  = DVKIndexBuffer::Create(device, cmdBuffer, primitive->indices);
-                }
-            }
         }
         else
         {
@@ -516,12 +652,6 @@ namespace vk_demo
                 primitive->indices.push_back(indices[i]);
             }
             mesh->primitives.push_back(primitive);
-
-            if (cmdBuffer)
-            {
-                primitive->vertexBuffer = DVKVertexBuffer::Create(device, cmdBuffer, primitive->vertices, attributes);
-                primitive->indexBuffer  = DVKIndexBuffer::Create(device, cmdBuffer, primitive->indices);
-            }
         }
 
         for (int32 i = 0; i < mesh->primitives.size(); ++i)
@@ -535,6 +665,24 @@ namespace vk_demo
         }
     }
 
+    void DVKModel::LoadLODs(DVKPrimitive* primitive, int32 stride, int32 positionOffset)
+    {
+        // 拆分边界在primitive内是开放边界，顶点固定不动，相邻primitive之间不会出现裂缝
+        std::vector<uint32> indices(primitive->indices.begin(), primitive->indices.end());
+        std::vector<std::vector<uint32>> lodIndices;
+        std::vector<float> lodErrors;
+        DVKMeshSimplifier::BuildLODs(lodIndices, lodErrors, indices.data(), (uint32)indices.size(), primitive->vertices.data() + positionOffset, stride, (uint32)(primitive->vertices.size() / stride));
+
+        primitive->lods.resize(lodIndices.size());
+        for (int32 i = 0; i < lodIndices.size(); ++i)
+        {
+            DVKPrimitiveLOD& lod = primitive->lods[i];
+            lod.indices.assign(lodIndices[i].begin(), lodIndices[i].end());
+            lod.triangleNum = (int32)lod.indices.size() / 3;
+            lod.error       = lodErrors[i];
+        }
+    }
+
     DVKMesh* DVKModel::LoadMesh(const aiMesh* aiMesh, const aiScene* aiScene)
     {
         DVKMesh* mesh = new DVKMesh();
@@ -563,9 +711,59 @@ namespace vk_demo
         std::vector<uint32> indices;
         LoadIndices(indices, aiMesh, aiScene);
 
+        int32 stride         = 0;
+        int32 positionOffset = -1;
+        for (int32 i = 0; i < attributes.size(); ++i)
+        {
+            if (attributes[i] == VertexAttribute::VA_Position)
+            {
+                positionOffset = stride;
+            }
+            stride += VertexAttributeToSize(attributes[i]) / sizeof(float);
+        }
+
+        // 重排三角形与顶点的顺序，提高post-transform cache命中率并减少overdraw
+        if (DVKMeshOptimizer::enabled)
+        {
+            DVKMeshOptimizer::Optimize(vertices, indices, stride, positionOffset);
+        }
+
         // load primitives
         LoadPrimitives(vertices, indices, mesh, aiMesh, aiScene);
 
+        // 拆分后每个primitive分别简化与压缩，两者都需要读取float的位置
+        for (int32 i = 0; i < mesh->primitives.size(); ++i)
+        {
+            DVKPrimitive* primitive = mesh->primitives[i];
+
+            if (DVKMeshSimplifier::lodCount > 0 && positionOffset >= 0)
+            {
+                LoadLODs(primitive, stride, positionOffset);
+            }
+
+            if (quantization.IsQuantized())
+            {
+                DVKVertexQuantizer::Quantize(primitive->vertices, attributes, quantization, mmin, mmax);
+            }
+
+            if (uploader)
+            {
+                primitive->vertexBuffer = DVKVertexBuffer::Create(device, uploader, primitive->vertices, attributes, quantization);
+                primitive->indexBuffer  = DVKIndexBuffer::Create(device, uploader, primitive->indices);
+                for (int32 j = 0; j < primitive->lods.size(); ++j)
+                {
+                    primitive->lods[j].indexBuffer = DVKIndexBuffer::Create(device, uploader, primitive->lods[j].indices);
+                }
+            }
+        }
+
+        mesh->UpdateLODErrors();
+
+        if (quantization.IsQuantized())
+        {
+            DVKVertexQuantizer::GetPositionTransform(quantization.GetElementType(VertexAttribute::VA_Position), mmin, mmax, mesh->dequantizeOffset, mesh->dequantizeScale);
+        }
+
         mesh->bounding.min = mmin;
         mesh->bounding.max = mmax;
         mesh->bounding.UpdateCorners();
@@ -647,9 +845,9 @@ namespace vk_demo
                 aiNodeAnim* nodeAnim = aianimation->mChannels[j];
                 std::string nodeName = nodeAnim->mNodeName.C_Str();
 
-                dvkAnimation.clips.insert(std::make_pair(nodeName, DVKAnimationClip()));
+                dvkAnimation.clips.push_back(DVKAnimationClip());
 
-                DVKAnimationClip& animClip = dvkAnimation.clips[nodeName];
+                DVKAnimationClip& animClip = dvkAnimation.clips.back();
                 animClip.nodeName = nodeName;
                 animClip.duration = 0.0f;
 
@@ -680,11 +878,76 @@ namespace vk_demo
                     animClip.duration = MMath::Max((float)aikey.mTime / timeTick, animClip.duration);
                 }
 
+                // 非等间隔的关键帧重采样为固定帧率，播放时直接计算索引
+                animClip.positions.Resample(ANIM_SAMPLE_RATE);
+                animClip.scales.Resample(ANIM_SAMPLE_RATE);
+                animClip.rotations.Resample(ANIM_SAMPLE_RATE);
+
                 dvkAnimation.duration = MMath::Max(animClip.duration, dvkAnimation.duration);
             }
         }
     }
 
+    void DVKModel::BuildSkeleton()
+    {
+        skeleton = DVKSkeleton();
+        if (rootNode == nullptr)
+        {
+            return;
+        }
+
+        // 先序遍历，保证父节点排在子节点之前
+        std::unordered_map<DVKNode*, int32> nodeIndices;
+        std::vector<DVKNode*> stack;
+        stack.push_back(rootNode);
+        while (stack.size() > 0)
+        {
+            DVKNode* node = stack.back();
+            stack.pop_back();
+
+            nodeIndices.insert(std::make_pair(node, (int32)skeleton.nodes.size()));
+            skeleton.nodes.push_back(node);
+            skeleton.parents.push_back(node->parent ? nodeIndices[node->parent] : -1);
+
+            for (int32 i = (int32)node->children.size() - 1; i >= 0; --i)
+            {
+                stack.push_back(node->children[i]);
+            }
+        }
+
+        int32 numNodes = (int32)skeleton.nodes.size();
+        skeleton.translations.resize(numNodes, Vector3(0, 0, 0));
+        skeleton.rotations.resize(numNodes, Quat(0, 0, 0, 1));
+        skeleton.scales.resize(numNodes, Vector3(1, 1, 1));
+        skeleton.animated.resize(numNodes, 0);
+        skeleton.globalMatrices.resize(numNodes);
+
+        auto findNode = [&](const std::string& name) -> int32
+        {
+            auto it = nodesMap.find(name);
+            if (it == nodesMap.end())
+            {
+                return -1;
+            }
+            return nodeIndices[it->second];
+        };
+
+        skeleton.boneNodes.resize(bones.size());
+        for (int32 i = 0; i < bones.size(); ++i)
+        {
+            skeleton.boneNodes[i] = findNode(bones[i]->name);
+        }
+
+        for (int32 i = 0; i < animations.size(); ++i)
+        {
+            for (int32 j = 0; j < animations[i].clips.size(); ++j)
+            {
+                DVKAnimationClip& clip = animations[i].clips[j];
+                clip.nodeIndex = findNode(clip.nodeName);
+            }
+        }
+    }
+
     void DVKModel::GotoAnimation(float time)
     {
         if (animIndex == -1)
@@ -695,11 +958,16 @@ namespace vk_demo
         DVKAnimation& animation = animations[animIndex];
         animation.time = MMath::Clamp(time, 0.0f, animation.duration);
 
-        // update nodes animation
-        for (auto it = animation.clips.begin(); it != animation.clips.end(); ++it)
+        // sample clips
+        std::fill(skeleton.animated.begin(), skeleton.animated.end(), 0);
+        for (int32 i = 0; i < animation.clips.size(); ++i)
         {
-            vk_demo::DVKAnimationClip& clip = it->second;
-            vk_demo::DVKNode* node = nodesMap[clip.nodeName];
+            DVKAnimationClip& clip = animation.clips[i];
+            int32 nodeIndex = clip.nodeIndex;
+            if (nodeIndex < 0)
+            {
+                continue;
+            }
 
             float alpha = 0.0f;
 
@@ -707,39 +975,62 @@ namespace vk_demo
             Quat prevRot(0, 0, 0, 1);
             Quat nextRot(0, 0, 0, 1);
             clip.rotations.GetValue(animation.time, prevRot, nextRot, alpha);
-            Quat retRot = MMath::Lerp(prevRot, nextRot, alpha);
+            skeleton.rotations[nodeIndex] = MMath::Lerp(prevRot, nextRot, alpha);
 
             // position
             Vector3 prevPos(0, 0, 0);
             Vector3 nextPos(0, 0, 0);
             clip.positions.GetValue(animation.time, prevPos, nextPos, alpha);
-            Vector3 retPos = MMath::Lerp(prevPos, nextPos, alpha);
+            skeleton.translations[nodeIndex] = MMath::Lerp(prevPos, nextPos, alpha);
 
             // scale
             Vector3 prevScale(1, 1, 1);
             Vector3 nextScale(1, 1, 1);
             clip.scales.GetValue(animation.time, prevScale, nextScale, alpha);
-            Vector3 retScale = MMath::Lerp(prevScale, nextScale, alpha);
+            skeleton.scales[nodeIndex] = MMath::Lerp(prevScale, nextScale, alpha);
 
-            node->localMatrix.SetIdentity();
-            node->localMatrix.AppendScale(retScale);
-            node->localMatrix.Append(retRot.ToMatrix());
-            node->localMatrix.AppendTranslation(retPos);
+            skeleton.animated[nodeIndex] = 1;
+        }
+
+        // local to global，父节点已先于子节点计算
+        for (int32 i = 0; i < skeleton.nodes.size(); ++i)
+        {
+            DVKNode* node = skeleton.nodes[i];
+            if (skeleton.animated[i])
+            {
+                node->localMatrix.SetIdentity();
+                node->localMatrix.AppendScale(skeleton.scales[i]);
+                node->localMatrix.Append(skeleton.rotations[i].ToMatrix());
+                node->localMatrix.AppendTranslation(skeleton.translations[i]);
+            }
+
+            Matrix4x4& globalMatrix = skeleton.globalMatrices[i];
+            globalMatrix = node->localMatrix;
+            if (skeleton.parents[i] >= 0)
+            {
+                globalMatrix.Append(skeleton.globalMatrices[skeleton.parents[i]]);
+            }
+            node->globalMatrix = globalMatrix;
         }
 
         // update bones
         for (int32 i = 0; i < bones.size(); ++i)
         {
             DVKBone* bone = bones[i];
-            DVKNode* node = nodesMap[bone->name];
+            int32 nodeIndex = skeleton.boneNodes[i];
             // 注意行列矩阵的区别
             bone->finalTransform = bone->inverseBindPose;
-            bone->finalTransform.Append(node->GetGlobalMatrix());
+            if (nodeIndex >= 0)
+            {
+                bone->finalTransform.Append(skeleton.globalMatrices[nodeIndex]);
+            }
         }
     }
 
     void DVKModel::Update(float time, float delta)
     {
+        CPU_PROFILE_SCOPE("DVKModel::Update");
+
         if (animIndex == -1)
         {
             return;
@@ -783,7 +1074,7 @@ namespace vk_demo
         int32 stride = 0;
         for (int32 i = 0; i < attributes.size(); ++i)
         {
-            stride += VertexAttributeToSize(attributes[i]);
+            stride += VertexAttributeToSize(attributes[i], quantization);
         }
 
         VkVertexInputBindingDescription vertexInputBinding = {};
@@ -804,13 +1095,176 @@ namespace vk_demo
             VkVertexInputAttributeDescription inputAttribute = {};
             inputAttribute.binding  = 0;
             inputAttribute.location = i;
-            inputAttribute.format   = VertexAttributeToVkFormat(attributes[i]);
+            inputAttribute.format   = VertexAttributeToVkFormat(attributes[i], quantization);
             inputAttribute.offset   = offset;
-            offset += VertexAttributeToSize(attributes[i]);
+            offset += VertexAttributeToSize(attributes[i], quantization);
             vertexInputAttributs.push_back(inputAttribute);
         }
 
         return vertexInputAttributs;
     }
 
+    void DVKModel::SetMovable(bool movable, const std::function<void()>& onMoved)
+    {
+        std::vector<DVKBuffer*> buffers;
+        for (int32 i = 0; i < meshes.size(); ++i)
+        {
+            DVKMesh* mesh = meshes[i];
+            for (int32 j = 0; j < mesh->primitives.size(); ++j)
+            {
+                DVKPrimitive* primitive = mesh->primitives[j];
+                if (primitive->vertexBuffer)
+                {
+                    buffers.push_back(primitive->vertexBuffer->dvkBuffer);
+                }
+                if (primitive->instanceBuffer)
+                {
+                    buffers.push_back(primitive->instanceBuffer->dvkBuffer);
+                }
+                if (primitive->indexBuffer)
+                {
+                    buffers.push_back(primitive->indexBuffer->dvkBuffer);
+                }
+                for (int32 k = 0; k < primitive->lods.size(); ++k)
+                {
+                    if (primitive->lods[k].indexBuffer)
+                    {
+                        buffers.push_back(primitive->lods[k].indexBuffer->dvkBuffer);
+                    }
+                }
+            }
+        }
+
+        int32 numMovable = 0;
+        for (int32 i = 0; i < buffers.size(); ++i)
+        {
+            DVKBuffer* buffer = buffers[i];
+            if (!buffer->SetMovable(movable) || !movable)
+            {
+                buffer->onMoved = nullptr;
+                continue;
+            }
+
+            buffer->onMoved = [onMoved](DVKBuffer*) {
+                if (onMoved)
+                {
+                    onMoved();
+                }
+            };
+            numMovable += 1;
+        }
+
+        if (movable)
+        {
+            MLOG("Model movable : %d/%d buffers", numMovable, (int32)buffers.size());
+        }
+    }
+
+    void DVKModel::GetVertexMemory(uint64& outBytes, uint64& outFloatBytes)
+    {
+        uint32 stride      = 0;
+        uint32 floatStride = 0;
+        for (int32 i = 0; i < attributes.size(); ++i)
+        {
+            stride      += VertexAttributeToSize(attributes[i], quantization);
+            floatStride += VertexAttributeToSize(attributes[i]);
+        }
+
+        outBytes      = 0;
+        outFloatBytes = 0;
+        for (int32 i = 0; i < meshes.size(); ++i)
+        {
+            for (int32 j = 0; j < meshes[i]->primitives.size(); ++j)
+            {
+                uint64 vertexCount = meshes[i]->primitives[j]->vertexCount;
+                outBytes      += vertexCount * stride;
+                outFloatBytes += vertexCount * floatStride;
+            }
+        }
+    }
+
+
+    void DVKModel::BuildMeshlets(DVKUploadQueue* uploader, uint32 maxVertices, uint32 maxTriangles)
+    {
+        CPU_PROFILE_SCOPE("DVKModel::BuildMeshlets");
+
+        uint32 stride         = 0;
+        int32  positionOffset = -1;
+        for (int32 i = 0; i < attributes.size(); ++i)
+        {
+            if (attributes[i] == VertexAttribute::VA_Position)
+            {
+                positionOffset = stride;
+            }
+            stride += VertexAttributeToSize(attributes[i], quantization);
+        }
+
+        if (positionOffset < 0 || stride == 0)
+        {
+            MLOGE("BuildMeshlets : model has no position attribute.");
+            return;
+        }
+
+        VertexElementType positionType = quantization.GetElementType(VertexAttribute::VA_Position);
+
+        std::vector<float>  positions;
+        std::vector<uint32> indices;
+        for (int32 i = 0; i < meshes.size(); ++i)
+        {
+            DVKMesh* mesh = meshes[i];
+            for (int32 j = 0; j < mesh->primitives.size(); ++j)
+            {
+                DVKPrimitive* primitive = mesh->primitives[j];
+                if (primitive->indices.size() == 0)
+                {
+                    continue;
+                }
+
+                // 解压到mesh空间，包围球与法线锥和未压缩时一致
+                uint32 vertexCount = (uint32)(primitive->vertices.size() * sizeof(float) / stride);
+                const uint8* data  = (const uint8*)primitive->vertices.data() + positionOffset;
+                positions.resize(vertexCount * 3);
+                for (uint32 k = 0; k < vertexCount; ++k)
+                {
+                    const uint8* src = data + k * stride;
+                    Vector3 position;
+                    if (positionType == VET_Short4N)
+                    {
+                        int16 packed[3];
+                        memcpy(packed, src, sizeof(packed));
+                        position = Vector3(packed[0] / 32767.0f, packed[1] / 32767.0f, packed[2] / 32767.0f);
+                    }
+                    else if (positionType == VET_Half4)
+                    {
+                        uint16 packed[3];
+                        memcpy(packed, src, sizeof(packed));
+                        position = Vector3(DVKVertexQuantizer::HalfToFloat(packed[0]), DVKVertexQuantizer::HalfToFloat(packed[1]), DVKVertexQuantizer::HalfToFloat(packed[2]));
+                    }
+                    else
+                    {
+                        memcpy(&position, src, sizeof(float) * 3);
+                    }
+                    position = position * mesh->dequantizeScale + mesh->dequantizeOffset;
+
+                    positions[k * 3 + 0] = position.x;
+                    positions[k * 3 + 1] = position.y;
+                    positions[k * 3 + 2] = position.z;
+                }
+
+                indices.assign(primitive->indices.begin(), primitive->indices.end());
+
+                if (primitive->meshlets == nullptr)
+                {
+                    primitive->meshlets = new DVKMeshletData();
+                }
+                DVKMeshletBuilder::Build(*(primitive->meshlets), indices.data(), (uint32)indices.size(), positions.data(), 3, vertexCount, maxVertices, maxTriangles);
+
+                if (uploader)
+                {
+                    primitive->meshlets->Upload(device, uploader);
+                }
+            }
+        }
+    }
+
 }
@@ -4,6 +4,8 @@
 #include "DVKBuffer.h"
 #include "DVKIndexBuffer.h"
 #include "DVKVertexBuffer.h"
+#include "DVKUploadQueue.h"
+#include "DVKMeshlet.h"
 
 #include "Common/Common.h"
 #include "Math/Math.h"
@@ -14,12 +16,14 @@
 #include "Vulkan/VulkanCommon.h"
 #include "vulkan/vulkan_core.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <string>
 #include <cstring>
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <functional>
 
 struct aiMesh;
 struct aiScene;
@@ -62,16 +66,32 @@ namespace vk_demo
         }
     };
 
+    // 简化后的一级LOD，与LOD0共用顶点缓冲，只有索引不同
+    struct DVKPrimitiveLOD
+    {
+        DVKIndexBuffer*     indexBuffer = nullptr;
+        std::vector<uint16> indices;
+        int32               triangleNum = 0;
+        float               error = 0.0f;   // 相对原始网格的mesh空间误差
+    };
+
     struct DVKPrimitive
     {
        DVKIndexBuffer* indexBuffer = nullptr;
        DVKVertexBuffer* vertexBuffer = nullptr;
        DVKVertexBuffer* instanceBuffer = nullptr;
 
+       // DVKModel::BuildMeshlets之后才有
+       DVKMeshletData* meshlets = nullptr;
+
        std::vector<float> vertices;
        std::vector<float> instanceDatas;
        std::vector<uint16> indices;
 
+       // LOD1开始的各级，LOD0为indexBuffer/indices
+       std::vector<DVKPrimitiveLOD> lods;
+       int32 lodIndex = 0;
+
        int32 vertexCount = 0;
        int32 triangleNum = 0;
 
@@ -96,23 +116,55 @@ namespace vk_demo
                 delete instanceBuffer;
             }
 
+            if (meshlets)
+            {
+                delete meshlets;
+            }
+
+            for (int32 i = 0; i < lods.size(); ++i)
+            {
+                delete lods[i].indexBuffer;
+            }
+            lods.clear();
+
             indexBuffer  = nullptr;
             vertexBuffer = nullptr;
         }
 
+        // 级数少于mesh时使用最后一级
+        DVKIndexBuffer* GetIndexBuffer()
+        {
+            if (lodIndex <= 0 || lods.size() == 0)
+            {
+                return indexBuffer;
+            }
+            return lods[MMath::Min<int32>(lodIndex, (int32)lods.size()) - 1].indexBuffer;
+        }
+
+        int32 GetTriangleNum(int32 lod)
+        {
+            if (lod <= 0 || lods.size() == 0)
+            {
+                return triangleNum;
+            }
+            return lods[MMath::Min<int32>(lod, (int32)lods.size()) - 1].triangleNum;
+        }
+
         void DrawOnly(VkCommandBuffer cmdBuffer)
         {
-            if (vertexBuffer && !indexBuffer)
+            DVKIndexBuffer* lodIndexBuffer = GetIndexBuffer();
+            if (vertexBuffer && !lodIndexBuffer)
             {
                 vkCmdDraw(cmdBuffer, vertexCount, 1, 0, 0);
             }
             else
             {
-                vkCmdDrawIndexed(cmdBuffer, indexBuffer->indexCount, indexBuffer->instanceCount, 0, 0, 0);
+                vkCmdDrawIndexed(cmdBuffer, lodIndexBuffer->indexCount, lodIndexBuffer->instanceCount, 0, 0, 0);
             }
         }
        void BindOnly(VkCommandBuffer cmdBuffer)
        {
+          DVKIndexBuffer* lodIndexBuffer = GetIndexBuffer();
           if(vertexBuffer)
           {
               vkCmdBindVertexBuffers(cmdBuffer,0,1,&(vertexBuffer->dvkBuffer->buffer),&(vertexBuffer->offset));
@@ -122,13 +174,14 @@ namespace vk_demo
           {
               vkCmdBindVertexBuffers(cmdBuffer,1,1,&(instanceBuffer->dvkBuffer->buffer),&(instanceBuffer->offset));
           }
-          if (indexBuffer)
+          if (lodIndexBuffer)
           {
-              vkCmdBindIndexBuffer(cmdBuffer, indexBuffer->dvkBuffer->buffer, 0, indexBuffer->indexType);
+              vkCmdBindIndexBuffer(cmdBuffer, lodIndexBuffer->dvkBuffer->buffer, 0, lodIndexBuffer->indexType);
           }
        }
       void BindDrawCmd(VkCommandBuffer cmdBuffer)
       {
+          DVKIndexBuffer* lodIndexBuffer = GetIndexBuffer();
           if(vertexBuffer)
           {
               vkCmdBindVertexBuffers(cmdBuffer,0,1,&(vertexBuffer->dvkBuffer->buffer),&(vertexBuffer->offset));
@@ -138,18 +191,18 @@ namespace vk_demo
           {
               vkCmdBindVertexBuffers(cmdBuffer,1,1,&(instanceBuffer->dvkBuffer->buffer),&(instanceBuffer->offset));
           }
-          if (indexBuffer)
+          if (lodIndexBuffer)
           {
-              vkCmdBindIndexBuffer(cmdBuffer, indexBuffer->dvkBuffer->buffer, 0, indexBuffer->indexType);
+              vkCmdBindIndexBuffer(cmdBuffer, lodIndexBuffer->dvkBuffer->buffer, 0, lodIndexBuffer->indexType);
           }
 
-          if (vertexBuffer && !indexBuffer)
+          if (vertexBuffer && !lodIndexBuffer)
           {
               vkCmdDraw(cmdBuffer, vertexCount, 1, 0, 0);
           }
           else
           {
-              vkCmdDrawIndexed(cmdBuffer, indexBuffer->indexCount, indexBuffer->instanceCount, 0, 0, 0);
+              vkCmdDrawIndexed(cmdBuffer, lodIndexBuffer->indexCount, lodIndexBuffer->instanceCount, 0, 0, 0);
           }
       }
     };
@@ -180,12 +233,16 @@ namespace vk_demo
     };
 
     template <class ValueType>
-    
     struct DVKAnimChannel
     {
         std::vector<float>     keys;
         std::vector<ValueType> values;
 
+        // 上一次命中的关键帧，顺序播放时下一次查找通常就在它附近
+        int32 cursor = 0;
+        // keys等间隔时直接计算索引
+        float invInterval = 0.0f;
+
         void GetValue(float key, ValueType& outPrevValue, ValueType& outNextValue, float& outAlpha)
         {
             outAlpha = 0.0f;
@@ -207,29 +264,124 @@ namespace vk_demo
                 outAlpha     = 0.0f;
                 return;
             }
-            int32 frameIndex = 0;
 
-            for(int32 i=0;i<keys.size()-1;++i)
+            int32 frameIndex = FindFrame(key);
+
+            outPrevValue = values[frameIndex+0];
+            outNextValue = values[frameIndex+1];
+
+            float prevKey = keys[frameIndex+0];
+            float nextKey = keys[frameIndex+1];
+            outAlpha = nextKey > prevKey ? (key-prevKey)/(nextKey-prevKey) : 0.0f;
+        }
+
+        // 返回满足keys[i] <= key < keys[i+1]的i，调用者保证key在keys范围内
+        int32 FindFrame(float key)
+        {
+            int32 lastFrame = (int32)keys.size() - 2;
+
+            if (invInterval > 0.0f)
+            {
+                cursor = MMath::Clamp((int32)((key - keys.front()) * invInterval), 0, lastFrame);
+                return cursor;
+            }
+
+            cursor = MMath::Clamp(cursor, 0, lastFrame);
+            if (keys[cursor] <= key)
+            {
+                if (key < keys[cursor + 1])
+                {
+                    return cursor;
+                }
+                if (cursor < lastFrame && key < keys[cursor + 2])
+                {
+                    cursor += 1;
+                    return cursor;
+                }
+            }
+
+            cursor = (int32)(std::upper_bound(keys.begin(), keys.end(), key) - keys.begin()) - 1;
+            cursor = MMath::Clamp(cursor, 0, lastFrame);
+            return cursor;
+        }
+
+        // 检测keys是否等间隔，导入或读取cooked数据之后调用
+        void UpdateSampling()
+        {
+            cursor      = 0;
+            invInterval = 0.0f;
+
+            if (keys.size() < 2)
+            {
+                return;
+            }
+
+            float interval = (keys.back() - keys.front()) / (keys.size() - 1);
+            if (interval <= 0.0f)
             {
-              if(key<=keys[i+1])
-              {
-                  frameIndex = i;
-                  break;
-              }
+                return;
             }
 
-           outPrevValue = values[frameIndex+0];
-           outNextValue = values[frameIndex+1];       
+            for (int32 i = 1; i < keys.size(); ++i)
+            {
+                float expected = keys.front() + interval * i;
+                if (MMath::Abs(keys[i] - expected) > interval * 0.001f)
+                {
+                    return;
+                }
+            }
 
-           float prevKey = keys[frameIndex+0];
-           float nextKey = keys[frameIndex+1];
-           outAlpha = (key-prevKey)/(nextKey-prevKey); 
+            invInterval = 1.0f / interval;
+        }
+
+        // 重采样为固定帧率，采样点不少于原关键帧数量且不超过其maxGrowth倍时才执行。
+        // 采样点更少说明关键帧比目标帧率更密，重采样会丢失关键帧，保留原数据走二分查找。
+        void Resample(float sampleRate, int32 maxGrowth = 4)
+        {
+            if (keys.size() < 3 || sampleRate <= 0.0f)
+            {
+                UpdateSampling();
+                return;
+            }
+
+            UpdateSampling();
+            if (invInterval > 0.0f)
+            {
+                return;
+            }
+
+            float duration  = keys.back() - keys.front();
+            int32 numFrames = MMath::CeilToInt(duration * sampleRate) + 1;
+            if (numFrames < keys.size() || numFrames > keys.size() * maxGrowth)
+            {
+                return;
+            }
+
+            std::vector<float>     newKeys(numFrames);
+            std::vector<ValueType> newValues(numFrames);
+            float interval = duration / (numFrames - 1);
+            for (int32 i = 0; i < numFrames; ++i)
+            {
+                float key = i == numFrames - 1 ? keys.back() : keys.front() + interval * i;
+                ValueType prevValue = values.front();
+                ValueType nextValue = values.front();
+                float alpha = 0.0f;
+                GetValue(key, prevValue, nextValue, alpha);
+                newKeys[i]   = key;
+                newValues[i] = MMath::Lerp(prevValue, nextValue, alpha);
+            }
+
+            keys   = std::move(newKeys);
+            values = std::move(newValues);
+            UpdateSampling();
         }
     };
 
     struct DVKAnimationClip
     {
       std::string nodeName;
+      // 在DVKSkeleton中的节点索引，BuildSkeleton时绑定
+      int32 nodeIndex = -1;
       float duration;
       DVKAnimChannel<Vector3> positions;
       DVKAnimChannel<Vector3> scales;
@@ -242,7 +394,26 @@ namespace vk_demo
       float time = 0.0f;
       float duration = 0.0f;
       float speed = 1.0f;
-      std::unordered_map<std::string,DVKAnimationClip> clips;
+      std::vector<DVKAnimationClip> clips;
+    };
+
+    // 加载完成后由节点树编译出的扁平骨架，播放时不再按名字查找节点。
+    // 节点按先序排列，父节点索引总小于子节点，一次线性遍历即可算出全部global矩阵。
+    struct DVKSkeleton
+    {
+      std::vector<DVKNode*>   nodes;
+      std::vector<int32>      parents;
+
+      // 动画采样结果，按节点索引存放
+      std::vector<Vector3>    translations;
+      std::vector<Quat>       rotations;
+      std::vector<Vector3>    scales;
+      std::vector<uint8>      animated;
+
+      std::vector<Matrix4x4>  globalMatrices;
+
+      // bone索引到节点索引
+      std::vector<int32>      boneNodes;
     };
 
     struct DVKMesh
@@ -259,6 +430,14 @@ namespace vk_demo
       int32 vertexCount;
       int32 triangleCount;
 
+      // 位置压缩时顶点坐标为包围盒内的相对坐标：position = encoded * dequantizeScale + dequantizeOffset
+      Vector3 dequantizeOffset = Vector3::ZeroVector;
+      Vector3 dequantizeScale  = Vector3::OneVector;
+
+      // 各级LOD相对原始网格的mesh空间误差，lodErrors[0]为0；取所有primitive中的最大值
+      std::vector<float> lodErrors;
+      int32 lodIndex = 0;
+
       DVKMesh():linkNode(nullptr),
             vertexCount(0),
             triangleCount(0)
@@ -266,6 +445,67 @@ namespace vk_demo
 
       }
 
+      // 位置压缩时需要先乘该矩阵再乘节点矩阵，未压缩时为单位矩阵
+      Matrix4x4 GetDequantizeMatrix() const
+      {
+        Matrix4x4 matrix;
+        matrix.SetIdentity();
+        matrix.AppendScale(dequantizeScale);
+        matrix.AppendTranslation(dequantizeOffset);
+        return matrix;
+      }
+
+      // 由各primitive的LOD误差汇总，primitive级数不足时按最后一级计
+      void UpdateLODErrors()
+      {
+        int32 count = 0;
+        for(int i=0;i<primitives.size();++i)
+        {
+          count = MMath::Max<int32>(count, (int32)primitives[i]->lods.size());
+        }
+
+        lodErrors.clear();
+        if (count == 0)
+        {
+          return;
+        }
+
+        lodErrors.resize(count + 1, 0.0f);
+        for(int i=0;i<primitives.size();++i)
+        {
+          std::vector<DVKPrimitiveLOD>& lods = primitives[i]->lods;
+          for(int32 lod=1;lod<=count && lods.size()>0;++lod)
+          {
+            lodErrors[lod] = MMath::Max(lodErrors[lod], lods[MMath::Min<int32>(lod, (int32)lods.size()) - 1].error);
+          }
+        }
+      }
+
+      int32 GetLODCount() const
+      {
+        return lodErrors.size() > 0 ? (int32)lodErrors.size() : 1;
+      }
+
+      // 切换之后需要重新录制绘制命令
+      void SetLOD(int32 lod)
+      {
+        lodIndex = MMath::Clamp(lod, 0, GetLODCount() - 1);
+        for(int i=0;i<primitives.size();++i)
+        {
+          primitives[i]->lodIndex = lodIndex;
+        }
+      }
+
+      int32 GetTriangleCount(int32 lod)
+      {
+        int32 count = 0;
+        for(int i=0;i<primitives.size();++i)
+        {
+          count += primitives[i]->GetTriangleNum(lod);
+        }
+        return count;
+      }
+
       void BindOnly(VkCommandBuffer cmdBuffer)
       {
         for(int i=0;i<primitives.size();++i)
@@ -410,14 +650,38 @@ namespace vk_demo
 
         void GotoAnimation(float time);
 
+        // 节点、骨骼或动画变化之后重新编译骨架，加载时会自动调用
+        void BuildSkeleton();
+
         VkVertexInputBindingDescription GetInputBinding();
 
         std::vector<VkVertexInputAttributeDescription> GetInputAttributes();
 
-        static DVKModel* LoadFromFile(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, const std::vector<VertexAttribute>& attributes);
+        // quantization为各attribute的存储格式，默认全部为float，见DVKVertexQuantization
+        static DVKModel* LoadFromFile(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization = DVKVertexQuantization());
 
         static DVKModel* Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, const std::vector<float>& vertices, const std::vector<uint16>& indices, const std::vector<VertexAttribute>& attributes);
 
+        // 拷贝记录到uploader中，不等待，同一批加载结束后由调用者Flush/WaitIdle一次
+        static DVKModel* Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const std::vector<float>& vertices, const std::vector<uint16>& indices, const std::vector<VertexAttribute>& attributes);
+
+        // 所有primitive的拷贝记录到uploader中，不等待；渲染前需Flush，并在Wait/IsComplete之后才能释放uploader。
+        // 优先读取cooked文件，不存在或已过期时经Assimp加载并重新cook
+        static DVKModel* LoadFromFileAsync(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization = DVKVertexQuantization());
+
+        // 总是经Assimp加载，不读写cooked文件
+        static DVKModel* LoadFromAssimp(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization = DVKVertexQuantization());
+
+        // 顶点数据的实际大小，以及全部使用float时的大小
+        void GetVertexMemory(uint64& outBytes, uint64& outFloatBytes);
+
+        // 允许碎片整理移动顶点、索引buffer(meshlet的storage buffer被descriptor引用，不参与)。
+        // 任一buffer搬迁后调用onMoved，持有者需要在其中让所有引用模型的command buffer在下次提交前重新录制
+        void SetMovable(bool movable, const std::function<void()>& onMoved = nullptr);
+
+        // 为每个primitive划分meshlet并计算包围球与法线锥，uploader不为空时同时上传为storage buffer
+        void BuildMeshlets(DVKUploadQueue* uploader = nullptr, uint32 maxVertices = DVKMeshletBuilder::MaxVertices, uint32 maxTriangles = DVKMeshletBuilder::MaxTriangles);
+
     protected:
 
         DVKNode* LoadNode(const aiNode* node, const aiScene* scene);
@@ -434,6 +698,8 @@ namespace vk_demo
 
         void LoadPrimitives(std::vector<float>& vertices, std::vector<uint32>& indices, DVKMesh* mesh, const aiMesh* aiMesh, const aiScene* aiScene);
 
+        void LoadLODs(DVKPrimitive* primitive, int32 stride, int32 positionOffset);
+
         void LoadAnim(const aiScene* aiScene);
         
       public:
@@ -452,10 +718,16 @@ namespace vk_demo
         BonesMap                        bonesMap;
 
         std::vector<VertexAttribute>    attributes;
+        DVKVertexQuantization           quantization;
         std::vector<DVKAnimation>       animations;
         int32                           animIndex = -1;
+
+        DVKSkeleton                     skeleton;
       private:
+        friend class DVKMeshCook;
+
         DVKCommandBuffer* cmdBuffer = nullptr;
+        DVKUploadQueue* uploader = nullptr;
         bool loadSkin = false;
 
 
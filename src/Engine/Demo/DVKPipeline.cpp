@@ -1,4 +1,5 @@
 #include "DVKPipeline.h"
+#include "DVKPipelineCache.h"
 #include "vulkan/vulkan_core.h"
 
 namespace vk_demo
@@ -72,7 +73,7 @@ namespace vk_demo
                 pipelineCreateInfo.pTessellationState = &(pipelineInfo.tessellationState);
             }
 
-            VERIFYVULKANRESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, VULKAN_CPU_ALLOCATOR, &(pipeline->pipeline)));
+            VERIFYVULKANRESULT(DVKPipelineCache::CreateGraphicsPipeline(vulkanDevice, pipelineCache, pipelineCreateInfo, &(pipeline->pipeline)));
 
             return pipeline;
     }
@@ -0,0 +1,278 @@
+#include "DVKPipelineCache.h"
+#include "FileManager.h"
+
+#include "Common/Log.h"
+#include "Utils/Crc.h"
+#include "Vulkan/VulkanDevice.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace vk_demo
+{
+    // 文件头，用于校验cache是否由当前设备与驱动生成
+    struct PipelineCacheFileHeader
+    {
+        uint32  magic;
+        uint32  version;
+        uint32  vendorID;
+        uint32  deviceID;
+        uint32  driverVersion;
+        uint8   uuid[VK_UUID_SIZE];
+        uint32  dataSize;
+        uint32  dataCrc;
+    };
+
+    // vkGetPipelineCacheData返回数据的头部(VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+    struct PipelineCacheDataHeader
+    {
+        uint32  headerSize;
+        uint32  headerVersion;
+        uint32  vendorID;
+        uint32  deviceID;
+        uint8   uuid[VK_UUID_SIZE];
+    };
+
+    static const uint32 PIPELINE_CACHE_MAGIC   = 0x4843504D; // MPCH
+    static const uint32 PIPELINE_CACHE_VERSION = 1;
+
+    uint32 DVKPipelineCache::numPipelines = 0;
+    uint32 DVKPipelineCache::numHits      = 0;
+    uint32 DVKPipelineCache::numMisses    = 0;
+    double DVKPipelineCache::compileTime  = 0.0;
+
+    static bool ValidateCacheData(const VkPhysicalDeviceProperties& properties, const uint8* fileData, uint32 fileSize)
+    {
+        if (fileSize < sizeof(PipelineCacheFileHeader))
+        {
+            MLOG("Pipeline cache invalid : file too small.");
+            return false;
+        }
+
+        const PipelineCacheFileHeader* header = (const PipelineCacheFileHeader*)fileData;
+        if (header->magic != PIPELINE_CACHE_MAGIC || header->version != PIPELINE_CACHE_VERSION)
+        {
+            MLOG("Pipeline cache invalid : unknown format.");
+            return false;
+        }
+
+        if (header->vendorID != properties.vendorID || header->deviceID != properties.deviceID || header->driverVersion != properties.driverVersion)
+        {
+            MLOG("Pipeline cache invalid : device or driver changed.");
+            return false;
+        }
+
+        if (memcmp(header->uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        {
+            MLOG("Pipeline cache invalid : pipelineCacheUUID mismatch.");
+            return false;
+        }
+
+        if (header->dataSize != fileSize - sizeof(PipelineCacheFileHeader) || header->dataSize < sizeof(PipelineCacheDataHeader))
+        {
+            MLOG("Pipeline cache invalid : truncated data.");
+            return false;
+        }
+
+        const uint8* data = fileData + sizeof(PipelineCacheFileHeader);
+        if (Crc::MemCrc32(data, header->dataSize) != header->dataCrc)
+        {
+            MLOG("Pipeline cache invalid : crc mismatch.");
+            return false;
+        }
+
+        // 驱动自身的头部也需要匹配，否则部分驱动会直接崩溃而不是忽略
+        PipelineCacheDataHeader dataHeader;
+        memcpy(&dataHeader, data, sizeof(PipelineCacheDataHeader));
+        if (dataHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+            dataHeader.vendorID != properties.vendorID ||
+            dataHeader.deviceID != properties.deviceID ||
+            memcmp(dataHeader.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        {
+            MLOG("Pipeline cache invalid : driver header mismatch.");
+            return false;
+        }
+
+        return true;
+    }
+
+    DVKPipelineCache::~DVKPipelineCache()
+    {
+        if (pipelineCache != VK_NULL_HANDLE)
+        {
+            vkDestroyPipelineCache(device, pipelineCache, VULKAN_CPU_ALLOCATOR);
+            pipelineCache = VK_NULL_HANDLE;
+        }
+    }
+
+    DVKPipelineCache* DVKPipelineCache::Create(std::shared_ptr<VulkanDevice> vulkanDevice, const std::string& filename)
+    {
+        DVKPipelineCache* cache = new DVKPipelineCache();
+        cache->vulkanDevice = vulkanDevice;
+        cache->device       = vulkanDevice->GetInstanceHandle();
+        cache->filepath     = FileManager::GetFilePath(filename);
+
+        // 缓存文件可能不存在，不能走FileManager::ReadFile，否则首次启动会报错
+        std::vector<uint8> fileData;
+        FILE* file = fopen(cache->filepath.c_str(), "rb");
+        if (file)
+        {
+            fseek(file, 0, SEEK_END);
+            long fileSize = ftell(file);
+            fseek(file, 0, SEEK_SET);
+            if (fileSize > 0)
+            {
+                fileData.resize(fileSize);
+                if (fread(fileData.data(), 1, fileSize, file) != (size_t)fileSize)
+                {
+                    fileData.clear();
+                }
+            }
+            fclose(file);
+        }
+
+        VkPipelineCacheCreateInfo createInfo;
+        ZeroVulkanStruct(createInfo, VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO);
+
+        if (fileData.size() > 0 && ValidateCacheData(vulkanDevice->GetDeviceProperties(), fileData.data(), (uint32)fileData.size()))
+        {
+            createInfo.initialDataSize = fileData.size() - sizeof(PipelineCacheFileHeader);
+            createInfo.pInitialData    = fileData.data() + sizeof(PipelineCacheFileHeader);
+        }
+
+        VkResult result = vkCreatePipelineCache(cache->device, &createInfo, VULKAN_CPU_ALLOCATOR, &cache->pipelineCache);
+        if (result != VK_SUCCESS && createInfo.initialDataSize > 0)
+        {
+            // 驱动拒绝了数据，退回到空cache
+            createInfo.initialDataSize = 0;
+            createInfo.pInitialData    = nullptr;
+            result = vkCreatePipelineCache(cache->device, &createInfo, VULKAN_CPU_ALLOCATOR, &cache->pipelineCache);
+        }
+        VERIFYVULKANRESULT(result);
+
+        cache->loadedSize = (uint32)createInfo.initialDataSize;
+        if (cache->loadedSize > 0)
+        {
+            MLOG("Pipeline cache loaded : %s (%d bytes)", cache->filepath.c_str(), cache->loadedSize);
+        }
+        else
+        {
+            MLOG("Pipeline cache cold start : %s", cache->filepath.c_str());
+        }
+
+        return cache;
+    }
+
+    bool DVKPipelineCache::Save()
+    {
+        size_t dataSize = 0;
+        VERIFYVULKANRESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr));
+        if (dataSize == 0)
+        {
+            return false;
+        }
+
+        std::vector<uint8> fileData(sizeof(PipelineCacheFileHeader) + dataSize);
+        uint8* data = fileData.data() + sizeof(PipelineCacheFileHeader);
+        VERIFYVULKANRESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, data));
+
+        const VkPhysicalDeviceProperties& properties = vulkanDevice->GetDeviceProperties();
+
+        PipelineCacheFileHeader header = {};
+        header.magic         = PIPELINE_CACHE_MAGIC;
+        header.version       = PIPELINE_CACHE_VERSION;
+        header.vendorID      = properties.vendorID;
+        header.deviceID      = properties.deviceID;
+        header.driverVersion = properties.driverVersion;
+        header.dataSize      = (uint32)dataSize;
+        header.dataCrc       = Crc::MemCrc32(data, (int32)dataSize);
+        memcpy(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+        memcpy(fileData.data(), &header, sizeof(PipelineCacheFileHeader));
+
+        // 先写临时文件再替换，中途退出不会留下损坏的cache
+        std::string tempPath = filepath + ".tmp";
+        FILE* file = fopen(tempPath.c_str(), "wb");
+        if (!file)
+        {
+            MLOGE("Failed open pipeline cache for write : %s", tempPath.c_str());
+            return false;
+        }
+
+        bool written = fwrite(fileData.data(), 1, fileData.size(), file) == fileData.size();
+        written = fflush(file) == 0 && written;
+        fclose(file);
+
+        if (!written)
+        {
+            MLOGE("Failed write pipeline cache : %s", tempPath.c_str());
+            remove(tempPath.c_str());
+            return false;
+        }
+
+#if PLATFORM_WINDOWS
+        bool replaced = MoveFileExA(tempPath.c_str(), filepath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        bool replaced = rename(tempPath.c_str(), filepath.c_str()) == 0;
+#endif
+
+        if (!replaced)
+        {
+            MLOGE("Failed replace pipeline cache : %s", filepath.c_str());
+            remove(tempPath.c_str());
+            return false;
+        }
+
+        MLOG("Pipeline cache saved : %s (%d bytes)", filepath.c_str(), (int32)dataSize);
+        return true;
+    }
+
+    VkResult DVKPipelineCache::CreateGraphicsPipeline(std::shared_ptr<VulkanDevice> vulkanDevice, VkPipelineCache pipelineCache, const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline* outPipeline)
+    {
+        VkDevice device = vulkanDevice->GetInstanceHandle();
+        VkGraphicsPipelineCreateInfo pipelineCreateInfo = createInfo;
+
+        // VK_EXT_pipeline_creation_feedback可以告诉我们是否命中了cache
+        bool hasFeedback = vulkanDevice->IsExtensionEnabled(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+
+        VkPipelineCreationFeedbackEXT pipelineFeedback = {};
+        std::vector<VkPipelineCreationFeedbackEXT> stageFeedbacks(createInfo.stageCount);
+
+        VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo;
+        ZeroVulkanStruct(feedbackInfo, VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT);
+        feedbackInfo.pNext                              = createInfo.pNext;
+        feedbackInfo.pPipelineCreationFeedback          = &pipelineFeedback;
+        feedbackInfo.pipelineStageCreationFeedbackCount = createInfo.stageCount;
+        feedbackInfo.pPipelineStageCreationFeedbacks    = stageFeedbacks.data();
+
+        if (hasFeedback)
+        {
+            pipelineCreateInfo.pNext = &feedbackInfo;
+        }
+
+        double beginTime = GenericPlatformTime::Seconds();
+        VkResult result  = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, VULKAN_CPU_ALLOCATOR, outPipeline);
+        compileTime     += GenericPlatformTime::Seconds() - beginTime;
+        numPipelines    += 1;
+
+        if (hasFeedback && (pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT))
+        {
+            if (pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT)
+            {
+                numHits += 1;
+            }
+            else
+            {
+                numMisses += 1;
+            }
+        }
+
+        return result;
+    }
+
+    void DVKPipelineCache::PrintStats()
+    {
+        MLOG("Pipeline cache stats : %d pipelines, %d hits, %d misses, %d unknown, %.3fms compile", numPipelines, numHits, numMisses, numPipelines - numHits - numMisses, compileTime * 1000.0);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Engine.h"
+#include "Common/Common.h"
+
+#include "Vulkan/VulkanCommon.h"
+#include "vulkan/vulkan_core.h"
+
+#include <string>
+#include <memory>
+
+class VulkanDevice;
+
+namespace vk_demo
+{
+    class DVKPipelineCache
+    {
+    private:
+        DVKPipelineCache()
+        {
+
+        }
+
+    public:
+        ~DVKPipelineCache();
+
+        // 从磁盘加载pipeline cache，文件不存在或与当前设备/驱动不匹配时创建空cache
+        static DVKPipelineCache* Create(std::shared_ptr<VulkanDevice> vulkanDevice, const std::string& filename);
+
+        // vkCreateGraphicsPipelines的封装，统计cache命中情况与编译耗时
+        static VkResult CreateGraphicsPipeline(std::shared_ptr<VulkanDevice> vulkanDevice, VkPipelineCache pipelineCache, const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline* outPipeline);
+
+        static void PrintStats();
+
+        bool Save();
+
+    public:
+        VkDevice                        device = VK_NULL_HANDLE;
+        VkPipelineCache                 pipelineCache = VK_NULL_HANDLE;
+        std::shared_ptr<VulkanDevice>   vulkanDevice = nullptr;
+        std::string                     filepath;
+        uint32                          loadedSize = 0;
+
+        static uint32                   numPipelines;
+        static uint32                   numHits;
+        static uint32                   numMisses;
+        static double                   compileTime;
+    };
+}
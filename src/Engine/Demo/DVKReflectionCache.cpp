@@ -0,0 +1,307 @@
+#include "DVKReflectionCache.h"
+#include "FileManager.h"
+
+#include "Common/Log.h"
+#include "Utils/Crc.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+
+#include <cstring>
+#include <vector>
+
+namespace vk_demo
+{
+    struct ReflectionCacheFileHeader
+    {
+        uint32  magic;
+        uint32  version;
+        uint32  numEntries;
+        uint32  dataSize;
+        uint32  dataCrc;
+    };
+
+    static const uint32 REFLECTION_CACHE_MAGIC   = 0x4352534D; // MSRC
+    static const uint32 REFLECTION_CACHE_VERSION = 2;
+
+    std::unordered_map<uint64, DVKShaderReflection> DVKReflectionCache::entries;
+    std::string DVKReflectionCache::filepath;
+    bool   DVKReflectionCache::dirty     = false;
+    uint32 DVKReflectionCache::numHits   = 0;
+    uint32 DVKReflectionCache::numMisses = 0;
+    double DVKReflectionCache::coldTime  = 0.0;
+    double DVKReflectionCache::warmTime  = 0.0;
+    double DVKReflectionCache::loadTime  = 0.0;
+
+    class ReflectionWriter
+    {
+    public:
+        void Write(uint32 value)
+        {
+            data.insert(data.end(), (const uint8*)&value, (const uint8*)&value + sizeof(uint32));
+        }
+
+        void Write(uint64 value)
+        {
+            data.insert(data.end(), (const uint8*)&value, (const uint8*)&value + sizeof(uint64));
+        }
+
+        void Write(const std::string& value)
+        {
+            Write((uint32)value.size());
+            data.insert(data.end(), value.begin(), value.end());
+        }
+
+    public:
+        std::vector<uint8> data;
+    };
+
+    class ReflectionReader
+    {
+    public:
+        ReflectionReader(const uint8* inData, uint32 inSize)
+            : data(inData)
+            , size(inSize)
+            , offset(0)
+        {
+
+        }
+
+        bool Read(uint32& value)
+        {
+            return ReadBytes(&value, sizeof(uint32));
+        }
+
+        bool Read(uint64& value)
+        {
+            return ReadBytes(&value, sizeof(uint64));
+        }
+
+        bool Read(std::string& value)
+        {
+            uint32 length = 0;
+            if (!Read(length) || length > size - offset)
+            {
+                return false;
+            }
+            value.assign((const char*)(data + offset), length);
+            offset += length;
+            return true;
+        }
+
+    private:
+        bool ReadBytes(void* dst, uint32 count)
+        {
+            if (count > size - offset)
+            {
+                return false;
+            }
+            memcpy(dst, data + offset, count);
+            offset += count;
+            return true;
+        }
+
+    private:
+        const uint8*    data;
+        uint32          size;
+        uint32          offset;
+    };
+
+    uint64 DVKReflectionCache::GenerateKey(const uint8* data, uint32 size, VkShaderStageFlagBits stage, bool dynamicUBO)
+    {
+        // FNV-1a 64
+        uint64 hash = 0xcbf29ce484222325ull;
+        for (uint32 i = 0; i < size; ++i)
+        {
+            hash ^= data[i];
+            hash *= 0x100000001b3ull;
+        }
+
+        uint32 extra[3] = { size, (uint32)stage, dynamicUBO ? 1u : 0u };
+        const uint8* extraData = (const uint8*)extra;
+        for (uint32 i = 0; i < sizeof(extra); ++i)
+        {
+            hash ^= extraData[i];
+            hash *= 0x100000001b3ull;
+        }
+
+        return hash;
+    }
+
+    const DVKShaderReflection* DVKReflectionCache::Find(uint64 key)
+    {
+        auto it = entries.find(key);
+        if (it == entries.end())
+        {
+            numMisses += 1;
+            return nullptr;
+        }
+        numHits += 1;
+        return &(it->second);
+    }
+
+    void DVKReflectionCache::Add(uint64 key, const DVKShaderReflection& reflection)
+    {
+        entries[key] = reflection;
+        dirty = true;
+    }
+
+    static bool ReadEntries(ReflectionReader& reader, uint32 numEntries, std::unordered_map<uint64, DVKShaderReflection>& outEntries)
+    {
+        for (uint32 i = 0; i < numEntries; ++i)
+        {
+            uint64 key = 0;
+            uint32 numResources = 0;
+            if (!reader.Read(key) || !reader.Read(numResources))
+            {
+                return false;
+            }
+
+            DVKShaderReflection reflection;
+            reflection.resources.resize(numResources);
+            for (uint32 j = 0; j < numResources; ++j)
+            {
+                DVKShaderReflection::Resource& resource = reflection.resources[j];
+                uint32 descriptorType = 0;
+                if (!reader.Read(resource.name) || !reader.Read(descriptorType) || !reader.Read(resource.set) || !reader.Read(resource.binding) || !reader.Read(resource.bufferSize))
+                {
+                    return false;
+                }
+                resource.descriptorType = (VkDescriptorType)descriptorType;
+            }
+
+            uint32 numInputs = 0;
+            if (!reader.Read(numInputs))
+            {
+                return false;
+            }
+
+            reflection.inputs.resize(numInputs);
+            for (uint32 j = 0; j < numInputs; ++j)
+            {
+                uint32 attribute  = 0;
+                uint32 location   = 0;
+                uint32 integer    = 0;
+                uint32 components = 0;
+                if (!reader.Read(attribute) || !reader.Read(location) || !reader.Read(integer) || !reader.Read(components))
+                {
+                    return false;
+                }
+                reflection.inputs[j].attribute  = (VertexAttribute)attribute;
+                reflection.inputs[j].location   = (int32)location;
+                reflection.inputs[j].integer    = integer != 0;
+                reflection.inputs[j].components = (int32)components;
+            }
+
+            outEntries.insert(std::make_pair(key, reflection));
+        }
+        return true;
+    }
+
+    bool DVKReflectionCache::Load(const std::string& filename)
+    {
+        // MapFile/WriteFile内部会拼接资源目录，这里只保存相对路径
+        filepath = filename;
+
+        double beginTime = GenericPlatformTime::Seconds();
+
+        // 缓存文件可能不存在，映射失败时不报错
+        MappedFile file;
+        if (!FileManager::MapFile(filepath, file))
+        {
+            MLOG("Shader reflection cache cold start : %s", filepath.c_str());
+            return false;
+        }
+
+        bool valid = false;
+        std::unordered_map<uint64, DVKShaderReflection> loaded;
+        if (file.size >= sizeof(ReflectionCacheFileHeader))
+        {
+            ReflectionCacheFileHeader header;
+            memcpy(&header, file.data, sizeof(ReflectionCacheFileHeader));
+
+            const uint8* data = file.data + sizeof(ReflectionCacheFileHeader);
+            if (header.magic == REFLECTION_CACHE_MAGIC &&
+                header.version == REFLECTION_CACHE_VERSION &&
+                header.dataSize == file.size - sizeof(ReflectionCacheFileHeader) &&
+                Crc::MemCrc32(data, header.dataSize) == header.dataCrc)
+            {
+                ReflectionReader reader(data, header.dataSize);
+                valid = ReadEntries(reader, header.numEntries, loaded);
+            }
+        }
+        FileManager::UnmapFile(file);
+
+        if (!valid)
+        {
+            MLOG("Shader reflection cache invalid : %s", filepath.c_str());
+            return false;
+        }
+
+        for (auto it = loaded.begin(); it != loaded.end(); ++it)
+        {
+            entries.insert(*it);
+        }
+        loadTime += GenericPlatformTime::Seconds() - beginTime;
+
+        MLOG("Shader reflection cache loaded : %s (%d shaders)", filepath.c_str(), (int32)loaded.size());
+        return true;
+    }
+
+    bool DVKReflectionCache::Save()
+    {
+        if (!dirty || filepath.size() == 0)
+        {
+            return false;
+        }
+
+        ReflectionWriter writer;
+        writer.data.resize(sizeof(ReflectionCacheFileHeader));
+
+        for (auto it = entries.begin(); it != entries.end(); ++it)
+        {
+            const DVKShaderReflection& reflection = it->second;
+            writer.Write(it->first);
+
+            writer.Write((uint32)reflection.resources.size());
+            for (int32 i = 0; i < reflection.resources.size(); ++i)
+            {
+                const DVKShaderReflection::Resource& resource = reflection.resources[i];
+                writer.Write(resource.name);
+                writer.Write((uint32)resource.descriptorType);
+                writer.Write(resource.set);
+                writer.Write(resource.binding);
+                writer.Write(resource.bufferSize);
+            }
+
+            writer.Write((uint32)reflection.inputs.size());
+            for (int32 i = 0; i < reflection.inputs.size(); ++i)
+            {
+                writer.Write((uint32)reflection.inputs[i].attribute);
+                writer.Write((uint32)reflection.inputs[i].location);
+                writer.Write((uint32)(reflection.inputs[i].integer ? 1 : 0));
+                writer.Write((uint32)reflection.inputs[i].components);
+            }
+        }
+
+        ReflectionCacheFileHeader header = {};
+        header.magic      = REFLECTION_CACHE_MAGIC;
+        header.version    = REFLECTION_CACHE_VERSION;
+        header.numEntries = (uint32)entries.size();
+        header.dataSize   = (uint32)(writer.data.size() - sizeof(ReflectionCacheFileHeader));
+        header.dataCrc    = Crc::MemCrc32(writer.data.data() + sizeof(ReflectionCacheFileHeader), header.dataSize);
+        memcpy(writer.data.data(), &header, sizeof(ReflectionCacheFileHeader));
+
+        if (!FileManager::WriteFile(filepath, writer.data.data(), writer.data.size()))
+        {
+            return false;
+        }
+
+        dirty = false;
+        MLOG("Shader reflection cache saved : %s (%d shaders, %d bytes)", filepath.c_str(), (int32)entries.size(), (int32)writer.data.size());
+        return true;
+    }
+
+    void DVKReflectionCache::PrintStats()
+    {
+        MLOG("Shader reflection cache stats : %d hits (%.3fms), %d misses (%.3fms reflect), %.3fms load", numHits, warmTime * 1000.0, numMisses, coldTime * 1000.0, loadTime * 1000.0);
+    }
+}
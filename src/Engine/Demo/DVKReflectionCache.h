@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Common/Common.h"
+#include "DVKShader.h"
+
+#include "vulkan/vulkan_core.h"
+
+#include <string>
+#include <unordered_map>
+
+namespace vk_demo
+{
+    // SPIR-V反射结果的磁盘缓存，key为SPIR-V内容的hash。
+    // 命中时DVKShader直接用缓存的结果重建layout，不再调用SPIRV-Cross。
+    class DVKReflectionCache
+    {
+    public:
+
+        static uint64 GenerateKey(const uint8* data, uint32 size, VkShaderStageFlagBits stage, bool dynamicUBO);
+
+        static const DVKShaderReflection* Find(uint64 key);
+
+        static void Add(uint64 key, const DVKShaderReflection& reflection);
+
+        // 文件不存在或校验失败时从空缓存开始
+        static bool Load(const std::string& filename);
+
+        // 只有新增了条目才会写回
+        static bool Save();
+
+        static void PrintStats();
+
+    public:
+        static std::unordered_map<uint64, DVKShaderReflection>  entries;
+        static std::string                                      filepath;
+        static bool                                             dirty;
+
+        static uint32                                           numHits;
+        static uint32                                           numMisses;
+        // 未命中时SPIRV-Cross反射的耗时与命中时重建的耗时
+        static double                                           coldTime;
+        static double                                           warmTime;
+        static double                                           loadTime;
+    };
+}
@@ -1,4 +1,8 @@
 #include "DVKShader.h"
+#include "DVKDescriptorAllocator.h"
+#include "DVKReflectionCache.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "Utils/CPUProfiler.h"
 #include "Common/Common.h"
 #include "DVKVertexBuffer.h"
 #include "Vulkan/RHIDefinitions.h"
@@ -7,10 +11,218 @@
 #include "spirv_cross.hpp"
 #include <string>
 
-
+// 模板是1.1的核心功能，实例版本为1.0的平台不使用
+#if defined(VK_VERSION_1_1) && !PLATFORM_IOS && !PLATFORM_ANDROID
+    #define DVK_SUPPORTS_UPDATE_TEMPLATE 1
+#else
+    #define DVK_SUPPORTS_UPDATE_TEMPLATE 0
+#endif
 
 namespace vk_demo
 {
+    uint64 DVKDescriptorSetPool::frameNumber = 1;
+    uint64 DVKDescriptorSetPool::completedFrame = 0;
+    std::vector<uint64> DVKDescriptorSetPool::slotFrames;
+
+    void DVKDescriptorSetPool::BeginFrame(int32 frameIndex)
+    {
+        // 该槽位上一次提交的帧已经完成，帧按顺序完成，之前的帧也都完成了
+        if (frameIndex >= slotFrames.size())
+        {
+            slotFrames.resize(frameIndex + 1, 0);
+        }
+        completedFrame = MMath::Max(completedFrame, slotFrames[frameIndex]);
+        frameNumber   += 1;
+        slotFrames[frameIndex] = frameNumber;
+    }
+
+    void DVKDescriptorSet::Flush()
+    {
+        if (dirtyHandles.size() == 0)
+        {
+            return;
+        }
+
+        const std::vector<DVKDescriptorSetLayoutsInfo::BindInfo>& handles = setLayoutsInfo->handles;
+        const std::vector<DVKDescriptorSetLayoutInfo>& setLayouts = setLayoutsInfo->setLayouts;
+
+        // 整个set的descriptor都写过才能用模板，模板会更新set内的全部binding
+        uint64 templateSets = 0;
+#if DVK_SUPPORTS_UPDATE_TEMPLATE
+        if (updateTemplates.size() > 0)
+        {
+            uint64 dirtySets = 0;
+            for (int32 i = 0; i < dirtyHandles.size(); ++i)
+            {
+                dirtySets |= 1ull << handles[dirtyHandles[i]].setIndex;
+            }
+
+            for (int32 i = 0; i < setLayouts.size() && i < 64; ++i)
+            {
+                if ((dirtySets & (1ull << i)) == 0 || updateTemplates[i] == VK_NULL_HANDLE)
+                {
+                    continue;
+                }
+
+                bool complete = true;
+                int32 firstHandle = setLayouts[i].firstHandle;
+                for (int32 j = 0; j < setLayouts[i].bindings.size(); ++j)
+                {
+                    complete = complete && (states[firstHandle + j] & DS_Written) != 0;
+                }
+
+                if (complete)
+                {
+                    vkUpdateDescriptorSetWithTemplate(device, descriptorSets[i], updateTemplates[i], descriptorData.data() + firstHandle);
+                    templateSets |= 1ull << i;
+                }
+            }
+        }
+#endif
+
+        writes.clear();
+        for (int32 i = 0; i < dirtyHandles.size(); ++i)
+        {
+            int32 handle = dirtyHandles[i];
+            const DVKDescriptorSetLayoutsInfo::BindInfo& bindInfo = handles[handle];
+            states[handle] &= ~DS_Dirty;
+
+            if (bindInfo.setIndex < 64 && (templateSets & (1ull << bindInfo.setIndex)) != 0)
+            {
+                continue;
+            }
+
+            bool isBuffer =
+                bindInfo.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ||
+                bindInfo.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
+                bindInfo.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER ||
+                bindInfo.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+
+            VkWriteDescriptorSet writeDescriptorSet;
+            ZeroVulkanStruct(writeDescriptorSet, VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET);
+            writeDescriptorSet.dstSet          = descriptorSets[bindInfo.setIndex];
+            writeDescriptorSet.descriptorCount = 1;
+            writeDescriptorSet.descriptorType  = bindInfo.descriptorType;
+            writeDescriptorSet.pBufferInfo     = isBuffer ? &(descriptorData[handle].buffer) : nullptr;
+            writeDescriptorSet.pImageInfo      = isBuffer ? nullptr : &(descriptorData[handle].image);
+            writeDescriptorSet.dstBinding      = bindInfo.binding;
+            writes.push_back(writeDescriptorSet);
+        }
+
+        if (writes.size() > 0)
+        {
+            vkUpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+        }
+
+        dirtyHandles.clear();
+    }
+
+    DVKDescriptorSet::~DVKDescriptorSet()
+    {
+        if (dirtyHandles.size() > 0)
+        {
+            MLOGE("DescriptorSet destroyed with %d pending writes.", (int32)dirtyHandles.size());
+        }
+
+        // 在途帧可能还在使用这个set，pool会等到释放时的帧完成后再归还
+        if (pool && descriptorSets.size() > 0)
+        {
+            pool->FreeDescriptorSet(descriptorSets.data());
+        }
+        pool = nullptr;
+    }
+
+    bool DVKDescriptorSet::AllocateTransient(DVKDescriptorAllocator* allocator)
+    {
+        if (pool)
+        {
+            MLOGE("AllocateTransient called on a persistent descriptor set.");
+            return false;
+        }
+
+        if (!allocator->Allocate(*setLayoutsInfo, *descriptorSetLayouts, descriptorSets.data()))
+        {
+            return false;
+        }
+
+        // 新分配的set内容未定义，已写过的descriptor全部重新提交
+        for (int32 handle = 0; handle < states.size(); ++handle)
+        {
+            if (states[handle] & DS_Written)
+            {
+                MarkDirty(handle);
+            }
+        }
+
+        return true;
+    }
+
+    DVKDescriptorSet* DVKShader::CreateTransientDescriptorSet()
+    {
+        if (setLayoutsInfo.setLayouts.size() == 0)
+        {
+            return nullptr;
+        }
+
+        DVKDescriptorSet* dvkSet = new DVKDescriptorSet();
+        dvkSet->device               = device;
+        dvkSet->setLayoutsInfo       = &setLayoutsInfo;
+        dvkSet->descriptorSetLayouts = &descriptorSetLayouts;
+        dvkSet->updateTemplates      = updateTemplates;
+        dvkSet->descriptorSets.resize(setLayoutsInfo.setLayouts.size(), VK_NULL_HANDLE);
+        dvkSet->descriptorData.resize(setLayoutsInfo.handles.size());
+        dvkSet->states.resize(setLayoutsInfo.handles.size(), 0);
+
+        return dvkSet;
+    }
+
+    DVKDescriptorSet* DVKShader::AllocateDescriptorSet()
+    {
+        if (setLayoutsInfo.setLayouts.size() == 0)
+        {
+            return nullptr;
+        }
+
+        DVKDescriptorSet* dvkSet = new DVKDescriptorSet();
+        dvkSet->device               = device;
+        dvkSet->setLayoutsInfo       = &setLayoutsInfo;
+        dvkSet->descriptorSetLayouts = &descriptorSetLayouts;
+        dvkSet->updateTemplates      = updateTemplates;
+        dvkSet->descriptorSets.resize(setLayoutsInfo.setLayouts.size());
+        dvkSet->descriptorData.resize(setLayoutsInfo.handles.size());
+        dvkSet->states.resize(setLayoutsInfo.handles.size(), 0);
+
+        for (int32 i = (int32)descriptorSetPools.size() - 1; i >= 0; --i)
+        {
+            if (descriptorSetPools[i]->AllocateDescriptorSet(dvkSet->descriptorSets.data()))
+            {
+                dvkSet->pool = descriptorSetPools[i];
+                return dvkSet;
+            }
+        }
+
+        // 新pool按64, 128 ... 1024次分配几何增长
+        int32 numLayouts = (int32)descriptorSetLayouts.size();
+        int32 numAllocs  = MMath::Min(64 << MMath::Min((int32)descriptorSetPools.size(), 4), 1024);
+        std::shared_ptr<DVKDescriptorSetPool> setPool = std::make_shared<DVKDescriptorSetPool>(device, numAllocs * numLayouts, setLayoutsInfo, descriptorSetLayouts);
+        descriptorSetPools.push_back(setPool);
+        if (descriptorSetPools.size() > 1)
+        {
+            MLOG("DescriptorSetPool grow : %d pools, %d sets in new pool.", (int32)descriptorSetPools.size(), setPool->maxSet);
+        }
+
+        if (setPool->AllocateDescriptorSet(dvkSet->descriptorSets.data()))
+        {
+            dvkSet->pool = setPool;
+        }
+        else
+        {
+            MLOGE("Failed allocate descriptor set.");
+        }
+
+        return dvkSet;
+    }
+
     DVKShaderModule* DVKShaderModule::Create(std::shared_ptr<VulkanDevice> vulkanDevice, const char* filename, VkShaderStageFlagBits stage)
     {
         VkDevice device = vulkanDevice->GetInstanceHandle();
@@ -54,6 +266,9 @@ namespace vk_demo
         DVKShader* shader = new DVKShader();
         shader->device     = vulkanDevice->GetInstanceHandle();
         shader->dynamicUBO = dynamicUBO;
+#if DVK_SUPPORTS_UPDATE_TEMPLATE
+        shader->supportsUpdateTemplates = vulkanDevice->GetDeviceProperties().apiVersion >= VK_API_VERSION_1_1;
+#endif
 
         shader->vertShaderModule = vertModule;
         shader->fragShaderModule = fragModule;
@@ -77,151 +292,69 @@ namespace vk_demo
         return Create(vulkanDevice, false, vert, frag, geom, comp, tesc, tese);
     }
     
-    void DVKShader::ProcessAttachments(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkPipelineStageFlags stageFlags)
+    static void AddResource(spirv_cross::Compiler& compiler, const spirv_cross::Resource& res, VkDescriptorType descriptorType, uint32 bufferSize, DVKShaderReflection& reflection)
+    {
+        DVKShaderReflection::Resource resource;
+        resource.name           = compiler.get_name(res.id);
+        resource.descriptorType = descriptorType;
+        resource.set            = compiler.get_decoration(res.id, spv::DecorationDescriptorSet);
+        resource.binding        = compiler.get_decoration(res.id, spv::DecorationBinding);
+        resource.bufferSize     = bufferSize;
+        reflection.resources.push_back(resource);
+    }
+
+    void DVKShader::ProcessAttachments(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection)
     {
         // 获取attachment信息
         for (int32 i = 0; i < resources.subpass_inputs.size(); ++i)
         {
-            spirv_cross::Resource& res      = resources.subpass_inputs[i];
-            spirv_cross::SPIRType type      = compiler.get_type(res.type_id);
-            spirv_cross::SPIRType base_type = compiler.get_type(res.base_type_id);
-            const std::string &varName      = compiler.get_name(res.id);
-
-            int32 set     = compiler.get_decoration(res.id, spv::DecorationDescriptorSet);
-            int32 binding = compiler.get_decoration(res.id, spv::DecorationBinding);
-
-            VkDescriptorSetLayoutBinding setLayoutBinding = {};
-            setLayoutBinding.binding             = binding;
-            setLayoutBinding.descriptorType     = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-            setLayoutBinding.descriptorCount    = 1;
-            setLayoutBinding.stageFlags         = stageFlags;
-            setLayoutBinding.pImmutableSamplers = nullptr;
-
-            setLayoutsInfo.AddDescriptorSetLayoutBinding(varName, set, setLayoutBinding);
-
-            auto it = imageParams.find(varName);
-            if (it == imageParams.end())
-            {
-                ImageInfo imageInfo = {};
-                imageInfo.set            = set;
-                imageInfo.binding        = binding;
-                imageInfo.stageFlags     = stageFlags;
-                imageInfo.descriptorType = setLayoutBinding.descriptorType;
-                imageParams.insert(std::make_pair(varName, imageInfo));
-            }
-            else
-            {
-                it->second.stageFlags |= stageFlags;
-            }
-
+            AddResource(compiler, resources.subpass_inputs[i], VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0, reflection);
         }
     }
 
-   void DVKShader::ProcessUniformBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags)
-   {
-         // 获取Uniform Buffer信息
+    void DVKShader::ProcessUniformBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection)
+    {
+        // 获取Uniform Buffer信息
         for (int32 i = 0; i < resources.uniform_buffers.size(); ++i)
         {
-            spirv_cross::Resource& res      = resources.uniform_buffers[i];
-            spirv_cross::SPIRType type      = compiler.get_type(res.type_id);
-            spirv_cross::SPIRType base_type = compiler.get_type(res.base_type_id);
-            const std::string &varName      = compiler.get_name(res.id);
-            const std::string &typeName     = compiler.get_name(res.base_type_id);
-            uint32 uniformBufferStructSize  = (uint32)compiler.get_declared_struct_size(type);
-
-            int32 set     = compiler.get_decoration(res.id, spv::DecorationDescriptorSet);
-            int32 binding = compiler.get_decoration(res.id, spv::DecorationBinding);
+            const spirv_cross::Resource& res  = resources.uniform_buffers[i];
+            const spirv_cross::SPIRType& type = compiler.get_type(res.type_id);
+            const std::string& typeName       = compiler.get_name(res.base_type_id);
+            uint32 uniformBufferStructSize    = (uint32)compiler.get_declared_struct_size(type);
 
             // [layout (binding = 0) uniform MVPDynamicBlock] 标记为Dynamic的buffer
-            VkDescriptorSetLayoutBinding setLayoutBinding = {};
-            setLayoutBinding.binding             = binding;
-            setLayoutBinding.descriptorType     = (typeName.find("Dynamic") != std::string::npos || dynamicUBO) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            setLayoutBinding.descriptorCount    = 1;
-            setLayoutBinding.stageFlags         = stageFlags;
-            setLayoutBinding.pImmutableSamplers = nullptr;
-
-            setLayoutsInfo.AddDescriptorSetLayoutBinding(varName, set, setLayoutBinding);
-
-            // 保存UBO变量信息
-            auto it = bufferParams.find(varName);
-            if (it == bufferParams.end())
-            {
-                BufferInfo bufferInfo = {};
-                bufferInfo.set            = set;
-                bufferInfo.binding        = binding;
-                bufferInfo.bufferSize     = uniformBufferStructSize;
-                bufferInfo.stageFlags     = stageFlags;
-                bufferInfo.descriptorType = setLayoutBinding.descriptorType;
-                bufferParams.insert(std::make_pair(varName, bufferInfo));
-            }
-            else
-            {
-                it->second.stageFlags |= setLayoutBinding.stageFlags;
-            }
+            VkDescriptorType descriptorType = (typeName.find("Dynamic") != std::string::npos || dynamicUBO) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            AddResource(compiler, res, descriptorType, uniformBufferStructSize, reflection);
         }
-   }
-
+    }
 
-    void DVKShader::ProcessTextures(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags)
+    void DVKShader::ProcessTextures(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection)
     {
-         // 获取Texture
+        // 获取Texture
         for (int32 i = 0; i < resources.sampled_images.size(); ++i)
         {
-            spirv_cross::Resource& res      = resources.sampled_images[i];
-            spirv_cross::SPIRType type      = compiler.get_type(res.type_id);
-            spirv_cross::SPIRType base_type = compiler.get_type(res.base_type_id);
-            const std::string&      varName = compiler.get_name(res.id);
-
-            int32 set = compiler.get_decoration(res.id,spv::DecorationDescriptorSet);
-            int32 binding = compiler.get_decoration(res.id, spv::DecorationBinding);
-            VkDescriptorSetLayoutBinding setLayoutBinding = {};
-            setLayoutBinding.binding             = binding;
-            setLayoutBinding.descriptorType     = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            setLayoutBinding.descriptorCount    = 1;
-            setLayoutBinding.stageFlags         = stageFlags;
-            setLayoutBinding.pImmutableSamplers = nullptr;
-
-            setLayoutsInfo.AddDescriptorSetLayoutBinding(varName, set, setLayoutBinding);
-            
-            auto it = imageParams.find(varName);
-            if (it == imageParams.end())
-            {
-                ImageInfo imageInfo = {};
-                imageInfo.set            = set;
-                imageInfo.binding        = binding;
-                imageInfo.stageFlags     = stageFlags;
-                imageInfo.descriptorType = setLayoutBinding.descriptorType;
-                imageParams.insert(std::make_pair(varName, imageInfo));
-            }
-            else
-            {
-                it->second.stageFlags |= stageFlags;
-            }
+            AddResource(compiler, resources.sampled_images[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, reflection);
         }
     }
 
-    void DVKShader::ProcessInput(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags)
+    void DVKShader::ProcessInput(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection)
     {
-        if (stageFlags != VK_SHADER_STAGE_VERTEX_BIT)
-        {
-            return;
-        }
-
-        for(int32 i=0;i<resources.stage_inputs.size();++i)
+        for (int32 i = 0; i < resources.stage_inputs.size(); ++i)
         {
-            spirv_cross::Resource& res = resources.stage_inputs[i];
-            spirv_cross::SPIRType type = compiler.get_type(res.type_id);
-            const std::string &varName = compiler.get_name(res.id);
-            int32 inputAttributeSize = type.vecsize;
-
-            VertexAttribute attribute  = StringToVertexAttribute(varName.c_str());
-            if(attribute==VertexAttribute::VA_None)
+            const spirv_cross::Resource& res  = resources.stage_inputs[i];
+            const spirv_cross::SPIRType& type = compiler.get_type(res.type_id);
+            const std::string& varName        = compiler.get_name(res.id);
+            int32 inputAttributeSize          = type.vecsize;
+            bool isInteger                    = type.basetype == spirv_cross::SPIRType::Int || type.basetype == spirv_cross::SPIRType::UInt;
+
+            VertexAttribute attribute = StringToVertexAttribute(varName.c_str());
+            if (attribute == VertexAttribute::VA_None)
             {
-                if(inputAttributeSize==1)
+                if (inputAttributeSize == 1)
                 {
                     attribute = VertexAttribute::VA_InstanceFloat1;
                 }
-                else if(inputAttributeSize==2)
+                else if (inputAttributeSize == 2)
                 {
                     attribute = VertexAttribute::VA_InstanceFloat2;
                 }
@@ -235,97 +368,117 @@ namespace vk_demo
                 }
                 MLOG("Not found attribute : %s, treat as instance attribute : %d.", varName.c_str(), int32(attribute));
             }
+
             // location必须连续
-            int32 location = compiler.get_decoration(res.id, spv::DecorationLocation);
             DVKAttribute dvkAttribute = {};
-            dvkAttribute.location  = location;
-            dvkAttribute.attribute = attribute;
-            m_InputAttributes.push_back(dvkAttribute);
+            dvkAttribute.location   = compiler.get_decoration(res.id, spv::DecorationLocation);
+            dvkAttribute.attribute  = attribute;
+            dvkAttribute.integer    = isInteger;
+            dvkAttribute.components = inputAttributeSize;
+            reflection.inputs.push_back(dvkAttribute);
         }
     }
 
-     void DVKShader::ProcessStorageBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags)
-     {
-        for(int32 i=0;i<resources.storage_buffers.size();++i)
+    void DVKShader::ProcessStorageBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection)
+    {
+        for (int32 i = 0; i < resources.storage_buffers.size(); ++i)
         {
-            spirv_cross::Resource& res = resources.storage_buffers[i];
-            spirv_cross::SPIRType type = compiler.get_type(res.type_id);
-            spirv_cross::SPIRType base_type = compiler.get_type(res.base_type_id);
-            const std::string &varName = compiler.get_name(res.id);
-            
-            int32 set     = compiler.get_decoration(res.id, spv::DecorationDescriptorSet);
-            int32 binding = compiler.get_decoration(res.id, spv::DecorationBinding);
+            AddResource(compiler, resources.storage_buffers[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, reflection);
+        }
+    }
 
-            VkDescriptorSetLayoutBinding setLayoutBinding = {};
-            setLayoutBinding.binding            = binding;
-            setLayoutBinding.descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-            setLayoutBinding.descriptorCount    = 1;
-            setLayoutBinding.stageFlags         = stageFlags;
-            setLayoutBinding.pImmutableSamplers = nullptr;
+    void DVKShader::ProcessStorageImages(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection)
+    {
+        for (int32 i = 0; i < resources.storage_images.size(); ++i)
+        {
+            AddResource(compiler, resources.storage_images[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, reflection);
+        }
+    }
 
-            setLayoutsInfo.AddDescriptorSetLayoutBinding(varName, set, setLayoutBinding);
+    void DVKShader::ReflectShaderModule(DVKShaderModule* shaderModule, DVKShaderReflection& reflection)
+    {
+        CPU_PROFILE_SCOPE("DVKShader::ReflectShaderModule");
 
-            // 保存UBO变量信息
-            auto it = bufferParams.find(varName);
-            if (it == bufferParams.end())
-            {
-                BufferInfo bufferInfo = {};
-                bufferInfo.set            = set;
-                bufferInfo.binding        = binding;
-                bufferInfo.bufferSize     = 0;
-                bufferInfo.stageFlags     = stageFlags;
-                bufferInfo.descriptorType = setLayoutBinding.descriptorType;
-                bufferParams.insert(std::make_pair(varName, bufferInfo));
-            }
-            else
-            {
-                it->second.stageFlags = it->second.stageFlags | setLayoutBinding.stageFlags;
-            }
+        // 反编译Shader获取相关信息
+        spirv_cross::Compiler compiler((uint32*)shaderModule->data, shaderModule->size / sizeof(uint32));
+        spirv_cross::ShaderResources resources = compiler.get_shader_resources();
+
+        // 顺序与ApplyReflection的插入顺序相关，不能随意调整
+        ProcessAttachments(compiler, resources, reflection);
+        ProcessUniformBuffers(compiler, resources, reflection);
+        ProcessTextures(compiler, resources, reflection);
+        ProcessStorageImages(compiler, resources, reflection);
+        if (shaderModule->stage == VK_SHADER_STAGE_VERTEX_BIT)
+        {
+            ProcessInput(compiler, resources, reflection);
         }
-     }
+        ProcessStorageBuffers(compiler, resources, reflection);
+    }
 
-     void DVKShader::ProcessStorageImages(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags)
+    void DVKShader::ApplyReflection(const DVKShaderReflection& reflection, VkShaderStageFlags stageFlags)
     {
-        for (int32 i = 0; i < resources.storage_images.size(); ++i)
+        for (int32 i = 0; i < reflection.resources.size(); ++i)
         {
-            spirv_cross::Resource& res      = resources.storage_images[i];
-            spirv_cross::SPIRType type      = compiler.get_type(res.type_id);
-            spirv_cross::SPIRType base_type = compiler.get_type(res.base_type_id);
-            const std::string&      varName = compiler.get_name(res.id);
-
-            int32 set     = compiler.get_decoration(res.id, spv::DecorationDescriptorSet);
-            int32 binding = compiler.get_decoration(res.id, spv::DecorationBinding);
+            const DVKShaderReflection::Resource& resource = reflection.resources[i];
 
             VkDescriptorSetLayoutBinding setLayoutBinding = {};
-            setLayoutBinding.binding             = binding;
-            setLayoutBinding.descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            setLayoutBinding.binding            = resource.binding;
+            setLayoutBinding.descriptorType     = resource.descriptorType;
             setLayoutBinding.descriptorCount    = 1;
             setLayoutBinding.stageFlags         = stageFlags;
             setLayoutBinding.pImmutableSamplers = nullptr;
 
-            setLayoutsInfo.AddDescriptorSetLayoutBinding(varName, set, setLayoutBinding);
+            setLayoutsInfo.AddDescriptorSetLayoutBinding(resource.name, resource.set, setLayoutBinding);
+
+            bool isBuffer = resource.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ||
+                            resource.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
+                            resource.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 
-            auto it = imageParams.find(varName);
-            if (it == imageParams.end())
+            // 保存UBO/SSBO与图像变量信息
+            if (isBuffer)
             {
-                ImageInfo imageInfo = {};
-                imageInfo.set            = set;
-                imageInfo.binding        = binding;
-                imageInfo.stageFlags     = stageFlags;
-                imageInfo.descriptorType = setLayoutBinding.descriptorType;
-                imageParams.insert(std::make_pair(varName, imageInfo));
+                auto it = bufferParams.find(resource.name);
+                if (it == bufferParams.end())
+                {
+                    BufferInfo bufferInfo = {};
+                    bufferInfo.set            = resource.set;
+                    bufferInfo.binding        = resource.binding;
+                    bufferInfo.bufferSize     = resource.bufferSize;
+                    bufferInfo.stageFlags     = stageFlags;
+                    bufferInfo.descriptorType = resource.descriptorType;
+                    bufferParams.insert(std::make_pair(resource.name, bufferInfo));
+                }
+                else
+                {
+                    it->second.stageFlags |= stageFlags;
+                }
             }
             else
             {
-                it->second.stageFlags |= stageFlags;
+                auto it = imageParams.find(resource.name);
+                if (it == imageParams.end())
+                {
+                    ImageInfo imageInfo = {};
+                    imageInfo.set            = resource.set;
+                    imageInfo.binding        = resource.binding;
+                    imageInfo.stageFlags     = stageFlags;
+                    imageInfo.descriptorType = resource.descriptorType;
+                    imageParams.insert(std::make_pair(resource.name, imageInfo));
+                }
+                else
+                {
+                    it->second.stageFlags |= stageFlags;
+                }
             }
-
         }
-    }
 
+        m_InputAttributes.insert(m_InputAttributes.end(), reflection.inputs.begin(), reflection.inputs.end());
+    }
 
- void DVKShader::ProcessShaderModule(DVKShaderModule* shaderModule)
+    void DVKShader::ProcessShaderModule(DVKShaderModule* shaderModule)
     {
+        CPU_PROFILE_SCOPE("DVKShader::ProcessShaderModule");
+
         if (!shaderModule)
         {
             return;
@@ -339,17 +492,23 @@ namespace vk_demo
         shaderCreateInfo.pName  = "main";
         shaderStageCreateInfos.push_back(shaderCreateInfo);
 
-        // 反编译Shader获取相关信息
-        spirv_cross::Compiler compiler((uint32*)shaderModule->data, shaderModule->size / sizeof(uint32));
-        spirv_cross::ShaderResources resources = compiler.get_shader_resources();
+        // 反射结果只与SPIR-V内容、stage以及dynamicUBO有关，命中缓存时不需要SPIRV-Cross
+        uint64 key = DVKReflectionCache::GenerateKey(shaderModule->data, shaderModule->size, shaderModule->stage, dynamicUBO);
 
-        ProcessAttachments(compiler, resources, shaderModule->stage);
-        ProcessUniformBuffers(compiler, resources, shaderModule->stage);
-        ProcessTextures(compiler, resources, shaderModule->stage);
-        ProcessStorageImages(compiler, resources, shaderModule->stage);
-        ProcessInput(compiler, resources, shaderModule->stage);
-        ProcessStorageBuffers(compiler, resources, shaderModule->stage);
+        double beginTime = GenericPlatformTime::Seconds();
+        const DVKShaderReflection* cached = DVKReflectionCache::Find(key);
+        if (cached)
+        {
+            ApplyReflection(*cached, shaderModule->stage);
+            DVKReflectionCache::warmTime += GenericPlatformTime::Seconds() - beginTime;
+            return;
+        }
 
+        DVKShaderReflection reflection;
+        ReflectShaderModule(shaderModule, reflection);
+        ApplyReflection(reflection, shaderModule->stage);
+        DVKReflectionCache::Add(key, reflection);
+        DVKReflectionCache::coldTime += GenericPlatformTime::Seconds() - beginTime;
     }
 
     void DVKShader::Compile()
@@ -364,8 +523,23 @@ namespace vk_demo
         GenerateLayout();
     }
 
+    void DVKShader::SetVertexQuantization(const DVKVertexQuantization& quantization)
+    {
+        vertexQuantization = quantization;
+        GenerateInputInfo();
+    }
+
+    static bool IsIntegerElementType(VertexElementType type)
+    {
+        return type == VET_UByte4 || type == VET_Short2 || type == VET_Short4 || type == VET_UShort2 || type == VET_UShort4 || type == VET_UInt3;
+    }
+
     void DVKShader::GenerateInputInfo()
     {
+        perVertexAttributes.clear();
+        instancesAttributes.clear();
+        inputAttributes.clear();
+
         // 对inputAttributes进行排序，获取Attributes列表
         std::sort(
             m_InputAttributes.begin(),
@@ -387,6 +561,34 @@ namespace vk_demo
             else
             {
                 perVertexAttributes.push_back(attribute);
+
+                // 未指定格式时按shader中的声明推断：uvec4的SkinIndex、uvec3的SkinPack以及vec2的八面体法线
+                if (vertexQuantization.types[attribute] == VET_None)
+                {
+                    if (attribute == VertexAttribute::VA_SkinIndex && m_InputAttributes[i].integer)
+                    {
+                        vertexQuantization.Set(attribute, VET_UByte4);
+                    }
+                    else if (attribute == VertexAttribute::VA_SkinPack && m_InputAttributes[i].integer)
+                    {
+                        vertexQuantization.Set(attribute, VET_UInt3);
+                    }
+                    else if (attribute == VertexAttribute::VA_Normal && m_InputAttributes[i].components == 2)
+                    {
+                        vertexQuantization.Set(attribute, VET_Short2N);
+                    }
+                }
+
+                // 整数格式必须声明为int/uint，八面体编码的法线声明为vec2
+                VertexElementType type = vertexQuantization.GetElementType(attribute);
+                if (IsIntegerElementType(type) != m_InputAttributes[i].integer)
+                {
+                    MLOGE("Shader input %d (attribute %d) is %s, but vertex format %d is %s.", m_InputAttributes[i].location, (int32)attribute, m_InputAttributes[i].integer ? "integer" : "float", (int32)type, IsIntegerElementType(type) ? "integer" : "float");
+                }
+                else if (attribute == VertexAttribute::VA_Normal && type == VET_Short2N && m_InputAttributes[i].components != 2)
+                {
+                    MLOGE("Shader input %d is octahedral normal, declare it as vec2.", m_InputAttributes[i].location);
+                }
             }
         }
 
@@ -397,7 +599,7 @@ namespace vk_demo
             int32 stride = 0;
             for (int32 i = 0; i < perVertexAttributes.size(); ++i)
             {
-                stride += VertexAttributeToSize(perVertexAttributes[i]);
+                stride += VertexAttributeToSize(perVertexAttributes[i], vertexQuantization);
             }
             VkVertexInputBindingDescription perVertexInputBinding = {};
             perVertexInputBinding.binding   = 0;
@@ -430,9 +632,9 @@ namespace vk_demo
                 VkVertexInputAttributeDescription inputAttribute = {};
                 inputAttribute.binding  = 0;
                 inputAttribute.location = location;
-                inputAttribute.format   = VertexAttributeToVkFormat(perVertexAttributes[i]);
+                inputAttribute.format   = VertexAttributeToVkFormat(perVertexAttributes[i], vertexQuantization);
                 inputAttribute.offset   = offset;
-                offset += VertexAttributeToSize(perVertexAttributes[i]);
+                offset += VertexAttributeToSize(perVertexAttributes[i], vertexQuantization);
                 inputAttributes.push_back(inputAttribute);
 
                 location += 1;
@@ -505,5 +707,63 @@ namespace vk_demo
         pipeLayoutInfo.setLayoutCount = (uint32_t)descriptorSetLayouts.size();
         pipeLayoutInfo.pSetLayouts    = descriptorSetLayouts.data();
         VERIFYVULKANRESULT(vkCreatePipelineLayout(device, &pipeLayoutInfo, VULKAN_CPU_ALLOCATOR, &pipelineLayout));
+
+        setLayoutsInfo.GenerateHandles();
+        GenerateUpdateTemplates();
+    }
+
+    void DVKShader::GenerateUpdateTemplates()
+    {
+#if DVK_SUPPORTS_UPDATE_TEMPLATE
+        if (!supportsUpdateTemplates)
+        {
+            return;
+        }
+
+        // 每个set一个模板，数据按句柄顺序存放在DVKDescriptorSet::descriptorData中
+        std::vector<VkDescriptorUpdateTemplateEntry> entries;
+        for (int32 i = 0; i < setLayoutsInfo.setLayouts.size(); ++i)
+        {
+            const DVKDescriptorSetLayoutInfo& setLayoutInfo = setLayoutsInfo.setLayouts[i];
+
+            entries.resize(setLayoutInfo.bindings.size());
+            for (int32 j = 0; j < setLayoutInfo.bindings.size(); ++j)
+            {
+                entries[j].dstBinding      = setLayoutInfo.bindings[j].binding;
+                entries[j].dstArrayElement = 0;
+                entries[j].descriptorCount = 1;
+                entries[j].descriptorType  = setLayoutInfo.bindings[j].descriptorType;
+                entries[j].offset          = j * sizeof(DVKDescriptorData);
+                entries[j].stride          = sizeof(DVKDescriptorData);
+            }
+
+            VkDescriptorUpdateTemplateCreateInfo templateCreateInfo;
+            ZeroVulkanStruct(templateCreateInfo, VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO);
+            templateCreateInfo.descriptorUpdateEntryCount = (uint32_t)entries.size();
+            templateCreateInfo.pDescriptorUpdateEntries   = entries.data();
+            templateCreateInfo.templateType               = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+            templateCreateInfo.descriptorSetLayout        = descriptorSetLayouts[i];
+
+            VkDescriptorUpdateTemplate updateTemplate = VK_NULL_HANDLE;
+            if (vkCreateDescriptorUpdateTemplate(device, &templateCreateInfo, VULKAN_CPU_ALLOCATOR, &updateTemplate) != VK_SUCCESS)
+            {
+                MLOGE("Failed create descriptor update template, fallback to vkUpdateDescriptorSets.");
+                DestroyUpdateTemplates();
+                return;
+            }
+            updateTemplates.push_back(updateTemplate);
+        }
+#endif
+    }
+
+    void DVKShader::DestroyUpdateTemplates()
+    {
+#if DVK_SUPPORTS_UPDATE_TEMPLATE
+        for (int32 i = 0; i < updateTemplates.size(); ++i)
+        {
+            vkDestroyDescriptorUpdateTemplate(device, updateTemplates[i], VULKAN_CPU_ALLOCATOR);
+        }
+#endif
+        updateTemplates.clear();
     }
 }
\ No newline at end of file
@@ -6,10 +6,12 @@
 #include <unordered_map>
 
 #include "Configuration/Platform.h"
+#include "Math/Math.h"
 
 #include "DVKUtils.h"
 #include "DVKBuffer.h"
 #include "DVKTexture.h"
+#include "DVKVertexBuffer.h"
 
 #include "FileManager.h"
 #include "Vulkan/VulkanCommon.h"
@@ -24,6 +26,9 @@ namespace spirv_cross
 
 namespace vk_demo
 {
+    class DVKDescriptorAllocator;
+    class DVKDescriptorSetPool;
+
     class DVKDescriptorSetLayoutInfo
     {
         private:
@@ -40,6 +45,8 @@ namespace vk_demo
             }
         public:
             int32           set = -1;
+            // 该set第一个binding的句柄，set内的句柄按binding顺序连续
+            int32           firstHandle = 0;
             BindingsArray   bindings;
     };    
 
@@ -48,8 +55,11 @@ namespace vk_demo
         public:
         struct BindInfo
         {
-            int32 set;
-            int32 binding;
+            int32               set;
+            int32               binding;
+            int32               setIndex = 0;
+            int32               handle = -1;
+            VkDescriptorType    descriptorType = VK_DESCRIPTOR_TYPE_MAX_ENUM;
         };
         DVKDescriptorSetLayoutsInfo()
         {
@@ -112,22 +122,97 @@ namespace vk_demo
 
             // 保存变量映射信息
             BindInfo paramInfo = {};
-            paramInfo.set      = set;
-            paramInfo.binding  = binding.binding;
+            paramInfo.set            = set;
+            paramInfo.binding        = binding.binding;
+            paramInfo.descriptorType = binding.descriptorType;
             paramsMap.insert(std::make_pair(varName, paramInfo));
        }
+
+       // setLayouts排序之后调用，为每个binding分配连续的整数句柄，写入时直接按句柄索引
+       void GenerateHandles()
+       {
+            handles.clear();
+            for (int32 i = 0; i < setLayouts.size(); ++i)
+            {
+                setLayouts[i].firstHandle = (int32)handles.size();
+                for (int32 j = 0; j < setLayouts[i].bindings.size(); ++j)
+                {
+                    BindInfo bindInfo = {};
+                    bindInfo.set            = setLayouts[i].set;
+                    bindInfo.binding        = setLayouts[i].bindings[j].binding;
+                    bindInfo.setIndex       = i;
+                    bindInfo.handle         = (int32)handles.size();
+                    bindInfo.descriptorType = setLayouts[i].bindings[j].descriptorType;
+                    handles.push_back(bindInfo);
+                }
+            }
+
+            for (auto it = paramsMap.begin(); it != paramsMap.end(); ++it)
+            {
+                for (int32 i = 0; i < handles.size(); ++i)
+                {
+                    if (handles[i].set == it->second.set && handles[i].binding == it->second.binding)
+                    {
+                        it->second = handles[i];
+                        break;
+                    }
+                }
+            }
+       }
+
+       int32 GetHandle(const std::string& name) const
+       {
+            auto it = paramsMap.find(name);
+            if (it == paramsMap.end())
+            {
+                return -1;
+            }
+            return it->second.handle;
+       }
+
     public:
         std::unordered_map<std::string, BindInfo>   paramsMap;
+        std::vector<BindInfo>                       handles;
         std::vector<DVKDescriptorSetLayoutInfo>     setLayouts;
     };   
 
+    // 一个descriptor的写入数据，布局与VkDescriptorUpdateTemplateEntry的stride一致
+    union DVKDescriptorData
+    {
+        VkDescriptorImageInfo   image;
+        VkDescriptorBufferInfo  buffer;
+    };
+
 
      struct DVKAttribute
     {
         VertexAttribute attribute;
         int32           location;
+        // shader中的声明，用于检查与顶点格式是否匹配
+        bool            integer = false;
+        int32           components = 0;
+    };
+
+    // 单个shader module的反射结果，与SPIRV-Cross无关，可以直接序列化到反射缓存
+    struct DVKShaderReflection
+    {
+        struct Resource
+        {
+            std::string         name;
+            VkDescriptorType    descriptorType;
+            uint32              set;
+            uint32              binding;
+            uint32              bufferSize;
+        };
+
+        // 按反射顺序保存，重建时的插入顺序与直接反射一致
+        std::vector<Resource>       resources;
+        std::vector<DVKAttribute>   inputs;
     };
 
+    // Write只记录数据，Flush时一次提交：整个set都写过时走VkDescriptorUpdateTemplate，
+    // 否则合并成一次vkUpdateDescriptorSets。绑定descriptorSets之前必须先Flush。
+    // 持久set从shader的pool分配，析构时归还；临时set每帧通过AllocateTransient从DVKDescriptorAllocator重新分配。
     class DVKDescriptorSet
     {
        public:
@@ -136,95 +221,142 @@ namespace vk_demo
 
         }
 
-        ~DVKDescriptorSet()
+        ~DVKDescriptorSet();
+
+        // 从当前帧的临时pool重新分配，已写过的descriptor会在下次Flush时重新提交
+        bool AllocateTransient(DVKDescriptorAllocator* allocator);
+
+        FORCE_INLINE int32 GetHandle(const std::string& name) const
         {
+            return setLayoutsInfo->GetHandle(name);
+        }
 
+        FORCE_INLINE bool IsDirty() const
+        {
+            return dirtyHandles.size() > 0;
         }
 
-        void WriteImage(const std::string& name, DVKTexture* texture)
+        void WriteImage(int32 handle, DVKTexture* texture)
         {
-            auto it = setLayoutsInfo.paramsMap.find(name);
-            if (it == setLayoutsInfo.paramsMap.end())
+            if (handle < 0 || handle >= descriptorData.size())
             {
-                MLOGE("Failed write buffer, %s not found!", name.c_str());
+                MLOGE("Failed write image, invalid handle %d!", handle);
+                return;
+            }
+            descriptorData[handle].image = texture->descriptorInfo;
+            MarkDirty(handle);
+        }
+
+        void WriteBuffer(int32 handle, const VkDescriptorBufferInfo* bufferInfo)
+        {
+            if (handle < 0 || handle >= descriptorData.size())
+            {
+                MLOGE("Failed write buffer, invalid handle %d!", handle);
                 return;
             }
+            descriptorData[handle].buffer = *bufferInfo;
+            MarkDirty(handle);
+        }
 
-            auto bindInfo = it->second;
-
-            VkWriteDescriptorSet writeDescriptorSet;
-            ZeroVulkanStruct(writeDescriptorSet, VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET);
-            writeDescriptorSet.dstSet          = descriptorSets[bindInfo.set];
-            writeDescriptorSet.descriptorCount = 1;
-            writeDescriptorSet.descriptorType  = setLayoutsInfo.GetDescriptorType(bindInfo.set, bindInfo.binding);
-            writeDescriptorSet.pBufferInfo     = nullptr;
-            writeDescriptorSet.pImageInfo      = &(texture->descriptorInfo);
-            writeDescriptorSet.dstBinding      = bindInfo.binding;
-            vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+        void WriteBuffer(int32 handle, DVKBuffer* buffer)
+        {
+            WriteBuffer(handle, &(buffer->descriptor));
+        }
+
+        void WriteImage(const std::string& name, DVKTexture* texture)
+        {
+            int32 handle = GetHandle(name);
+            if (handle < 0)
+            {
+                MLOGE("Failed write image, %s not found!", name.c_str());
+                return;
+            }
+            WriteImage(handle, texture);
         }
 
         void WriteBuffer(const std::string& name, const VkDescriptorBufferInfo* bufferInfo)
         {
-            auto it = setLayoutsInfo.paramsMap.find(name);
-            if (it == setLayoutsInfo.paramsMap.end())
+            int32 handle = GetHandle(name);
+            if (handle < 0)
             {
                 MLOGE("Failed write buffer, %s not found!", name.c_str());
                 return;
             }
-
-            auto bindInfo = it->second;
-
-            VkWriteDescriptorSet writeDescriptorSet;
-            ZeroVulkanStruct(writeDescriptorSet, VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET);
-            writeDescriptorSet.dstSet          = descriptorSets[bindInfo.set];
-            writeDescriptorSet.descriptorCount = 1;
-            writeDescriptorSet.descriptorType  = setLayoutsInfo.GetDescriptorType(bindInfo.set, bindInfo.binding);
-            writeDescriptorSet.pBufferInfo     = bufferInfo;
-            writeDescriptorSet.dstBinding      = bindInfo.binding;
-            vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+            WriteBuffer(handle, bufferInfo);
         }
 
         void WriteBuffer(const std::string& name, DVKBuffer* buffer)
         {
-            auto it = setLayoutsInfo.paramsMap.find(name);
-            if (it == setLayoutsInfo.paramsMap.end())
+            int32 handle = GetHandle(name);
+            if (handle < 0)
             {
                 MLOGE("Failed write buffer, %s not found!", name.c_str());
                 return;
             }
+            WriteBuffer(handle, &(buffer->descriptor));
+        }
 
-            auto bindInfo = it->second;
+        void Flush();
+
+    private:
+
+        enum DescriptorState
+        {
+            DS_Written = 1,
+            DS_Dirty   = 2,
+        };
 
-            VkWriteDescriptorSet writeDescriptorSet;
-            ZeroVulkanStruct(writeDescriptorSet, VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET);
-            writeDescriptorSet.dstSet          = descriptorSets[bindInfo.set];
-            writeDescriptorSet.descriptorCount = 1;
-            writeDescriptorSet.descriptorType  = setLayoutsInfo.GetDescriptorType(bindInfo.set, bindInfo.binding);
-            writeDescriptorSet.pBufferInfo     = &(buffer->descriptor);
-            writeDescriptorSet.dstBinding      = bindInfo.binding;
-            vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+        FORCE_INLINE void MarkDirty(int32 handle)
+        {
+            if ((states[handle] & DS_Dirty) == 0)
+            {
+                dirtyHandles.push_back(handle);
+            }
+            states[handle] |= DS_Written | DS_Dirty;
         }
 
     public:
 
         VkDevice    device;
 
-        DVKDescriptorSetLayoutsInfo     setLayoutsInfo;
-        std::vector<VkDescriptorSet>    descriptorSets;
+        const DVKDescriptorSetLayoutsInfo*      setLayoutsInfo = nullptr;
+        const std::vector<VkDescriptorSetLayout>* descriptorSetLayouts = nullptr;
+        // 持久set所属的pool，临时set为空。pool可能比shader活得久
+        std::shared_ptr<DVKDescriptorSetPool>   pool;
+        std::vector<VkDescriptorSet>            descriptorSets;
+        // 与descriptorSets一一对应，为空表示设备不支持模板
+        std::vector<VkDescriptorUpdateTemplate> updateTemplates;
+
+        std::vector<DVKDescriptorData>          descriptorData;
+        std::vector<uint8>                      states;
+        std::vector<int32>                      dirtyHandles;
+        std::vector<VkWriteDescriptorSet>       writes;
     };
 
 
 
+    // 持久descriptor set使用的pool，创建时带FREE_DESCRIPTOR_SET_BIT，set释放后空间可以复用。
+    // 释放的set可能仍被在途帧引用，先记录释放时的帧号，等该帧的fence等待之后才真正归还pool。
     class DVKDescriptorSetPool
     {
     public:
+        struct PendingFree
+        {
+            std::vector<VkDescriptorSet>    descriptorSets;
+            uint64                          frameNumber;
+        };
+
         DVKDescriptorSetPool(VkDevice inDevice, int32 inMaxSet, const DVKDescriptorSetLayoutsInfo& setLayoutsInfo, const std::vector<VkDescriptorSetLayout>& inDescriptorSetLayouts)
         {
             device  = inDevice;
-            maxSet  = inMaxSet;
             usedSet = 0;
             descriptorSetLayouts = inDescriptorSetLayouts;
 
+            // 每次分配占用descriptorSetLayouts.size()个set，pool大小按能分配的次数计算
+            int32 numLayouts = MMath::Max((int32)descriptorSetLayouts.size(), 1);
+            int32 numAllocs  = MMath::Max(inMaxSet / numLayouts, 1);
+            maxSet = numAllocs * numLayouts;
+
             std::vector<VkDescriptorPoolSize> poolSizes;
             for (int32 i = 0; i < setLayoutsInfo.setLayouts.size(); ++i)
             {
@@ -233,7 +365,7 @@ namespace vk_demo
                 {
                     VkDescriptorPoolSize poolSize = {};
                     poolSize.type            = setLayoutInfo.bindings[j].descriptorType;
-                    poolSize.descriptorCount = setLayoutInfo.bindings[j].descriptorCount;
+                    poolSize.descriptorCount = setLayoutInfo.bindings[j].descriptorCount * numAllocs;
                     poolSizes.push_back(poolSize);
                 }
             }
@@ -250,6 +382,7 @@ namespace vk_demo
 
             VkDescriptorPoolCreateInfo descriptorPoolInfo;
             ZeroVulkanStruct(descriptorPoolInfo, VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO);
+            descriptorPoolInfo.flags         = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
             descriptorPoolInfo.poolSizeCount = (uint32_t)poolSizes.size();
             descriptorPoolInfo.pPoolSizes    = poolSizes.data();
             descriptorPoolInfo.maxSets       = maxSet;
@@ -258,6 +391,9 @@ namespace vk_demo
 
         ~DVKDescriptorSetPool()
         {
+            // 销毁pool时其中的set一并释放，未归还的不需要再单独释放
+            pendingFrees.clear();
+
             if (descriptorPool != VK_NULL_HANDLE)
             {
                 vkDestroyDescriptorPool(device, descriptorPool, VULKAN_CPU_ALLOCATOR);
@@ -267,34 +403,71 @@ namespace vk_demo
 
         bool IsFull()
         {
-            return usedSet >= maxSet;
+            return usedSet + (int32)descriptorSetLayouts.size() > maxSet;
         }
 
         bool AllocateDescriptorSet(VkDescriptorSet* descriptorSet)
         {
-            if (usedSet + descriptorSetLayouts.size() >= maxSet)
+            ReleasePendingFrees();
+
+            if (IsFull())
             {
                 return false;
             }
 
-            usedSet += (int32)descriptorSetLayouts.size();
-
             VkDescriptorSetAllocateInfo allocInfo;
             ZeroVulkanStruct(allocInfo, VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO);
             allocInfo.descriptorPool     = descriptorPool;
             allocInfo.descriptorSetCount = (uint32_t)descriptorSetLayouts.size();
             allocInfo.pSetLayouts        = descriptorSetLayouts.data();
-            VERIFYVULKANRESULT(vkAllocateDescriptorSets(device, &allocInfo, descriptorSet));
+            if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSet) != VK_SUCCESS)
+            {
+                return false;
+            }
 
+            usedSet += (int32)descriptorSetLayouts.size();
             return true;
         }
 
+        void FreeDescriptorSet(const VkDescriptorSet* descriptorSet)
+        {
+            PendingFree pendingFree;
+            pendingFree.descriptorSets.assign(descriptorSet, descriptorSet + descriptorSetLayouts.size());
+            pendingFree.frameNumber = frameNumber;
+            pendingFrees.push_back(pendingFree);
+
+            ReleasePendingFrees();
+        }
+
+        // 归还已完成帧中释放的set
+        void ReleasePendingFrees()
+        {
+            int32 numReleased = 0;
+            while (numReleased < pendingFrees.size() && pendingFrees[numReleased].frameNumber <= completedFrame)
+            {
+                const PendingFree& pendingFree = pendingFrees[numReleased];
+                VERIFYVULKANRESULT(vkFreeDescriptorSets(device, descriptorPool, (uint32_t)pendingFree.descriptorSets.size(), pendingFree.descriptorSets.data()));
+                usedSet     -= (int32)pendingFree.descriptorSets.size();
+                numReleased += 1;
+            }
+            pendingFrees.erase(pendingFrees.begin(), pendingFrees.begin() + numReleased);
+        }
+
+        // 必须在frameIndex对应的fence等待之后调用，与DVKDescriptorAllocator::BeginFrame相同
+        static void BeginFrame(int32 frameIndex);
+
     public:
         int32                               maxSet;
         int32                               usedSet;
         VkDevice                            device = VK_NULL_HANDLE;
         std::vector<VkDescriptorSetLayout>  descriptorSetLayouts;
         VkDescriptorPool                    descriptorPool = VK_NULL_HANDLE;
+        std::vector<PendingFree>            pendingFrees;
+
+        // 所有pool共用的帧号，初始化阶段算作第一帧
+        static uint64                       frameNumber;
+        static uint64                       completedFrame;
+        static std::vector<uint64>          slotFrames;
     };
 
     class DVKShaderModule
@@ -355,7 +528,7 @@ namespace vk_demo
     private:
         typedef std::vector<VkPipelineShaderStageCreateInfo>    ShaderStageInfoArray;
         typedef std::vector<VkDescriptorSetLayout>              DescriptorSetLayouts;
-        typedef std::vector<DVKDescriptorSetPool*>              DVKDescriptorSetPools;
+        typedef std::vector<std::shared_ptr<DVKDescriptorSetPool>> DVKDescriptorSetPools;
 
         DVKShader()
         {
@@ -401,6 +574,8 @@ namespace vk_demo
                 teseShaderModule = nullptr;
             }
 
+            DestroyUpdateTemplates();
+
             for (int32 i = 0; i < descriptorSetLayouts.size(); ++i)
             {
                 vkDestroyDescriptorSetLayout(device, descriptorSetLayouts[i], VULKAN_CPU_ALLOCATOR);
@@ -413,10 +588,7 @@ namespace vk_demo
                 pipelineLayout = VK_NULL_HANDLE;
             }
 
-            for (int32 i = 0; i < descriptorSetPools.size(); ++i)
-            {
-                delete descriptorSetPools[i];
-            }
+            // 还有set没释放的pool由set持有，等set释放后再销毁
             descriptorSetPools.clear();
 
         }
@@ -427,32 +599,13 @@ namespace vk_demo
 
         static DVKShader* Create(std::shared_ptr<VulkanDevice> vulkanDevice, bool dynamicUBO, const char* vert, const char* frag, const char* geom = nullptr, const char* comp = nullptr, const char* tesc = nullptr, const char* tese = nullptr);
 
-        DVKDescriptorSet* AllocateDescriptorSet()
-        {
-            if (setLayoutsInfo.setLayouts.size() == 0)
-            {
-                return nullptr;
-            }
-
-            DVKDescriptorSet* dvkSet = new DVKDescriptorSet();
-            dvkSet->device = device;
-            dvkSet->setLayoutsInfo = setLayoutsInfo;
-            dvkSet->descriptorSets.resize(setLayoutsInfo.setLayouts.size());
-
-            for (int32 i = (int32)descriptorSetPools.size() - 1; i >= 0; --i)
-            {
-                if (descriptorSetPools[i]->AllocateDescriptorSet(dvkSet->descriptorSets.data()))
-                {
-                    return dvkSet;
-                }
-            }
+        DVKDescriptorSet* AllocateDescriptorSet();
 
-            DVKDescriptorSetPool* setPool = new DVKDescriptorSetPool(device, 64, setLayoutsInfo, descriptorSetLayouts);
-            descriptorSetPools.push_back(setPool);
-            setPool->AllocateDescriptorSet(dvkSet->descriptorSets.data());
+        // 顶点使用压缩格式时在创建pipeline之前调用，通常传入DVKModel::quantization，重新生成inputBindings/inputAttributes
+        void SetVertexQuantization(const DVKVertexQuantization& quantization);
 
-            return dvkSet;
-        }
+        // 临时set，需要每帧在录制前调用AllocateTransient
+        DVKDescriptorSet* CreateTransientDescriptorSet();
 
     private:
 
@@ -460,19 +613,27 @@ namespace vk_demo
 
         void GenerateLayout();
 
+        void GenerateUpdateTemplates();
+
+        void DestroyUpdateTemplates();
+
         void GenerateInputInfo();
 
-        void ProcessStorageBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags);
+        void ProcessStorageBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection);
+
+        void ProcessStorageImages(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection);
+
+        void ProcessInput(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection);
 
-        void ProcessStorageImages(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags);
+        void ProcessTextures(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection);
 
-        void ProcessInput(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags);
+        void ProcessAttachments(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection);
 
-        void ProcessTextures(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags);
+        void ProcessUniformBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, DVKShaderReflection& reflection);
 
-        void ProcessAttachments(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkPipelineStageFlags stageFlags);
+        void ReflectShaderModule(DVKShaderModule* shaderModule, DVKShaderReflection& reflection);
 
-        void ProcessUniformBuffers(spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& resources, VkShaderStageFlags stageFlags);
+        void ApplyReflection(const DVKShaderReflection& reflection, VkShaderStageFlags stageFlags);
 
         void ProcessShaderModule(DVKShaderModule* shaderModule);
 
@@ -493,15 +654,18 @@ namespace vk_demo
 
         VkDevice                        device = VK_NULL_HANDLE;
         bool                            dynamicUBO = false;
+        bool                            supportsUpdateTemplates = false;
 
         ShaderStageInfoArray            shaderStageCreateInfos;
         DVKDescriptorSetLayoutsInfo     setLayoutsInfo;
         std::vector<VertexAttribute>    perVertexAttributes;
         std::vector<VertexAttribute>    instancesAttributes;
+        DVKVertexQuantization           vertexQuantization;
         InputBindingsVector             inputBindings;
         InputAttributesVector           inputAttributes;
 
         DescriptorSetLayouts            descriptorSetLayouts;
+        std::vector<VkDescriptorUpdateTemplate> updateTemplates;
         VkPipelineLayout                pipelineLayout = VK_NULL_HANDLE;
         DVKDescriptorSetPools           descriptorSetPools;
 
@@ -5,10 +5,304 @@
 
 #include "Math/Math.h"
 #include "Loader/ImageLoader.h"
+#include "HAL/ThreadPool.h"
+#include "Utils/CPUProfiler.h"
+
+#include <atomic>
+#include <functional>
 
 namespace vk_demo
 {
 
+    static void GenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image, int32 width, int32 height, int32 mipLevels, ImageLayoutBarrier imageLayout, int32 layerCount = 1)
+    {
+        VkImageSubresourceRange subresourceRange = {};
+        subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        subresourceRange.levelCount     = 1;
+        subresourceRange.layerCount     = layerCount;
+        subresourceRange.baseArrayLayer = 0;
+        subresourceRange.baseMipLevel   = 0;
+
+        // TransferDest to TransferSrc
+        vk_demo::ImagePipelineBarrier(commandBuffer, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, subresourceRange);
+
+        // Generate the mip chain
+        for (uint32_t i = 1; i < (uint32_t)mipLevels; i++)
+        {
+            VkImageBlit imageBlit = {};
+
+            int32 mip0Width  = MMath::Max(width >> (i - 1), 1);
+            int32 mip0Height = MMath::Max(height >> (i - 1), 1);
+            int32 mip1Width  = MMath::Max(width >> (i - 0), 1);
+            int32 mip1Height = MMath::Max(height >> (i - 0), 1);
+
+            imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            imageBlit.srcSubresource.layerCount = layerCount;
+            imageBlit.srcSubresource.mipLevel   = i - 1;
+            imageBlit.srcOffsets[1].x = int32_t(mip0Width);
+            imageBlit.srcOffsets[1].y = int32_t(mip0Height);
+            imageBlit.srcOffsets[1].z = 1;
+
+            imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            imageBlit.dstSubresource.layerCount = layerCount;
+            imageBlit.dstSubresource.mipLevel   = i;
+            imageBlit.dstOffsets[1].x = int32_t(mip1Width);
+            imageBlit.dstOffsets[1].y = int32_t(mip1Height);
+            imageBlit.dstOffsets[1].z = 1;
+
+            VkImageSubresourceRange mipSubRange = {};
+            mipSubRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+            mipSubRange.baseMipLevel   = i;
+            mipSubRange.levelCount     = 1;
+            mipSubRange.layerCount     = layerCount;
+            mipSubRange.baseArrayLayer = 0;
+
+            // undefined to dst
+            vk_demo::ImagePipelineBarrier(commandBuffer, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, mipSubRange);
+
+            // blit image
+            vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+
+            // dst to src
+            vk_demo::ImagePipelineBarrier(commandBuffer, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, mipSubRange);
+        }
+
+        subresourceRange.levelCount = mipLevels;
+
+        // dst to layout
+        vk_demo::ImagePipelineBarrier(commandBuffer, image, ImageLayoutBarrier::TransferSource, imageLayout, subresourceRange);
+    }
+
+    // 并行读取并解码多张尺寸相同的图片，每个图层解码后直接写入allocate返回的staging内存。
+    // hdr为true时输出RGBA32F，否则输出RGBA8。
+    static bool DecodeLayers(const std::vector<std::string>& filenames, bool hdr, const std::function<uint8*(uint64)>& allocate, int32& outWidth, int32& outHeight, uint64& outLayerSize)
+    {
+        CPU_PROFILE_SCOPE("DVKTexture::DecodeLayers");
+
+        struct LayerInfo
+        {
+            MappedFile  file;
+            int32       width  = 0;
+            int32       height = 0;
+            bool        valid  = false;
+        };
+
+        int32 numLayers = (int32)filenames.size();
+        if (numLayers == 0)
+        {
+            return false;
+        }
+
+        // 只解析文件头得到尺寸，用于一次分配全部staging
+        std::vector<LayerInfo> layers(numLayers);
+        ThreadPool::Get().ParallelFor(numLayers, [&](int32 index)
+        {
+            LayerInfo& layer = layers[index];
+            int32 comp = 0;
+            if (FileManager::MapFile(filenames[index], layer.file))
+            {
+                layer.valid = StbImage::InfoFromMemory(layer.file.data, (int32)layer.file.size, &layer.width, &layer.height, &comp);
+            }
+        });
+
+        bool valid = true;
+        for (int32 i = 0; i < numLayers; ++i)
+        {
+            if (!layers[i].valid)
+            {
+                MLOGE("Failed load image : %s", filenames[i].c_str());
+                valid = false;
+            }
+            else if (layers[i].width != layers[0].width || layers[i].height != layers[0].height)
+            {
+                // TextureArray与Cube要求尺寸一致
+                MLOGE("Image size mismatch : %s", filenames[i].c_str());
+                valid = false;
+            }
+        }
+
+        uint8* staging = nullptr;
+        uint64 layerSize = (uint64)layers[0].width * layers[0].height * 4 * (hdr ? sizeof(float) : 1);
+        if (valid)
+        {
+            staging = allocate(layerSize * numLayers);
+        }
+
+        std::atomic<bool> decoded(staging != nullptr);
+        ThreadPool::Get().ParallelFor(numLayers, [&](int32 index)
+        {
+            LayerInfo& layer = layers[index];
+            if (staging && decoded)
+            {
+                CPU_PROFILE_SCOPE("DVKTexture::DecodeLayer");
+
+                int32 comp   = 0;
+                int32 width  = 0;
+                int32 height = 0;
+                uint8* data  = hdr ?
+                    (uint8*)StbImage::LoadFloatFromMemory(layer.file.data, (int32)layer.file.size, &width, &height, &comp, 4) :
+                    StbImage::LoadFromMemory(layer.file.data, (int32)layer.file.size, &width, &height, &comp, 4);
+                if (data)
+                {
+                    memcpy(staging + layerSize * index, data, layerSize);
+                    StbImage::Free(data);
+                }
+                else
+                {
+                    MLOGE("Failed load image : %s", filenames[index].c_str());
+                    decoded = false;
+                }
+            }
+            FileManager::UnmapFile(layer.file);
+        });
+
+        outWidth     = layers[0].width;
+        outHeight    = layers[0].height;
+        outLayerSize = layerSize;
+
+        return decoded;
+    }
+
+    // 图层解码到uploader的staging，拷贝与mipmap生成记录到uploader中
+    static DVKTexture* CreateLayeredAsync(const std::vector<std::string>& filenames, bool cube, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, ImageLayoutBarrier imageLayout)
+    {
+        int32 width      = 0;
+        int32 height     = 0;
+        uint64 layerSize = 0;
+
+        VkBuffer srcBuffer     = VK_NULL_HANDLE;
+        VkDeviceSize srcOffset = 0;
+        bool decoded = DecodeLayers(filenames, cube, [&](uint64 size) -> uint8*
+        {
+            return uploader->AllocateStaging(size, 16, srcBuffer, srcOffset);
+        }, width, height, layerSize);
+
+        if (!decoded)
+        {
+            return nullptr;
+        }
+
+        int32 numArray  = (int32)filenames.size();
+        VkFormat format = cube ? VK_FORMAT_R32G32B32A32_SFLOAT : VK_FORMAT_R8G8B8A8_UNORM;
+        int32 mipLevels = MMath::FloorToInt(MMath::Log2((float)MMath::Max(width, height))) + 1;
+        VkDevice device = vulkanDevice->GetInstanceHandle();
+
+        VkMemoryRequirements memReqs = {};
+
+        // image info
+        VkImage                image = VK_NULL_HANDLE;
+        VkDeviceMemory         imageMemory = VK_NULL_HANDLE;
+        VulkanResourceAllocation* imageAllocation = nullptr;
+        VkImageView            imageView = VK_NULL_HANDLE;
+        VkSampler              imageSampler = VK_NULL_HANDLE;
+        VkDescriptorImageInfo  descriptorInfo = {};
+
+        // 创建image
+        VkImageCreateInfo imageCreateInfo;
+        ZeroVulkanStruct(imageCreateInfo, VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO);
+        imageCreateInfo.imageType       = VK_IMAGE_TYPE_2D;
+        imageCreateInfo.format          = format;
+        imageCreateInfo.mipLevels       = mipLevels;
+        imageCreateInfo.arrayLayers     = numArray;
+        imageCreateInfo.samples         = VK_SAMPLE_COUNT_1_BIT;
+        imageCreateInfo.tiling          = VK_IMAGE_TILING_OPTIMAL;
+        imageCreateInfo.sharingMode     = VK_SHARING_MODE_EXCLUSIVE;
+        imageCreateInfo.initialLayout   = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageCreateInfo.extent          = { (uint32_t)width, (uint32_t)height, 1 };
+        imageCreateInfo.usage           = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageCreateInfo.flags           = cube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+        VERIFYVULKANRESULT(vkCreateImage(device, &imageCreateInfo, VULKAN_CPU_ALLOCATOR, &image));
+
+        // bind image buffer
+        vkGetImageMemoryRequirements(device, image, &memReqs);
+        imageAllocation = vulkanDevice->GetResourceHeapManager().AllocateImageMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, __FILE__, __LINE__);
+        if (imageAllocation == nullptr)
+        {
+            vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+            return nullptr;
+        }
+        imageAllocation->AddRef();
+        imageAllocation->BindImage(vulkanDevice.get(), image);
+        imageMemory = imageAllocation->GetHandle();
+
+        VkImageSubresourceRange subresourceRange = {};
+        subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        subresourceRange.levelCount     = 1;
+        subresourceRange.layerCount     = numArray;
+        subresourceRange.baseMipLevel   = 0;
+        subresourceRange.baseArrayLayer = 0;
+
+        std::vector<VkBufferImageCopy> bufferCopyRegions(numArray);
+        for (int32 i = 0; i < numArray; ++i)
+        {
+            VkBufferImageCopy& bufferCopyRegion = bufferCopyRegions[i];
+            bufferCopyRegion = {};
+            bufferCopyRegion.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+            bufferCopyRegion.imageSubresource.mipLevel       = 0;
+            bufferCopyRegion.imageSubresource.baseArrayLayer = i;
+            bufferCopyRegion.imageSubresource.layerCount     = 1;
+            bufferCopyRegion.imageExtent.width  = width;
+            bufferCopyRegion.imageExtent.height = height;
+            bufferCopyRegion.imageExtent.depth  = 1;
+            bufferCopyRegion.bufferOffset       = srcOffset + layerSize * i;
+        }
+
+        VkCommandBuffer commandBuffer = uploader->UploadImage(image, subresourceRange, srcBuffer, bufferCopyRegions);
+
+        // 所有图层一起生成mipmap
+        GenerateMipmaps(commandBuffer, image, width, height, mipLevels, imageLayout, numArray);
+
+        VkSamplerCreateInfo samplerInfo;
+        ZeroVulkanStruct(samplerInfo, VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO);
+        samplerInfo.magFilter        = VK_FILTER_LINEAR;
+        samplerInfo.minFilter        = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode       = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerInfo.addressModeU     = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeV     = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeW     = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.compareOp        = VK_COMPARE_OP_NEVER;
+        samplerInfo.borderColor      = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+        samplerInfo.maxAnisotropy    = 1.0;
+        samplerInfo.anisotropyEnable = VK_FALSE;
+        samplerInfo.maxLod           = (float)mipLevels;
+        samplerInfo.minLod           = 0;
+        VERIFYVULKANRESULT(vkCreateSampler(device, &samplerInfo, VULKAN_CPU_ALLOCATOR, &imageSampler));
+
+        VkImageViewCreateInfo viewInfo;
+        ZeroVulkanStruct(viewInfo, VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO);
+        viewInfo.viewType = cube ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+        viewInfo.image    = image;
+        viewInfo.format   = format;
+        viewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.layerCount = numArray;
+        viewInfo.subresourceRange.levelCount = mipLevels;
+        VERIFYVULKANRESULT(vkCreateImageView(device, &viewInfo, VULKAN_CPU_ALLOCATOR, &imageView));
+
+        descriptorInfo.sampler     = imageSampler;
+        descriptorInfo.imageView   = imageView;
+        descriptorInfo.imageLayout = GetImageLayout(imageLayout);
+
+        DVKTexture* texture   = new DVKTexture();
+        texture->descriptorInfo = descriptorInfo;
+        texture->format         = format;
+        texture->height         = height;
+        texture->image          = image;
+        texture->imageLayout    = GetImageLayout(imageLayout);
+        texture->imageMemory    = imageMemory;
+        texture->allocation     = imageAllocation;
+        texture->imageSampler   = imageSampler;
+        texture->imageView      = imageView;
+        texture->imageCreateInfo = imageCreateInfo;
+        texture->viewCreateInfo  = viewInfo;
+        texture->device         = device;
+        texture->width          = width;
+        texture->mipLevels      = mipLevels;
+        texture->layerCount     = numArray;
+
+        return texture;
+    }
+
     DVKTexture* DVKTexture::Create2D(const uint8* rgbaData, uint32 size, VkFormat format, int32 width, int32 height, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, VkImageUsageFlags imageUsageFlags, ImageLayoutBarrier imageLayout)
     {
         int32 mipLevels = MMath::FloorToInt(MMath::Log2((float)MMath::Max(width, height))) + 1;
@@ -19,14 +313,12 @@ namespace vk_demo
         stagingBuffer->CopyFrom((void*)rgbaData, size);
         stagingBuffer->UnMap();
 
-        uint32 memoryTypeIndex = 0;
         VkMemoryRequirements memReqs = {};
-        VkMemoryAllocateInfo memAllocInfo;
-        ZeroVulkanStruct(memAllocInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
 
         // image info
         VkImage                         image = VK_NULL_HANDLE;
         VkDeviceMemory                  imageMemory = VK_NULL_HANDLE;
+        VulkanResourceAllocation*       imageAllocation = nullptr;
         VkImageView                     imageView = VK_NULL_HANDLE;
         VkSampler                       imageSampler = VK_NULL_HANDLE;
         VkDescriptorImageInfo           descriptorInfo = {};
@@ -58,11 +350,16 @@ namespace vk_demo
 
         // bind image buffer
         vkGetImageMemoryRequirements(device, image, &memReqs);
-        vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex);
-        memAllocInfo.allocationSize  = memReqs.size;
-        memAllocInfo.memoryTypeIndex = memoryTypeIndex;
-        VERIFYVULKANRESULT(vkAllocateMemory(device, &memAllocInfo, VULKAN_CPU_ALLOCATOR, &imageMemory));
-        VERIFYVULKANRESULT(vkBindImageMemory(device, image, imageMemory, 0));
+        imageAllocation = vulkanDevice->GetResourceHeapManager().AllocateImageMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, __FILE__, __LINE__);
+        if (imageAllocation == nullptr)
+        {
+            delete stagingBuffer;
+            vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+            return nullptr;
+        }
+        imageAllocation->AddRef();
+        imageAllocation->BindImage(vulkanDevice.get(), image);
+        imageMemory = imageAllocation->GetHandle();
 
         // start record
         cmdBuffer->Begin();
@@ -89,59 +386,171 @@ namespace vk_demo
         // copy buffer to image
         vkCmdCopyBufferToImage(cmdBuffer->cmdBuffer, stagingBuffer->buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 
-        // TransferDest to TransferSrc
-        vk_demo::ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, subresourceRange);
+        // 生成mipmap并转换到最终layout
+        GenerateMipmaps(cmdBuffer->cmdBuffer, image, width, height, mipLevels, imageLayout);
 
-        // Generate the mip chain
-        for (uint32_t i = 1; i < (uint32_t)mipLevels; i++)
+        cmdBuffer->End();
+        cmdBuffer->Submit();
+
+        delete stagingBuffer;
+
+        VkSamplerCreateInfo samplerInfo;
+        ZeroVulkanStruct(samplerInfo, VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO);
+        samplerInfo.magFilter        = VK_FILTER_LINEAR;
+        samplerInfo.minFilter        = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode       = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerInfo.addressModeU     = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeV     = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeW     = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.compareOp        = VK_COMPARE_OP_NEVER;
+        samplerInfo.borderColor      = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+        samplerInfo.maxAnisotropy    = 1.0;
+        samplerInfo.anisotropyEnable = VK_FALSE;
+        samplerInfo.maxLod           = (float)mipLevels;
+        samplerInfo.minLod           = 0.0f;
+        VERIFYVULKANRESULT(vkCreateSampler(device, &samplerInfo, VULKAN_CPU_ALLOCATOR, &imageSampler));
+
+        VkImageViewCreateInfo viewInfo;
+        ZeroVulkanStruct(viewInfo, VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO);
+        viewInfo.image      = image;
+        viewInfo.viewType   = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format     = format;
+        viewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.layerCount = 1;
+        viewInfo.subresourceRange.levelCount = mipLevels;
+        VERIFYVULKANRESULT(vkCreateImageView(device, &viewInfo, VULKAN_CPU_ALLOCATOR, &imageView));
+
+        descriptorInfo.sampler     = imageSampler;
+        descriptorInfo.imageView   = imageView;
+        descriptorInfo.imageLayout = GetImageLayout(imageLayout);
+
+        DVKTexture* texture   = new DVKTexture();
+        texture->descriptorInfo = descriptorInfo;
+        texture->format         = format;
+        texture->height         = height;
+        texture->image          = image;
+        texture->imageLayout    = GetImageLayout(imageLayout);
+        texture->imageMemory    = imageMemory;
+        texture->allocation     = imageAllocation;
+        texture->imageSampler   = imageSampler;
+        texture->imageView      = imageView;
+        texture->imageCreateInfo = imageCreateInfo;
+        texture->viewCreateInfo  = viewInfo;
+        texture->device         = device;
+        texture->width          = width;
+        texture->mipLevels      = mipLevels;
+        texture->layerCount     = 1;
+
+        return texture;
+    }
+
+    DVKTexture* DVKTexture::Create2D(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, VkImageUsageFlags imageUsageFlags, ImageLayoutBarrier imageLayout)
+    {
+        CPU_PROFILE_SCOPE("DVKTexture::Create2D");
+
+        uint32 dataSize = 0;
+        uint8* dataPtr  = nullptr;
+        if (!FileManager::ReadFile(filename, dataPtr, dataSize))
         {
-            VkImageBlit imageBlit = {};
+            MLOGE("Failed load image : %s", filename.c_str());
+            return nullptr;
+        }
 
-            int32 mip0Width  = MMath::Max(width >> (i - 1), 1);
-            int32 mip0Height = MMath::Max(height >> (i - 1), 1);
-            int32 mip1Width  = MMath::Max(width >> (i - 0), 1);
-            int32 mip1Height = MMath::Max(height >> (i - 0), 1);
+        int32 comp   = 0;
+        int32 width  = 0;
+        int32 height = 0;
+        uint8* rgbaData = StbImage::LoadFromMemory(dataPtr, dataSize, &width, &height, &comp, 4);
 
-            imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            imageBlit.srcSubresource.layerCount = 1;
-            imageBlit.srcSubresource.mipLevel   = i - 1;
-            imageBlit.srcOffsets[1].x = int32_t(mip0Width);
-            imageBlit.srcOffsets[1].y = int32_t(mip0Height);
-            imageBlit.srcOffsets[1].z = 1;
+        delete[] dataPtr;
+        dataPtr = nullptr;
 
-            imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            imageBlit.dstSubresource.layerCount = 1;
-            imageBlit.dstSubresource.mipLevel   = i;
-            imageBlit.dstOffsets[1].x = int32_t(mip1Width);
-            imageBlit.dstOffsets[1].y = int32_t(mip1Height);
-            imageBlit.dstOffsets[1].z = 1;
+        if (rgbaData == nullptr)
+        {
+            MLOGE("Failed load image : %s", filename.c_str());
+            return nullptr;
+        }
 
-            VkImageSubresourceRange mipSubRange = {};
-            mipSubRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
-            mipSubRange.baseMipLevel   = i;
-            mipSubRange.levelCount     = 1;
-            mipSubRange.layerCount     = 1;
-            mipSubRange.baseArrayLayer = 0;
+        DVKTexture* texture = Create2D(rgbaData, width * height * 4, VK_FORMAT_R8G8B8A8_UNORM, width, height, vulkanDevice, cmdBuffer, imageUsageFlags, imageLayout);
 
-            // undefined to dst
-            vk_demo::ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, mipSubRange);
+        StbImage::Free(rgbaData);
 
-            // blit image
-            vkCmdBlitImage(cmdBuffer->cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+        return texture;
+    }
 
-            // dst to src
-            vk_demo::ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::TransferDest, ImageLayoutBarrier::TransferSource, mipSubRange);
+    DVKTexture* DVKTexture::Create2D(const uint8* rgbaData, uint32 size, VkFormat format, int32 width, int32 height, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, VkImageUsageFlags imageUsageFlags, ImageLayoutBarrier imageLayout)
+    {
+        int32 mipLevels = MMath::FloorToInt(MMath::Log2((float)MMath::Max(width, height))) + 1;
+        VkDevice device = vulkanDevice->GetInstanceHandle();
+
+        VkMemoryRequirements memReqs = {};
+
+        // image info
+        VkImage                         image = VK_NULL_HANDLE;
+        VkDeviceMemory                  imageMemory = VK_NULL_HANDLE;
+        VulkanResourceAllocation*       imageAllocation = nullptr;
+        VkImageView                     imageView = VK_NULL_HANDLE;
+        VkSampler                       imageSampler = VK_NULL_HANDLE;
+        VkDescriptorImageInfo           descriptorInfo = {};
+
+        imageUsageFlags |= VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+        // 创建image
+        VkImageCreateInfo imageCreateInfo;
+        ZeroVulkanStruct(imageCreateInfo, VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO);
+        imageCreateInfo.imageType       = VK_IMAGE_TYPE_2D;
+        imageCreateInfo.format          = format;
+        imageCreateInfo.mipLevels       = mipLevels;
+        imageCreateInfo.arrayLayers     = 1;
+        imageCreateInfo.samples         = VK_SAMPLE_COUNT_1_BIT;
+        imageCreateInfo.tiling          = VK_IMAGE_TILING_OPTIMAL;
+        imageCreateInfo.sharingMode     = VK_SHARING_MODE_EXCLUSIVE;
+        imageCreateInfo.initialLayout   = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageCreateInfo.extent          = { (uint32_t)width, (uint32_t)height, 1 };
+        imageCreateInfo.usage           = imageUsageFlags;
+        VERIFYVULKANRESULT(vkCreateImage(device, &imageCreateInfo, VULKAN_CPU_ALLOCATOR, &image));
+
+        // bind image buffer
+        vkGetImageMemoryRequirements(device, image, &memReqs);
+        imageAllocation = vulkanDevice->GetResourceHeapManager().AllocateImageMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, __FILE__, __LINE__);
+        if (imageAllocation == nullptr)
+        {
+            vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+            return nullptr;
         }
+        imageAllocation->AddRef();
+        imageAllocation->BindImage(vulkanDevice.get(), image);
+        imageMemory = imageAllocation->GetHandle();
 
-        subresourceRange.levelCount = mipLevels;
+        // 像素直接写入uploader的staging，不再单独创建staging buffer
+        VkBuffer srcBuffer     = VK_NULL_HANDLE;
+        VkDeviceSize srcOffset = 0;
+        uint8* staging = uploader->AllocateStaging(size, 16, srcBuffer, srcOffset);
+        memcpy(staging, rgbaData, size);
 
-        // dst to layout
-        vk_demo::ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::TransferSource, imageLayout, subresourceRange);
+        VkImageSubresourceRange subresourceRange = {};
+        subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        subresourceRange.levelCount     = 1;
+        subresourceRange.layerCount     = 1;
+        subresourceRange.baseArrayLayer = 0;
+        subresourceRange.baseMipLevel   = 0;
 
-        cmdBuffer->End();
-        cmdBuffer->Submit();
+        std::vector<VkBufferImageCopy> bufferCopyRegions(1);
+        VkBufferImageCopy& bufferCopyRegion = bufferCopyRegions[0];
+        bufferCopyRegion = {};
+        bufferCopyRegion.bufferOffset                    = srcOffset;
+        bufferCopyRegion.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        bufferCopyRegion.imageSubresource.mipLevel       = 0;
+        bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+        bufferCopyRegion.imageSubresource.layerCount     = 1;
+        bufferCopyRegion.imageExtent.width  = width;
+        bufferCopyRegion.imageExtent.height = height;
+        bufferCopyRegion.imageExtent.depth  = 1;
 
-        delete stagingBuffer;
+        VkCommandBuffer commandBuffer = uploader->UploadImage(image, subresourceRange, srcBuffer, bufferCopyRegions);
+
+        // blit需要graphics queue，在uploader的graphics command buffer中完成
+        GenerateMipmaps(commandBuffer, image, width, height, mipLevels, imageLayout);
 
         VkSamplerCreateInfo samplerInfo;
         ZeroVulkanStruct(samplerInfo, VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO);
@@ -181,8 +590,11 @@ namespace vk_demo
         texture->image          = image;
         texture->imageLayout    = GetImageLayout(imageLayout);
         texture->imageMemory    = imageMemory;
+        texture->allocation     = imageAllocation;
         texture->imageSampler   = imageSampler;
         texture->imageView      = imageView;
+        texture->imageCreateInfo = imageCreateInfo;
+        texture->viewCreateInfo  = viewInfo;
         texture->device         = device;
         texture->width          = width;
         texture->mipLevels      = mipLevels;
@@ -191,8 +603,10 @@ namespace vk_demo
         return texture;
     }
 
-    DVKTexture* DVKTexture::Create2D(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, VkImageUsageFlags imageUsageFlags, ImageLayoutBarrier imageLayout)
+    DVKTexture* DVKTexture::Create2D(const std::string& filename, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, VkImageUsageFlags imageUsageFlags, ImageLayoutBarrier imageLayout)
     {
+        CPU_PROFILE_SCOPE("DVKTexture::Create2D");
+
         uint32 dataSize = 0;
         uint8* dataPtr  = nullptr;
         if (!FileManager::ReadFile(filename, dataPtr, dataSize))
@@ -215,7 +629,7 @@ namespace vk_demo
             return nullptr;
         }
 
-        DVKTexture* texture = Create2D(rgbaData, width * height * 4, VK_FORMAT_R8G8B8A8_UNORM, width, height, vulkanDevice, cmdBuffer, imageUsageFlags, imageLayout);
+        DVKTexture* texture = Create2D(rgbaData, width * height * 4, VK_FORMAT_R8G8B8A8_UNORM, width, height, vulkanDevice, uploader, imageUsageFlags, imageLayout);
 
         StbImage::Free(rgbaData);
 
@@ -239,14 +653,12 @@ namespace vk_demo
             mipLevels = MMath::FloorToInt(MMath::Log2((float)MMath::Max(width, height))) + 1;
         }
 
-        uint32 memoryTypeIndex = 0;
         VkMemoryRequirements memReqs = {};
-        VkMemoryAllocateInfo memAllocInfo;
-        ZeroVulkanStruct(memAllocInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
 
         // image info
         VkImage                         image = VK_NULL_HANDLE;
         VkDeviceMemory                  imageMemory = VK_NULL_HANDLE;
+        VulkanResourceAllocation*       imageAllocation = nullptr;
         VkImageView                     imageView = VK_NULL_HANDLE;
         VkSampler                       imageSampler = VK_NULL_HANDLE;
         VkDescriptorImageInfo           descriptorInfo = {};
@@ -269,11 +681,15 @@ namespace vk_demo
 
         // bind image buffer
         vkGetImageMemoryRequirements(device, image, &memReqs);
-        vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex);
-        memAllocInfo.allocationSize  = memReqs.size;
-        memAllocInfo.memoryTypeIndex = memoryTypeIndex;
-        VERIFYVULKANRESULT(vkAllocateMemory(device, &memAllocInfo, VULKAN_CPU_ALLOCATOR, &imageMemory));
-        VERIFYVULKANRESULT(vkBindImageMemory(device, image, imageMemory, 0));
+        imageAllocation = vulkanDevice->GetResourceHeapManager().AllocateImageMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, __FILE__, __LINE__);
+        if (imageAllocation == nullptr)
+        {
+            vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+            return nullptr;
+        }
+        imageAllocation->AddRef();
+        imageAllocation->BindImage(vulkanDevice.get(), image);
+        imageMemory = imageAllocation->GetHandle();
 
         VkSamplerCreateInfo samplerInfo;
         ZeroVulkanStruct(samplerInfo, VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO);
@@ -337,8 +753,11 @@ namespace vk_demo
         texture->image          = image;
         texture->imageLayout    = GetImageLayout(imageLayout);
         texture->imageMemory    = imageMemory;
+        texture->allocation     = imageAllocation;
         texture->imageSampler   = imageSampler;
         texture->imageView      = imageView;
+        texture->imageCreateInfo = imageCreateInfo;
+        texture->viewCreateInfo  = viewInfo;
         texture->device         = device;
         texture->mipLevels      = mipLevels;
         texture->layerCount     = 1;
@@ -380,16 +799,14 @@ namespace vk_demo
     {
         VkDevice device = vulkanDevice->GetInstanceHandle();
 
-        uint32 memoryTypeIndex = 0;
         VkMemoryRequirements memReqs = {};
-        VkMemoryAllocateInfo memAllocInfo;
-        ZeroVulkanStruct(memAllocInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
 
         int32 mipLevels = 1;
 
         // image info
         VkImage                         image = VK_NULL_HANDLE;
         VkDeviceMemory                  imageMemory = VK_NULL_HANDLE;
+        VulkanResourceAllocation*       imageAllocation = nullptr;
         VkImageView                     imageView = VK_NULL_HANDLE;
         VkSampler                       imageSampler = VK_NULL_HANDLE;
         VkDescriptorImageInfo           descriptorInfo = {};
@@ -411,11 +828,15 @@ namespace vk_demo
 
         // bind image buffer
         vkGetImageMemoryRequirements(device, image, &memReqs);
-        vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex);
-        memAllocInfo.allocationSize  = memReqs.size;
-        memAllocInfo.memoryTypeIndex = memoryTypeIndex;
-        VERIFYVULKANRESULT(vkAllocateMemory(device, &memAllocInfo, VULKAN_CPU_ALLOCATOR, &imageMemory));
-        VERIFYVULKANRESULT(vkBindImageMemory(device, image, imageMemory, 0));
+        imageAllocation = vulkanDevice->GetResourceHeapManager().AllocateImageMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, __FILE__, __LINE__);
+        if (imageAllocation == nullptr)
+        {
+            vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+            return nullptr;
+        }
+        imageAllocation->AddRef();
+        imageAllocation->BindImage(vulkanDevice.get(), image);
+        imageMemory = imageAllocation->GetHandle();
 
         VkSamplerCreateInfo samplerInfo;
         ZeroVulkanStruct(samplerInfo, VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO);
@@ -479,8 +900,11 @@ namespace vk_demo
         texture->image          = image;
         texture->imageLayout    = GetImageLayout(imageLayout);
         texture->imageMemory    = imageMemory;
+        texture->allocation     = imageAllocation;
         texture->imageSampler   = imageSampler;
         texture->imageView      = imageView;
+        texture->imageCreateInfo = imageCreateInfo;
+        texture->viewCreateInfo  = viewInfo;
         texture->device         = device;
         texture->mipLevels      = mipLevels;
         texture->layerCount     = numArray;
@@ -493,16 +917,14 @@ namespace vk_demo
     {
         VkDevice device = vulkanDevice->GetInstanceHandle();
 
-        uint32 memoryTypeIndex = 0;
         VkMemoryRequirements memReqs = {};
-        VkMemoryAllocateInfo memAllocInfo;
-        ZeroVulkanStruct(memAllocInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
 
         int32 mipLevels = 1;
 
         // image info
         VkImage                         image = VK_NULL_HANDLE;
         VkDeviceMemory                  imageMemory = VK_NULL_HANDLE;
+        VulkanResourceAllocation*       imageAllocation = nullptr;
         VkImageView                     imageView = VK_NULL_HANDLE;
         VkSampler                       imageSampler = VK_NULL_HANDLE;
         VkDescriptorImageInfo           descriptorInfo = {};
@@ -524,11 +946,15 @@ namespace vk_demo
 
         // bind image buffer
         vkGetImageMemoryRequirements(device, image, &memReqs);
-        vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex);
-        memAllocInfo.allocationSize  = memReqs.size;
-        memAllocInfo.memoryTypeIndex = memoryTypeIndex;
-        VERIFYVULKANRESULT(vkAllocateMemory(device, &memAllocInfo, VULKAN_CPU_ALLOCATOR, &imageMemory));
-        VERIFYVULKANRESULT(vkBindImageMemory(device, image, imageMemory, 0));
+        imageAllocation = vulkanDevice->GetResourceHeapManager().AllocateImageMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, __FILE__, __LINE__);
+        if (imageAllocation == nullptr)
+        {
+            vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+            return nullptr;
+        }
+        imageAllocation->AddRef();
+        imageAllocation->BindImage(vulkanDevice.get(), image);
+        imageMemory = imageAllocation->GetHandle();
 
         VkSamplerCreateInfo samplerInfo;
         ZeroVulkanStruct(samplerInfo, VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO);
@@ -592,8 +1018,11 @@ namespace vk_demo
         texture->image          = image;
         texture->imageLayout    = GetImageLayout(imageLayout);
         texture->imageMemory    = imageMemory;
+        texture->allocation     = imageAllocation;
         texture->imageSampler   = imageSampler;
         texture->imageView      = imageView;
+        texture->imageCreateInfo = imageCreateInfo;
+        texture->viewCreateInfo  = viewInfo;
         texture->device         = device;
         texture->mipLevels      = mipLevels;
         texture->layerCount     = 1;
@@ -635,77 +1064,47 @@ namespace vk_demo
 
     DVKTexture* DVKTexture::CreateCube(const std::vector<std::string> filenames, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, ImageLayoutBarrier imageLayout)
     {
-        struct ImageInfo
-        {
-            int32   width  = 0;
-            int32   height = 0;
-            int32   comp   = 0;
-            uint8*  data   = nullptr;
-            uint32  size   = 0;
-        };
+        int32 width      = 0;
+        int32 height     = 0;
+        uint64 layerSize = 0;
 
-        // 加载图集数据
-        std::vector<ImageInfo> images(filenames.size());
-        for (int32 i = 0; i < filenames.size(); ++i)
+        // 准备stagingBuffer，图层并行解码后直接写入
+        DVKBuffer* stagingBuffer = nullptr;
+        bool decoded = DecodeLayers(filenames, true, [&](uint64 size) -> uint8*
         {
-            uint32 dataSize = 0;
-            uint8* dataPtr  = nullptr;
-            if (!FileManager::ReadFile(filenames[i], dataPtr, dataSize))
-            {
-                MLOGE("Failed load image : %s", filenames[i].c_str());
-                return nullptr;
-            }
-
-            ImageInfo& imageInfo = images[i];
-            imageInfo.data = (uint8*)StbImage::LoadFloatFromMemory(dataPtr, dataSize, &imageInfo.width, &imageInfo.height, &imageInfo.comp, 4);
-            imageInfo.comp = 4;
-            imageInfo.size = imageInfo.width * imageInfo.height * imageInfo.comp * 4;
-
-            delete[] dataPtr;
-            dataPtr = nullptr;
+            stagingBuffer = DVKBuffer::CreateBuffer(
+                vulkanDevice,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                size
+            );
+            stagingBuffer->Map();
+            return (uint8*)stagingBuffer->mapped;
+        }, width, height, layerSize);
+
+        if (stagingBuffer)
+        {
+            stagingBuffer->UnMap();
+        }
 
-            if (!imageInfo.data)
-            {
-                MLOGE("Failed load image : %s", filenames[i].c_str());
-                return nullptr;
-            }
+        if (!decoded)
+        {
+            delete stagingBuffer;
+            return nullptr;
         }
 
         // 图片信息，TextureArray要求尺寸一致
-        int32 width     = images[0].width;
-        int32 height    = images[0].height;
-        int32 numArray  = (int32)images.size();
+        int32 numArray  = (int32)filenames.size();
         VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
         int32 mipLevels = MMath::FloorToInt(MMath::Log2((float)MMath::Max(width, height))) + 1;
         VkDevice device = vulkanDevice->GetInstanceHandle();
 
-        uint32 memoryTypeIndex = 0;
         VkMemoryRequirements memReqs = {};
-        VkMemoryAllocateInfo memAllocInfo;
-        ZeroVulkanStruct(memAllocInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
-
-        // 准备stagingBuffer
-        DVKBuffer* stagingBuffer = DVKBuffer::CreateBuffer(
-            vulkanDevice,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            images[0].size * 6
-        );
-
-        for (int32 i = 0; i < images.size(); ++i)
-        {
-            uint8* src  = images[i].data;
-            uint32 size = images[i].size;
-            stagingBuffer->Map(size, size * i);
-            stagingBuffer->CopyFrom(src, size);
-            stagingBuffer->UnMap();
-
-            StbImage::Free(src);
-        }
 
         // image info
         VkImage                image = VK_NULL_HANDLE;
         VkDeviceMemory         imageMemory = VK_NULL_HANDLE;
+        VulkanResourceAllocation* imageAllocation = nullptr;
         VkImageView            imageView = VK_NULL_HANDLE;
         VkSampler              imageSampler = VK_NULL_HANDLE;
         VkDescriptorImageInfo  descriptorInfo = {};
@@ -728,11 +1127,16 @@ namespace vk_demo
 
         // bind image buffer
         vkGetImageMemoryRequirements(device, image, &memReqs);
-        vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex);
-        memAllocInfo.allocationSize  = memReqs.size;
-        memAllocInfo.memoryTypeIndex = memoryTypeIndex;
-        VERIFYVULKANRESULT(vkAllocateMemory(device, &memAllocInfo, VULKAN_CPU_ALLOCATOR, &imageMemory));
-        VERIFYVULKANRESULT(vkBindImageMemory(device, image, imageMemory, 0));
+        imageAllocation = vulkanDevice->GetResourceHeapManager().AllocateImageMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, __FILE__, __LINE__);
+        if (imageAllocation == nullptr)
+        {
+            delete stagingBuffer;
+            vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+            return nullptr;
+        }
+        imageAllocation->AddRef();
+        imageAllocation->BindImage(vulkanDevice.get(), image);
+        imageMemory = imageAllocation->GetHandle();
 
         // start record
         cmdBuffer->Begin();
@@ -747,7 +1151,7 @@ namespace vk_demo
         ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, subresourceRange);
 
         std::vector<VkBufferImageCopy> bufferCopyRegions;
-        for (int32 i = 0; i < images.size(); ++i)
+        for (int32 i = 0; i < numArray; ++i)
         {
             VkBufferImageCopy bufferCopyRegion = {};
             bufferCopyRegion.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -757,7 +1161,7 @@ namespace vk_demo
             bufferCopyRegion.imageExtent.width  = width;
             bufferCopyRegion.imageExtent.height = height;
             bufferCopyRegion.imageExtent.depth  = 1;
-            bufferCopyRegion.bufferOffset       = images[0].size * i;
+            bufferCopyRegion.bufferOffset       = layerSize * i;
             bufferCopyRegions.push_back(bufferCopyRegion);
         }
 
@@ -848,8 +1252,11 @@ namespace vk_demo
         texture->image          = image;
         texture->imageLayout    = GetImageLayout(imageLayout);
         texture->imageMemory    = imageMemory;
+        texture->allocation     = imageAllocation;
         texture->imageSampler   = imageSampler;
         texture->imageView      = imageView;
+        texture->imageCreateInfo = imageCreateInfo;
+        texture->viewCreateInfo  = viewInfo;
         texture->device         = device;
         texture->width          = width;
         texture->mipLevels      = mipLevels;
@@ -858,79 +1265,54 @@ namespace vk_demo
         return texture;
     }
 
+    DVKTexture* DVKTexture::CreateCube(const std::vector<std::string> filenames, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, ImageLayoutBarrier imageLayout)
+    {
+        return CreateLayeredAsync(filenames, true, vulkanDevice, uploader, imageLayout);
+    }
+
     DVKTexture* DVKTexture::Create2DArray(const std::vector<std::string> filenames, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, ImageLayoutBarrier imageLayout)
     {
-        struct ImageInfo
-        {
-            int32   width  = 0;
-            int32   height = 0;
-            int32   comp   = 0;
-            uint8*  data   = nullptr;
-            uint32  size   = 0;
-        };
+        int32 width      = 0;
+        int32 height     = 0;
+        uint64 layerSize = 0;
 
-        // 加载图集数据
-        std::vector<ImageInfo> images(filenames.size());
-        for (int32 i = 0; i < filenames.size(); ++i)
+        // 准备stagingBuffer，图层并行解码后直接写入
+        DVKBuffer* stagingBuffer = nullptr;
+        bool decoded = DecodeLayers(filenames, false, [&](uint64 size) -> uint8*
         {
-            uint32 dataSize = 0;
-            uint8* dataPtr  = nullptr;
-            if (!FileManager::ReadFile(filenames[i], dataPtr, dataSize))
-            {
-                MLOGE("Failed load image : %s", filenames[i].c_str());
-                return nullptr;
-            }
-
-            ImageInfo& imageInfo = images[i];
-            imageInfo.data = StbImage::LoadFromMemory(dataPtr, dataSize, &imageInfo.width, &imageInfo.height, &imageInfo.comp, 4);
-            imageInfo.comp = 4;
-            imageInfo.size = imageInfo.width * imageInfo.height * imageInfo.comp;
-
-            delete[] dataPtr;
-            dataPtr = nullptr;
+            stagingBuffer = DVKBuffer::CreateBuffer(
+                vulkanDevice,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                size
+            );
+            stagingBuffer->Map();
+            return (uint8*)stagingBuffer->mapped;
+        }, width, height, layerSize);
+
+        if (stagingBuffer)
+        {
+            stagingBuffer->UnMap();
+        }
 
-            if (!imageInfo.data)
-            {
-                MLOGE("Failed load image : %s", filenames[i].c_str());
-                return nullptr;
-            }
+        if (!decoded)
+        {
+            delete stagingBuffer;
+            return nullptr;
         }
 
         // 图片信息，TextureArray要求尺寸一致
-        int32 width     = images[0].width;
-        int32 height    = images[0].height;
-        int32 numArray  = (int32)images.size();
+        int32 numArray  = (int32)filenames.size();
         VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
         int32 mipLevels = MMath::FloorToInt(MMath::Log2((float)MMath::Max(width, height))) + 1;
         VkDevice device = vulkanDevice->GetInstanceHandle();
 
-        uint32 memoryTypeIndex = 0;
         VkMemoryRequirements memReqs = {};
-        VkMemoryAllocateInfo memAllocInfo;
-        ZeroVulkanStruct(memAllocInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
-
-        // 准备stagingBuffer
-        DVKBuffer* stagingBuffer = DVKBuffer::CreateBuffer(
-            vulkanDevice,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            width * height * 4 * numArray
-        );
-
-        for (int32 i = 0; i < images.size(); ++i)
-        {
-            uint8* src  = images[i].data;
-            uint32 size = width * height * 4;
-            stagingBuffer->Map(size, size * i);
-            stagingBuffer->CopyFrom(src, size);
-            stagingBuffer->UnMap();
-
-            StbImage::Free(src);
-        }
 
         // image info
         VkImage                image = VK_NULL_HANDLE;
         VkDeviceMemory         imageMemory = VK_NULL_HANDLE;
+        VulkanResourceAllocation* imageAllocation = nullptr;
         VkImageView            imageView = VK_NULL_HANDLE;
         VkSampler              imageSampler = VK_NULL_HANDLE;
         VkDescriptorImageInfo  descriptorInfo = {};
@@ -952,11 +1334,16 @@ namespace vk_demo
 
         // bind image buffer
         vkGetImageMemoryRequirements(device, image, &memReqs);
-        vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex);
-        memAllocInfo.allocationSize  = memReqs.size;
-        memAllocInfo.memoryTypeIndex = memoryTypeIndex;
-        VERIFYVULKANRESULT(vkAllocateMemory(device, &memAllocInfo, VULKAN_CPU_ALLOCATOR, &imageMemory));
-        VERIFYVULKANRESULT(vkBindImageMemory(device, image, imageMemory, 0));
+        imageAllocation = vulkanDevice->GetResourceHeapManager().AllocateImageMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, __FILE__, __LINE__);
+        if (imageAllocation == nullptr)
+        {
+            delete stagingBuffer;
+            vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+            return nullptr;
+        }
+        imageAllocation->AddRef();
+        imageAllocation->BindImage(vulkanDevice.get(), image);
+        imageMemory = imageAllocation->GetHandle();
 
         // start record
         cmdBuffer->Begin();
@@ -971,7 +1358,7 @@ namespace vk_demo
         ImagePipelineBarrier(cmdBuffer->cmdBuffer, image, ImageLayoutBarrier::Undefined, ImageLayoutBarrier::TransferDest, subresourceRange);
 
         std::vector<VkBufferImageCopy> bufferCopyRegions;
-        for (int32 i = 0; i < images.size(); ++i)
+        for (int32 i = 0; i < numArray; ++i)
         {
             VkBufferImageCopy bufferCopyRegion = {};
             bufferCopyRegion.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -981,7 +1368,7 @@ namespace vk_demo
             bufferCopyRegion.imageExtent.width  = width;
             bufferCopyRegion.imageExtent.height = height;
             bufferCopyRegion.imageExtent.depth  = 1;
-            bufferCopyRegion.bufferOffset       = width * height * 4 * i;
+            bufferCopyRegion.bufferOffset       = layerSize * i;
             bufferCopyRegions.push_back(bufferCopyRegion);
         }
 
@@ -1072,8 +1459,11 @@ namespace vk_demo
         texture->image          = image;
         texture->imageLayout    = GetImageLayout(imageLayout);
         texture->imageMemory    = imageMemory;
+        texture->allocation     = imageAllocation;
         texture->imageSampler   = imageSampler;
         texture->imageView      = imageView;
+        texture->imageCreateInfo = imageCreateInfo;
+        texture->viewCreateInfo  = viewInfo;
         texture->device         = device;
         texture->width          = width;
         texture->mipLevels      = mipLevels;
@@ -1082,6 +1472,11 @@ namespace vk_demo
         return texture;
     }
 
+    DVKTexture* DVKTexture::Create2DArray(const std::vector<std::string> filenames, std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, ImageLayoutBarrier imageLayout)
+    {
+        return CreateLayeredAsync(filenames, false, vulkanDevice, uploader, imageLayout);
+    }
+
     DVKTexture* DVKTexture::Create3D(VkFormat format, const uint8* rgbaData, int32 size, int32 width, int32 height, int32 depth, std::shared_ptr<VulkanDevice> vulkanDevice, DVKCommandBuffer* cmdBuffer, ImageLayoutBarrier imageLayout)
     {
         VkDevice device = vulkanDevice->GetInstanceHandle();
@@ -1091,14 +1486,12 @@ namespace vk_demo
         stagingBuffer->CopyFrom((void*)rgbaData, size);
         stagingBuffer->UnMap();
 
-        uint32 memoryTypeIndex = 0;
         VkMemoryRequirements memReqs = {};
-        VkMemoryAllocateInfo memAllocInfo;
-        ZeroVulkanStruct(memAllocInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
 
         // image info
         VkImage                         image = VK_NULL_HANDLE;
         VkDeviceMemory                  imageMemory = VK_NULL_HANDLE;
+        VulkanResourceAllocation*       imageAllocation = nullptr;
         VkImageView                     imageView = VK_NULL_HANDLE;
         VkSampler                       imageSampler = VK_NULL_HANDLE;
         VkDescriptorImageInfo           descriptorInfo = {};
@@ -1122,11 +1515,16 @@ namespace vk_demo
 
         // bind image buffer
         vkGetImageMemoryRequirements(device, image, &memReqs);
-        vulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex);
-        memAllocInfo.allocationSize  = memReqs.size;
-        memAllocInfo.memoryTypeIndex = memoryTypeIndex;
-        VERIFYVULKANRESULT(vkAllocateMemory(device, &memAllocInfo, VULKAN_CPU_ALLOCATOR, &imageMemory));
-        VERIFYVULKANRESULT(vkBindImageMemory(device, image, imageMemory, 0));
+        imageAllocation = vulkanDevice->GetResourceHeapManager().AllocateImageMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, __FILE__, __LINE__);
+        if (imageAllocation == nullptr)
+        {
+            delete stagingBuffer;
+            vkDestroyImage(device, image, VULKAN_CPU_ALLOCATOR);
+            return nullptr;
+        }
+        imageAllocation->AddRef();
+        imageAllocation->BindImage(vulkanDevice.get(), image);
+        imageMemory = imageAllocation->GetHandle();
 
         cmdBuffer->Begin();
 
@@ -1207,8 +1605,11 @@ namespace vk_demo
         texture->image          = image;
         texture->imageLayout    = GetImageLayout(imageLayout);
         texture->imageMemory    = imageMemory;
+        texture->allocation     = imageAllocation;
         texture->imageSampler   = imageSampler;
         texture->imageView      = imageView;
+        texture->imageCreateInfo = imageCreateInfo;
+        texture->viewCreateInfo  = viewInfo;
         texture->device         = device;
         texture->mipLevels      = 1;
         texture->layerCount     = 1;
@@ -1216,4 +1617,175 @@ namespace vk_demo
         return texture;
     }
 
+    bool DVKTexture::SetMovable(bool movable)
+    {
+        if (allocation == nullptr)
+        {
+            return false;
+        }
+
+        if (!movable)
+        {
+            allocation->SetMover(nullptr);
+            return true;
+        }
+
+        if (imageCreateInfo.sType != VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO || (imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) == 0)
+        {
+            return false;
+        }
+
+        allocation->SetMover(this);
+        return true;
+    }
+
+    bool DVKTexture::BeginMove(VkCommandBuffer cmdBuffer, VulkanResourceAllocation* newAllocation)
+    {
+        // 上一次搬迁的旧image还没有释放
+        if (moveImage != VK_NULL_HANDLE || retiredImage != VK_NULL_HANDLE)
+        {
+            return false;
+        }
+
+        VkImageCreateInfo createInfo = imageCreateInfo;
+        createInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        if (vkCreateImage(device, &createInfo, VULKAN_CPU_ALLOCATOR, &moveImage) != VK_SUCCESS)
+        {
+            moveImage = VK_NULL_HANDLE;
+            return false;
+        }
+
+        VkMemoryRequirements memReqs = {};
+        vkGetImageMemoryRequirements(device, moveImage, &memReqs);
+        if (memReqs.size > newAllocation->GetSize() || newAllocation->GetOffset() % memReqs.alignment != 0 || vkBindImageMemory(device, moveImage, newAllocation->GetHandle(), newAllocation->GetOffset()) != VK_SUCCESS)
+        {
+            vkDestroyImage(device, moveImage, VULKAN_CPU_ALLOCATOR);
+            moveImage = VK_NULL_HANDLE;
+            return false;
+        }
+
+        VkImageViewCreateInfo viewInfo = viewCreateInfo;
+        viewInfo.image = moveImage;
+        if (vkCreateImageView(device, &viewInfo, VULKAN_CPU_ALLOCATOR, &moveImageView) != VK_SUCCESS)
+        {
+            vkDestroyImage(device, moveImage, VULKAN_CPU_ALLOCATOR);
+            moveImage     = VK_NULL_HANDLE;
+            moveImageView = VK_NULL_HANDLE;
+            return false;
+        }
+
+        // 内容未定义的attachment不需要拷贝
+        if (imageLayout == VK_IMAGE_LAYOUT_UNDEFINED)
+        {
+            return true;
+        }
+
+        VkImageSubresourceRange subresourceRange = {};
+        subresourceRange.aspectMask     = viewCreateInfo.subresourceRange.aspectMask;
+        subresourceRange.baseMipLevel   = 0;
+        subresourceRange.levelCount     = imageCreateInfo.mipLevels;
+        subresourceRange.baseArrayLayer = 0;
+        subresourceRange.layerCount     = imageCreateInfo.arrayLayers;
+
+        VkImageMemoryBarrier barriers[2];
+        ZeroVulkanStruct(barriers[0], VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER);
+        barriers[0].srcAccessMask       = VK_ACCESS_MEMORY_WRITE_BIT;
+        barriers[0].dstAccessMask       = VK_ACCESS_TRANSFER_READ_BIT;
+        barriers[0].oldLayout           = imageLayout;
+        barriers[0].newLayout           = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].image               = image;
+        barriers[0].subresourceRange    = subresourceRange;
+
+        barriers[1]                     = barriers[0];
+        barriers[1].srcAccessMask       = 0;
+        barriers[1].dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[1].oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[1].image               = moveImage;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+        std::vector<VkImageCopy> regions(imageCreateInfo.mipLevels);
+        for (uint32 mip = 0; mip < imageCreateInfo.mipLevels; ++mip)
+        {
+            VkImageCopy& region = regions[mip];
+            region = {};
+            region.srcSubresource.aspectMask     = subresourceRange.aspectMask;
+            region.srcSubresource.mipLevel       = mip;
+            region.srcSubresource.baseArrayLayer = 0;
+            region.srcSubresource.layerCount     = imageCreateInfo.arrayLayers;
+            region.dstSubresource                = region.srcSubresource;
+            region.extent.width  = MMath::Max(imageCreateInfo.extent.width  >> mip, 1u);
+            region.extent.height = MMath::Max(imageCreateInfo.extent.height >> mip, 1u);
+            region.extent.depth  = MMath::Max(imageCreateInfo.extent.depth  >> mip, 1u);
+        }
+        vkCmdCopyImage(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, moveImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32)regions.size(), regions.data());
+
+        // 旧image在切换之前仍然可能被之后提交的帧使用，恢复原来的layout
+        barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        barriers[0].oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barriers[0].newLayout     = imageLayout;
+        barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        barriers[1].oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[1].newLayout     = imageLayout;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+        return true;
+    }
+
+    void DVKTexture::CommitMove(VulkanResourceAllocation* newAllocation)
+    {
+        newAllocation->AddRef();
+
+        retiredImage      = image;
+        retiredImageView  = imageView;
+        retiredAllocation = allocation;
+
+        image         = moveImage;
+        imageView     = moveImageView;
+        moveImage     = VK_NULL_HANDLE;
+        moveImageView = VK_NULL_HANDLE;
+        allocation    = newAllocation;
+        imageMemory   = newAllocation->GetHandle();
+        descriptorInfo.imageView = imageView;
+
+        if (onMoved)
+        {
+            onMoved(this);
+        }
+    }
+
+    void DVKTexture::FinishMove(VulkanResourceAllocation* oldAllocation)
+    {
+        if (retiredAllocation == oldAllocation)
+        {
+            ReleaseRetired();
+        }
+    }
+
+    void DVKTexture::ReleaseRetired()
+    {
+        if (retiredImageView != VK_NULL_HANDLE)
+        {
+            vkDestroyImageView(device, retiredImageView, VULKAN_CPU_ALLOCATOR);
+            retiredImageView = VK_NULL_HANDLE;
+        }
+
+        if (retiredImage != VK_NULL_HANDLE)
+        {
+            vkDestroyImage(device, retiredImage, VULKAN_CPU_ALLOCATOR);
+            retiredImage = VK_NULL_HANDLE;
+        }
+
+        if (retiredAllocation != nullptr)
+        {
+            retiredAllocation->SetMover(nullptr);
+            retiredAllocation->Release();
+            retiredAllocation = nullptr;
+        }
+    }
+
 }
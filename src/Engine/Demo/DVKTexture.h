@@ -1,16 +1,19 @@
 #pragma once
 #include "Engine.h"
 #include "DVKCommand.h"
+#include "DVKUploadQueue.h"
 #include "Common/Common.h"
 #include "Math/Math.h"
 #include "Vulkan/VulkanCommon.h"
+#include "Vulkan/VulkanMemory.h"
 #include "vulkan/vulkan_core.h"
 
 #include<vector>
+#include<functional>
 
 namespace vk_demo 
 {
-    class DVKTexture
+    class DVKTexture : public VulkanResourceMover
     {
         public:
         DVKTexture()
@@ -19,6 +22,21 @@ namespace vk_demo
         }
         ~DVKTexture()
         {
+            // 碎片整理过程中被销毁，新旧两份资源都要清理
+            if (moveImageView != VK_NULL_HANDLE)
+            {
+                vkDestroyImageView(device, moveImageView, VULKAN_CPU_ALLOCATOR);
+                moveImageView = VK_NULL_HANDLE;
+            }
+
+            if (moveImage != VK_NULL_HANDLE)
+            {
+                vkDestroyImage(device, moveImage, VULKAN_CPU_ALLOCATOR);
+                moveImage = VK_NULL_HANDLE;
+            }
+
+            ReleaseRetired();
+
             if (imageView != VK_NULL_HANDLE)
             {
                 vkDestroyImageView(device, imageView, VULKAN_CPU_ALLOCATOR);
@@ -37,6 +55,14 @@ namespace vk_demo
                 imageSampler = VK_NULL_HANDLE;
             }
 
+            if (allocation != nullptr)
+            {
+                allocation->SetMover(nullptr);
+                allocation->Release();
+                allocation  = nullptr;
+                imageMemory = VK_NULL_HANDLE;
+            }
+
             if (imageMemory != VK_NULL_HANDLE)
             {
                 vkFreeMemory(device, imageMemory, VULKAN_CPU_ALLOCATOR);
@@ -74,6 +100,27 @@ namespace vk_demo
             ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
         );
 
+        // 通过uploader异步上传，mipmap在uploader的graphics command buffer中生成，Flush之后才可使用
+        static DVKTexture* Create2D(
+            const uint8* rgbaData,
+            uint32 size,
+            VkFormat format,
+            int32 width,
+            int32 height,
+            std::shared_ptr<VulkanDevice> vulkanDevice,
+            DVKUploadQueue* uploader,
+            VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
+        );
+
+        static DVKTexture* Create2D(
+            const std::string& filename,
+            std::shared_ptr<VulkanDevice> vulkanDevice,
+            DVKUploadQueue* uploader,
+            VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
+        );
+
         static DVKTexture* CreateAttachment(
             std::shared_ptr<VulkanDevice> vulkanDevice,
             VkFormat format,
@@ -125,6 +172,14 @@ namespace vk_demo
             ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
         );
 
+        // 各面在线程池中并行解码并直接写入uploader的staging，Flush之后才可使用
+        static DVKTexture* CreateCube(
+            const std::vector<std::string> filenames,
+            std::shared_ptr<VulkanDevice> vulkanDevice,
+            DVKUploadQueue* uploader,
+            ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
+        );
+
         static DVKTexture* CreateCubeRenderTarget(
             std::shared_ptr<VulkanDevice> vulkanDevice,
             VkFormat format,
@@ -142,6 +197,13 @@ namespace vk_demo
             ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
         );
 
+        static DVKTexture* Create2DArray(
+            const std::vector<std::string> filenames,
+            std::shared_ptr<VulkanDevice> vulkanDevice,
+            DVKUploadQueue* uploader,
+            ImageLayoutBarrier imageLayout = ImageLayoutBarrier::PixelShaderRead
+        );
+
         static DVKTexture* Create2DArray(
             std::shared_ptr<VulkanDevice> vulkanDevice,
             DVKCommandBuffer* cmdBuffer,
@@ -168,12 +230,25 @@ namespace vk_demo
         );
 
 
+        // 允许碎片整理移动该texture，image需要带TRANSFER_SRC
+        bool SetMovable(bool movable);
+
+        virtual bool BeginMove(VkCommandBuffer cmdBuffer, VulkanResourceAllocation* newAllocation) override;
+
+        virtual void CommitMove(VulkanResourceAllocation* newAllocation) override;
+
+        virtual void FinishMove(VulkanResourceAllocation* oldAllocation) override;
+
+    private:
+        void ReleaseRetired();
+
        public:
     VkDevice                        device = nullptr;
 
         VkImage                         image = VK_NULL_HANDLE;
         VkImageLayout                   imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         VkDeviceMemory                  imageMemory = VK_NULL_HANDLE;
+        VulkanResourceAllocation*       allocation = nullptr;
         VkImageView                     imageView = VK_NULL_HANDLE;
         VkSampler                       imageSampler = VK_NULL_HANDLE;
         VkDescriptorImageInfo           descriptorInfo;
@@ -187,5 +262,18 @@ namespace vk_demo
         VkFormat                        format = VK_FORMAT_R8G8B8A8_UNORM;
 
         bool                            isCubeMap = false;
+
+        // 创建时的参数，碎片整理时按原样重建image与view
+        VkImageCreateInfo               imageCreateInfo = {};
+        VkImageViewCreateInfo           viewCreateInfo = {};
+
+        // 碎片整理把image搬到新的位置后回调，引用旧imageView的descriptor与framebuffer需要在这里更新
+        std::function<void(DVKTexture*)> onMoved;
+
+        VkImage                         moveImage = VK_NULL_HANDLE;
+        VkImageView                     moveImageView = VK_NULL_HANDLE;
+        VkImage                         retiredImage = VK_NULL_HANDLE;
+        VkImageView                     retiredImageView = VK_NULL_HANDLE;
+        VulkanResourceAllocation*       retiredAllocation = nullptr;
     };
 }
\ No newline at end of file
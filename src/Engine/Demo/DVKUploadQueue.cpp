@@ -0,0 +1,459 @@
+#include "DVKUploadQueue.h"
+
+#include "Common/Log.h"
+#include "Math/Math.h"
+#include "Utils/Alignment.h"
+#include "Vulkan/VulkanDevice.h"
+#include "Vulkan/VulkanQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vk_demo
+{
+    DVKUploadQueue::~DVKUploadQueue()
+    {
+        WaitIdle();
+
+        for (int32 i = 0; i < batches.size(); ++i)
+        {
+            vkDestroyFence(device, batches[i].fence, VULKAN_CPU_ALLOCATOR);
+            vkDestroySemaphore(device, batches[i].semaphore, VULKAN_CPU_ALLOCATOR);
+        }
+        batches.clear();
+
+        if (transferPool != VK_NULL_HANDLE && transferPool != graphicsPool)
+        {
+            vkDestroyCommandPool(device, transferPool, VULKAN_CPU_ALLOCATOR);
+        }
+        if (graphicsPool != VK_NULL_HANDLE)
+        {
+            vkDestroyCommandPool(device, graphicsPool, VULKAN_CPU_ALLOCATOR);
+        }
+        transferPool = VK_NULL_HANDLE;
+        graphicsPool = VK_NULL_HANDLE;
+
+        if (ringBuffer)
+        {
+            delete ringBuffer;
+            ringBuffer = nullptr;
+        }
+        ringData     = nullptr;
+        vulkanDevice = nullptr;
+    }
+
+    DVKUploadQueue* DVKUploadQueue::Create(std::shared_ptr<VulkanDevice> vulkanDevice, VkDeviceSize stagingSize, int32 numBatches)
+    {
+        DVKUploadQueue* uploader = new DVKUploadQueue();
+        uploader->vulkanDevice   = vulkanDevice;
+        uploader->device         = vulkanDevice->GetInstanceHandle();
+        uploader->graphicsQueue  = vulkanDevice->GetGraphicsQueue()->GetHandle();
+        uploader->graphicsFamily = vulkanDevice->GetGraphicsQueue()->GetFamilyIndex();
+        uploader->transferQueue  = vulkanDevice->GetTransferQueue()->GetHandle();
+        uploader->transferFamily = vulkanDevice->GetTransferQueue()->GetFamilyIndex();
+
+        VkCommandPoolCreateInfo poolCreateInfo;
+        ZeroVulkanStruct(poolCreateInfo, VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO);
+        poolCreateInfo.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolCreateInfo.queueFamilyIndex = uploader->graphicsFamily;
+        VERIFYVULKANRESULT(vkCreateCommandPool(uploader->device, &poolCreateInfo, VULKAN_CPU_ALLOCATOR, &uploader->graphicsPool));
+
+        uploader->transferPool = uploader->graphicsPool;
+        if (uploader->HasTransferQueue())
+        {
+            poolCreateInfo.queueFamilyIndex = uploader->transferFamily;
+            VERIFYVULKANRESULT(vkCreateCommandPool(uploader->device, &poolCreateInfo, VULKAN_CPU_ALLOCATOR, &uploader->transferPool));
+        }
+
+        // 至少两个batch，保证提交一个的同时还能录制下一个
+        uploader->batches.resize(MMath::Max(numBatches, 2));
+        for (int32 i = 0; i < uploader->batches.size(); ++i)
+        {
+            Batch& batch = uploader->batches[i];
+
+            VkCommandBufferAllocateInfo allocateInfo;
+            ZeroVulkanStruct(allocateInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO);
+            allocateInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocateInfo.commandBufferCount = 1;
+            allocateInfo.commandPool        = uploader->graphicsPool;
+            VERIFYVULKANRESULT(vkAllocateCommandBuffers(uploader->device, &allocateInfo, &batch.graphicsCmd));
+
+            if (uploader->HasTransferQueue())
+            {
+                allocateInfo.commandPool = uploader->transferPool;
+                VERIFYVULKANRESULT(vkAllocateCommandBuffers(uploader->device, &allocateInfo, &batch.transferCmd));
+            }
+            else
+            {
+                batch.transferCmd = batch.graphicsCmd;
+            }
+
+            VkFenceCreateInfo fenceCreateInfo;
+            ZeroVulkanStruct(fenceCreateInfo, VK_STRUCTURE_TYPE_FENCE_CREATE_INFO);
+            VERIFYVULKANRESULT(vkCreateFence(uploader->device, &fenceCreateInfo, VULKAN_CPU_ALLOCATOR, &batch.fence));
+
+            VkSemaphoreCreateInfo semaphoreCreateInfo;
+            ZeroVulkanStruct(semaphoreCreateInfo, VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO);
+            VERIFYVULKANRESULT(vkCreateSemaphore(uploader->device, &semaphoreCreateInfo, VULKAN_CPU_ALLOCATOR, &batch.semaphore));
+        }
+
+        uploader->ringBuffer = DVKBuffer::CreateBuffer(
+            vulkanDevice,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            stagingSize
+        );
+        uploader->ringBuffer->Map();
+        uploader->ringData = (uint8*)uploader->ringBuffer->mapped;
+        uploader->ringSize = stagingSize;
+
+        return uploader;
+    }
+
+    DVKUploadQueue::Batch& DVKUploadQueue::BeginBatch()
+    {
+        Batch& batch = batches[currentTicket % batches.size()];
+        if (batch.recording)
+        {
+            return batch;
+        }
+
+        // 复用slot之前，上一次使用它的batch必须已经完成
+        if (currentTicket > batches.size())
+        {
+            RetireBatches(currentTicket - batches.size(), true);
+        }
+
+        VkCommandBufferBeginInfo beginInfo;
+        ZeroVulkanStruct(beginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VERIFYVULKANRESULT(vkBeginCommandBuffer(batch.graphicsCmd, &beginInfo));
+        if (HasTransferQueue())
+        {
+            VERIFYVULKANRESULT(vkBeginCommandBuffer(batch.transferCmd, &beginInfo));
+        }
+
+        batch.ticket    = currentTicket;
+        batch.recording = true;
+        batch.ringBytes = 0;
+        return batch;
+    }
+
+    void DVKUploadQueue::RetireBatches(uint64 ticket, bool wait)
+    {
+        // batch按ticket顺序提交，也按顺序回收，ring空间才能连续释放
+        while (completedTicket < ticket && completedTicket + 1 < currentTicket)
+        {
+            Batch& batch = batches[(completedTicket + 1) % batches.size()];
+            if (wait)
+            {
+                VkResult status = vkGetFenceStatus(device, batch.fence);
+                if (status != VK_SUCCESS)
+                {
+                    numStalls += 1;
+                    VERIFYVULKANRESULT(vkWaitForFences(device, 1, &batch.fence, VK_TRUE, MAX_uint64));
+                }
+            }
+            else if (vkGetFenceStatus(device, batch.fence) != VK_SUCCESS)
+            {
+                break;
+            }
+
+            ringUsed -= batch.ringBytes;
+            batch.ringBytes = 0;
+
+            for (int32 i = 0; i < batch.tempBuffers.size(); ++i)
+            {
+                delete batch.tempBuffers[i];
+            }
+            batch.tempBuffers.clear();
+
+            completedTicket += 1;
+        }
+
+        if (ringUsed == 0)
+        {
+            ringHead = 0;
+        }
+    }
+
+    uint8* DVKUploadQueue::AllocateStaging(VkDeviceSize size, VkDeviceSize alignment, VkBuffer& outBuffer, VkDeviceSize& outOffset)
+    {
+        // 超过ring大小的数据单独创建staging，随batch一起回收
+        if (size > ringSize)
+        {
+            Batch& batch = BeginBatch();
+            DVKBuffer* staging = DVKBuffer::CreateBuffer(vulkanDevice, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size);
+            staging->Map();
+            batch.tempBuffers.push_back(staging);
+            outBuffer = staging->buffer;
+            outOffset = 0;
+            return (uint8*)staging->mapped;
+        }
+
+        while (true)
+        {
+            Batch& batch = BeginBatch();
+
+            VkDeviceSize offset   = AlignArbitrary(ringHead, alignment);
+            VkDeviceSize consumed = offset - ringHead + size;
+            if (offset + size > ringSize)
+            {
+                // 尾部放不下，跳过剩余部分回到开头
+                offset   = 0;
+                consumed = ringSize - ringHead + size;
+            }
+
+            if (ringUsed + consumed <= ringSize)
+            {
+                ringHead        = offset + size;
+                ringUsed       += consumed;
+                batch.ringBytes += consumed;
+                outBuffer = ringBuffer->buffer;
+                outOffset = offset;
+                return ringData + offset;
+            }
+
+            // ring已满：提交当前batch，再等待最早的batch释放空间
+            if (batch.ringBytes > 0 || batch.bufferCopies.size() > 0)
+            {
+                Flush();
+            }
+            RetireBatches(completedTicket + 1, true);
+        }
+
+        return nullptr;
+    }
+
+    uint64 DVKUploadQueue::UploadBuffer(DVKBuffer* dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset)
+    {
+        VkBuffer srcBuffer    = VK_NULL_HANDLE;
+        VkDeviceSize srcOffset = 0;
+        uint8* staging = AllocateStaging(size, 16, srcBuffer, srcOffset);
+        memcpy(staging, data, size);
+
+        BufferCopy bufferCopy;
+        bufferCopy.srcBuffer        = srcBuffer;
+        bufferCopy.dstBuffer        = dstBuffer->buffer;
+        bufferCopy.region.srcOffset = srcOffset;
+        bufferCopy.region.dstOffset = dstOffset;
+        bufferCopy.region.size      = size;
+
+        Batch& batch = BeginBatch();
+        batch.bufferCopies.push_back(bufferCopy);
+
+        numUploads += 1;
+        numBytes   += size;
+
+        return batch.ticket;
+    }
+
+    VkCommandBuffer DVKUploadQueue::UploadImage(VkImage image, const VkImageSubresourceRange& subresourceRange, VkBuffer srcBuffer, const std::vector<VkBufferImageCopy>& regions)
+    {
+        Batch& batch = BeginBatch();
+
+        VkImageMemoryBarrier imageBarrier;
+        ZeroVulkanStruct(imageBarrier, VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER);
+        imageBarrier.image               = image;
+        imageBarrier.subresourceRange    = subresourceRange;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageBarrier.newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        imageBarrier.srcAccessMask       = 0;
+        imageBarrier.dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(batch.transferCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+        vkCmdCopyBufferToImage(batch.transferCmd, srcBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32)regions.size(), regions.data());
+
+        if (HasTransferQueue())
+        {
+            // release：transfer queue -> graphics queue，layout保持不变
+            imageBarrier.oldLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            imageBarrier.newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            imageBarrier.srcQueueFamilyIndex = transferFamily;
+            imageBarrier.dstQueueFamilyIndex = graphicsFamily;
+            imageBarrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+            imageBarrier.dstAccessMask       = 0;
+            vkCmdPipelineBarrier(batch.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+            // acquire：graphics queue在semaphore之后接管
+            imageBarrier.srcAccessMask = 0;
+            imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(batch.graphicsCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+        }
+
+        numUploads += 1;
+        numCopies  += (uint32)regions.size();
+
+        return batch.graphicsCmd;
+    }
+
+    void DVKUploadQueue::RecordBufferCopies(Batch& batch)
+    {
+        if (batch.bufferCopies.size() == 0)
+        {
+            return;
+        }
+
+        std::sort(batch.bufferCopies.begin(), batch.bufferCopies.end(), [](const BufferCopy& a, const BufferCopy& b) {
+            if (a.dstBuffer != b.dstBuffer) {
+                return a.dstBuffer < b.dstBuffer;
+            }
+            if (a.srcBuffer != b.srcBuffer) {
+                return a.srcBuffer < b.srcBuffer;
+            }
+            return a.region.dstOffset < b.region.dstOffset;
+        });
+
+        std::vector<VkBufferCopy>           regions;
+        std::vector<VkBufferMemoryBarrier>  barriers;
+
+        for (int32 i = 0; i < batch.bufferCopies.size(); )
+        {
+            VkBuffer srcBuffer = batch.bufferCopies[i].srcBuffer;
+            VkBuffer dstBuffer = batch.bufferCopies[i].dstBuffer;
+
+            // 源和目标都连续的region合并成一个
+            regions.clear();
+            for (; i < batch.bufferCopies.size() && batch.bufferCopies[i].srcBuffer == srcBuffer && batch.bufferCopies[i].dstBuffer == dstBuffer; ++i)
+            {
+                const VkBufferCopy& region = batch.bufferCopies[i].region;
+                if (regions.size() > 0)
+                {
+                    VkBufferCopy& last = regions.back();
+                    if (last.srcOffset + last.size == region.srcOffset && last.dstOffset + last.size == region.dstOffset)
+                    {
+                        last.size += region.size;
+                        continue;
+                    }
+                }
+                regions.push_back(region);
+            }
+
+            vkCmdCopyBuffer(batch.transferCmd, srcBuffer, dstBuffer, (uint32)regions.size(), regions.data());
+            numCopies += (uint32)regions.size();
+
+            if (barriers.size() == 0 || barriers.back().buffer != dstBuffer)
+            {
+                VkBufferMemoryBarrier bufferBarrier;
+                ZeroVulkanStruct(bufferBarrier, VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER);
+                bufferBarrier.buffer              = dstBuffer;
+                bufferBarrier.offset              = 0;
+                bufferBarrier.size                = VK_WHOLE_SIZE;
+                bufferBarrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+                bufferBarrier.dstAccessMask       = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+                bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barriers.push_back(bufferBarrier);
+            }
+        }
+
+        if (HasTransferQueue())
+        {
+            for (int32 i = 0; i < barriers.size(); ++i)
+            {
+                barriers[i].srcQueueFamilyIndex = transferFamily;
+                barriers[i].dstQueueFamilyIndex = graphicsFamily;
+                barriers[i].dstAccessMask       = 0;
+            }
+            vkCmdPipelineBarrier(batch.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, (uint32)barriers.size(), barriers.data(), 0, nullptr);
+
+            for (int32 i = 0; i < barriers.size(); ++i)
+            {
+                barriers[i].srcAccessMask = 0;
+                barriers[i].dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+            }
+            vkCmdPipelineBarrier(batch.graphicsCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, (uint32)barriers.size(), barriers.data(), 0, nullptr);
+        }
+        else
+        {
+            vkCmdPipelineBarrier(batch.graphicsCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, (uint32)barriers.size(), barriers.data(), 0, nullptr);
+        }
+
+        batch.bufferCopies.clear();
+    }
+
+    uint64 DVKUploadQueue::Flush()
+    {
+        Batch& batch = batches[currentTicket % batches.size()];
+        if (!batch.recording)
+        {
+            return currentTicket - 1;
+        }
+
+        RecordBufferCopies(batch);
+
+        VERIFYVULKANRESULT(vkResetFences(device, 1, &batch.fence));
+
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+        VkSubmitInfo submitInfo;
+        ZeroVulkanStruct(submitInfo, VK_STRUCTURE_TYPE_SUBMIT_INFO);
+        submitInfo.commandBufferCount = 1;
+
+        if (HasTransferQueue())
+        {
+            VERIFYVULKANRESULT(vkEndCommandBuffer(batch.transferCmd));
+            submitInfo.pCommandBuffers      = &batch.transferCmd;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores    = &batch.semaphore;
+            VERIFYVULKANRESULT(vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE));
+
+            submitInfo.signalSemaphoreCount = 0;
+            submitInfo.pSignalSemaphores    = nullptr;
+            submitInfo.waitSemaphoreCount   = 1;
+            submitInfo.pWaitSemaphores      = &batch.semaphore;
+            submitInfo.pWaitDstStageMask    = &waitStage;
+        }
+
+        VERIFYVULKANRESULT(vkEndCommandBuffer(batch.graphicsCmd));
+        submitInfo.pCommandBuffers = &batch.graphicsCmd;
+        VERIFYVULKANRESULT(vkQueueSubmit(graphicsQueue, 1, &submitInfo, batch.fence));
+
+        batch.recording = false;
+        numSubmits     += 1;
+        currentTicket  += 1;
+
+        return batch.ticket;
+    }
+
+    bool DVKUploadQueue::IsComplete(uint64 ticket)
+    {
+        if (ticket >= currentTicket)
+        {
+            return false;
+        }
+        RetireBatches(ticket, false);
+        return completedTicket >= ticket;
+    }
+
+    void DVKUploadQueue::Wait(uint64 ticket)
+    {
+        if (ticket >= currentTicket)
+        {
+            Flush();
+        }
+        RetireBatches(ticket, true);
+    }
+
+    void DVKUploadQueue::WaitIdle()
+    {
+        Flush();
+        RetireBatches(currentTicket - 1, true);
+    }
+
+    VkFence DVKUploadQueue::GetFence(uint64 ticket)
+    {
+        if (ticket <= completedTicket || ticket >= currentTicket)
+        {
+            return VK_NULL_HANDLE;
+        }
+        return batches[ticket % batches.size()].fence;
+    }
+
+    void DVKUploadQueue::PrintStats()
+    {
+        MLOG("Upload queue stats : %d uploads, %.2f MB, %d copy regions, %d submits, %d stalls, %s", numUploads, (float)((double)numBytes / 1024.0 / 1024.0), numCopies, numSubmits, numStalls, HasTransferQueue() ? "transfer queue" : "graphics queue");
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "Engine.h"
+#include "DVKBuffer.h"
+
+#include "Common/Common.h"
+#include "Vulkan/VulkanCommon.h"
+#include "vulkan/vulkan_core.h"
+
+#include <vector>
+#include <memory>
+
+class VulkanDevice;
+
+namespace vk_demo
+{
+    // 批量异步上传：数据先写入环形staging buffer，Flush时一次提交。
+    // 有独立transfer queue时拷贝在transfer queue上执行，再通过queue ownership transfer交给graphics queue。
+    class DVKUploadQueue
+    {
+    private:
+        struct BufferCopy
+        {
+            VkBuffer        srcBuffer;
+            VkBuffer        dstBuffer;
+            VkBufferCopy    region;
+        };
+
+        struct Batch
+        {
+            VkCommandBuffer             transferCmd = VK_NULL_HANDLE;
+            VkCommandBuffer             graphicsCmd = VK_NULL_HANDLE;
+            VkFence                     fence = VK_NULL_HANDLE;
+            VkSemaphore                 semaphore = VK_NULL_HANDLE;
+            uint64                      ticket = 0;
+            bool                        recording = false;
+            VkDeviceSize                ringBytes = 0;
+            std::vector<BufferCopy>     bufferCopies;
+            std::vector<DVKBuffer*>     tempBuffers;
+        };
+
+        DVKUploadQueue()
+        {
+
+        }
+
+    public:
+        ~DVKUploadQueue();
+
+        static DVKUploadQueue* Create(std::shared_ptr<VulkanDevice> vulkanDevice, VkDeviceSize stagingSize = 32 * 1024 * 1024, int32 numBatches = 3);
+
+        // 在staging中分配一段可写内存，必须在下一次Flush之前写完
+        uint8* AllocateStaging(VkDeviceSize size, VkDeviceSize alignment, VkBuffer& outBuffer, VkDeviceSize& outOffset);
+
+        // 同一batch内的拷贝在Flush时按目标buffer合并成一次vkCmdCopyBuffer
+        uint64 UploadBuffer(DVKBuffer* dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+
+        // image从Undefined转到TransferDest并拷贝regions(srcBuffer来自AllocateStaging)。
+        // 返回graphics queue上的command buffer，此时image已归graphics queue所有且处于TRANSFER_DST_OPTIMAL，
+        // 调用者继续录制mipmap生成与最终layout转换。
+        VkCommandBuffer UploadImage(VkImage image, const VkImageSubresourceRange& subresourceRange, VkBuffer srcBuffer, const std::vector<VkBufferImageCopy>& regions);
+
+        uint64 Flush();
+
+        bool IsComplete(uint64 ticket);
+
+        void Wait(uint64 ticket);
+
+        void WaitIdle();
+
+        // ticket对应batch的fence，batch未提交或已回收时返回VK_NULL_HANDLE
+        VkFence GetFence(uint64 ticket);
+
+        void PrintStats();
+
+        FORCE_INLINE uint64 GetCurrentTicket() const
+        {
+            return currentTicket;
+        }
+
+        FORCE_INLINE bool HasTransferQueue() const
+        {
+            return transferFamily != graphicsFamily;
+        }
+
+    private:
+        Batch& BeginBatch();
+
+        void RetireBatches(uint64 ticket, bool wait);
+
+        void RecordBufferCopies(Batch& batch);
+
+    public:
+        std::shared_ptr<VulkanDevice>   vulkanDevice = nullptr;
+        VkDevice                        device = VK_NULL_HANDLE;
+
+        VkQueue                         transferQueue = VK_NULL_HANDLE;
+        VkQueue                         graphicsQueue = VK_NULL_HANDLE;
+        uint32                          transferFamily = 0;
+        uint32                          graphicsFamily = 0;
+        VkCommandPool                   transferPool = VK_NULL_HANDLE;
+        VkCommandPool                   graphicsPool = VK_NULL_HANDLE;
+
+        DVKBuffer*                      ringBuffer = nullptr;
+        uint8*                          ringData = nullptr;
+        VkDeviceSize                    ringSize = 0;
+        VkDeviceSize                    ringHead = 0;
+        VkDeviceSize                    ringUsed = 0;
+
+        std::vector<Batch>              batches;
+        uint64                          currentTicket = 1;
+        uint64                          completedTicket = 0;
+
+        uint64                          numBytes = 0;
+        uint32                          numUploads = 0;
+        uint32                          numCopies = 0;
+        uint32                          numSubmits = 0;
+        uint32                          numStalls = 0;
+    };
+}
@@ -21,7 +21,7 @@ namespace vk_demo
 
         vertexBuffer->dvkBuffer = vk_demo::DVKBuffer::CreateBuffer(
             vulkanDevice,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
             vertices.size() * sizeof(float)
         );
@@ -40,6 +40,30 @@ namespace vk_demo
         return vertexBuffer;
     }
 
+    DVKVertexBuffer* DVKVertexBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const std::vector<float>& vertices, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization)
+    {
+        return Create(vulkanDevice, uploader, vertices.data(), (int32)vertices.size(), attributes, quantization);
+    }
+
+    DVKVertexBuffer* DVKVertexBuffer::Create(std::shared_ptr<VulkanDevice> vulkanDevice, DVKUploadQueue* uploader, const float* vertices, int32 count, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization)
+    {
+        DVKVertexBuffer* vertexBuffer = new DVKVertexBuffer();
+        vertexBuffer->device       = vulkanDevice->GetInstanceHandle();
+        vertexBuffer->attributes   = attributes;
+        vertexBuffer->quantization = quantization;
+
+        vertexBuffer->dvkBuffer = vk_demo::DVKBuffer::CreateBuffer(
+            vulkanDevice,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            count * sizeof(float)
+        );
+
+        uploader->UploadBuffer(vertexBuffer->dvkBuffer, vertices, count * sizeof(float));
+
+        return vertexBuffer;
+    }
+
     std::vector<VkVertexInputAttributeDescription> DVKVertexBuffer::GetInputAttributes(const std::vector<VertexAttribute>& shaderInputs)
     {
         std::vector<VkVertexInputAttributeDescription> vertexInputAttributs;
@@ -49,9 +73,9 @@ namespace vk_demo
             VkVertexInputAttributeDescription inputAttribute = {};
             inputAttribute.binding  = 0;
             inputAttribute.location = i;
-            inputAttribute.format   = VertexAttributeToVkFormat(shaderInputs[i]);
+            inputAttribute.format   = VertexAttributeToVkFormat(shaderInputs[i], quantization);
             inputAttribute.offset   = offset;
-            offset += VertexAttributeToSize(shaderInputs[i]);
+            offset += VertexAttributeToSize(shaderInputs[i], quantization);
             vertexInputAttributs.push_back(inputAttribute);
         }
         return vertexInputAttributs;
@@ -62,7 +86,7 @@ namespace vk_demo
         int32 stride = 0;
         for (int32 i = 0; i < attributes.size(); ++i)
         {
-            stride += VertexAttributeToSize(attributes[i]);
+            stride += VertexAttributeToSize(attributes[i], quantization);
         }
 
         VkVertexInputBindingDescription vertexInputBinding = {};
@@ -3,6 +3,7 @@
 #include "Engine.h"
 #include "DVKCommand.h"
 #include "DVKBuffer.h"
+#include "DVKUploadQueue.h"
 
 #include "Common/Common.h"
 #include "Math/Math.h"
@@ -151,6 +152,123 @@ namespace vk_demo
         return format;
     }
 
+    // 默认的float格式，与VertexAttributeToSize/VertexAttributeToVkFormat一致
+    FORCE_INLINE VertexElementType VertexAttributeToElementType(VertexAttribute attribute)
+    {
+        if (attribute == VertexAttribute::VA_UV0 ||
+            attribute == VertexAttribute::VA_UV1 ||
+            attribute == VertexAttribute::VA_InstanceFloat2
+        )
+        {
+            return VET_Float2;
+        }
+        else if (attribute == VertexAttribute::VA_Position ||
+                 attribute == VertexAttribute::VA_Normal ||
+                 attribute == VertexAttribute::VA_Color ||
+                 attribute == VertexAttribute::VA_SkinPack ||
+                 attribute == VertexAttribute::VA_InstanceFloat3
+        )
+        {
+            return VET_Float3;
+        }
+        else if (attribute == VertexAttribute::VA_InstanceFloat1)
+        {
+            return VET_Float1;
+        }
+        else if (attribute == VertexAttribute::VA_None)
+        {
+            return VET_None;
+        }
+
+        return VET_Float4;
+    }
+
+    // 每个attribute在顶点中的存储格式，VET_None表示默认的float格式。
+    // 导入时支持的压缩格式，shader中的声明需要与之对应：
+    // Position   : VET_Half4 相对包围盒中心，VET_Short4N 按包围盒归一化，都需要先乘DVKMesh::GetDequantizeMatrix()
+    // Normal     : VET_Short2N 八面体编码，shader中声明为vec2
+    // Tangent    : VET_URGB10A2N xy为八面体编码，w为副切线方向，都映射到[0, 1]
+    // UV0/UV1    : VET_Half2
+    // Color      : VET_UByte4N
+    // SkinIndex  : VET_UByte4，shader中声明为uvec4
+    // SkinWeight : VET_UShort4N
+    // SkinPack   : VET_UInt3，shader中声明为uvec3
+    struct DVKVertexQuantization
+    {
+        uint8   types[VertexAttribute::VA_Count] = {};
+
+        DVKVertexQuantization& Set(VertexAttribute attribute, VertexElementType type)
+        {
+            types[attribute] = (uint8)type;
+            return *this;
+        }
+
+        FORCE_INLINE VertexElementType GetElementType(VertexAttribute attribute) const
+        {
+            return types[attribute] != VET_None ? (VertexElementType)types[attribute] : VertexAttributeToElementType(attribute);
+        }
+
+        FORCE_INLINE bool IsQuantized(VertexAttribute attribute) const
+        {
+            return types[attribute] != VET_None && types[attribute] != VertexAttributeToElementType(attribute);
+        }
+
+        bool IsQuantized() const
+        {
+            for (int32 i = 0; i < VertexAttribute::VA_Count; ++i)
+            {
+                if (IsQuantized((VertexAttribute)i))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool operator==(const DVKVertexQuantization& other) const
+        {
+            for (int32 i = 0; i < VertexAttribute::VA_Count; ++i)
+            {
+                if (GetElementType((VertexAttribute)i) != other.GetElementType((VertexAttribute)i))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool operator!=(const DVKVertexQuantization& other) const
+        {
+            return !(*this == other);
+        }
+
+        // 所有支持的attribute都压缩，位置使用snorm16
+        static DVKVertexQuantization Compact()
+        {
+            DVKVertexQuantization quantization;
+            quantization.Set(VertexAttribute::VA_Position,   VET_Short4N);
+            quantization.Set(VertexAttribute::VA_Normal,     VET_Short2N);
+            quantization.Set(VertexAttribute::VA_Tangent,    VET_URGB10A2N);
+            quantization.Set(VertexAttribute::VA_UV0,        VET_Half2);
+            quantization.Set(VertexAttribute::VA_UV1,        VET_Half2);
+            quantization.Set(VertexAttribute::VA_Color,      VET_UByte4N);
+            quantization.Set(VertexAttribute::VA_SkinIndex,  VET_UByte4);
+            quantization.Set(VertexAttribute::VA_SkinWeight, VET_UShort4N);
+            quantization.Set(VertexAttribute::VA_SkinPack,   VET_UInt3);
+            return quantization;
+        }
+    };
+
+    FORCE_INLINE int32 VertexAttributeToSize(VertexAttribute attribute, const DVKVertexQuantization& quantization)
+    {
+        return (int32)ElementTypeToSize(quantization.GetElementType(attribute));
+    }
+
+    FORCE_INLINE VkFormat VertexAttributeToVkFormat(VertexAttribute attribute, const DVKVertexQuantization& quantization)
+    {
+        return VEToVkFormat(quantization.GetElementType(attribute));
+    }
+
     class DVKVertexBuffer
     {
     private:
@@ -180,11 +298,18 @@ namespace vk_demo
 
         static DVKVertexBuffer* Create(std::shared_ptr<VulkanDevice> device, DVKCommandBuffer* cmdBuffer, std::vector<float> vertices, const std::vector<VertexAttribute>& attributes);
 
+        // 拷贝记录到uploader的当前batch，不等待完成；使用前需Flush/Wait对应ticket
+        static DVKVertexBuffer* Create(std::shared_ptr<VulkanDevice> device, DVKUploadQueue* uploader, const std::vector<float>& vertices, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization = DVKVertexQuantization());
+
+        // vertices按4字节计数，压缩格式的顶点同样以float数组存放
+        static DVKVertexBuffer* Create(std::shared_ptr<VulkanDevice> device, DVKUploadQueue* uploader, const float* vertices, int32 count, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization = DVKVertexQuantization());
+
     public:
         VkDevice                        device = VK_NULL_HANDLE;
         DVKBuffer*                      dvkBuffer = nullptr;
         VkDeviceSize                    offset = 0;
         std::vector<VertexAttribute>    attributes;
+        DVKVertexQuantization           quantization;
     };
 
 }
@@ -0,0 +1,338 @@
+#include "DVKVertexQuantizer.h"
+
+#include "Common/Log.h"
+#include "Math/Math.h"
+
+#include <cstring>
+
+namespace vk_demo
+{
+    static FORCE_INLINE int16 FloatToSNorm16(float value)
+    {
+        return (int16)MMath::RoundToInt(MMath::Clamp(value, -1.0f, 1.0f) * 32767.0f);
+    }
+
+    static FORCE_INLINE uint32 FloatToUNorm(float value, uint32 maxValue)
+    {
+        return (uint32)MMath::RoundToInt(MMath::Clamp(value, 0.0f, 1.0f) * maxValue);
+    }
+
+    bool DVKVertexQuantizer::IsSupported(VertexAttribute attribute, VertexElementType type)
+    {
+        if (type == VET_None || type == VertexAttributeToElementType(attribute))
+        {
+            return true;
+        }
+
+        switch (attribute)
+        {
+        case VertexAttribute::VA_Position:
+            return type == VET_Half4 || type == VET_Short4N;
+        case VertexAttribute::VA_Normal:
+            return type == VET_Short2N;
+        case VertexAttribute::VA_Tangent:
+            return type == VET_URGB10A2N;
+        case VertexAttribute::VA_UV0:
+        case VertexAttribute::VA_UV1:
+            return type == VET_Half2;
+        case VertexAttribute::VA_Color:
+            return type == VET_UByte4N;
+        case VertexAttribute::VA_SkinIndex:
+            return type == VET_UByte4;
+        case VertexAttribute::VA_SkinWeight:
+            return type == VET_UShort4N;
+        case VertexAttribute::VA_SkinPack:
+            return type == VET_UInt3;
+        default:
+            break;
+        }
+
+        return false;
+    }
+
+    DVKVertexQuantization DVKVertexQuantizer::Validate(const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization)
+    {
+        DVKVertexQuantization result;
+        for (int32 i = 0; i < attributes.size(); ++i)
+        {
+            VertexAttribute attribute = attributes[i];
+            VertexElementType type    = quantization.GetElementType(attribute);
+            if (IsSupported(attribute, type))
+            {
+                result.Set(attribute, type);
+            }
+            else
+            {
+                MLOGE("Vertex quantization not supported : attribute %d, type %d.", (int32)attribute, (int32)type);
+            }
+        }
+        return result;
+    }
+
+    void DVKVertexQuantizer::GetPositionTransform(VertexElementType type, const Vector3& boundsMin, const Vector3& boundsMax, Vector3& outOffset, Vector3& outScale)
+    {
+        outOffset = Vector3::ZeroVector;
+        outScale  = Vector3::OneVector;
+
+        if (type != VET_Half4 && type != VET_Short4N)
+        {
+            return;
+        }
+
+        // half保存相对中心的坐标，snorm16再按半边长归一化
+        outOffset = (boundsMin + boundsMax) * 0.5f;
+        if (type == VET_Short4N)
+        {
+            Vector3 extent = (boundsMax - boundsMin) * 0.5f;
+            outScale.x = extent.x > SMALL_NUMBER ? extent.x : 1.0f;
+            outScale.y = extent.y > SMALL_NUMBER ? extent.y : 1.0f;
+            outScale.z = extent.z > SMALL_NUMBER ? extent.z : 1.0f;
+        }
+    }
+
+    void DVKVertexQuantizer::Quantize(std::vector<float>& vertices, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization, const Vector3& boundsMin, const Vector3& boundsMax)
+    {
+        int32 srcStride = 0;
+        int32 dstStride = 0;
+        for (int32 i = 0; i < attributes.size(); ++i)
+        {
+            srcStride += VertexAttributeToSize(attributes[i]) / sizeof(float);
+            dstStride += VertexAttributeToSize(attributes[i], quantization) / sizeof(float);
+        }
+
+        if (srcStride == 0 || vertices.size() == 0 || !quantization.IsQuantized())
+        {
+            return;
+        }
+
+        Vector3 positionOffset;
+        Vector3 positionScale;
+        GetPositionTransform(quantization.GetElementType(VertexAttribute::VA_Position), boundsMin, boundsMax, positionOffset, positionScale);
+        Vector3 positionInvScale(1.0f / positionScale.x, 1.0f / positionScale.y, 1.0f / positionScale.z);
+
+        int32 vertexCount = (int32)vertices.size() / srcStride;
+        std::vector<float> result(vertexCount * dstStride);
+
+        bool indexOverflow = false;
+        for (int32 i = 0; i < vertexCount; ++i)
+        {
+            const float* src = vertices.data() + i * srcStride;
+            uint8* dst = (uint8*)(result.data() + i * dstStride);
+
+            for (int32 j = 0; j < attributes.size(); ++j)
+            {
+                VertexAttribute attribute = attributes[j];
+                VertexElementType type    = quantization.GetElementType(attribute);
+                int32 srcCount = VertexAttributeToSize(attribute) / sizeof(float);
+                int32 dstSize  = VertexAttributeToSize(attribute, quantization);
+
+                if (!quantization.IsQuantized(attribute) || (attribute == VertexAttribute::VA_SkinPack && type == VET_UInt3))
+                {
+                    memcpy(dst, src, dstSize);
+                }
+                else if (attribute == VertexAttribute::VA_Position)
+                {
+                    Vector3 position = (Vector3(src[0], src[1], src[2]) - positionOffset) * positionInvScale;
+                    if (type == VET_Short4N)
+                    {
+                        int16 packed[4] = { FloatToSNorm16(position.x), FloatToSNorm16(position.y), FloatToSNorm16(position.z), 32767 };
+                        memcpy(dst, packed, sizeof(packed));
+                    }
+                    else
+                    {
+                        uint16 packed[4] = { FloatToHalf(position.x), FloatToHalf(position.y), FloatToHalf(position.z), FloatToHalf(1.0f) };
+                        memcpy(dst, packed, sizeof(packed));
+                    }
+                }
+                else if (attribute == VertexAttribute::VA_Normal)
+                {
+                    float x = 0.0f;
+                    float y = 0.0f;
+                    EncodeOctahedral(Vector3(src[0], src[1], src[2]), x, y);
+                    int16 packed[2] = { FloatToSNorm16(x), FloatToSNorm16(y) };
+                    memcpy(dst, packed, sizeof(packed));
+                }
+                else if (attribute == VertexAttribute::VA_Tangent)
+                {
+                    // A2B10G10R10：r、g为八面体编码，a为副切线方向
+                    float x = 0.0f;
+                    float y = 0.0f;
+                    EncodeOctahedral(Vector3(src[0], src[1], src[2]), x, y);
+                    uint32 packed = FloatToUNorm(x * 0.5f + 0.5f, 1023) | (FloatToUNorm(y * 0.5f + 0.5f, 1023) << 10) | ((src[3] < 0.0f ? 0u : 3u) << 30);
+                    memcpy(dst, &packed, sizeof(packed));
+                }
+                else if (attribute == VertexAttribute::VA_UV0 || attribute == VertexAttribute::VA_UV1)
+                {
+                    uint16 packed[2] = { FloatToHalf(src[0]), FloatToHalf(src[1]) };
+                    memcpy(dst, packed, sizeof(packed));
+                }
+                else if (attribute == VertexAttribute::VA_Color)
+                {
+                    uint8 packed[4] = { (uint8)FloatToUNorm(src[0], 255), (uint8)FloatToUNorm(src[1], 255), (uint8)FloatToUNorm(src[2], 255), 255 };
+                    memcpy(dst, packed, sizeof(packed));
+                }
+                else if (attribute == VertexAttribute::VA_SkinIndex)
+                {
+                    uint8 packed[4];
+                    for (int32 k = 0; k < 4; ++k)
+                    {
+                        int32 index   = (int32)src[k];
+                        indexOverflow = indexOverflow || index > 255;
+                        packed[k]     = (uint8)MMath::Clamp(index, 0, 255);
+                    }
+                    memcpy(dst, packed, sizeof(packed));
+                }
+                else if (attribute == VertexAttribute::VA_SkinWeight)
+                {
+                    uint16 packed[4];
+                    for (int32 k = 0; k < 4; ++k)
+                    {
+                        packed[k] = (uint16)FloatToUNorm(src[k], 65535);
+                    }
+                    memcpy(dst, packed, sizeof(packed));
+                }
+
+                src += srcCount;
+                dst += dstSize;
+            }
+        }
+
+        if (indexOverflow)
+        {
+            MLOGE("Vertex quantization : skin index exceeds 255, use float skin indices for this mesh.");
+        }
+
+        vertices = std::move(result);
+    }
+
+    uint16 DVKVertexQuantizer::FloatToHalf(float value)
+    {
+        uint32 bits = 0;
+        memcpy(&bits, &value, sizeof(float));
+
+        uint32 sign     = (bits >> 16) & 0x8000;
+        uint32 exponent = (bits >> 23) & 0xFF;
+        uint32 mantissa = bits & 0x7FFFFF;
+
+        // NaN/Inf
+        if (exponent == 0xFF)
+        {
+            return (uint16)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+        }
+
+        int32 halfExponent = (int32)exponent - 127 + 15;
+
+        // 顶点数据不需要Inf，超出范围时取最大值
+        if (halfExponent >= 31)
+        {
+            return (uint16)(sign | 0x7BFF);
+        }
+
+        // 非规格化数，就近舍入到偶数
+        if (halfExponent <= 0)
+        {
+            if (halfExponent < -10)
+            {
+                return (uint16)sign;
+            }
+            mantissa |= 0x800000;
+            uint32 shift     = (uint32)(14 - halfExponent);
+            uint32 half      = mantissa >> shift;
+            uint32 remainder = mantissa & ((1u << shift) - 1);
+            uint32 halfway   = 1u << (shift - 1);
+            if (remainder > halfway || (remainder == halfway && (half & 1)))
+            {
+                half += 1;
+            }
+            return (uint16)(sign | half);
+        }
+
+        uint32 half      = ((uint32)halfExponent << 10) | (mantissa >> 13);
+        uint32 remainder = mantissa & 0x1FFF;
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        {
+            half += 1;
+        }
+        if (half >= 0x7C00)
+        {
+            half = 0x7BFF;
+        }
+        return (uint16)(sign | half);
+    }
+
+    float DVKVertexQuantizer::HalfToFloat(uint16 value)
+    {
+        uint32 sign     = (uint32)(value & 0x8000) << 16;
+        uint32 exponent = (value >> 10) & 0x1F;
+        uint32 mantissa = value & 0x3FF;
+
+        uint32 bits = 0;
+        if (exponent == 0x1F)
+        {
+            bits = sign | 0x7F800000 | (mantissa << 13);
+        }
+        else if (exponent != 0)
+        {
+            bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        }
+        else if (mantissa != 0)
+        {
+            // 非规格化数转为规格化的float
+            exponent = 127 - 15 + 1;
+            while ((mantissa & 0x400) == 0)
+            {
+                mantissa <<= 1;
+                exponent  -= 1;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+        }
+        else
+        {
+            bits = sign;
+        }
+
+        float result = 0.0f;
+        memcpy(&result, &bits, sizeof(float));
+        return result;
+    }
+
+    void DVKVertexQuantizer::EncodeOctahedral(const Vector3& normal, float& outX, float& outY)
+    {
+        float length = MMath::Abs(normal.x) + MMath::Abs(normal.y) + MMath::Abs(normal.z);
+        if (length < SMALL_NUMBER)
+        {
+            outX = 0.0f;
+            outY = 0.0f;
+            return;
+        }
+
+        float x = normal.x / length;
+        float y = normal.y / length;
+
+        // 下半球沿对角线折叠到外侧
+        if (normal.z < 0.0f)
+        {
+            float foldX = (1.0f - MMath::Abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float foldY = (1.0f - MMath::Abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = foldX;
+            y = foldY;
+        }
+
+        outX = x;
+        outY = y;
+    }
+
+    Vector3 DVKVertexQuantizer::DecodeOctahedral(float x, float y)
+    {
+        Vector3 normal(x, y, 1.0f - MMath::Abs(x) - MMath::Abs(y));
+        if (normal.z < 0.0f)
+        {
+            float foldX = (1.0f - MMath::Abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float foldY = (1.0f - MMath::Abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            normal.x = foldX;
+            normal.y = foldY;
+        }
+        normal.Normalize();
+        return normal;
+    }
+}
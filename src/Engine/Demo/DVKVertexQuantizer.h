@@ -0,0 +1,40 @@
+#pragma once
+
+#include "DVKVertexBuffer.h"
+
+#include "Common/Common.h"
+#include "Math/Vector3.h"
+#include "Vulkan/RHIDefinitions.h"
+
+#include <vector>
+
+namespace vk_demo
+{
+    // 导入阶段按DVKVertexQuantization重新打包顶点。压缩后的格式都是4字节的整数倍，
+    // 结果仍存放在float数组中，按4字节计数，后续的拆分、cook与上传不需要区分。
+    class DVKVertexQuantizer
+    {
+    public:
+        // 导入时是否支持把attribute压缩为type
+        static bool IsSupported(VertexAttribute attribute, VertexElementType type);
+
+        // 去掉attributes中不支持的压缩方式，回退为float
+        static DVKVertexQuantization Validate(const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization);
+
+        // 压缩后的顶点坐标到mesh空间：position = encoded * outScale + outOffset
+        static void GetPositionTransform(VertexElementType type, const Vector3& boundsMin, const Vector3& boundsMax, Vector3& outOffset, Vector3& outScale);
+
+        // vertices为按attributes交错的float顶点，原地改写为压缩格式。
+        // SkinPack为VET_UInt3时输入已经是整数的位模式，直接拷贝。
+        static void Quantize(std::vector<float>& vertices, const std::vector<VertexAttribute>& attributes, const DVKVertexQuantization& quantization, const Vector3& boundsMin, const Vector3& boundsMax);
+
+        static uint16 FloatToHalf(float value);
+
+        static float HalfToFloat(uint16 value);
+
+        // 单位向量的八面体编码，结果在[-1, 1]
+        static void EncodeOctahedral(const Vector3& normal, float& outX, float& outY);
+
+        static Vector3 DecodeOctahedral(float x, float y);
+    };
+}
@@ -1,6 +1,17 @@
 #include "DemoBase.h"
 //#include "DVKDefaultRes.h"
 #include "DVKCommand.h"
+#include "DVKDescriptorAllocator.h"
+#include "DVKGPUProfiler.h"
+#include "DVKMaterial.h"
+#include "DVKPipelineCache.h"
+#include "DVKReflectionCache.h"
+#include "DVKUploadQueue.h"
+#include "FileManager.h"
+
+#include "Vulkan/VulkanDefragmenter.h"
+
+#include "Math/Math.h"
 
 void DemoBase::Setup()
 {
@@ -20,29 +31,75 @@ void DemoBase::Setup()
 
 int32 DemoBase::AcquireBackbufferIndex()
 {
+    // 只等待即将复用的帧槽位，其余在途帧继续在GPU上执行
+    VkFence frameFence = m_Fences[m_FrameIndex];
+    vkWaitForFences(m_Device, 1, &frameFence, VK_TRUE, MAX_uint64);
+
+    // 每帧刷新一次显存预算，分配时不再逐次查询
+    m_VulkanDevice->GetMemoryManager().UpdateBudget();
+
+    // 在录制本帧命令之前切换搬迁完成的资源，CPU耗时限制在1ms内
+    if (m_Defragmenter)
+    {
+        m_Defragmenter->Update(0.001, m_DefragBudget);
+    }
+
+    // 该帧槽位上一次分配的临时descriptor set已不再被GPU使用
+    if (m_DescriptorAllocator)
+    {
+        m_DescriptorAllocator->BeginFrame(m_FrameIndex);
+    }
+
+    // 已完成帧中释放的持久descriptor set可以归还pool
+    vk_demo::DVKDescriptorSetPool::BeginFrame(m_FrameIndex);
+
+    // 回收已完成帧在material ring buffer中占用的uniform空间
+    vk_demo::DVKMaterial::BeginRingBufferFrame(m_FrameIndex);
+
     int32 backBufferIndex = m_SwapChain->AcquireImageIndex(&m_PresentComplete);
+    if (backBufferIndex < 0)
+    {
+        return backBufferIndex;
+    }
+
+    // 该image的command buffer可能仍被另一个帧槽位占用
+    VkFence imageFence = m_ImageFences[backBufferIndex];
+    if (imageFence != VK_NULL_HANDLE && imageFence != frameFence)
+    {
+        vkWaitForFences(m_Device, 1, &imageFence, VK_TRUE, MAX_uint64);
+    }
+    m_ImageFences[backBufferIndex] = frameFence;
+
+    // 该image的command buffer上一次提交已完成，读回其中的timestamp
+    if (m_GPUProfiler)
+    {
+        m_GPUProfiler->Readback(backBufferIndex);
+    }
+
     return backBufferIndex;
 }
 
 void DemoBase::Present(int backBufferIndex)
 {
+    VkFence frameFence = m_Fences[m_FrameIndex];
+
     VkSubmitInfo submitInfo = {};
     submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.pWaitDstStageMask    = &m_WaitStageMask;
     submitInfo.pWaitSemaphores      = &m_PresentComplete;
     submitInfo.waitSemaphoreCount   = 1;
-    submitInfo.pSignalSemaphores    = &m_RenderComplete;
+    submitInfo.pSignalSemaphores    = &(m_RenderComplete[m_FrameIndex]);
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pCommandBuffers      = &(m_CommandBuffers[backBufferIndex]);
     submitInfo.commandBufferCount   = 1;
 
-    vkResetFences(m_Device, 1, &(m_Fences[backBufferIndex]));
-
-    VERIFYVULKANRESULT(vkQueueSubmit(m_GfxQueue, 1, &submitInfo, m_Fences[backBufferIndex]));
-    vkWaitForFences(m_Device, 1, &(m_Fences[backBufferIndex]), true, MAX_uint64);
+    vkResetFences(m_Device, 1, &frameFence);
+    VERIFYVULKANRESULT(vkQueueSubmit(m_GfxQueue, 1, &submitInfo, frameFence));
 
     // present
-    m_SwapChain->Present(m_VulkanDevice->GetGraphicsQueue(), m_VulkanDevice->GetPresentQueue(), &m_RenderComplete);
+    m_SwapChain->Present(m_VulkanDevice->GetGraphicsQueue(), m_VulkanDevice->GetPresentQueue(), &(m_RenderComplete[m_FrameIndex]));
+
+    m_FrameIndex = (m_FrameIndex + 1) % m_NumFramesInFlight;
 }
 
 uint32 DemoBase::GetMemoryTypeFromProperties(uint32 typeBits, VkMemoryPropertyFlags properties)
@@ -54,38 +111,145 @@ uint32 DemoBase::GetMemoryTypeFromProperties(uint32 typeBits, VkMemoryPropertyFl
 
 void DemoBase::DestroyPipelineCache()
 {
-    VkDevice device = GetVulkanRHI()->GetDevice()->GetInstanceHandle();
-    vkDestroyPipelineCache(device, m_PipelineCache, VULKAN_CPU_ALLOCATOR);
-    m_PipelineCache = VK_NULL_HANDLE;
+    m_PersistentCache->Save();
+    vk_demo::DVKPipelineCache::PrintStats();
+
+    vk_demo::DVKReflectionCache::Save();
+    vk_demo::DVKReflectionCache::PrintStats();
+
+    delete m_PersistentCache;
+    m_PersistentCache = nullptr;
+    m_PipelineCache   = VK_NULL_HANDLE;
 }
 
 void DemoBase::CreatePipelineCache()
 {
-    VkDevice device = GetVulkanRHI()->GetDevice()->GetInstanceHandle();
+    m_PersistentCache = vk_demo::DVKPipelineCache::Create(GetVulkanRHI()->GetDevice(), GetTitle() + ".pipelinecache");
+    m_PipelineCache   = m_PersistentCache->pipelineCache;
+
+    // 反射结果只与SPIR-V内容有关，所有demo共用一个缓存文件
+    vk_demo::DVKReflectionCache::Load("shaders.reflectioncache");
+}
+
+void DemoBase::CreateDefragmenter()
+{
+    if (m_DefragBudget == 0)
+    {
+        return;
+    }
+
+    // 旧资源要等所有在途帧结束后才能销毁
+    m_Defragmenter = new VulkanResourceDefragmenter(m_VulkanDevice.get(), m_NumFramesInFlight);
+    MLOG("Defragmenter : %.2fMB per frame", (float)((double)m_DefragBudget / 1024.0 / 1024.0));
+}
 
-    VkPipelineCacheCreateInfo createInfo;
-    ZeroVulkanStruct(createInfo, VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO);
-    VERIFYVULKANRESULT(vkCreatePipelineCache(device, &createInfo, VULKAN_CPU_ALLOCATOR, &m_PipelineCache));
+void DemoBase::DestroyDefragmenter()
+{
+    if (m_Defragmenter)
+    {
+        delete m_Defragmenter;
+        m_Defragmenter = nullptr;
+    }
+}
+
+void DemoBase::CreateDescriptorAllocator()
+{
+    m_DescriptorAllocator = vk_demo::DVKDescriptorAllocator::Create(m_VulkanDevice, m_NumFramesInFlight);
+}
+
+void DemoBase::DestroyDescriptorAllocator()
+{
+    if (m_DescriptorAllocator)
+    {
+        m_DescriptorAllocator->PrintStats();
+        delete m_DescriptorAllocator;
+        m_DescriptorAllocator = nullptr;
+    }
+}
+
+void DemoBase::CreateGPUProfiler()
+{
+    m_GPUProfiler = vk_demo::DVKGPUProfiler::Create(m_VulkanDevice, (int32)m_CommandBuffers.size());
+    m_GPUProfiler->SetCapture(m_GPUProfile);
+}
+
+void DemoBase::DestroyGPUProfiler()
+{
+    if (m_GPUProfiler)
+    {
+        if (m_GPUProfile)
+        {
+            m_GPUProfiler->WriteCSV(m_GPUProfilePath.size() > 0 ? m_GPUProfilePath : GetTitle() + ".gpuprofile.csv");
+        }
+        delete m_GPUProfiler;
+        m_GPUProfiler = nullptr;
+    }
+}
+
+void DemoBase::CreateUploader()
+{
+    m_Uploader = vk_demo::DVKUploadQueue::Create(m_VulkanDevice);
+}
+
+void DemoBase::DestroyUploader()
+{
+    if (m_Uploader)
+    {
+        m_Uploader->WaitIdle();
+        m_Uploader->PrintStats();
+        delete m_Uploader;
+        m_Uploader = nullptr;
+    }
+}
+
+void DemoBase::WriteMemoryReport()
+{
+    if (!m_MemoryReport)
+    {
+        return;
+    }
+
+    // 在销毁资源之前输出，记录的是退出时仍然存活的分配以及运行期间的峰值
+    std::string filepath = m_MemoryReportPath.size() > 0 ? m_MemoryReportPath : FileManager::GetFilePath(GetTitle() + ".memory.json");
+    m_VulkanDevice->GetMemoryManager().WriteMemoryReport(filepath);
 }
 
 void DemoBase::CreateFences()
 {
     VkDevice device  = GetVulkanRHI()->GetDevice()->GetInstanceHandle();
-    int32 frameCount = GetVulkanRHI()->GetSwapChain()->GetBackBufferCount();
+    int32 imageCount = GetVulkanRHI()->GetSwapChain()->GetBackBufferCount();
+
+    // swapchain的acquire semaphore按image数量轮转，帧数不能超过image数量。
+    // 没有按帧分片的demo直接覆盖唯一的uniform与预录制的command buffer，只能1帧在途
+    if (m_FrameSliced)
+    {
+        m_NumFramesInFlight = MMath::Clamp(m_NumFramesInFlight, 2, 3);
+        m_NumFramesInFlight = MMath::Min(m_NumFramesInFlight, imageCount);
+    }
+    else
+    {
+        m_NumFramesInFlight = 1;
+    }
+    m_FrameIndex = 0;
 
     VkFenceCreateInfo fenceCreateInfo;
     ZeroVulkanStruct(fenceCreateInfo, VK_STRUCTURE_TYPE_FENCE_CREATE_INFO);
     fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    m_Fences.resize(frameCount);
-    for (int32 i = 0; i < m_Fences.size(); ++i)
+    VkSemaphoreCreateInfo createInfo;
+    ZeroVulkanStruct(createInfo, VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO);
+
+    m_Fences.resize(m_NumFramesInFlight);
+    m_RenderComplete.resize(m_NumFramesInFlight);
+    for (int32 i = 0; i < m_NumFramesInFlight; ++i)
     {
         VERIFYVULKANRESULT(vkCreateFence(device, &fenceCreateInfo, VULKAN_CPU_ALLOCATOR, &m_Fences[i]));
+        VERIFYVULKANRESULT(vkCreateSemaphore(device, &createInfo, VULKAN_CPU_ALLOCATOR, &m_RenderComplete[i]));
     }
 
-    VkSemaphoreCreateInfo createInfo;
-    ZeroVulkanStruct(createInfo, VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO);
-    vkCreateSemaphore(device, &createInfo, VULKAN_CPU_ALLOCATOR, &m_RenderComplete);
+    m_ImageFences.resize(imageCount, VK_NULL_HANDLE);
+
+    MLOG("Frames in flight : %d", m_NumFramesInFlight);
 }
 
 void DemoBase::DestroyFences()
@@ -95,9 +259,12 @@ void DemoBase::DestroyFences()
     for (int32 i = 0; i < m_Fences.size(); ++i)
     {
         vkDestroyFence(device, m_Fences[i], VULKAN_CPU_ALLOCATOR);
+        vkDestroySemaphore(device, m_RenderComplete[i], VULKAN_CPU_ALLOCATOR);
     }
 
-    vkDestroySemaphore(device, m_RenderComplete, VULKAN_CPU_ALLOCATOR);
+    m_Fences.clear();
+    m_RenderComplete.clear();
+    m_ImageFences.clear();
 }
 
 void DemoBase::CreateDefaultRes()
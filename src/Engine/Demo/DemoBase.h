@@ -9,7 +9,20 @@
 #include "Application/GenericWindow.h"
 #include "Application/GenericApplication.h"
 
+#include "DVKMeshOptimizer.h"
+
 #include <string>
+#include <cstdlib>
+
+namespace vk_demo
+{
+    class DVKPipelineCache;
+    class DVKDescriptorAllocator;
+    class DVKGPUProfiler;
+    class DVKUploadQueue;
+}
+
+class VulkanResourceDefragmenter;
 
 class DemoBase:public AppModuleBase
 {
@@ -23,13 +36,63 @@ public:
         , m_FrameWidth(0)
         , m_FrameHeight(0)
         , m_PipelineCache(VK_NULL_HANDLE)
+        , m_PersistentCache(nullptr)
         , m_PresentComplete(VK_NULL_HANDLE)
-        , m_RenderComplete(VK_NULL_HANDLE)
         , m_CommandPool(VK_NULL_HANDLE)
         , m_WaitStageMask(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT)
         , m_SwapChain(VK_NULL_HANDLE)
+        , m_NumFramesInFlight(2)
+        , m_FrameIndex(0)
+        , m_Defragmenter(nullptr)
+        , m_DescriptorAllocator(nullptr)
+        , m_GPUProfiler(nullptr)
+        , m_DefragBudget(0)
+        , m_Uploader(nullptr)
+        , m_MemoryReport(false)
+        , m_GPUProfile(false)
     {
-
+        // -frames=2|3 控制CPU可以领先GPU的帧数，只对m_FrameSliced的demo生效
+        // -defrag[=MB] 开启显存碎片整理，参数为每帧最多拷贝的MB数
+        // -memreport[=path] 退出前把显存用量写成JSON，默认写到<title>.memory.json
+        // -gpuprofile[=file] 记录每帧GPU分段耗时，退出前写成CSV，默认写到<title>.gpuprofile.csv
+        // -meshopt 导入模型时做顶点cache/overdraw重排，默认关闭
+        for (int32 i = 0; i < cmdLine.size(); ++i)
+        {
+            if (cmdLine[i].find("-frames=") == 0)
+            {
+                m_NumFramesInFlight = atoi(cmdLine[i].c_str() + 8);
+            }
+            else if (cmdLine[i].find("-defrag=") == 0)
+            {
+                m_DefragBudget = (uint64)MMath::Max(atoi(cmdLine[i].c_str() + 8), 1) * 1024 * 1024;
+            }
+            else if (cmdLine[i] == "-defrag")
+            {
+                m_DefragBudget = 8 * 1024 * 1024;
+            }
+            else if (cmdLine[i].find("-memreport=") == 0)
+            {
+                m_MemoryReport     = true;
+                m_MemoryReportPath = cmdLine[i].substr(11);
+            }
+            else if (cmdLine[i] == "-memreport")
+            {
+                m_MemoryReport = true;
+            }
+            else if (cmdLine[i].find("-gpuprofile=") == 0)
+            {
+                m_GPUProfile     = true;
+                m_GPUProfilePath = cmdLine[i].substr(12);
+            }
+            else if (cmdLine[i] == "-gpuprofile")
+            {
+                m_GPUProfile = true;
+            }
+            else if (cmdLine[i] == "-meshopt")
+            {
+                vk_demo::DVKMeshOptimizer::enabled = true;
+            }
+        }
     }
 
     virtual ~DemoBase()
@@ -86,10 +149,21 @@ public:
         CreateCommandBuffers();
         CreatePipelineCache();
         CreateDefaultRes();
+        CreateDefragmenter();
+        CreateDescriptorAllocator();
+        CreateGPUProfiler();
+        CreateUploader();
     }
 
     void Release() override
     {
+        // 释放资源前必须等待所有在途帧结束
+        vkDeviceWaitIdle(m_Device);
+        DestroyDefragmenter();
+        DestroyDescriptorAllocator();
+        DestroyGPUProfiler();
+        DestroyUploader();
+        WriteMemoryReport();
         AppModuleBase::Release();
         DestroyDefaultRes();
         DestroyFences();
@@ -103,6 +177,22 @@ public:
 
     uint32 GetMemoryTypeFromProperties(uint32 typeBits, VkMemoryPropertyFlags properties);
 
+    FORCE_INLINE int32 GetFrameIndex() const
+    {
+        return m_FrameIndex;
+    }
+
+    FORCE_INLINE int32 GetNumFramesInFlight() const
+    {
+        return m_NumFramesInFlight;
+    }
+
+    // 当前帧在按帧数复制的uniform buffer中的偏移
+    FORCE_INLINE uint32 GetFrameSliceOffset(uint32 sliceSize) const
+    {
+        return m_FrameIndex * sliceSize;
+    }
+
 private:
 
     void CreateDefaultRes();
@@ -121,7 +211,23 @@ private:
 
     void CreatePipelineCache();
 
+    void CreateDefragmenter();
 
+    void DestroyDefragmenter();
+
+    void WriteMemoryReport();
+
+    void CreateDescriptorAllocator();
+
+    void DestroyDescriptorAllocator();
+
+    void CreateGPUProfiler();
+
+    void DestroyGPUProfiler();
+
+    void CreateUploader();
+
+    void DestroyUploader();
 
 protected:
 
@@ -136,10 +242,12 @@ protected:
     int32                           m_FrameHeight;
 
     VkPipelineCache                 m_PipelineCache;
+    vk_demo::DVKPipelineCache*      m_PersistentCache;
 
     std::vector<VkFence>            m_Fences;
+    std::vector<VkFence>            m_ImageFences;
     VkSemaphore                     m_PresentComplete;
-    VkSemaphore                     m_RenderComplete;
+    std::vector<VkSemaphore>        m_RenderComplete;
 
     VkCommandPool                   m_CommandPool;
     VkCommandPool                   m_ComputeCommandPool;
@@ -149,6 +257,33 @@ protected:
 
     VulkanSwapChainRef              m_SwapChain;
 
+    int32                           m_NumFramesInFlight;
+    int32                           m_FrameIndex;
+
+    VulkanResourceDefragmenter*     m_Defragmenter;
+
+    // 每帧重置的临时descriptor set分配器
+    vk_demo::DVKDescriptorAllocator* m_DescriptorAllocator;
+
+    // 按swapchain image分slot的GPU分段计时，slot与m_CommandBuffers一一对应
+    vk_demo::DVKGPUProfiler*        m_GPUProfiler;
+
+    // 碎片整理每帧最多拷贝的字节数，0表示不整理
+    uint64                          m_DefragBudget;
+
+    // 加载资源共用的上传队列，LoadAssets里的模型、贴图都记录到这里，加载完成后WaitIdle一次
+    vk_demo::DVKUploadQueue*        m_Uploader;
+
+    bool                            m_MemoryReport;
+    std::string                     m_MemoryReportPath;
+
+    bool                            m_GPUProfile;
+    std::string                     m_GPUProfilePath;
+
+    // 派生类的uniform、界面顶点都按GetFrameIndex()分片，且每帧只重新录制获取到的command buffer时(如13、18)，
+    // 在构造函数中设为true才允许多帧在途；否则只保留1帧在途，CPU每帧写入前GPU已经执行完上一帧
+    bool                            m_FrameSliced = false;
+
     int32                           m_FrameCounter = 0;
     float                           m_LastFrameTime = 0.0f;
     int32                           m_LastFPS = 0;
@@ -3,14 +3,25 @@
 #include "Engine.h"
 #include "FileManager.h"
 
-#if PLATFORM_WINDOWS
+#include <cstdio>
 
+#if PLATFORM_WINDOWS
+    #include <windows.h>
 #elif PLATFORM_MAC
-
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
 #elif PLATFORM_IOS
-
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
 #elif PLATFORM_LINUX
-
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
 #elif PLATFORM_ANDROID
     #include "Application/Android/AndroidWindow.h"
 #endif
@@ -64,3 +75,211 @@ bool FileManager::ReadFile(const std::string& filepath, uint8*& dataPtr, uint32&
 
     return true;
 }
+
+bool FileManager::MapFile(const std::string& filepath, MappedFile& outFile)
+{
+    outFile = MappedFile();
+    std::string finalPath = FileManager::GetFilePath(filepath);
+
+#if PLATFORM_WINDOWS
+
+    HANDLE file = CreateFileA(finalPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    // mapping对象会持有文件，文件句柄可以直接关闭
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+    {
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    outFile.data   = (const uint8*)data;
+    outFile.size   = (uint64)fileSize.QuadPart;
+    outFile.handle = mapping;
+
+#elif PLATFORM_MAC || PLATFORM_IOS || PLATFORM_LINUX
+
+    int32 fd = open(finalPath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    outFile.data = (const uint8*)data;
+    outFile.size = (uint64)fileStat.st_size;
+
+#else
+
+    FILE* file = fopen(finalPath.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+    fclose(file);
+
+    uint8* dataPtr  = nullptr;
+    uint32 dataSize = 0;
+    if (!FileManager::ReadFile(filepath, dataPtr, dataSize))
+    {
+        return false;
+    }
+
+    outFile.data   = dataPtr;
+    outFile.size   = dataSize;
+    outFile.copied = true;
+
+#endif
+
+    return true;
+}
+
+void FileManager::UnmapFile(MappedFile& file)
+{
+    if (file.data == nullptr)
+    {
+        return;
+    }
+
+    if (file.copied)
+    {
+        delete[] file.data;
+    }
+    else
+    {
+#if PLATFORM_WINDOWS
+        UnmapViewOfFile(file.data);
+        CloseHandle((HANDLE)file.handle);
+#elif PLATFORM_MAC || PLATFORM_IOS || PLATFORM_LINUX
+        munmap((void*)file.data, (size_t)file.size);
+#endif
+    }
+
+    file = MappedFile();
+}
+
+bool FileManager::GetFileStat(const std::string& filepath, uint64& outSize, uint64& outModifiedTime)
+{
+    outSize         = 0;
+    outModifiedTime = 0;
+    std::string finalPath = FileManager::GetFilePath(filepath);
+
+#if PLATFORM_WINDOWS
+
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(finalPath.c_str(), GetFileExInfoStandard, &attributes))
+    {
+        return false;
+    }
+
+    outSize         = ((uint64)attributes.nFileSizeHigh << 32) | (uint64)attributes.nFileSizeLow;
+    outModifiedTime = ((uint64)attributes.ftLastWriteTime.dwHighDateTime << 32) | (uint64)attributes.ftLastWriteTime.dwLowDateTime;
+
+#elif PLATFORM_MAC || PLATFORM_IOS || PLATFORM_LINUX
+
+    struct stat fileStat;
+    if (stat(finalPath.c_str(), &fileStat) != 0)
+    {
+        return false;
+    }
+
+    outSize         = (uint64)fileStat.st_size;
+    outModifiedTime = (uint64)fileStat.st_mtime;
+
+#elif PLATFORM_ANDROID
+
+    AAsset* asset = AAssetManager_open(g_AndroidApp->activity->assetManager, finalPath.c_str(), AASSET_MODE_UNKNOWN);
+    if (!asset)
+    {
+        return false;
+    }
+
+    outSize = (uint64)AAsset_getLength(asset);
+    AAsset_close(asset);
+
+#else
+
+    FILE* file = fopen(finalPath.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    outSize = (uint64)ftell(file);
+    fclose(file);
+
+#endif
+
+    return true;
+}
+
+bool FileManager::WriteFile(const std::string& filepath, const uint8* dataPtr, uint64 dataSize)
+{
+    std::string finalPath = FileManager::GetFilePath(filepath);
+    std::string tempPath  = finalPath + ".tmp";
+
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file)
+    {
+        MLOGE("Failed open file for write : %s", tempPath.c_str());
+        return false;
+    }
+
+    bool written = fwrite(dataPtr, 1, (size_t)dataSize, file) == (size_t)dataSize;
+    written = fflush(file) == 0 && written;
+    fclose(file);
+
+    if (!written)
+    {
+        MLOGE("Failed write file : %s", tempPath.c_str());
+        remove(tempPath.c_str());
+        return false;
+    }
+
+#if PLATFORM_WINDOWS
+    bool replaced = MoveFileExA(tempPath.c_str(), finalPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    bool replaced = rename(tempPath.c_str(), finalPath.c_str()) == 0;
+#endif
+
+    if (!replaced)
+    {
+        MLOGE("Failed replace file : %s", finalPath.c_str());
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -4,11 +4,30 @@
 
 #include <string>
 
+// 只读映射的文件，平台不支持映射时退化为整体读入
+struct MappedFile
+{
+    const uint8*    data = nullptr;
+    uint64          size = 0;
+    void*           handle = nullptr;
+    bool            copied = false;
+};
+
 class FileManager
 {
 public:
     static bool ReadFile(const std::string& filepath, uint8*& dataPtr, uint32& dataSize);
 
+    static bool MapFile(const std::string& filepath, MappedFile& outFile);
+
+    static void UnmapFile(MappedFile& file);
+
+    // 文件大小与修改时间，平台取不到修改时间时outModifiedTime为0
+    static bool GetFileStat(const std::string& filepath, uint64& outSize, uint64& outModifiedTime);
+
+    // 先写临时文件再替换，避免中途退出留下半个文件
+    static bool WriteFile(const std::string& filepath, const uint8* dataPtr, uint64 dataSize);
+
     static std::string GetFilePath(const std::string& filepath);
 
 };
\ No newline at end of file
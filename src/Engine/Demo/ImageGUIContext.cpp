@@ -1,6 +1,10 @@
 #include "Engine.h"
 #include "ImageGUIContext.h"
 #include "Demo/FileManager.h"
+#include "Demo/DVKPipelineCache.h"
+#include "Math/Math.h"
+#include "Utils/Alignment.h"
+#include "Utils/CPUProfiler.h"
 
 #include "Application/GenericWindow.h"
 #include "Application/GenericApplication.h"
@@ -81,14 +85,21 @@ static uint32_t g__glsl_shader_frag_spv[] =
 
 ImageGUIContext::ImageGUIContext()
     : m_VulkanDevice(nullptr)
+    , m_GeometryCoherent(false)
+    , m_VertexCapacity(0)
+    , m_IndexCapacity(0)
+    , m_SliceSize(0)
+    , m_NumSlices(0)
+    , m_SliceIndex(0)
     , m_VertexCount(0)
     , m_IndexCount(0)
+    , m_CmdCount(0)
     , m_Subpass(0)
     , m_DescriptorPool(VK_NULL_HANDLE)
     , m_DescriptorSetLayout(VK_NULL_HANDLE)
     , m_DescriptorSet(VK_NULL_HANDLE)
     , m_PipelineLayout(VK_NULL_HANDLE)
-    , m_PipelineCache(VK_NULL_HANDLE)
+    , m_PipelineCache(nullptr)
     , m_Pipeline(VK_NULL_HANDLE)
     , m_LastRenderPass(VK_NULL_HANDLE)
     , m_FontMemory(VK_NULL_HANDLE)
@@ -255,7 +266,7 @@ void ImageGUIContext::PreparePipeline(VkRenderPass renderPass, int32 subpass, Vk
     pipelineCreateInfo.layout              = m_PipelineLayout;
     pipelineCreateInfo.renderPass          = renderPass;
     pipelineCreateInfo.subpass             = subpass;
-    VERIFYVULKANRESULT(vkCreateGraphicsPipelines(device, m_PipelineCache, 1, &pipelineCreateInfo, VULKAN_CPU_ALLOCATOR, &m_Pipeline));
+    VERIFYVULKANRESULT(vk_demo::DVKPipelineCache::CreateGraphicsPipeline(m_VulkanDevice, m_PipelineCache->pipelineCache, pipelineCreateInfo, &m_Pipeline));
 
     vkDestroyShaderModule(device, vertModule, VULKAN_CPU_ALLOCATOR);
     vkDestroyShaderModule(device, fragModule, VULKAN_CPU_ALLOCATOR);
@@ -268,9 +279,7 @@ void ImageGUIContext::PreparePipelineResources()
 {
     VkDevice device = m_VulkanDevice->GetInstanceHandle();
 
-    VkPipelineCacheCreateInfo createInfo;
-    ZeroVulkanStruct(createInfo, VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO);
-    VERIFYVULKANRESULT(vkCreatePipelineCache(device, &createInfo, VULKAN_CPU_ALLOCATOR, &m_PipelineCache));
+    m_PipelineCache = vk_demo::DVKPipelineCache::Create(m_VulkanDevice, "ImageGUI.pipelinecache");
 
     VkDescriptorPoolSize poolSize = {};
     poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -336,13 +345,15 @@ void ImageGUIContext::Destroy()
 {
     VkDevice device = m_VulkanDevice->GetInstanceHandle();
     ImGui::DestroyContext();
-    m_VertexBuffer.Destroy();
-    m_IndexBuffer.Destroy();
+    m_GeometryBuffer.Unmap();
+    m_GeometryBuffer.Destroy();
     vkDestroyDescriptorPool(device, m_DescriptorPool, VULKAN_CPU_ALLOCATOR);
     vkDestroyDescriptorSetLayout(device, m_DescriptorSetLayout, VULKAN_CPU_ALLOCATOR);
     vkDestroyPipelineLayout(device, m_PipelineLayout, VULKAN_CPU_ALLOCATOR);
     vkDestroyPipeline(device, m_Pipeline, VULKAN_CPU_ALLOCATOR);
-    vkDestroyPipelineCache(device, m_PipelineCache, VULKAN_CPU_ALLOCATOR);
+    m_PipelineCache->Save();
+    delete m_PipelineCache;
+    m_PipelineCache = nullptr;
     vkFreeMemory(device, m_FontMemory, VULKAN_CPU_ALLOCATOR);
     vkDestroyImage(device, m_FontImage, VULKAN_CPU_ALLOCATOR);
     vkDestroyImageView(device, m_FontView, VULKAN_CPU_ALLOCATOR);
@@ -638,8 +649,10 @@ void ImageGUIContext::EndFrame()
     ImGui::Render();
 }
 
-bool ImageGUIContext::Update()
+bool ImageGUIContext::Update(int32 frameIndex)
 {
+    CPU_PROFILE_SCOPE("ImageGUIContext::Update");
+
     ImDrawData* imDrawData = ImGui::GetDrawData();
     bool updateCmdBuffers  = false;
 
@@ -648,41 +661,53 @@ bool ImageGUIContext::Update()
         return false;
     }
 
-    // Note: Alignment is done inside buffer creation
     VkDeviceSize vertexBufferSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
     VkDeviceSize indexBufferSize  = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
 
-    // Update buffers only if vertex or index count has been changed compared to current buffer size
     if ((vertexBufferSize == 0) || (indexBufferSize == 0))
     {
         return false;
     }
 
-    // Vertex buffer
-    if ((m_VertexBuffer.buffer == VK_NULL_HANDLE) || (m_VertexCount != imDrawData->TotalVtxCount))
+    // 容量不足或slice不够时按倍数增长，稳定后不再重建
+    int32 numSlices = MMath::Max(m_NumSlices, frameIndex + 1);
+    if (m_GeometryBuffer.buffer == VK_NULL_HANDLE || vertexBufferSize > m_VertexCapacity || indexBufferSize > m_IndexCapacity || numSlices > m_NumSlices)
     {
-        m_VertexCount = imDrawData->TotalVtxCount;
-        m_VertexBuffer.Unmap();
-        m_VertexBuffer.Destroy();
-        CreateBuffer(m_VertexBuffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, vertexBufferSize);
-        m_VertexBuffer.Map();
-        updateCmdBuffers = true;
-    }
+        VkDeviceSize vertexCapacity = MMath::Max<VkDeviceSize>(m_VertexCapacity, 64 * 1024);
+        VkDeviceSize indexCapacity  = MMath::Max<VkDeviceSize>(m_IndexCapacity, 32 * 1024);
+        while (vertexCapacity < vertexBufferSize)
+        {
+            vertexCapacity *= 2;
+        }
+        while (indexCapacity < indexBufferSize)
+        {
+            indexCapacity *= 2;
+        }
 
-    // Index buffer
-    if ((m_IndexBuffer.buffer == VK_NULL_HANDLE) || (m_IndexCount < imDrawData->TotalIdxCount))
-    {
-        m_IndexCount = imDrawData->TotalIdxCount;
-        m_IndexBuffer.Unmap();
-        m_IndexBuffer.Destroy();
-        CreateBuffer(m_IndexBuffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, indexBufferSize);
-        m_IndexBuffer.Map();
+        // 旧buffer可能仍被在途帧引用，重建前先等待GPU
+        if (m_GeometryBuffer.buffer != VK_NULL_HANDLE)
+        {
+            vkDeviceWaitIdle(m_VulkanDevice->GetInstanceHandle());
+        }
+
+        CreateGeometryBuffer(vertexCapacity, indexCapacity, numSlices);
         updateCmdBuffers = true;
     }
 
-    // Upload data
-    ImDrawVert* vtxDst = (ImDrawVert*)m_VertexBuffer.mapped;
-    ImDrawIdx* idxDst  = (ImDrawIdx*)m_IndexBuffer.mapped;
+    // 绘制数量变化时需要重新录制
+    bool countChanged = m_VertexCount != imDrawData->TotalVtxCount || m_IndexCount != imDrawData->TotalIdxCount || m_CmdCount != imDrawData->CmdListsCount;
+    updateCmdBuffers  = updateCmdBuffers || countChanged;
+
+    m_SliceIndex  = frameIndex;
+    m_VertexCount = imDrawData->TotalVtxCount;
+    m_IndexCount  = imDrawData->TotalIdxCount;
+    m_CmdCount    = imDrawData->CmdListsCount;
+
+    // 顶点与索引一次遍历写入
+    VkDeviceSize sliceOffset = m_SliceSize * m_SliceIndex;
+    uint8* sliceData   = (uint8*)m_GeometryBuffer.mapped + sliceOffset;
+    ImDrawVert* vtxDst = (ImDrawVert*)(sliceData);
+    ImDrawIdx* idxDst  = (ImDrawIdx*)(sliceData + m_VertexCapacity);
 
     for (int n = 0; n < imDrawData->CmdListsCount; n++)
     {
@@ -693,12 +718,59 @@ bool ImageGUIContext::Update()
         idxDst += cmdList->IdxBuffer.Size;
     }
 
-    m_VertexBuffer.Flush();
-    m_IndexBuffer.Flush();
+    // 非coherent内存只flush写入的部分
+    if (!m_GeometryCoherent)
+    {
+        VkDeviceSize atomSize = MMath::Max<VkDeviceSize>(m_VulkanDevice->GetLimits().nonCoherentAtomSize, 1);
+
+        VkMappedMemoryRange mappedRanges[2];
+        ZeroVulkanStruct(mappedRanges[0], VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE);
+        mappedRanges[0].memory = m_GeometryBuffer.memory;
+        mappedRanges[0].offset = sliceOffset;
+        mappedRanges[0].size   = MMath::Min(Align<VkDeviceSize>(vertexBufferSize, atomSize), m_GeometryBuffer.size - mappedRanges[0].offset);
+
+        ZeroVulkanStruct(mappedRanges[1], VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE);
+        mappedRanges[1].memory = m_GeometryBuffer.memory;
+        mappedRanges[1].offset = sliceOffset + m_VertexCapacity;
+        mappedRanges[1].size   = MMath::Min(Align<VkDeviceSize>(indexBufferSize, atomSize), m_GeometryBuffer.size - mappedRanges[1].offset);
+
+        VERIFYVULKANRESULT(vkFlushMappedMemoryRanges(m_VulkanDevice->GetInstanceHandle(), 2, mappedRanges));
+    }
 
     return updateCmdBuffers || m_Updated;
 }
 
+void ImageGUIContext::CreateGeometryBuffer(VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity, int32 numSlices)
+{
+    m_GeometryBuffer.Unmap();
+    m_GeometryBuffer.Destroy();
+
+    // 偏移需要同时满足flush的nonCoherentAtomSize，容量均为2的幂
+    VkDeviceSize atomSize = MMath::Max<VkDeviceSize>(m_VulkanDevice->GetLimits().nonCoherentAtomSize, 4);
+    m_VertexCapacity = Align<VkDeviceSize>(vertexCapacity, atomSize);
+    m_IndexCapacity  = Align<VkDeviceSize>(indexCapacity, atomSize);
+    m_SliceSize      = m_VertexCapacity + m_IndexCapacity;
+    m_NumSlices      = numSlices;
+
+    VkBufferUsageFlags usageFlags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    VkDeviceSize totalSize        = m_SliceSize * m_NumSlices;
+
+    // 优先使用coherent内存，不支持时退回到手动flush
+    uint32 memoryTypeIndex = 0;
+    m_GeometryCoherent = m_VulkanDevice->GetMemoryManager().GetMemoryTypeFromProperties(~0u, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &memoryTypeIndex) == VK_SUCCESS;
+    if (m_GeometryCoherent)
+    {
+        CreateBuffer(m_GeometryBuffer, usageFlags, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, totalSize);
+    }
+    else
+    {
+        CreateBuffer(m_GeometryBuffer, usageFlags, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, totalSize);
+    }
+    m_GeometryBuffer.Map();
+
+    MLOG("ImageGUI geometry buffer : %d slices x (%lluKB vertex + %lluKB index)", m_NumSlices, (uint64)(m_VertexCapacity / 1024), (uint64)(m_IndexCapacity / 1024));
+}
+
 void ImageGUIContext::CreateBuffer(UIBuffer& buffer, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size)
 {
     VkDevice device = m_VulkanDevice->GetInstanceHandle();
@@ -741,7 +813,7 @@ void ImageGUIContext::BindDrawCmd(const VkCommandBuffer& commandBuffer, const Vk
 
     VkDeviceSize vertexBufferSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
     VkDeviceSize indexBufferSize  = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
-    if (vertexBufferSize == 0 || indexBufferSize == 0)
+    if (vertexBufferSize == 0 || indexBufferSize == 0 || m_GeometryBuffer.buffer == VK_NULL_HANDLE)
     {
         return;
     }
@@ -752,7 +824,8 @@ void ImageGUIContext::BindDrawCmd(const VkCommandBuffer& commandBuffer, const Vk
     }
 
     ImGuiIO& io = ImGui::GetIO();
-    VkDeviceSize offsets[1] = { 0 };
+    VkDeviceSize sliceOffset = m_SliceSize * m_SliceIndex;
+    VkDeviceSize offsets[1]  = { sliceOffset };
     ImVec2 displayPos = imDrawData->DisplayPos;
 
     VkViewport viewport = {};
@@ -772,8 +845,8 @@ void ImageGUIContext::BindDrawCmd(const VkCommandBuffer& commandBuffer, const Vk
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline);
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &m_DescriptorSet, 0, nullptr);
     vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &m_PushData);
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_VertexBuffer.buffer, offsets);
-    vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_GeometryBuffer.buffer, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, m_GeometryBuffer.buffer, sliceOffset + m_VertexCapacity, VK_INDEX_TYPE_UINT16);
 
     for (int32_t i = 0; i < imDrawData->CmdListsCount; ++i)
     {
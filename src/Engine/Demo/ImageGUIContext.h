@@ -7,6 +7,11 @@
 
 #include "imgui.h"
 
+namespace vk_demo
+{
+    class DVKPipelineCache;
+}
+
 
 class ImageGUIContext
 {
@@ -90,7 +95,10 @@ public:
     void Init(const std::string& font);
     void Destroy();
     void Resize(uint32 width,uint32 height);
-    bool Update();
+    // 写入frameIndex(DemoBase::GetFrameIndex())在途帧独占的区域，调用前必须已等待该帧的fence(即在DemoBase::AcquireBackbufferIndex之后调用)，
+    // 之后录制的command buffer只能在该帧提交。未分帧的demo只有slice 0，同样要在Acquire之后调用。
+    // 返回true表示buffer重建过或绘制数量变化，需要重新录制。
+    bool Update(int32 frameIndex);
     void StartFrame();
     void EndFrame();
     void BindDrawCmd(const VkCommandBuffer& commandBuffer, const VkRenderPass& renderPass, int32 subpass = 0, VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT);
@@ -109,16 +117,25 @@ protected:
 
     void CreateBuffer(UIBuffer& buffer, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size);
 
+    void CreateGeometryBuffer(VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity, int32 numSlices);
+
 protected:
 
     typedef std::shared_ptr<VulkanDevice> VulkanDeviceRef;
 
     VulkanDeviceRef         m_VulkanDevice;
 
-    UIBuffer                m_VertexBuffer;
-    UIBuffer                m_IndexBuffer;
+    // 常驻映射的顶点与索引buffer，每个在途帧一个slice，slice内先放顶点再放索引
+    UIBuffer                m_GeometryBuffer;
+    bool                    m_GeometryCoherent;
+    VkDeviceSize            m_VertexCapacity;
+    VkDeviceSize            m_IndexCapacity;
+    VkDeviceSize            m_SliceSize;
+    int32                   m_NumSlices;
+    int32                   m_SliceIndex;
     int32                   m_VertexCount;
     int32                   m_IndexCount;
+    int32                   m_CmdCount;
 
     int32                   m_Subpass;
 
@@ -127,7 +144,7 @@ protected:
     VkDescriptorSet         m_DescriptorSet;
     VkPipelineLayout        m_PipelineLayout;
 
-    VkPipelineCache         m_PipelineCache;
+    vk_demo::DVKPipelineCache*  m_PipelineCache;
     VkPipeline              m_Pipeline;
 
     VkRenderPass            m_LastRenderPass;
@@ -0,0 +1,7 @@
+#include "GenericPlatform/InputManager.h"
+
+// Linux平台目前只有无窗口的离屏模式，没有键盘与鼠标输入
+void InputManager::Init()
+{
+
+}
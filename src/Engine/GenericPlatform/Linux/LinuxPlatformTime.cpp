@@ -0,0 +1,15 @@
+#include "LinuxPlatformTime.h"
+#include "Common/Log.h"
+
+// clock_gettime以纳秒为单位
+double LinuxPlatformTime::s_SecondsPerCycle = 1.0e-9;
+
+double LinuxPlatformTime::InitTiming(void)
+{
+    struct timespec resolution;
+    if (clock_getres(CLOCK_MONOTONIC, &resolution) != 0 || resolution.tv_sec != 0 || resolution.tv_nsec > 1000000)
+    {
+        MLOGE("CLOCK_MONOTONIC resolution too coarse for frame timing.");
+    }
+    return GenericPlatformTime::Seconds();
+}
@@ -0,0 +1,38 @@
+# pragma once
+
+#include "Common/Common.h"
+
+#include <time.h>
+
+class LinuxPlatformTime
+{
+public:
+
+    static double InitTiming();
+
+    // CLOCK_MONOTONIC不受系统时间调整影响，适合统计帧耗时
+    static FORCE_INLINE double Seconds()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec + (double)ts.tv_nsec * GetSecondsPerCycle() + 16777216.0;
+    }
+
+    // 以GetSecondsPerCycle()为单位的计数，省去浮点换算，用于CPU分段计时
+    static FORCE_INLINE uint64 Cycles64()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64)ts.tv_sec * 1000000000ULL + (uint64)ts.tv_nsec;
+    }
+
+    static FORCE_INLINE double GetSecondsPerCycle()
+    {
+        return s_SecondsPerCycle;
+    }
+
+protected:
+    static double s_SecondsPerCycle;
+};
+
+typedef LinuxPlatformTime GenericPlatformTime;
@@ -17,6 +17,14 @@ public:
         return cycles.QuadPart * GetSecondsPerCycle() + 16777216.0;
     }
 
+    // 以GetSecondsPerCycle()为单位的计数，省去浮点换算，用于CPU分段计时
+    static FORCE_INLINE uint64 Cycles64()
+    {
+        LARGE_INTEGER cycles;
+        QueryPerformanceCounter(&cycles);
+        return (uint64)cycles.QuadPart;
+    }
+
     static FORCE_INLINE double GetSecondsPerCycle()
     {
         return s_SecondsPerCycle;
@@ -0,0 +1,123 @@
+#include "ThreadPool.h"
+#include "Utils/CPUProfiler.h"
+
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(int32 numThreads)
+{
+    if (numThreads <= 0)
+    {
+        numThreads = (int32)std::thread::hardware_concurrency() - 1;
+        numThreads = numThreads < 1 ? 1 : numThreads;
+    }
+
+    for (int32 i = 0; i < numThreads; ++i)
+    {
+        m_Threads.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Exit = true;
+    }
+    m_Condition.notify_all();
+
+    for (int32 i = 0; i < m_Threads.size(); ++i)
+    {
+        m_Threads[i].join();
+    }
+    m_Threads.clear();
+}
+
+ThreadPool& ThreadPool::Get()
+{
+    static ThreadPool threadPool;
+    return threadPool;
+}
+
+void ThreadPool::Push(const Job& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Jobs.push_back(job);
+    }
+    m_Condition.notify_one();
+}
+
+void ThreadPool::ParallelFor(int32 count, const std::function<void(int32)>& func)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    if (count == 1)
+    {
+        func(0);
+        return;
+    }
+
+    // 每个执行者循环领取下一个索引，任务耗时不均时也能保持负载均衡
+    struct ParallelState
+    {
+        std::atomic<int32>          next;
+        std::atomic<int32>          done;
+        std::mutex                  mutex;
+        std::condition_variable     condition;
+    };
+
+    std::shared_ptr<ParallelState> state = std::make_shared<ParallelState>();
+    state->next = 0;
+    state->done = 0;
+
+    auto execute = [state, count, &func]()
+    {
+        int32 index = state->next.fetch_add(1);
+        while (index < count)
+        {
+            func(index);
+            if (state->done.fetch_add(1) + 1 == count)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->condition.notify_all();
+            }
+            index = state->next.fetch_add(1);
+        }
+    };
+
+    int32 numHelpers = count - 1 < GetNumThreads() ? count - 1 : GetNumThreads();
+    for (int32 i = 0; i < numHelpers; ++i)
+    {
+        Push(execute);
+    }
+
+    execute();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->condition.wait(lock, [state, count]() { return state->done.load() == count; });
+}
+
+void ThreadPool::WorkerLoop()
+{
+    CPUProfiler::SetThreadName("Worker");
+
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this]() { return m_Exit || m_Jobs.size() > 0; });
+            if (m_Exit && m_Jobs.size() == 0)
+            {
+                return;
+            }
+            job = m_Jobs.front();
+            m_Jobs.pop_front();
+        }
+        job();
+    }
+}
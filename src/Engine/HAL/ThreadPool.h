@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Common/Common.h"
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// 简单的工作线程池，用于资源加载等可并行的CPU任务。
+class ThreadPool
+{
+public:
+    typedef std::function<void()> Job;
+
+    // numThreads为0时使用硬件线程数减一
+    ThreadPool(int32 numThreads = 0);
+
+    ~ThreadPool();
+
+    // 全局线程池，第一次使用时创建
+    static ThreadPool& Get();
+
+    void Push(const Job& job);
+
+    // 并行执行func(0) ... func(count - 1)，调用线程也参与执行，返回时全部完成
+    void ParallelFor(int32 count, const std::function<void(int32)>& func);
+
+    FORCE_INLINE int32 GetNumThreads() const
+    {
+        return (int32)m_Threads.size();
+    }
+
+private:
+    void WorkerLoop();
+
+private:
+    std::vector<std::thread>    m_Threads;
+    std::deque<Job>             m_Jobs;
+    std::mutex                  m_Mutex;
+    std::condition_variable     m_Condition;
+    bool                        m_Exit = false;
+};
@@ -1,5 +1,6 @@
 #include "Configuration/Platform.h"
 #include "GenericPlatform/GenericPlatformTime.h"
+#include "Utils/CPUProfiler.h"
 
 #include "Engine.h"
 #include "Launch.h"
@@ -7,6 +8,9 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
 
 enum LaunchErrorType
 {
@@ -22,6 +26,115 @@ std::shared_ptr<AppModuleBase> g_AppModule;
 double g_LastTime = 0.0;
 double g_CurrTime = 0.0;
 
+// 固定帧数的基准测试模式：-benchframes=N [-warmup=N] [-frametimes=file.csv]
+// 运行N帧后退出并输出CPU帧耗时统计，用于CI中无窗口运行示例。
+// 不使用-frames=，该参数由DemoBase解析为在途帧数。
+int32 g_BenchmarkFrames = 0;
+int32 g_BenchmarkWarmup = 0;
+std::string g_BenchmarkOutput;
+std::vector<double> g_FrameTimes;
+
+// -cpuprofile[=file.json] 开启CPU分段计时，退出时输出统计并写出Chrome trace
+bool g_CPUProfile = false;
+std::string g_CPUProfileOutput;
+
+void ParseBenchmarkOptions(const std::vector<std::string>& cmdLine)
+{
+    for (int32 i = 1; i < cmdLine.size(); ++i)
+    {
+        if (cmdLine[i].find("-benchframes=") == 0)
+        {
+            g_BenchmarkFrames = atoi(cmdLine[i].c_str() + 13);
+        }
+        else if (cmdLine[i].find("-warmup=") == 0)
+        {
+            g_BenchmarkWarmup = atoi(cmdLine[i].c_str() + 8);
+        }
+        else if (cmdLine[i].find("-frametimes=") == 0)
+        {
+            g_BenchmarkOutput = cmdLine[i].substr(12);
+        }
+        else if (cmdLine[i].find("-cpuprofile=") == 0)
+        {
+            g_CPUProfile       = true;
+            g_CPUProfileOutput = cmdLine[i].substr(12);
+        }
+        else if (cmdLine[i] == "-cpuprofile")
+        {
+            g_CPUProfile = true;
+        }
+    }
+
+    if (g_BenchmarkFrames > 0)
+    {
+        g_BenchmarkWarmup = g_BenchmarkWarmup < 0 ? 0 : g_BenchmarkWarmup;
+        g_FrameTimes.reserve(g_BenchmarkFrames);
+    }
+
+    // 在创建AppModule之前开启，加载阶段的耗时也会被记录
+    if (g_CPUProfile)
+    {
+        CPUProfiler::Enable(true);
+        CPUProfiler::SetCapture(true);
+    }
+}
+
+void ReportBenchmark()
+{
+    if (g_FrameTimes.size() == 0)
+    {
+        return;
+    }
+
+    if (g_BenchmarkOutput.size() > 0)
+    {
+        FILE* file = fopen(g_BenchmarkOutput.c_str(), "w");
+        if (file)
+        {
+            fprintf(file, "frame,ms\n");
+            for (int32 i = 0; i < g_FrameTimes.size(); ++i)
+            {
+                fprintf(file, "%d,%.4f\n", i, g_FrameTimes[i] * 1000.0);
+            }
+            fclose(file);
+        }
+        else
+        {
+            MLOGE("Failed write frame times : %s", g_BenchmarkOutput.c_str());
+        }
+    }
+
+    std::vector<double> sorted = g_FrameTimes;
+    std::sort(sorted.begin(), sorted.end());
+
+    double total = 0.0;
+    for (int32 i = 0; i < sorted.size(); ++i)
+    {
+        total += sorted[i];
+    }
+
+    const int32 count = (int32)sorted.size();
+    const double average = total / count;
+    auto percentile = [&sorted, count](double p) -> double
+    {
+        int32 index = (int32)(p * (count - 1) + 0.5);
+        return sorted[index];
+    };
+
+    MLOG("Benchmark %s : %d frames (%d warmup), avg %.3fms (%.1f fps), min %.3fms, p50 %.3fms, p95 %.3fms, p99 %.3fms, max %.3fms",
+        g_AppModule->GetTitle().c_str(),
+        count,
+        g_BenchmarkWarmup,
+        average * 1000.0,
+        average > 0.0 ? 1.0 / average : 0.0,
+        sorted[0] * 1000.0,
+        percentile(0.50) * 1000.0,
+        percentile(0.95) * 1000.0,
+        percentile(0.99) * 1000.0,
+        sorted[count - 1] * 1000.0
+    );
+}
+
 int32 EnginePreInit(const std::vector<std::string>& cmdLine)
 {
     int32 width  = g_AppModule->GetWidth();
@@ -80,19 +193,58 @@ void EngineLoop()
     double nowT  = GenericPlatformTime::Seconds();
     double delta = nowT - g_LastTime;
 
-    g_AppModule->Loop((float)g_CurrTime, (float)delta);
+    {
+        CPU_PROFILE_SCOPE("Frame");
+
+        {
+            CPU_PROFILE_SCOPE("Loop");
+            g_AppModule->Loop((float)g_CurrTime, (float)delta);
+        }
+
+        // reset between module and engine
+        {
+            CPU_PROFILE_SCOPE("InputManager::Reset");
+            InputManager::Reset();
+        }
 
-    // reset between module and engine
-    InputManager::Reset();
+        {
+            CPU_PROFILE_SCOPE("Engine::Tick");
+            g_GameEngine->Tick((float)g_CurrTime, (float)delta);
+        }
+    }
 
-    g_GameEngine->Tick((float)g_CurrTime, (float)delta);
+    CPUProfiler::EndFrame();
 
     g_LastTime = nowT;
     g_CurrTime = g_CurrTime + delta;
+
+    if (g_BenchmarkFrames > 0)
+    {
+        // 帧耗时从本帧开始到Tick结束，包含等待GPU的时间
+        static int32 frameIndex = 0;
+        if (frameIndex >= g_BenchmarkWarmup)
+        {
+            g_FrameTimes.push_back(GenericPlatformTime::Seconds() - nowT);
+        }
+        frameIndex += 1;
+
+        if (frameIndex >= g_BenchmarkWarmup + g_BenchmarkFrames)
+        {
+            g_GameEngine->RequestExit(true);
+        }
+    }
 }
 
 void EngineExit()
 {
+    ReportBenchmark();
+
+    if (g_CPUProfile)
+    {
+        CPUProfiler::PrintStats();
+        CPUProfiler::WriteChromeTrace(g_CPUProfileOutput.size() > 0 ? g_CPUProfileOutput : g_AppModule->GetTitle() + ".trace.json");
+    }
+
     g_AppModule->Exist();
     g_AppModule = nullptr;
 
@@ -104,6 +256,8 @@ int32 GuardedMain(const std::vector<std::string>& cmdLine)
 {
     g_GameEngine = std::make_shared<Engine>();
 
+    ParseBenchmarkOptions(cmdLine);
+
     g_AppModule = CreateAppMode(cmdLine);
     if (!g_AppModule)
     {
@@ -14,6 +14,11 @@ uint8* StbImage::LoadFromMemory(const uint8* inBuffer, int32 inSize, int32* outW
     return stbi_load_from_memory(inBuffer, inSize, outWidth, outHeight, outComp, reqComp);
 }
 
+bool StbImage::InfoFromMemory(const uint8* inBuffer, int32 inSize, int32* outWidth, int32* outHeight, int32* outComp)
+{
+    return stbi_info_from_memory(inBuffer, inSize, outWidth, outHeight, outComp) != 0;
+}
+
 float* StbImage::LoadFloatFromMemory(const uint8* inBuffer, int32 inSize, int32* outWidth, int32* outHeight, int32* outComp, int32 reqComp)
 {
     return stbi_loadf_from_memory(inBuffer, inSize, outWidth, outHeight, outComp, reqComp);
@@ -12,6 +12,9 @@ public:
 
     static uint8* LoadFromMemory(const uint8* inBuffer, int32 inSize, int32* outWidth, int32* outHeight, int32* outComp, int32 reqComp);
 
+    // 只解析文件头，不解码像素
+    static bool InfoFromMemory(const uint8* inBuffer, int32 inSize, int32* outWidth, int32* outHeight, int32* outComp);
+
     static float* LoadFloatFromMemory(const uint8* inBuffer, int32 inSize, int32* outWidth, int32* outHeight, int32* outComp, int32 reqComp);
 
     static void Free(uint8* data);
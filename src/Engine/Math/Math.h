@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "Math/PlatformMath.h"
+#include "Math/MathSIMD.h"
 #include "Common/Common.h"
 
 #include <string>
@@ -326,6 +327,47 @@ public:
 	}
     
     static FORCE_INLINE void VectorMatrixMultiply(void* result, const void* matrix1, const void* matrix2)
+    {
+#if PLATFORM_MATH_SIMD
+        SIMDMath::MatrixMultiply(result, matrix1, matrix2);
+#else
+        VectorMatrixMultiplyScalar(result, matrix1, matrix2);
+#endif
+    }
+
+    static FORCE_INLINE void VectorMatrixInverse(void* dstMatrix, const void* srcMatrix)
+    {
+#if PLATFORM_MATH_SIMD
+        SIMDMath::MatrixInverse(dstMatrix, srcMatrix);
+#else
+        VectorMatrixInverseScalar(dstMatrix, srcMatrix);
+#endif
+    }
+
+    static FORCE_INLINE void VectorTransformVector(void* result, const void* vec, const void* matrix)
+    {
+#if PLATFORM_MATH_SIMD
+        SIMDMath::TransformVector(result, vec, matrix);
+#else
+        VectorTransformVectorScalar(result, vec, matrix);
+#endif
+    }
+
+    // vecs与result为连续的float4数组
+    static FORCE_INLINE void VectorTransformVectors(void* result, const void* vecs, int32 count, const void* matrix)
+    {
+#if PLATFORM_MATH_SIMD
+        SIMDMath::TransformVectors(result, vecs, count, matrix);
+#else
+        for (int32 i = 0; i < count; ++i)
+        {
+            VectorTransformVectorScalar((float*)result + i * 4, (const float*)vecs + i * 4, matrix);
+        }
+#endif
+    }
+
+    // 以下标量实现用于不支持SIMD的平台，以及校验SIMD结果
+    static FORCE_INLINE void VectorMatrixMultiplyScalar(void* result, const void* matrix1, const void* matrix2)
     {
         typedef float Float4x4[4][4];
         const Float4x4& a = *((const Float4x4*) matrix1);
@@ -355,7 +397,7 @@ public:
         memcpy(result, &temp, 16 * sizeof(float));
     }
     
-    static FORCE_INLINE void VectorMatrixInverse(void* dstMatrix, const void* srcMatrix)
+    static FORCE_INLINE void VectorMatrixInverseScalar(void* dstMatrix, const void* srcMatrix)
     {
         typedef float Float4x4[4][4];
         const Float4x4& m = *((const Float4x4*)srcMatrix);
@@ -439,7 +481,7 @@ public:
         memcpy(dstMatrix, &result, 16 * sizeof(float));
     }
     
-    static FORCE_INLINE void VectorTransformVector(void* result, const void* vec,  const void* matrix)
+    static FORCE_INLINE void VectorTransformVectorScalar(void* result, const void* vec,  const void* matrix)
     {
         typedef float Float4[4];
         typedef float Float4x4[4][4];
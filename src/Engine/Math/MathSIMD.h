@@ -0,0 +1,360 @@
+#pragma once
+
+#include "Common/Common.h"
+#include "Configuration/Platform.h"
+
+// 编译期选择SIMD后端：x86使用SSE(有FMA时使用fmadd)，AArch64使用NEON，其余平台走MMath中的标量实现。
+// 定义MATH_DISABLE_SIMD可强制使用标量实现。
+#if !defined(MATH_DISABLE_SIMD) && (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define PLATFORM_MATH_SSE 1
+#else
+	#define PLATFORM_MATH_SSE 0
+#endif
+
+#if !defined(MATH_DISABLE_SIMD) && !PLATFORM_MATH_SSE && (defined(__aarch64__) || defined(_M_ARM64))
+	#define PLATFORM_MATH_NEON 1
+#else
+	#define PLATFORM_MATH_NEON 0
+#endif
+
+#define PLATFORM_MATH_SIMD (PLATFORM_MATH_SSE || PLATFORM_MATH_NEON)
+
+#if PLATFORM_MATH_SSE
+	#include <xmmintrin.h>
+	#include <emmintrin.h>
+	#if defined(__FMA__) || defined(__AVX2__)
+		#include <immintrin.h>
+		#define PLATFORM_MATH_FMA 1
+	#else
+		#define PLATFORM_MATH_FMA 0
+	#endif
+#elif PLATFORM_MATH_NEON
+	#include <arm_neon.h>
+#endif
+
+#if PLATFORM_MATH_SIMD
+
+#if PLATFORM_MATH_SSE
+
+typedef __m128 VectorRegister;
+
+FORCE_INLINE VectorRegister VectorLoad(const float* ptr)
+{
+	return _mm_loadu_ps(ptr);
+}
+
+FORCE_INLINE void VectorStore(const VectorRegister& vec, float* ptr)
+{
+	_mm_storeu_ps(ptr, vec);
+}
+
+FORCE_INLINE VectorRegister VectorSet(float x, float y, float z, float w)
+{
+	return _mm_setr_ps(x, y, z, w);
+}
+
+FORCE_INLINE VectorRegister VectorAdd(const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_add_ps(a, b);
+}
+
+FORCE_INLINE VectorRegister VectorSubtract(const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_sub_ps(a, b);
+}
+
+FORCE_INLINE VectorRegister VectorMultiply(const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_mul_ps(a, b);
+}
+
+FORCE_INLINE VectorRegister VectorDivide(const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_div_ps(a, b);
+}
+
+// a * b + c
+FORCE_INLINE VectorRegister VectorMultiplyAdd(const VectorRegister& a, const VectorRegister& b, const VectorRegister& c)
+{
+#if PLATFORM_MATH_FMA
+	return _mm_fmadd_ps(a, b, c);
+#else
+	return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+// (a.x, a.y, b.z, b.w)按索引选取，x、y取自a，z、w取自b
+#define VectorShuffle(a, b, x, y, z, w)	_mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+
+#define VectorSwizzle(a, x, y, z, w)	_mm_shuffle_ps(a, a, _MM_SHUFFLE(w, z, y, x))
+
+#define VectorReplicate(a, index)		_mm_shuffle_ps(a, a, _MM_SHUFFLE(index, index, index, index))
+
+FORCE_INLINE VectorRegister VectorSetFloat1(float value)
+{
+	return _mm_set1_ps(value);
+}
+
+// a > b的分量为全1，否则为0
+FORCE_INLINE VectorRegister VectorCompareGT(const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_cmpgt_ps(a, b);
+}
+
+FORCE_INLINE VectorRegister VectorBitwiseOr(const VectorRegister& a, const VectorRegister& b)
+{
+	return _mm_or_ps(a, b);
+}
+
+// 各分量的最高位组成4位掩码，x为bit0
+FORCE_INLINE int32 VectorMaskBits(const VectorRegister& vec)
+{
+	return _mm_movemask_ps(vec);
+}
+
+#elif PLATFORM_MATH_NEON
+
+typedef float32x4_t VectorRegister;
+
+FORCE_INLINE VectorRegister VectorLoad(const float* ptr)
+{
+	return vld1q_f32(ptr);
+}
+
+FORCE_INLINE void VectorStore(const VectorRegister& vec, float* ptr)
+{
+	vst1q_f32(ptr, vec);
+}
+
+FORCE_INLINE VectorRegister VectorSet(float x, float y, float z, float w)
+{
+	const float values[4] = { x, y, z, w };
+	return vld1q_f32(values);
+}
+
+FORCE_INLINE VectorRegister VectorAdd(const VectorRegister& a, const VectorRegister& b)
+{
+	return vaddq_f32(a, b);
+}
+
+FORCE_INLINE VectorRegister VectorSubtract(const VectorRegister& a, const VectorRegister& b)
+{
+	return vsubq_f32(a, b);
+}
+
+FORCE_INLINE VectorRegister VectorMultiply(const VectorRegister& a, const VectorRegister& b)
+{
+	return vmulq_f32(a, b);
+}
+
+FORCE_INLINE VectorRegister VectorDivide(const VectorRegister& a, const VectorRegister& b)
+{
+	return vdivq_f32(a, b);
+}
+
+FORCE_INLINE VectorRegister VectorMultiplyAdd(const VectorRegister& a, const VectorRegister& b, const VectorRegister& c)
+{
+	return vfmaq_f32(c, a, b);
+}
+
+template<int32 X, int32 Y, int32 Z, int32 W>
+FORCE_INLINE VectorRegister VectorShuffleTemplate(const VectorRegister& a, const VectorRegister& b)
+{
+	VectorRegister result = vdupq_n_f32(vgetq_lane_f32(a, X));
+	result = vsetq_lane_f32(vgetq_lane_f32(a, Y), result, 1);
+	result = vsetq_lane_f32(vgetq_lane_f32(b, Z), result, 2);
+	result = vsetq_lane_f32(vgetq_lane_f32(b, W), result, 3);
+	return result;
+}
+
+#define VectorShuffle(a, b, x, y, z, w)	VectorShuffleTemplate<x, y, z, w>(a, b)
+
+#define VectorSwizzle(a, x, y, z, w)	VectorShuffleTemplate<x, y, z, w>(a, a)
+
+#define VectorReplicate(a, index)		vdupq_laneq_f32(a, index)
+
+FORCE_INLINE VectorRegister VectorSetFloat1(float value)
+{
+	return vdupq_n_f32(value);
+}
+
+FORCE_INLINE VectorRegister VectorCompareGT(const VectorRegister& a, const VectorRegister& b)
+{
+	return vreinterpretq_f32_u32(vcgtq_f32(a, b));
+}
+
+FORCE_INLINE VectorRegister VectorBitwiseOr(const VectorRegister& a, const VectorRegister& b)
+{
+	return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+}
+
+FORCE_INLINE int32 VectorMaskBits(const VectorRegister& vec)
+{
+	static const int32 shifts[4] = { 0, 1, 2, 3 };
+	uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(vec), 31);
+	return (int32)vaddvq_u32(vshlq_u32(bits, vld1q_s32(shifts)));
+}
+
+#endif
+
+struct SIMDMath
+{
+	// result = matrix1 * matrix2，行主序，与MMath::VectorMatrixMultiply一致
+	static FORCE_INLINE void MatrixMultiply(void* result, const void* matrix1, const void* matrix2)
+	{
+		const float* a = (const float*)matrix1;
+		const float* b = (const float*)matrix2;
+		float* r = (float*)result;
+
+		const VectorRegister b0 = VectorLoad(b + 0);
+		const VectorRegister b1 = VectorLoad(b + 4);
+		const VectorRegister b2 = VectorLoad(b + 8);
+		const VectorRegister b3 = VectorLoad(b + 12);
+
+		// 先全部算完再写回，result可以与输入重叠
+		VectorRegister rows[4];
+		for (int32 i = 0; i < 4; ++i)
+		{
+			const VectorRegister row = VectorLoad(a + i * 4);
+			VectorRegister temp = VectorMultiply(VectorReplicate(row, 0), b0);
+			temp = VectorMultiplyAdd(VectorReplicate(row, 1), b1, temp);
+			temp = VectorMultiplyAdd(VectorReplicate(row, 2), b2, temp);
+			temp = VectorMultiplyAdd(VectorReplicate(row, 3), b3, temp);
+			rows[i] = temp;
+		}
+
+		VectorStore(rows[0], r + 0);
+		VectorStore(rows[1], r + 4);
+		VectorStore(rows[2], r + 8);
+		VectorStore(rows[3], r + 12);
+	}
+
+	// result = vec * matrix
+	static FORCE_INLINE void TransformVector(void* result, const void* vec, const void* matrix)
+	{
+		const float* m = (const float*)matrix;
+		const VectorRegister v = VectorLoad((const float*)vec);
+
+		VectorRegister temp = VectorMultiply(VectorReplicate(v, 0), VectorLoad(m + 0));
+		temp = VectorMultiplyAdd(VectorReplicate(v, 1), VectorLoad(m + 4), temp);
+		temp = VectorMultiplyAdd(VectorReplicate(v, 2), VectorLoad(m + 8), temp);
+		temp = VectorMultiplyAdd(VectorReplicate(v, 3), VectorLoad(m + 12), temp);
+
+		VectorStore(temp, (float*)result);
+	}
+
+	// 批量变换，矩阵只加载一次
+	static FORCE_INLINE void TransformVectors(void* result, const void* vecs, int32 count, const void* matrix)
+	{
+		const float* m = (const float*)matrix;
+		const float* src = (const float*)vecs;
+		float* dst = (float*)result;
+
+		const VectorRegister m0 = VectorLoad(m + 0);
+		const VectorRegister m1 = VectorLoad(m + 4);
+		const VectorRegister m2 = VectorLoad(m + 8);
+		const VectorRegister m3 = VectorLoad(m + 12);
+
+		for (int32 i = 0; i < count; ++i)
+		{
+			const VectorRegister v = VectorLoad(src + i * 4);
+			VectorRegister temp = VectorMultiply(VectorReplicate(v, 0), m0);
+			temp = VectorMultiplyAdd(VectorReplicate(v, 1), m1, temp);
+			temp = VectorMultiplyAdd(VectorReplicate(v, 2), m2, temp);
+			temp = VectorMultiplyAdd(VectorReplicate(v, 3), m3, temp);
+			VectorStore(temp, dst + i * 4);
+		}
+	}
+
+	// 分块求逆：M = |A B|，A、B、C、D为2x2子矩阵，每个寄存器存放一个2x2矩阵(行主序)。
+	//              |C D|
+	// 与标量实现一样不检查奇异矩阵，调用者负责。
+	static FORCE_INLINE void MatrixInverse(void* dstMatrix, const void* srcMatrix)
+	{
+		const float* src = (const float*)srcMatrix;
+		float* dst = (float*)dstMatrix;
+
+		const VectorRegister row0 = VectorLoad(src + 0);
+		const VectorRegister row1 = VectorLoad(src + 4);
+		const VectorRegister row2 = VectorLoad(src + 8);
+		const VectorRegister row3 = VectorLoad(src + 12);
+
+		const VectorRegister A = VectorShuffle(row0, row1, 0, 1, 0, 1);
+		const VectorRegister B = VectorShuffle(row0, row1, 2, 3, 2, 3);
+		const VectorRegister C = VectorShuffle(row2, row3, 0, 1, 0, 1);
+		const VectorRegister D = VectorShuffle(row2, row3, 2, 3, 2, 3);
+
+		// (|A|, |B|, |C|, |D|)
+		const VectorRegister detSub = VectorSubtract(
+			VectorMultiply(VectorShuffle(row0, row2, 0, 2, 0, 2), VectorShuffle(row1, row3, 1, 3, 1, 3)),
+			VectorMultiply(VectorShuffle(row0, row2, 1, 3, 1, 3), VectorShuffle(row1, row3, 0, 2, 0, 2))
+		);
+		const VectorRegister detA = VectorReplicate(detSub, 0);
+		const VectorRegister detB = VectorReplicate(detSub, 1);
+		const VectorRegister detC = VectorReplicate(detSub, 2);
+		const VectorRegister detD = VectorReplicate(detSub, 3);
+
+		// X#表示X的伴随矩阵
+		const VectorRegister D_C = Mat2AdjMul(D, C);
+		const VectorRegister A_B = Mat2AdjMul(A, B);
+
+		// X# = |D|A - B(D#C)
+		VectorRegister X_ = VectorSubtract(VectorMultiply(detD, A), Mat2Mul(B, D_C));
+		// W# = |A|D - C(A#B)
+		VectorRegister W_ = VectorSubtract(VectorMultiply(detA, D), Mat2Mul(C, A_B));
+		// Y# = |B|C - D(A#B)#
+		VectorRegister Y_ = VectorSubtract(VectorMultiply(detB, C), Mat2MulAdj(D, A_B));
+		// Z# = |C|B - A(D#C)#
+		VectorRegister Z_ = VectorSubtract(VectorMultiply(detC, B), Mat2MulAdj(A, D_C));
+
+		// |M| = |A||D| + |B||C| - tr((A#B)(D#C))
+		VectorRegister tr = VectorMultiply(A_B, VectorSwizzle(D_C, 0, 2, 1, 3));
+		tr = VectorAdd(tr, VectorSwizzle(tr, 2, 3, 0, 1));
+		tr = VectorAdd(tr, VectorSwizzle(tr, 1, 0, 3, 2));
+		VectorRegister detM = VectorMultiply(detA, detD);
+		detM = VectorMultiplyAdd(detB, detC, detM);
+		detM = VectorSubtract(detM, tr);
+
+		const VectorRegister rDetM = VectorDivide(VectorSet(1.0f, -1.0f, -1.0f, 1.0f), detM);
+		X_ = VectorMultiply(X_, rDetM);
+		Y_ = VectorMultiply(Y_, rDetM);
+		Z_ = VectorMultiply(Z_, rDetM);
+		W_ = VectorMultiply(W_, rDetM);
+
+		// 伴随矩阵的重排与写回合并为一次shuffle
+		VectorStore(VectorShuffle(X_, Y_, 3, 1, 3, 1), dst + 0);
+		VectorStore(VectorShuffle(X_, Y_, 2, 0, 2, 0), dst + 4);
+		VectorStore(VectorShuffle(Z_, W_, 3, 1, 3, 1), dst + 8);
+		VectorStore(VectorShuffle(Z_, W_, 2, 0, 2, 0), dst + 12);
+	}
+
+private:
+	// 2x2 a * b
+	static FORCE_INLINE VectorRegister Mat2Mul(const VectorRegister& a, const VectorRegister& b)
+	{
+		return VectorAdd(
+			VectorMultiply(a, VectorSwizzle(b, 0, 3, 0, 3)),
+			VectorMultiply(VectorSwizzle(a, 1, 0, 3, 2), VectorSwizzle(b, 2, 1, 2, 1))
+		);
+	}
+
+	// 2x2 a# * b
+	static FORCE_INLINE VectorRegister Mat2AdjMul(const VectorRegister& a, const VectorRegister& b)
+	{
+		return VectorSubtract(
+			VectorMultiply(VectorSwizzle(a, 3, 3, 0, 0), b),
+			VectorMultiply(VectorSwizzle(a, 1, 1, 2, 2), VectorSwizzle(b, 2, 3, 0, 1))
+		);
+	}
+
+	// 2x2 a * b#
+	static FORCE_INLINE VectorRegister Mat2MulAdj(const VectorRegister& a, const VectorRegister& b)
+	{
+		return VectorSubtract(
+			VectorMultiply(a, VectorSwizzle(b, 3, 0, 3, 0)),
+			VectorMultiply(VectorSwizzle(a, 1, 0, 3, 2), VectorSwizzle(b, 2, 1, 2, 1))
+		);
+	}
+};
+
+#endif
@@ -121,6 +121,8 @@ public:
 
 	FORCE_INLINE Vector4 TransformVector4(const Vector4& v) const;
 
+	FORCE_INLINE void TransformVectors(const Vector4* src, Vector4* dst, int32 count) const;
+
 	FORCE_INLINE Vector4 TransformPosition(const Vector3 &v) const;
 
 	FORCE_INLINE Vector3 InverseTransformPosition(const Vector3 &v) const;
@@ -910,6 +912,11 @@ FORCE_INLINE Vector4 Matrix4x4::TransformVector4(const Vector4 &v) const
 	return result;
 }
 
+FORCE_INLINE void Matrix4x4::TransformVectors(const Vector4* src, Vector4* dst, int32 count) const
+{
+	MMath::VectorTransformVectors(dst, src, count, this);
+}
+
 FORCE_INLINE Vector4 Matrix4x4::TransformPosition(const Vector3 &v) const
 {
 	return TransformVector4(Vector4(v.x, v.y, v.z, 1.0f));
@@ -0,0 +1,343 @@
+#include "CPUProfiler.h"
+#include "Common/Log.h"
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <cstdio>
+
+enum
+{
+    RingSize        = 16384,
+    RingMask        = RingSize - 1,
+    MaxTraceEvents  = 1 << 20,
+    CalibrateCount  = 4096,
+};
+
+// 每个线程一个，只有所属线程写head，只有EndFrame所在线程写tail
+struct ThreadBuffer
+{
+    CPUProfiler::Event      events[RingSize];
+    std::atomic<uint32>     head;
+    std::atomic<uint32>     tail;
+    std::atomic<uint32>     dropped;
+    uint32                  threadId = 0;
+    const char*             name = nullptr;
+
+    ThreadBuffer()
+        : head(0)
+        , tail(0)
+        , dropped(0)
+    {
+
+    }
+};
+
+struct ZoneStats
+{
+    uint64  frameCycles = 0;
+    uint32  frameCalls = 0;
+    uint64  totalCycles = 0;
+    uint64  totalCalls = 0;
+    uint64  maxFrameCycles = 0;
+    uint32  numFrames = 0;
+};
+
+struct TraceEvent
+{
+    CPUProfiler::Event  event;
+    uint32              threadId;
+};
+
+bool CPUProfiler::s_Enabled = false;
+
+static bool                                         s_Capture = false;
+static std::mutex                                   s_Mutex;
+static std::vector<std::unique_ptr<ThreadBuffer>>   s_Threads;
+static std::unordered_map<const char*, ZoneStats>   s_Zones;
+static std::vector<TraceEvent>                      s_TraceEvents;
+static uint32                                       s_TraceDropped = 0;
+static uint64                                       s_StartCycles = 0;
+static uint64                                       s_FrameStartCycles = 0;
+static uint64                                       s_TotalFrameCycles = 0;
+static uint64                                       s_TotalEvents = 0;
+static uint32                                       s_NumFrames = 0;
+static double                                       s_ScopeCycles = 0.0;
+
+static thread_local ThreadBuffer*                   t_Buffer = nullptr;
+static thread_local const char*                     t_ThreadName = nullptr;
+
+static ThreadBuffer* RegisterThread()
+{
+    std::lock_guard<std::mutex> lock(s_Mutex);
+
+    ThreadBuffer* buffer = new ThreadBuffer();
+    buffer->threadId = (uint32)s_Threads.size();
+    buffer->name     = t_ThreadName;
+    s_Threads.push_back(std::unique_ptr<ThreadBuffer>(buffer));
+
+    return buffer;
+}
+
+void CPUProfiler::Enable(bool enable)
+{
+#if ENABLE_CPU_PROFILER
+    if (!enable || s_Enabled)
+    {
+        s_Enabled = enable;
+        return;
+    }
+
+    if (t_ThreadName == nullptr)
+    {
+        SetThreadName("Main");
+    }
+    if (t_Buffer == nullptr)
+    {
+        t_Buffer = RegisterThread();
+    }
+
+    // 空scope的耗时即为计时本身的开销，测完丢弃这些事件
+    s_Enabled = true;
+    uint64 beginCycles = GenericPlatformTime::Cycles64();
+    for (int32 i = 0; i < CalibrateCount; ++i)
+    {
+        CPUProfileScope scope("CPUProfiler::Calibrate");
+    }
+    s_ScopeCycles = (double)(GenericPlatformTime::Cycles64() - beginCycles) / CalibrateCount;
+
+    {
+        std::lock_guard<std::mutex> lock(s_Mutex);
+        t_Buffer->tail.store(t_Buffer->head.load(std::memory_order_acquire), std::memory_order_release);
+        t_Buffer->dropped.store(0, std::memory_order_relaxed);
+    }
+
+    s_StartCycles      = GenericPlatformTime::Cycles64();
+    s_FrameStartCycles = s_StartCycles;
+
+    MLOG("CPU profiler : %.1fns per scope", s_ScopeCycles * GenericPlatformTime::GetSecondsPerCycle() * 1000000000.0);
+#else
+    if (enable)
+    {
+        MLOG("CPU profiler : compiled out, set ENABLE_CPU_PROFILER to 1.");
+    }
+#endif
+}
+
+void CPUProfiler::SetCapture(bool capture)
+{
+    std::lock_guard<std::mutex> lock(s_Mutex);
+    s_Capture = capture;
+}
+
+void CPUProfiler::SetThreadName(const char* name)
+{
+    t_ThreadName = name;
+    if (t_Buffer)
+    {
+        std::lock_guard<std::mutex> lock(s_Mutex);
+        t_Buffer->name = name;
+    }
+}
+
+void CPUProfiler::AddEvent(const char* name, uint64 begin, uint64 end)
+{
+    ThreadBuffer* buffer = t_Buffer;
+    if (buffer == nullptr)
+    {
+        buffer   = RegisterThread();
+        t_Buffer = buffer;
+    }
+
+    // ring满时丢弃新事件，不覆盖尚未汇总的数据
+    uint32 head = buffer->head.load(std::memory_order_relaxed);
+    if (head - buffer->tail.load(std::memory_order_acquire) >= RingSize)
+    {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Event& event = buffer->events[head & RingMask];
+    event.name  = name;
+    event.begin = begin;
+    event.end   = end;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void CPUProfiler::EndFrame()
+{
+    if (!s_Enabled)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(s_Mutex);
+
+    for (int32 i = 0; i < s_Threads.size(); ++i)
+    {
+        ThreadBuffer* buffer = s_Threads[i].get();
+        uint32 tail = buffer->tail.load(std::memory_order_relaxed);
+        uint32 head = buffer->head.load(std::memory_order_acquire);
+
+        for (uint32 index = tail; index != head; ++index)
+        {
+            const Event& event = buffer->events[index & RingMask];
+
+            ZoneStats& zone   = s_Zones[event.name];
+            zone.frameCycles += event.end - event.begin;
+            zone.frameCalls  += 1;
+
+            if (s_Capture)
+            {
+                if (s_TraceEvents.size() < MaxTraceEvents)
+                {
+                    TraceEvent traceEvent;
+                    traceEvent.event    = event;
+                    traceEvent.threadId = buffer->threadId;
+                    s_TraceEvents.push_back(traceEvent);
+                }
+                else
+                {
+                    s_TraceDropped += 1;
+                }
+            }
+        }
+
+        s_TotalEvents += head - tail;
+        buffer->tail.store(head, std::memory_order_release);
+    }
+
+    for (auto it = s_Zones.begin(); it != s_Zones.end(); ++it)
+    {
+        ZoneStats& zone = it->second;
+        if (zone.frameCalls == 0)
+        {
+            continue;
+        }
+        zone.totalCycles   += zone.frameCycles;
+        zone.totalCalls    += zone.frameCalls;
+        zone.maxFrameCycles = zone.frameCycles > zone.maxFrameCycles ? zone.frameCycles : zone.maxFrameCycles;
+        zone.numFrames     += 1;
+        zone.frameCycles    = 0;
+        zone.frameCalls     = 0;
+    }
+
+    uint64 nowCycles    = GenericPlatformTime::Cycles64();
+    s_TotalFrameCycles += nowCycles - s_FrameStartCycles;
+    s_FrameStartCycles  = nowCycles;
+    s_NumFrames        += 1;
+}
+
+static void WriteJsonString(FILE* file, const char* str)
+{
+    fputc('"', file);
+    for (const char* c = str ? str : "unknown"; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+            fputc(*c, file);
+        }
+        else if ((uint8)*c >= 0x20) {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+bool CPUProfiler::WriteChromeTrace(const std::string& filepath)
+{
+    std::lock_guard<std::mutex> lock(s_Mutex);
+
+    FILE* file = fopen(filepath.c_str(), "w");
+    if (!file)
+    {
+        MLOGE("Failed write cpu trace : %s", filepath.c_str());
+        return false;
+    }
+
+    const double microseconds = GenericPlatformTime::GetSecondsPerCycle() * 1000000.0;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    bool first = true;
+    for (int32 i = 0; i < s_Threads.size(); ++i)
+    {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", s_Threads[i]->threadId);
+        WriteJsonString(file, s_Threads[i]->name ? s_Threads[i]->name : "Thread");
+        fprintf(file, "}}");
+        first = false;
+    }
+
+    for (int32 i = 0; i < s_TraceEvents.size(); ++i)
+    {
+        const TraceEvent& traceEvent = s_TraceEvents[i];
+        // 开启之前就已开始的scope从开启时刻算起
+        uint64 begin = traceEvent.event.begin > s_StartCycles ? traceEvent.event.begin - s_StartCycles : 0;
+        uint64 end   = traceEvent.event.end   > s_StartCycles ? traceEvent.event.end   - s_StartCycles : 0;
+
+        fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+        WriteJsonString(file, traceEvent.event.name);
+        fprintf(file, ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", traceEvent.threadId, begin * microseconds, (end - begin) * microseconds);
+        first = false;
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    MLOG("CPU profiler : %d events written to %s, %d dropped", (int32)s_TraceEvents.size(), filepath.c_str(), s_TraceDropped);
+    return true;
+}
+
+void CPUProfiler::PrintStats()
+{
+    std::lock_guard<std::mutex> lock(s_Mutex);
+
+    if (s_NumFrames == 0)
+    {
+        return;
+    }
+
+    // 不同编译单元中相同的字面量地址可能不同，按名字合并
+    std::map<std::string, ZoneStats> zones;
+    for (auto it = s_Zones.begin(); it != s_Zones.end(); ++it)
+    {
+        ZoneStats& zone     = zones[it->first];
+        zone.totalCycles   += it->second.totalCycles;
+        zone.totalCalls    += it->second.totalCalls;
+        zone.maxFrameCycles = it->second.maxFrameCycles > zone.maxFrameCycles ? it->second.maxFrameCycles : zone.maxFrameCycles;
+        zone.numFrames      = it->second.numFrames > zone.numFrames ? it->second.numFrames : zone.numFrames;
+    }
+
+    uint32 dropped = 0;
+    for (int32 i = 0; i < s_Threads.size(); ++i)
+    {
+        dropped += s_Threads[i]->dropped.load(std::memory_order_relaxed);
+    }
+
+    const double milliseconds = GenericPlatformTime::GetSecondsPerCycle() * 1000.0;
+    const double overhead     = s_TotalFrameCycles > 0 ? s_TotalEvents * s_ScopeCycles / s_TotalFrameCycles * 100.0 : 0.0;
+
+    MLOG("CPU profiler : %d frames, avg %.3fms, %d threads, %.1f scopes per frame, overhead %.3f%%, %d dropped",
+        s_NumFrames,
+        s_TotalFrameCycles * milliseconds / s_NumFrames,
+        (int32)s_Threads.size(),
+        (double)s_TotalEvents / s_NumFrames,
+        overhead,
+        dropped
+    );
+
+    for (auto it = zones.begin(); it != zones.end(); ++it)
+    {
+        const ZoneStats& zone = it->second;
+        MLOG("  %-32s : %.3fms per frame, max %.3fms, %.1f calls per frame, %d frames",
+            it->first.c_str(),
+            zone.totalCycles * milliseconds / s_NumFrames,
+            zone.maxFrameCycles * milliseconds,
+            (double)zone.totalCalls / s_NumFrames,
+            zone.numFrames
+        );
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Common/Common.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+
+#include <string>
+
+// CPU分段计时。CPU_PROFILE_SCOPE在作用域开始与结束各取一次GenericPlatformTime::Cycles64()，
+// 结束时写入当前线程自己的ring buffer(单生产者单消费者，无锁)，主线程每帧EndFrame时汇总所有线程。
+// 未开启时每个scope只多一次分支判断；ENABLE_CPU_PROFILER为0时宏不产生任何代码。
+class CPUProfiler
+{
+public:
+    struct Event
+    {
+        const char* name;   // 必须是生命周期足够长的字符串，通常是字面量
+        uint64      begin;
+        uint64      end;
+    };
+
+    // 开启时测量单个scope的开销，用于PrintStats中估算计时本身的占比
+    static void Enable(bool enable);
+
+    static FORCE_INLINE bool IsEnabled()
+    {
+        return s_Enabled;
+    }
+
+    // 开启后汇总时保留每个事件，用于WriteChromeTrace
+    static void SetCapture(bool capture);
+
+    // 设置当前线程在trace中显示的名字，name必须是字面量
+    static void SetThreadName(const char* name);
+
+    static void AddEvent(const char* name, uint64 begin, uint64 end);
+
+    // 每帧结束时在主线程调用
+    static void EndFrame();
+
+    // 导出Chrome trace_event格式的JSON，可在chrome://tracing或Perfetto中打开
+    static bool WriteChromeTrace(const std::string& filepath);
+
+    static void PrintStats();
+
+private:
+    static bool s_Enabled;
+};
+
+class CPUProfileScope
+{
+public:
+    FORCE_INLINE CPUProfileScope(const char* name)
+        : m_Name(name)
+        , m_Begin(CPUProfiler::IsEnabled() ? GenericPlatformTime::Cycles64() : 0)
+    {
+
+    }
+
+    FORCE_INLINE ~CPUProfileScope()
+    {
+        if (m_Begin != 0)
+        {
+            CPUProfiler::AddEvent(m_Name, m_Begin, GenericPlatformTime::Cycles64());
+        }
+    }
+
+private:
+    const char* m_Name;
+    uint64      m_Begin;
+};
+
+#if ENABLE_CPU_PROFILER
+    #define CPU_PROFILE_CONCAT_INNER(a, b) a##b
+    #define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT_INNER(a, b)
+    #define CPU_PROFILE_SCOPE(name) CPUProfileScope CPU_PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
+#else
+    #define CPU_PROFILE_SCOPE(name)
+#endif
@@ -0,0 +1,408 @@
+#include "TLSFAllocator.h"
+#include "Alignment.h"
+
+#include "Common/Log.h"
+#include "Math/Math.h"
+
+FORCE_INLINE static uint32 FindLastSet(uint32 value)
+{
+    return 31 - MMath::CountLeadingZeros(value);
+}
+
+FORCE_INLINE static uint32 FindFirstSet(uint32 value)
+{
+    return MMath::CountTrailingZeros(value);
+}
+
+TLSFAllocator::TLSFAllocator()
+{
+    Init(0);
+}
+
+TLSFAllocator::TLSFAllocator(uint32 size)
+{
+    Init(size);
+}
+
+void TLSFAllocator::Init(uint32 size)
+{
+    m_Blocks.clear();
+    m_UnusedBlocks.clear();
+
+    m_FLBitmap      = 0;
+    m_MaxSize       = size;
+    m_UsedSize      = 0;
+    m_NumFreeBlocks = 0;
+
+    for (int32 fl = 0; fl < FL_INDEX_COUNT; ++fl)
+    {
+        m_SLBitmap[fl] = 0;
+        for (int32 sl = 0; sl < SL_INDEX_COUNT; ++sl)
+        {
+            m_Heads[fl][sl] = InvalidBlock;
+        }
+    }
+
+    if (size == 0)
+    {
+        return;
+    }
+
+    uint32 index = NewBlock();
+    Block& block = m_Blocks[index];
+    block.offset = 0;
+    block.size   = size;
+    InsertFreeBlock(index);
+}
+
+void TLSFAllocator::MappingInsert(uint32 size, uint32& fl, uint32& sl)
+{
+    if (size < SMALL_BLOCK_SIZE)
+    {
+        fl = 0;
+        sl = size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT);
+    }
+    else
+    {
+        fl = FindLastSet(size);
+        sl = (size >> (fl - SL_INDEX_COUNT_LOG2)) ^ (1 << SL_INDEX_COUNT_LOG2);
+        fl = fl - (FL_INDEX_SHIFT - 1);
+    }
+}
+
+bool TLSFAllocator::MappingSearch(uint64 size, uint32& fl, uint32& sl)
+{
+    // 向上取整到下一个二级区间，保证该区间内的任意块都能满足请求
+    if (size >= SMALL_BLOCK_SIZE)
+    {
+        uint32 lastSet = (uint32)MMath::FloorLog2_64(size);
+        size += ((uint64)1 << (lastSet - SL_INDEX_COUNT_LOG2)) - 1;
+    }
+    else
+    {
+        size += (SMALL_BLOCK_SIZE / SL_INDEX_COUNT) - 1;
+    }
+
+    if (size > 0xFFFFFFFF)
+    {
+        return false;
+    }
+
+    MappingInsert((uint32)size, fl, sl);
+    return true;
+}
+
+uint32 TLSFAllocator::FindFreeBlock(uint64 size) const
+{
+    uint32 fl = 0;
+    uint32 sl = 0;
+    if (!MappingSearch(size, fl, sl))
+    {
+        return InvalidBlock;
+    }
+
+    uint32 slMap = m_SLBitmap[fl] & (~0u << sl);
+    if (slMap == 0)
+    {
+        uint32 flMap = fl + 1 < 32 ? m_FLBitmap & (~0u << (fl + 1)) : 0;
+        if (flMap == 0)
+        {
+            return InvalidBlock;
+        }
+        fl    = FindFirstSet(flMap);
+        slMap = m_SLBitmap[fl];
+    }
+
+    sl = FindFirstSet(slMap);
+    return m_Heads[fl][sl];
+}
+
+uint32 TLSFAllocator::FindFreeBlockInClass(uint32 size, uint32 alignment) const
+{
+    uint32 fl = 0;
+    uint32 sl = 0;
+    MappingInsert(size, fl, sl);
+
+    for (uint32 index = m_Heads[fl][sl]; index != InvalidBlock; index = m_Blocks[index].nextFree)
+    {
+        const Block& block = m_Blocks[index];
+        if ((uint64)Align(block.offset, alignment) - block.offset + size <= block.size)
+        {
+            return index;
+        }
+    }
+
+    return InvalidBlock;
+}
+
+uint32 TLSFAllocator::NewBlock()
+{
+    uint32 index = 0;
+    if (m_UnusedBlocks.size() > 0)
+    {
+        index = m_UnusedBlocks.back();
+        m_UnusedBlocks.pop_back();
+    }
+    else
+    {
+        index = (uint32)m_Blocks.size();
+        m_Blocks.push_back(Block());
+    }
+
+    Block& block       = m_Blocks[index];
+    block.offset       = 0;
+    block.size         = 0;
+    block.prevPhysical = InvalidBlock;
+    block.nextPhysical = InvalidBlock;
+    block.prevFree     = InvalidBlock;
+    block.nextFree     = InvalidBlock;
+    block.free         = false;
+    return index;
+}
+
+void TLSFAllocator::InsertFreeBlock(uint32 index)
+{
+    Block& block = m_Blocks[index];
+
+    uint32 fl = 0;
+    uint32 sl = 0;
+    MappingInsert(block.size, fl, sl);
+
+    uint32 head    = m_Heads[fl][sl];
+    block.free     = true;
+    block.prevFree = InvalidBlock;
+    block.nextFree = head;
+    if (head != InvalidBlock)
+    {
+        m_Blocks[head].prevFree = index;
+    }
+
+    m_Heads[fl][sl] = index;
+    m_FLBitmap     |= 1u << fl;
+    m_SLBitmap[fl] |= 1u << sl;
+    m_NumFreeBlocks += 1;
+}
+
+void TLSFAllocator::RemoveFreeBlock(uint32 index)
+{
+    Block& block = m_Blocks[index];
+
+    uint32 fl = 0;
+    uint32 sl = 0;
+    MappingInsert(block.size, fl, sl);
+
+    if (block.prevFree != InvalidBlock)
+    {
+        m_Blocks[block.prevFree].nextFree = block.nextFree;
+    }
+    if (block.nextFree != InvalidBlock)
+    {
+        m_Blocks[block.nextFree].prevFree = block.prevFree;
+    }
+
+    if (m_Heads[fl][sl] == index)
+    {
+        m_Heads[fl][sl] = block.nextFree;
+        if (block.nextFree == InvalidBlock)
+        {
+            m_SLBitmap[fl] &= ~(1u << sl);
+            if (m_SLBitmap[fl] == 0)
+            {
+                m_FLBitmap &= ~(1u << fl);
+            }
+        }
+    }
+
+    block.free     = false;
+    block.prevFree = InvalidBlock;
+    block.nextFree = InvalidBlock;
+    m_NumFreeBlocks -= 1;
+}
+
+bool TLSFAllocator::Allocate(uint32 size, uint32 alignment, Allocation& outAllocation)
+{
+    size      = MMath::Max(size, 1u);
+    alignment = MMath::Max(alignment, 1u);
+
+    // 先按请求大小查找，空闲块多数已经对齐；放不下时再按最坏的对齐填充查找
+    uint32 index = FindFreeBlock(size);
+    if (index != InvalidBlock)
+    {
+        const Block& block = m_Blocks[index];
+        if ((uint64)Align(block.offset, alignment) - block.offset + size > block.size)
+        {
+            index = InvalidBlock;
+        }
+    }
+
+    if (index == InvalidBlock && alignment > 1)
+    {
+        index = FindFreeBlock((uint64)size + alignment - 1);
+    }
+
+    // 向上取整会跳过与请求同一区间的块，例如刚好等于请求大小的整页，最后在该区间内逐个检查
+    if (index == InvalidBlock)
+    {
+        index = FindFreeBlockInClass(size, alignment);
+    }
+
+    if (index == InvalidBlock)
+    {
+        return false;
+    }
+
+    RemoveFreeBlock(index);
+
+    uint32 alignedOffset = Align(m_Blocks[index].offset, alignment);
+    uint32 allocatedSize = alignedOffset - m_Blocks[index].offset + size;
+
+    // 剩余部分拆分为新的空闲块
+    if (m_Blocks[index].size > allocatedSize)
+    {
+        uint32 remain = NewBlock();
+        Block& block  = m_Blocks[index];
+        Block& tail   = m_Blocks[remain];
+
+        tail.offset       = block.offset + allocatedSize;
+        tail.size         = block.size - allocatedSize;
+        tail.prevPhysical = index;
+        tail.nextPhysical = block.nextPhysical;
+        if (block.nextPhysical != InvalidBlock)
+        {
+            m_Blocks[block.nextPhysical].prevPhysical = remain;
+        }
+
+        block.nextPhysical = remain;
+        block.size         = allocatedSize;
+        InsertFreeBlock(remain);
+    }
+
+    m_UsedSize += allocatedSize;
+
+    outAllocation.block         = index;
+    outAllocation.offset        = m_Blocks[index].offset;
+    outAllocation.alignedOffset = alignedOffset;
+    outAllocation.size          = allocatedSize;
+    return true;
+}
+
+void TLSFAllocator::MergePhysical(uint32 index, uint32 next)
+{
+    Block& block = m_Blocks[index];
+    Block& other = m_Blocks[next];
+
+    block.size        += other.size;
+    block.nextPhysical = other.nextPhysical;
+    if (other.nextPhysical != InvalidBlock)
+    {
+        m_Blocks[other.nextPhysical].prevPhysical = index;
+    }
+
+    other.size = 0;
+    m_UnusedBlocks.push_back(next);
+}
+
+void TLSFAllocator::Free(uint32 index)
+{
+    if (index >= m_Blocks.size() || m_Blocks[index].free)
+    {
+        MLOGE("Invalid TLSF block %d.", (int32)index);
+        return;
+    }
+
+    m_UsedSize -= m_Blocks[index].size;
+
+    // 与物理相邻的空闲块合并
+    uint32 prev = m_Blocks[index].prevPhysical;
+    if (prev != InvalidBlock && m_Blocks[prev].free)
+    {
+        RemoveFreeBlock(prev);
+        MergePhysical(prev, index);
+        index = prev;
+    }
+
+    uint32 next = m_Blocks[index].nextPhysical;
+    if (next != InvalidBlock && m_Blocks[next].free)
+    {
+        RemoveFreeBlock(next);
+        MergePhysical(index, next);
+    }
+
+    InsertFreeBlock(index);
+}
+
+uint32 TLSFAllocator::GetLargestFreeBlock() const
+{
+    if (m_FLBitmap == 0)
+    {
+        return 0;
+    }
+
+    // 最高的非空区间里的块一定比其余区间大，只需比较该区间内的块
+    uint32 fl      = FindLastSet(m_FLBitmap);
+    uint32 sl      = FindLastSet(m_SLBitmap[fl]);
+    uint32 largest = 0;
+    for (uint32 index = m_Heads[fl][sl]; index != InvalidBlock; index = m_Blocks[index].nextFree)
+    {
+        largest = MMath::Max(largest, m_Blocks[index].size);
+    }
+    return largest;
+}
+
+bool TLSFAllocator::Validate() const
+{
+    if (m_MaxSize == 0)
+    {
+        return true;
+    }
+
+    // 物理链表从偏移0的块开始，必须首尾相接地覆盖整个区间
+    uint32 first = InvalidBlock;
+    for (uint32 i = 0; i < m_Blocks.size(); ++i)
+    {
+        if (m_Blocks[i].size > 0 && m_Blocks[i].offset == 0 && m_Blocks[i].prevPhysical == InvalidBlock)
+        {
+            first = i;
+            break;
+        }
+    }
+
+    if (first == InvalidBlock)
+    {
+        return false;
+    }
+
+    uint32 offset    = 0;
+    uint32 used      = 0;
+    uint32 numFree   = 0;
+    bool   prevFree  = false;
+    for (uint32 index = first; index != InvalidBlock; index = m_Blocks[index].nextPhysical)
+    {
+        const Block& block = m_Blocks[index];
+        if (block.offset != offset || (block.free && prevFree))
+        {
+            return false;
+        }
+
+        if (block.free)
+        {
+            uint32 fl = 0;
+            uint32 sl = 0;
+            MappingInsert(block.size, fl, sl);
+            if ((m_SLBitmap[fl] & (1u << sl)) == 0)
+            {
+                return false;
+            }
+            numFree += 1;
+        }
+        else
+        {
+            used += block.size;
+        }
+
+        prevFree = block.free;
+        offset  += block.size;
+    }
+
+    return offset == m_MaxSize && used == m_UsedSize && numFree == m_NumFreeBlocks;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "Common/Common.h"
+
+#include <vector>
+
+// 两级分离适配(TLSF)的区间分配器，只管理偏移，不持有实际内存。
+// 一级按2的幂划分，二级再把每个区间等分为32份，用位图在O(1)内找到合适的空闲块；
+// 释放时通过物理相邻链表立即与前后空闲块合并，同样是O(1)。
+class TLSFAllocator
+{
+public:
+    enum
+    {
+        InvalidBlock = 0xFFFFFFFF,
+    };
+
+    struct Allocation
+    {
+        uint32  block;
+        uint32  offset;         // 块起始位置，包含对齐填充
+        uint32  alignedOffset;  // 对齐后的偏移
+        uint32  size;           // 填充 + 请求大小
+    };
+
+public:
+    TLSFAllocator();
+
+    explicit TLSFAllocator(uint32 size);
+
+    void Init(uint32 size);
+
+    bool Allocate(uint32 size, uint32 alignment, Allocation& outAllocation);
+
+    void Free(uint32 block);
+
+    FORCE_INLINE bool IsEmpty() const
+    {
+        return m_UsedSize == 0;
+    }
+
+    FORCE_INLINE uint32 GetMaxSize() const
+    {
+        return m_MaxSize;
+    }
+
+    FORCE_INLINE uint32 GetUsedSize() const
+    {
+        return m_UsedSize;
+    }
+
+    FORCE_INLINE uint32 GetNumFreeBlocks() const
+    {
+        return m_NumFreeBlocks;
+    }
+
+    FORCE_INLINE uint32 GetNumUsedBlocks() const
+    {
+        return (uint32)(m_Blocks.size() - m_UnusedBlocks.size()) - m_NumFreeBlocks;
+    }
+
+    // 最大的空闲块，用于统计碎片
+    uint32 GetLargestFreeBlock() const;
+
+    // 遍历物理块检查链表与位图是否一致，仅用于调试与测试
+    bool Validate() const;
+
+private:
+    enum
+    {
+        SL_INDEX_COUNT_LOG2 = 5,
+        SL_INDEX_COUNT      = 1 << SL_INDEX_COUNT_LOG2,
+        ALIGN_SIZE_LOG2     = 2,
+        FL_INDEX_SHIFT      = SL_INDEX_COUNT_LOG2 + ALIGN_SIZE_LOG2,
+        FL_INDEX_COUNT      = 32 - FL_INDEX_SHIFT + 1,
+        SMALL_BLOCK_SIZE    = 1 << FL_INDEX_SHIFT,
+    };
+
+    struct Block
+    {
+        uint32  offset;
+        uint32  size;
+        uint32  prevPhysical;
+        uint32  nextPhysical;
+        uint32  prevFree;
+        uint32  nextFree;
+        bool    free;
+    };
+
+    static void MappingInsert(uint32 size, uint32& fl, uint32& sl);
+
+    static bool MappingSearch(uint64 size, uint32& fl, uint32& sl);
+
+    uint32 FindFreeBlock(uint64 size) const;
+
+    uint32 FindFreeBlockInClass(uint32 size, uint32 alignment) const;
+
+    uint32 NewBlock();
+
+    void InsertFreeBlock(uint32 index);
+
+    void RemoveFreeBlock(uint32 index);
+
+    void MergePhysical(uint32 index, uint32 next);
+
+private:
+    std::vector<Block>  m_Blocks;
+    std::vector<uint32> m_UnusedBlocks;
+    uint32              m_Heads[FL_INDEX_COUNT][SL_INDEX_COUNT];
+    uint32              m_SLBitmap[FL_INDEX_COUNT];
+    uint32              m_FLBitmap;
+    uint32              m_MaxSize;
+    uint32              m_UsedSize;
+    uint32              m_NumFreeBlocks;
+};
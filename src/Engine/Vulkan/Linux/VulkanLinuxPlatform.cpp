@@ -0,0 +1,41 @@
+#include "Configuration/Platform.h"
+#include "Application/Application.h"
+
+#include "Engine.h"
+
+#include "Vulkan/Linux/VulkanPlatformDefines.h"
+#include "Vulkan/VulkanRHI.h"
+#include "Vulkan/VulkanGlobals.h"
+
+static PFN_vkGetInstanceProcAddr G_GetInstanceProcAddr = nullptr;
+
+bool VulkanLinuxPlatform::LoadVulkanLibrary()
+{
+	return true;
+}
+
+bool VulkanLinuxPlatform::LoadVulkanInstanceFunctions(VkInstance instance)
+{
+	G_GetInstanceProcAddr = vkGetInstanceProcAddr;
+	return true;
+}
+
+void VulkanLinuxPlatform::FreeVulkanLibrary()
+{
+
+}
+
+void VulkanLinuxPlatform::GetInstanceExtensions(std::vector<const char*>& outExtensions)
+{
+
+}
+
+void VulkanLinuxPlatform::GetDeviceExtensions(std::vector<const char*>& outExtensions)
+{
+
+}
+
+void VulkanLinuxPlatform::CreateSurface(VkInstance instance, VkSurfaceKHR* outSurface)
+{
+	*outSurface = VK_NULL_HANDLE;
+}
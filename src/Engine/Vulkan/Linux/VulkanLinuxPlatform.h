@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "Common/Common.h"
+#include "Vulkan/VulkanGenericPlatform.h"
+
+// Linux平台只支持离屏渲染，不依赖任何窗口系统扩展，lavapipe等软件驱动也可以运行。
+class VulkanLinuxPlatform : public VulkanGenericPlatform
+{
+public:
+	static bool LoadVulkanLibrary();
+
+	static bool LoadVulkanInstanceFunctions(VkInstance instance);
+
+	static void FreeVulkanLibrary();
+
+	static void GetInstanceExtensions(std::vector<const char*>& outExtensions);
+
+	static void GetDeviceExtensions(std::vector<const char*>& outExtensions);
+
+	static void CreateSurface(VkInstance instance, VkSurfaceKHR* outSurface);
+
+	static bool SupportsSurface()
+	{
+		return false;
+	}
+};
+
+typedef VulkanLinuxPlatform VulkanPlatform;
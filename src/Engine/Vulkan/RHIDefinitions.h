@@ -80,6 +80,7 @@ enum VertexElementType
     VET_UShort2N,
     VET_UShort4N,
     VET_URGB10A2N,
+    VET_UInt3,
     VET_MAX,
     
     VET_NumBits = 5,
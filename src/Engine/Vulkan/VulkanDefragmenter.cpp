@@ -0,0 +1,407 @@
+#include "VulkanDefragmenter.h"
+#include "VulkanDevice.h"
+#include "VulkanQueue.h"
+#include "VulkanGlobals.h"
+
+#include "Common/Log.h"
+#include "Math/Math.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+
+#include <algorithm>
+
+VulkanResourceDefragmenter::VulkanResourceDefragmenter(VulkanDevice* device, int32 numFramesInFlight)
+    : m_Device(device)
+    , m_CommandPool(VK_NULL_HANDLE)
+    , m_CommandBuffer(VK_NULL_HANDLE)
+    , m_Fence(VK_NULL_HANDLE)
+    , m_Recording(false)
+    , m_Submitted(false)
+    , m_NumFramesInFlight(numFramesInFlight)
+    , m_FrameCounter(0)
+    , m_MaxOccupancy(0.5f)
+    , m_HasBaseline(false)
+    , m_NumMoved(0)
+    , m_NumMovedBytes(0)
+    , m_NumBatches(0)
+    , m_NumPagesReleased(0)
+    , m_CPUTime(0.0)
+{
+    VkDevice vkDevice = m_Device->GetInstanceHandle();
+
+    // 拷贝在graphics queue上执行，image不需要做queue ownership transfer
+    VkCommandPoolCreateInfo poolCreateInfo;
+    ZeroVulkanStruct(poolCreateInfo, VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO);
+    poolCreateInfo.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolCreateInfo.queueFamilyIndex = m_Device->GetGraphicsQueue()->GetFamilyIndex();
+    VERIFYVULKANRESULT(vkCreateCommandPool(vkDevice, &poolCreateInfo, VULKAN_CPU_ALLOCATOR, &m_CommandPool));
+
+    VkCommandBufferAllocateInfo allocateInfo;
+    ZeroVulkanStruct(allocateInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO);
+    allocateInfo.commandPool        = m_CommandPool;
+    allocateInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = 1;
+    VERIFYVULKANRESULT(vkAllocateCommandBuffers(vkDevice, &allocateInfo, &m_CommandBuffer));
+
+    VkFenceCreateInfo fenceCreateInfo;
+    ZeroVulkanStruct(fenceCreateInfo, VK_STRUCTURE_TYPE_FENCE_CREATE_INFO);
+    VERIFYVULKANRESULT(vkCreateFence(vkDevice, &fenceCreateInfo, VULKAN_CPU_ALLOCATOR, &m_Fence));
+}
+
+VulkanResourceDefragmenter::~VulkanResourceDefragmenter()
+{
+    Flush();
+    PrintStats();
+
+    VkDevice vkDevice = m_Device->GetInstanceHandle();
+    vkFreeCommandBuffers(vkDevice, m_CommandPool, 1, &m_CommandBuffer);
+    vkDestroyCommandPool(vkDevice, m_CommandPool, VULKAN_CPU_ALLOCATOR);
+    vkDestroyFence(vkDevice, m_Fence, VULKAN_CPU_ALLOCATOR);
+}
+
+void VulkanResourceDefragmenter::Update(double budgetSeconds, uint64 budgetBytes)
+{
+    double beginTime = GenericPlatformTime::Seconds();
+
+    m_FrameCounter += 1;
+
+    if (m_Submitted && vkGetFenceStatus(m_Device->GetInstanceHandle(), m_Fence) == VK_SUCCESS)
+    {
+        CompleteBatch();
+    }
+
+    RetireMoves(false);
+
+    // 同一时间只有一批拷贝在GPU上执行
+    if (!m_Submitted)
+    {
+        RecordMoves(budgetSeconds, budgetBytes);
+    }
+
+    m_CPUTime += GenericPlatformTime::Seconds() - beginTime;
+}
+
+void VulkanResourceDefragmenter::Flush()
+{
+    if (m_Submitted)
+    {
+        VERIFYVULKANRESULT(vkWaitForFences(m_Device->GetInstanceHandle(), 1, &m_Fence, VK_TRUE, MAX_uint64));
+        CompleteBatch();
+    }
+    RetireMoves(true);
+}
+
+void VulkanResourceDefragmenter::BeginCommandBuffer()
+{
+    if (m_Recording)
+    {
+        return;
+    }
+
+    VkCommandBufferBeginInfo beginInfo;
+    ZeroVulkanStruct(beginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VERIFYVULKANRESULT(vkBeginCommandBuffer(m_CommandBuffer, &beginInfo));
+
+    // 之前提交的帧可能还在写这些资源
+    VkMemoryBarrier barrier;
+    ZeroVulkanStruct(barrier, VK_STRUCTURE_TYPE_MEMORY_BARRIER);
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(m_CommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    m_Recording = true;
+}
+
+VulkanResourceHeapPage* VulkanResourceDefragmenter::FindSourcePage(std::vector<VulkanResourceHeapPage*>& pages, std::vector<VulkanResourceHeapPage*>& outTargets)
+{
+    if (pages.size() < 2)
+    {
+        return nullptr;
+    }
+
+    // 选择使用率最低、且所有分配都可以移动的page
+    VulkanResourceHeapPage* source = nullptr;
+    float sourceOccupancy = m_MaxOccupancy;
+    for (int32 index = 0; index < pages.size(); ++index)
+    {
+        VulkanResourceHeapPage* page = pages[index];
+        if (page->IsMapped() || page->m_ResourceAllocations.size() == 0)
+        {
+            continue;
+        }
+
+        float occupancy = (float)page->m_UsedSize / (float)page->m_MaxSize;
+        if (occupancy >= sourceOccupancy)
+        {
+            continue;
+        }
+
+        bool movable = true;
+        for (int32 i = 0; i < page->m_ResourceAllocations.size(); ++i)
+        {
+            if (page->m_ResourceAllocations[i]->m_Mover == nullptr)
+            {
+                movable = false;
+                break;
+            }
+        }
+
+        if (movable)
+        {
+            source          = page;
+            sourceOccupancy = occupancy;
+        }
+    }
+
+    if (source == nullptr)
+    {
+        return nullptr;
+    }
+
+    // 其余page按使用量从高到低作为目标，优先填满已经较满的page
+    uint64 freeBytes = 0;
+    for (int32 index = 0; index < pages.size(); ++index)
+    {
+        VulkanResourceHeapPage* page = pages[index];
+        if (page != source && !page->IsMapped())
+        {
+            outTargets.push_back(page);
+            freeBytes += page->m_MaxSize - page->m_UsedSize;
+        }
+    }
+
+    std::sort(outTargets.begin(), outTargets.end(), [](const VulkanResourceHeapPage* a, const VulkanResourceHeapPage* b) {
+        return a->m_UsedSize > b->m_UsedSize;
+    });
+
+    // 放不下整个page就不移动，否则搬迁后page仍然不能释放
+    if (freeBytes < source->m_UsedSize)
+    {
+        outTargets.clear();
+        return nullptr;
+    }
+
+    return source;
+}
+
+VulkanResourceAllocation* VulkanResourceDefragmenter::AllocateTarget(VulkanResourceAllocation* allocation, const std::vector<VulkanResourceHeapPage*>& targets)
+{
+    for (int32 index = 0; index < targets.size(); ++index)
+    {
+        VulkanResourceHeapPage* page = targets[index];
+        if (page->m_MaxSize - page->m_UsedSize < allocation->m_RequestedSize)
+        {
+            continue;
+        }
+
+        VulkanResourceAllocation* target = page->TryAllocate(allocation->m_RequestedSize, allocation->m_Alignment, allocation->m_File, allocation->m_Line);
+        if (target)
+        {
+            return target;
+        }
+    }
+    return nullptr;
+}
+
+void VulkanResourceDefragmenter::RecordMoves(double budgetSeconds, uint64 budgetBytes)
+{
+    double beginTime = GenericPlatformTime::Seconds();
+    uint64 numBytes  = 0;
+    bool   exhausted = false;
+
+    VulkanResourceHeapManager& heapManager = m_Device->GetResourceHeapManager();
+    for (int32 heapIndex = 0; heapIndex < heapManager.m_ResourceTypeHeaps.size() && !exhausted; ++heapIndex)
+    {
+        VulkanResourceHeap* heap = heapManager.m_ResourceTypeHeaps[heapIndex];
+        if (!heap)
+        {
+            continue;
+        }
+
+        std::vector<VulkanResourceHeapPage*>* pageLists[2] = { &heap->m_UsedBufferPages, &heap->m_UsedImagePages };
+        for (int32 listIndex = 0; listIndex < 2 && !exhausted; ++listIndex)
+        {
+            std::vector<VulkanResourceHeapPage*> targets;
+            VulkanResourceHeapPage* source = FindSourcePage(*pageLists[listIndex], targets);
+            if (!source)
+            {
+                continue;
+            }
+
+            for (int32 index = 0; index < source->m_ResourceAllocations.size(); ++index)
+            {
+                VulkanResourceAllocation* allocation = source->m_ResourceAllocations[index];
+                if (allocation->m_Moving)
+                {
+                    continue;
+                }
+
+                if (numBytes >= budgetBytes || GenericPlatformTime::Seconds() - beginTime >= budgetSeconds)
+                {
+                    exhausted = true;
+                    break;
+                }
+
+                VulkanResourceAllocation* target = AllocateTarget(allocation, targets);
+                if (!target)
+                {
+                    break;
+                }
+                target->AddRef();
+
+                // 本轮整理的第一次搬迁，记录整理前的统计
+                if (!m_HasBaseline)
+                {
+                    m_Baseline = VulkanResourceHeapStats();
+                    heapManager.GetStats(m_Baseline);
+                    m_HasBaseline = true;
+                }
+
+                BeginCommandBuffer();
+                if (!allocation->m_Mover->BeginMove(m_CommandBuffer, target))
+                {
+                    target->Release();
+                    break;
+                }
+
+                // 搬迁期间持有旧分配的引用，保证持有者提前销毁时旧page仍然有效
+                allocation->AddRef();
+                allocation->m_Moving = true;
+                target->m_Moving     = true;
+
+                Move move;
+                move.src         = allocation;
+                move.dst         = target;
+                move.mover       = allocation->m_Mover;
+                move.retireFrame = 0;
+                m_Moves.push_back(move);
+
+                numBytes += allocation->m_AllocationSize;
+            }
+        }
+    }
+
+    if (!m_Recording)
+    {
+        // 没有可以整理的page，本轮整理结束
+        if (m_HasBaseline && IsIdle())
+        {
+            PrintStats();
+            m_HasBaseline = false;
+        }
+        return;
+    }
+
+    // 拷贝结果对之后提交的帧可见
+    VkMemoryBarrier barrier;
+    ZeroVulkanStruct(barrier, VK_STRUCTURE_TYPE_MEMORY_BARRIER);
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier(m_CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    VERIFYVULKANRESULT(vkEndCommandBuffer(m_CommandBuffer));
+    m_Recording = false;
+
+    VkSubmitInfo submitInfo;
+    ZeroVulkanStruct(submitInfo, VK_STRUCTURE_TYPE_SUBMIT_INFO);
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers    = &m_CommandBuffer;
+    VERIFYVULKANRESULT(vkResetFences(m_Device->GetInstanceHandle(), 1, &m_Fence));
+    VERIFYVULKANRESULT(vkQueueSubmit(m_Device->GetGraphicsQueue()->GetHandle(), 1, &submitInfo, m_Fence));
+
+    m_Submitted      = true;
+    m_NumBatches    += 1;
+    m_NumMovedBytes += numBytes;
+}
+
+void VulkanResourceDefragmenter::CompleteBatch()
+{
+    for (int32 index = 0; index < m_Moves.size(); ++index)
+    {
+        Move& move = m_Moves[index];
+
+        // 持有者在拷贝期间被销毁，新资源已由持有者清理
+        if (move.src->m_Mover != move.mover)
+        {
+            CancelMove(move);
+            continue;
+        }
+
+        move.dst->m_Mover  = move.mover;
+        move.dst->m_Moving = false;
+        move.mover->CommitMove(move.dst);
+        move.dst->Release();
+        move.dst = nullptr;
+
+        move.retireFrame = m_FrameCounter + m_NumFramesInFlight;
+        m_Retiring.push_back(move);
+        m_NumMoved += 1;
+    }
+
+    m_Moves.clear();
+    m_Submitted = false;
+    VERIFYVULKANRESULT(vkResetCommandBuffer(m_CommandBuffer, 0));
+}
+
+void VulkanResourceDefragmenter::CancelMove(Move& move)
+{
+    move.dst->m_Moving = false;
+    move.dst->Release();
+    move.src->m_Moving = false;
+    move.src->Release();
+}
+
+void VulkanResourceDefragmenter::RetireMoves(bool immediately)
+{
+    bool retired = false;
+    for (int32 index = (int32)m_Retiring.size() - 1; index >= 0; --index)
+    {
+        Move& move = m_Retiring[index];
+        if (!immediately && move.retireFrame > m_FrameCounter)
+        {
+            continue;
+        }
+
+        if (move.src->m_Mover == move.mover)
+        {
+            move.src->m_Mover = nullptr;
+            move.mover->FinishMove(move.src);
+        }
+        // 最后一个引用，旧分配在这里归还给page，page搬空后进入FreePages
+        move.src->Release();
+
+        m_Retiring[index] = m_Retiring.back();
+        m_Retiring.pop_back();
+        retired = true;
+    }
+
+    if (retired)
+    {
+        VulkanResourceHeapManager& heapManager = m_Device->GetResourceHeapManager();
+        VulkanResourceHeapStats before;
+        heapManager.GetStats(before);
+        heapManager.ReleaseFreedPages();
+        m_NumPagesReleased += before.numFreePages;
+    }
+}
+
+void VulkanResourceDefragmenter::PrintStats()
+{
+    VulkanResourceHeapStats current;
+    m_Device->GetResourceHeapManager().GetStats(current);
+
+    if (m_HasBaseline)
+    {
+        MLOG("Defrag pages %d -> %d, resident %.2fMB -> %.2fMB, occupancy %.1f%% -> %.1f%%, fragmentation %.1f%% -> %.1f%%, free chunks %d -> %d",
+            m_Baseline.numPages, current.numPages,
+            (float)((double)m_Baseline.residentBytes / 1024.0 / 1024.0), (float)((double)current.residentBytes / 1024.0 / 1024.0),
+            100.0f * m_Baseline.GetOccupancy(), 100.0f * current.GetOccupancy(),
+            100.0f * m_Baseline.GetFragmentation(), 100.0f * current.GetFragmentation(),
+            m_Baseline.numFreeBlocks, current.numFreeBlocks
+        );
+    }
+
+    MLOG("Defrag stats : %d moves (%.2fMB) in %d batches, %d pages released, %.3fms CPU, current %d pages %.2fMB, fragmentation %.1f%%",
+        m_NumMoved, (float)((double)m_NumMovedBytes / 1024.0 / 1024.0), m_NumBatches, m_NumPagesReleased, m_CPUTime * 1000.0,
+        current.numPages, (float)((double)current.residentBytes / 1024.0 / 1024.0), 100.0f * current.GetFragmentation()
+    );
+}
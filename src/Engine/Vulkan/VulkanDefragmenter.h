@@ -0,0 +1,83 @@
+#pragma once
+#include "Common/Common.h"
+#include "VulkanMemory.h"
+#include "vulkan/vulkan_core.h"
+
+#include <vector>
+
+class VulkanDevice;
+
+// 增量式显存碎片整理：每帧在预算内挑选最稀疏的page，把其中的分配搬到更满的page，
+// 搬空的page在旧资源不再被引用后归还给驱动。
+// 只处理device local且未映射的page，并且page内所有分配都设置了VulkanResourceMover。
+class VulkanResourceDefragmenter
+{
+public:
+    VulkanResourceDefragmenter(VulkanDevice* device, int32 numFramesInFlight);
+
+    virtual ~VulkanResourceDefragmenter();
+
+    // 每帧调用一次，需要在当前帧的fence等待之后、录制命令之前调用
+    void Update(double budgetSeconds, uint64 budgetBytes);
+
+    // 等待所有搬迁完成并立即释放旧资源，调用前GPU必须空闲
+    void Flush();
+
+    void PrintStats();
+
+    FORCE_INLINE bool IsIdle() const
+    {
+        return m_Moves.size() == 0 && m_Retiring.size() == 0;
+    }
+
+    // 使用率低于该值的page才会被搬空
+    FORCE_INLINE void SetMaxOccupancy(float occupancy)
+    {
+        m_MaxOccupancy = occupancy;
+    }
+
+private:
+    struct Move
+    {
+        VulkanResourceAllocation*   src;
+        VulkanResourceAllocation*   dst;
+        VulkanResourceMover*        mover;
+        uint64                      retireFrame;
+    };
+
+    void RetireMoves(bool immediately);
+
+    void CompleteBatch();
+
+    void RecordMoves(double budgetSeconds, uint64 budgetBytes);
+
+    VulkanResourceHeapPage* FindSourcePage(std::vector<VulkanResourceHeapPage*>& pages, std::vector<VulkanResourceHeapPage*>& outTargets);
+
+    VulkanResourceAllocation* AllocateTarget(VulkanResourceAllocation* allocation, const std::vector<VulkanResourceHeapPage*>& targets);
+
+    void BeginCommandBuffer();
+
+    void CancelMove(Move& move);
+
+private:
+    VulkanDevice*                   m_Device;
+    VkCommandPool                   m_CommandPool;
+    VkCommandBuffer                 m_CommandBuffer;
+    VkFence                         m_Fence;
+    bool                            m_Recording;
+    bool                            m_Submitted;
+    int32                           m_NumFramesInFlight;
+    uint64                          m_FrameCounter;
+    float                           m_MaxOccupancy;
+
+    std::vector<Move>               m_Moves;
+    std::vector<Move>               m_Retiring;
+
+    bool                            m_HasBaseline;
+    VulkanResourceHeapStats         m_Baseline;
+    uint32                          m_NumMoved;
+    uint64                          m_NumMovedBytes;
+    uint32                          m_NumBatches;
+    uint32                          m_NumPagesReleased;
+    double                          m_CPUTime;
+};
@@ -24,6 +24,7 @@ VulkanDevice::VulkanDevice(VkPhysicalDevice physicalDevice)
     , m_PresentQueue(nullptr)
     , m_FenceManager(nullptr)
     , m_MemoryManager(nullptr)
+    , m_ResourceHeapManager(nullptr)
 	, m_PhysicalDeviceFeatures2(nullptr)
 {
     
@@ -40,6 +41,18 @@ VulkanDevice::~VulkanDevice()
 }
 
 
+bool VulkanDevice::IsExtensionEnabled(const char* name) const
+{
+    for (int32 i = 0; i < m_EnabledExtensions.size(); ++i)
+    {
+        if (m_EnabledExtensions[i] == name)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 void VulkanDevice::CreateDevice()
 {
    	bool debugMarkersFound = false;
@@ -56,6 +69,12 @@ void VulkanDevice::CreateDevice()
 		}
     }
 
+    m_EnabledExtensions.clear();
+    for (int32 i = 0; i < deviceExtensions.size(); ++i)
+    {
+        m_EnabledExtensions.push_back(deviceExtensions[i]);
+    }
+
     VkDeviceCreateInfo deviceInfo;
     ZeroVulkanStruct(deviceInfo,VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO);
     deviceInfo.enabledExtensionCount = uint32_t(deviceExtensions.size());
@@ -190,6 +209,10 @@ void VulkanDevice::Destroy()
     m_FenceManager->Destory();
     delete m_FenceManager;
 
+    m_ResourceHeapManager->PrintStats();
+    m_ResourceHeapManager->Destory();
+    delete m_ResourceHeapManager;
+
     m_MemoryManager->Destory();
     delete m_MemoryManager;
 
@@ -209,6 +232,9 @@ void VulkanDevice::InitGPU(int32 deviceIndex)
     
     m_MemoryManager = new VulkanDeviceMemoryManager();
     m_MemoryManager->Init(this);
+
+    m_ResourceHeapManager = new VulkanResourceHeapManager(this);
+    m_ResourceHeapManager->Init();
     
     m_FenceManager = new VulkanFenceManager();
 	m_FenceManager->Init(this);
@@ -9,6 +9,7 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <string>
 
 
 class VulkanFenceManager;
@@ -75,7 +76,12 @@ public:
     {
         return m_PhysicalDeviceFeatures;
     }
-    
+
+    FORCE_INLINE const std::vector<VkQueueFamilyProperties>& GetQueueFamilyProperties() const
+    {
+        return m_QueueFamilyProps;
+    }
+
     FORCE_INLINE VkDevice GetInstanceHandle() const
     {
         return m_Device;
@@ -95,6 +101,11 @@ public:
     {
         return *m_MemoryManager;
     }
+
+    FORCE_INLINE VulkanResourceHeapManager& GetResourceHeapManager()
+    {
+        return *m_ResourceHeapManager;
+    }
     
 	FORCE_INLINE void AddAppDeviceExtensions(const char* name)
 	{
@@ -106,6 +117,8 @@ public:
 		m_PhysicalDeviceFeatures2 = deviceFeatures;
 	}
 
+	bool IsExtensionEnabled(const char* name) const;
+
 
 private:
     
@@ -140,8 +153,10 @@ private:
 
     VulkanFenceManager*                     m_FenceManager;
     VulkanDeviceMemoryManager*              m_MemoryManager;
+    VulkanResourceHeapManager*              m_ResourceHeapManager;
 
 	std::vector<const char*>				m_AppDeviceExtensions;
+	std::vector<std::string>				m_EnabledExtensions;
 	VkPhysicalDeviceFeatures2*				m_PhysicalDeviceFeatures2;
 
 };
\ No newline at end of file
@@ -174,6 +174,10 @@ VulkanResourceSubAllocation::VulkanResourceSubAllocation(uint32 requestedSize, u
     , m_AlignedOffset(alignedOffset)
     , m_AllocationSize(allocationSize)
     , m_AllocationOffset(allocationOffset)
+    , m_AllocatorBlock(TLSFAllocator::InvalidBlock)
+    , m_AllocatorSlot(0)
+    , m_File(nullptr)
+    , m_Line(0)
 {
     
 }
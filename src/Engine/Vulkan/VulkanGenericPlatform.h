@@ -24,5 +24,11 @@ public:
     {
         
     }
+
+    // 不支持surface的平台由VulkanSwapChain创建离屏backbuffer
+    static bool SupportsSurface()
+    {
+        return true;
+    }
 };
 
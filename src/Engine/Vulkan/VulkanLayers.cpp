@@ -1,6 +1,6 @@
 #include "Common/Common.h"
 #include "Common/Log.h"
-#include "Vulkan/Windows/VulkanWindowsPlatform.h"
+#include "Vulkan/VulkanPlatform.h"
 #include "VulkanPlatform.h"
 #include "VulkanRHI.h"
 #include "VulkanDevice.h"
@@ -99,15 +99,16 @@ static const char* G_DeviceExtensions[] =
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 	VK_KHR_SAMPLER_MIRROR_CLAMP_TO_EDGE_EXTENSION_NAME,
 	VK_KHR_MAINTENANCE1_EXTENSION_NAME,
+	VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME,
 
 #if PLATFORM_WINDOWS
-
+	VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
 #elif PLATFORM_MAC
 
 #elif PLATFORM_IOS
 
 #elif PLATFORM_LINUX
-
+	VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
 #elif PLATFORM_ANDROID
 	
 #endif
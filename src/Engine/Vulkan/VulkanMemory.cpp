@@ -8,9 +8,18 @@
 #include "vulkan/vulkan_core.h"
 #include <algorithm>
 #include <cstddef>
+#include <cstdio>
 #include <stdint.h>
+#include <string>
 #include <vector>
 
+// 实例版本为1.1时才能直接调用vkGetPhysicalDeviceMemoryProperties2，见VulkanRHI::CreateInstance
+#if defined(VK_EXT_memory_budget) && !PLATFORM_IOS && !PLATFORM_ANDROID
+    #define VULKAN_SUPPORTS_MEMORY_BUDGET 1
+#else
+    #define VULKAN_SUPPORTS_MEMORY_BUDGET 0
+#endif
+
 
 enum
 {
@@ -20,46 +29,20 @@ enum
 };
 
    
-// VulkanRange
-//merge ranges to one range
-void VulkanRange::JoinConsecutiveRanges(std::vector<VulkanRange>& ranges)
-{
-    if (ranges.size() == 0) {
-        return;
-    }
-    
-    std::sort(ranges.begin(), ranges.end(), [](const VulkanRange& a, const VulkanRange& b) {
-        if (a.offset > b.offset) {
-            return 1;
-        }
-        else if (a.offset == b.offset) {
-            return 0;
-        }
-        else {
-            return -1;
-        }
-    });
-    
-    for (int32 index = (int32)ranges.size() - 1; index > 0; --index)
-    {
-        VulkanRange& current = ranges[index + 0];
-        VulkanRange& prev    = ranges[index - 1];
-        if (prev.offset + prev.size == current.offset)
-        {
-            prev.size += current.size;
-            ranges.erase(ranges.begin() + index);
-        }
-    }
-}
-
-
 VulkanResourceAllocation::VulkanResourceAllocation(VulkanResourceHeapPage* owner, VulkanDeviceMemoryAllocation* deviceMemoryAllocation, uint32 requestedSize, uint32 alignedOffset, uint32 allocationSize, uint32 allocationOffset, const char* file, uint32 line)
     : m_Owner(owner)
     , m_AllocationSize(allocationSize)
     , m_AllocationOffset(allocationOffset)
     , m_RequestedSize(requestedSize)
     , m_AlignedOffset(alignedOffset)
+    , m_AllocatorBlock(TLSFAllocator::InvalidBlock)
+    , m_PageSlot(0)
+    , m_Alignment(1)
     , m_DeviceMemoryAllocation(deviceMemoryAllocation)
+    , m_Mover(nullptr)
+    , m_Moving(false)
+    , m_File(file)
+    , m_Line(line)
 {
 
 
@@ -102,6 +85,7 @@ VulkanDeviceMemoryManager::VulkanDeviceMemoryManager()
     , m_HasUnifiedMemory(false)
     , m_NumAllocations(0)
     , m_PeakNumAllocations(0)
+    , m_HasMemoryBudget(false)
 {
     memset(&m_MemoryProperties, 0, sizeof(VkPhysicalDeviceMemoryProperties));
 }
@@ -117,8 +101,17 @@ void VulkanDeviceMemoryManager::Init(VulkanDevice* device)
 
     vkGetPhysicalDeviceMemoryProperties(m_Device->GetPhysicalHandle(), &m_MemoryProperties);
     m_HeapInfos.resize(m_MemoryProperties.memoryHeapCount);
+    m_TagInfos.clear();
+
+#if VULKAN_SUPPORTS_MEMORY_BUDGET
+    m_HasMemoryBudget = m_Device->IsExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+#else
+    m_HasMemoryBudget = false;
+#endif
 
     SetupAndPrintMemInfo();
+    UpdateBudget();
+    MLOG("Memory budget : %s", m_HasMemoryBudget ? "VK_EXT_memory_budget" : "estimated from heap size");
 }
 
 
@@ -174,6 +167,15 @@ VulkanDeviceMemoryAllocation* VulkanDeviceMemoryManager::Alloc(bool canFail, VkD
     newAllocation->m_CanBeMapped     = ((m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)  == VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
     newAllocation->m_IsCoherent      = ((m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
     newAllocation->m_IsCached        = ((m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)   == VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    newAllocation->m_File            = file;
+    newAllocation->m_Line            = line;
+
+    // 超出预算不一定失败，驱动可能换页到系统内存，这里只提示，由上层决定是否换策略
+    if (IsOverBudget(memoryTypeIndex, allocationSize))
+    {
+        uint32 heapIndex = m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+        MLOG("Device memory over budget, Heap=%d Requested=%fKb Usage=%fMb Budget=%fMb %s(%d)", heapIndex, (float)allocationSize / 1024.0f, (float)((double)GetHeapUsage(heapIndex) / 1024.0 / 1024.0), (float)((double)GetHeapBudget(heapIndex) / 1024.0 / 1024.0), file ? file : "", line);
+    }
 
     VkResult  result = vkAllocateMemory(m_DeviceHandle, &allocInfo,VULKAN_CPU_ALLOCATOR,&newAllocation->m_Handle);
 
@@ -182,6 +184,7 @@ VulkanDeviceMemoryAllocation* VulkanDeviceMemoryManager::Alloc(bool canFail, VkD
         if(canFail)
         {
             MLOG("Failed to allocate Device Memory, Requested=%fKb MemTypeIndex=%d", (float)allocInfo.allocationSize / 1024.0f, allocInfo.memoryTypeIndex);
+            delete newAllocation;
             return nullptr;
         }
         MLOG("Out of Device Memory, Requested=%fKb MemTypeIndex=%d", (float)allocInfo.allocationSize / 1024.0f, allocInfo.memoryTypeIndex);
@@ -193,6 +196,7 @@ VulkanDeviceMemoryAllocation* VulkanDeviceMemoryManager::Alloc(bool canFail, VkD
         if (canFail)
         {
             MLOG("Failed to allocate Host Memory, Requested=%fKb MemTypeIndex=%d", (float)allocInfo.allocationSize / 1024.0f, allocInfo.memoryTypeIndex);
+            delete newAllocation;
             return nullptr;
         }
         MLOG("Out of Host Memory, Requested=%fKb MemTypeIndex=%d", (float)allocInfo.allocationSize / 1024.0f, allocInfo.memoryTypeIndex);
@@ -213,6 +217,7 @@ VulkanDeviceMemoryAllocation* VulkanDeviceMemoryManager::Alloc(bool canFail, VkD
     m_HeapInfos[heapIndex].allocations.push_back(newAllocation);
     m_HeapInfos[heapIndex].usedSize += allocationSize;
     m_HeapInfos[heapIndex].peakSize = MMath::Max(m_HeapInfos[heapIndex].peakSize, m_HeapInfos[heapIndex].usedSize);
+    m_HeapInfos[heapIndex].peakUsage = MMath::Max(m_HeapInfos[heapIndex].peakUsage, GetHeapUsage(heapIndex));
     
     return newAllocation;
 }
@@ -263,12 +268,193 @@ uint64 VulkanDeviceMemoryManager::GetTotalMemory(bool gpu) const
         const bool isGPUHeap = (m_MemoryProperties.memoryHeaps[index].flags&VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)==VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
         if(isGPUHeap==gpu)
         {
-            totalMemory+=m_HeapInfos[index].totalSize;
+            totalMemory+=GetHeapBudget(index);
         }
     }
     return totalMemory;
 }
 
+void VulkanDeviceMemoryManager::UpdateBudget()
+{
+#if VULKAN_SUPPORTS_MEMORY_BUDGET
+    if (m_HasMemoryBudget)
+    {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties;
+        ZeroVulkanStruct(budgetProperties, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT);
+
+        VkPhysicalDeviceMemoryProperties2 memoryProperties;
+        ZeroVulkanStruct(memoryProperties, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2);
+        memoryProperties.pNext = &budgetProperties;
+
+        vkGetPhysicalDeviceMemoryProperties2(m_Device->GetPhysicalHandle(), &memoryProperties);
+
+        for (uint32 index = 0; index < m_HeapInfos.size(); ++index)
+        {
+            HeapInfo& heapInfo = m_HeapInfos[index];
+            // 部分驱动会报告0或者超过heap大小的预算，此时退回估算值
+            VkDeviceSize budget = budgetProperties.heapBudget[index];
+            if (budget == 0 || budget > m_MemoryProperties.memoryHeaps[index].size) {
+                budget = heapInfo.totalSize;
+            }
+            heapInfo.budget           = budget;
+            heapInfo.usage            = budgetProperties.heapUsage[index];
+            heapInfo.usedSizeAtBudget = heapInfo.usedSize;
+            heapInfo.peakUsage        = MMath::Max(heapInfo.peakUsage, heapInfo.usage);
+        }
+        return;
+    }
+#endif
+
+    for (uint32 index = 0; index < m_HeapInfos.size(); ++index)
+    {
+        HeapInfo& heapInfo = m_HeapInfos[index];
+        heapInfo.budget           = heapInfo.totalSize;
+        heapInfo.usage            = heapInfo.usedSize;
+        heapInfo.usedSizeAtBudget = heapInfo.usedSize;
+        heapInfo.peakUsage        = MMath::Max(heapInfo.peakUsage, heapInfo.usage);
+    }
+}
+
+VkDeviceSize VulkanDeviceMemoryManager::GetHeapBudget(uint32 heapIndex) const
+{
+    return m_HeapInfos[heapIndex].budget;
+}
+
+VkDeviceSize VulkanDeviceMemoryManager::GetHeapUsage(uint32 heapIndex) const
+{
+    const HeapInfo& heapInfo = m_HeapInfos[heapIndex];
+    if (heapInfo.usedSize >= heapInfo.usedSizeAtBudget) {
+        return heapInfo.usage + (heapInfo.usedSize - heapInfo.usedSizeAtBudget);
+    }
+    VkDeviceSize freed = heapInfo.usedSizeAtBudget - heapInfo.usedSize;
+    return heapInfo.usage > freed ? heapInfo.usage - freed : 0;
+}
+
+bool VulkanDeviceMemoryManager::IsOverBudget(uint32 memoryTypeIndex, VkDeviceSize size) const
+{
+    uint32 heapIndex = m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    return GetHeapUsage(heapIndex) + size > GetHeapBudget(heapIndex);
+}
+
+void VulkanDeviceMemoryManager::AddTagUsage(const char* file, uint32 line, VkDeviceSize size)
+{
+    TagInfo& tagInfo = m_TagInfos[GetTag(file, line)];
+    tagInfo.count      += 1;
+    tagInfo.totalCount += 1;
+    tagInfo.size       += size;
+    tagInfo.peakSize    = MMath::Max(tagInfo.peakSize, tagInfo.size);
+}
+
+void VulkanDeviceMemoryManager::RemoveTagUsage(const char* file, uint32 line, VkDeviceSize size)
+{
+    auto tag = m_TagInfos.find(GetTag(file, line));
+    if (tag != m_TagInfos.end())
+    {
+        tag->second.count -= 1;
+        tag->second.size  -= size;
+    }
+}
+
+std::string VulkanDeviceMemoryManager::GetTag(const char* file, uint32 line)
+{
+    if (!file) {
+        return "unknown";
+    }
+
+    // 只保留文件名，不同机器上的构建路径不影响diff
+    const char* name = file;
+    for (const char* it = file; *it; ++it)
+    {
+        if (*it == '/' || *it == '\\') {
+            name = it + 1;
+        }
+    }
+    return std::string(name) + ":" + std::to_string(line);
+}
+
+std::string VulkanDeviceMemoryManager::GetMemoryReport()
+{
+    UpdateBudget();
+
+    std::string report;
+    char buffer[512];
+
+    auto Append = [&](const char* format, auto... args)
+    {
+        snprintf(buffer, sizeof(buffer), format, args...);
+        report += buffer;
+    };
+
+    report += "{\n";
+    Append("  \"budgetSource\": \"%s\",\n", m_HasMemoryBudget ? "VK_EXT_memory_budget" : "estimate");
+    Append("  \"numAllocations\": %u,\n", m_NumAllocations);
+    Append("  \"peakNumAllocations\": %u,\n", m_PeakNumAllocations);
+
+    report += "  \"heaps\": [\n";
+    for (uint32 index = 0; index < m_HeapInfos.size(); ++index)
+    {
+        const HeapInfo& heapInfo = m_HeapInfos[index];
+        bool isGPUHeap = (m_MemoryProperties.memoryHeaps[index].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+        Append("    { \"index\": %u, \"deviceLocal\": %s, \"size\": %llu, \"budget\": %llu, \"usage\": %llu, \"peakUsage\": %llu, \"allocated\": %llu, \"peakAllocated\": %llu, \"allocations\": %u }%s\n",
+            index,
+            isGPUHeap ? "true" : "false",
+            (unsigned long long)m_MemoryProperties.memoryHeaps[index].size,
+            (unsigned long long)GetHeapBudget(index),
+            (unsigned long long)GetHeapUsage(index),
+            (unsigned long long)heapInfo.peakUsage,
+            (unsigned long long)heapInfo.usedSize,
+            (unsigned long long)heapInfo.peakSize,
+            (uint32)heapInfo.allocations.size(),
+            index + 1 < m_HeapInfos.size() ? "," : ""
+        );
+    }
+    report += "  ],\n";
+
+    // std::map按tag排序，两次输出的顺序一致
+    report += "  \"tags\": [\n";
+    int32 tagIndex = 0;
+    for (auto it = m_TagInfos.begin(); it != m_TagInfos.end(); ++it, ++tagIndex)
+    {
+        const TagInfo& tagInfo = it->second;
+        Append("    { \"tag\": \"%s\", \"count\": %u, \"size\": %llu, \"peakSize\": %llu, \"totalCount\": %u }%s\n",
+            it->first.c_str(),
+            tagInfo.count,
+            (unsigned long long)tagInfo.size,
+            (unsigned long long)tagInfo.peakSize,
+            tagInfo.totalCount,
+            tagIndex + 1 < (int32)m_TagInfos.size() ? "," : ""
+        );
+    }
+    report += "  ]\n";
+    report += "}\n";
+
+    return report;
+}
+
+bool VulkanDeviceMemoryManager::WriteMemoryReport(const std::string& filepath)
+{
+    std::string report = GetMemoryReport();
+
+    FILE* file = fopen(filepath.c_str(), "wb");
+    if (!file)
+    {
+        MLOGE("Failed open memory report for write : %s", filepath.c_str());
+        return false;
+    }
+
+    bool written = fwrite(report.data(), 1, report.size(), file) == report.size();
+    fclose(file);
+
+    if (!written)
+    {
+        MLOGE("Failed write memory report : %s", filepath.c_str());
+        return false;
+    }
+
+    MLOG("Memory report saved : %s", filepath.c_str());
+    return true;
+}
+
 
 void VulkanDeviceMemoryManager::SetupAndPrintMemInfo()
 {
@@ -361,7 +547,7 @@ VulkanBufferSubAllocation* VulkanResourceHeapManager::AllocateBuffer(uint32 size
     for(int32 index=0;index<m_UsedBufferAllocations[poolSize].size();index++)
     {
          VulkanSubBufferAllocator* bufferAllocation = m_UsedBufferAllocations[poolSize][index];
-         if((bufferAllocation->m_BufferUsageFlags&bufferUsageFlags==bufferUsageFlags)&&
+         if((bufferAllocation->m_BufferUsageFlags&bufferUsageFlags)==bufferUsageFlags&&
           (bufferAllocation->m_MemoryPropertyFlags & memoryPropertyFlags) == memoryPropertyFlags)
           {
             VulkanBufferSubAllocation* subAllocation = (VulkanBufferSubAllocation*)bufferAllocation->TryAllocateNoLocking(size, alignment, file, line);
@@ -473,7 +659,7 @@ void VulkanResourceHeapManager::DumpMemory()
             for (int32 index = 0; index < usedAllocations.size(); ++index)
             {
                 VulkanSubBufferAllocator* bufferAllocation = usedAllocations[index];
-                MLOG("%6d %p %p 0x%06x 0x%08x %6d   %6d    %d/%d", index, (void*)bufferAllocation->m_Buffer, (void*)bufferAllocation->m_DeviceMemoryAllocation->GetHandle(), bufferAllocation->m_MemoryPropertyFlags, bufferAllocation->m_BufferUsageFlags, (int32)bufferAllocation->m_SubAllocations.size(), (int32)bufferAllocation->m_FreeList.size(), (int32)bufferAllocation->m_UsedSize, bufferAllocation->m_MaxSize);
+                MLOG("%6d %p %p 0x%06x 0x%08x %6d   %6d    %d/%d", index, (void*)bufferAllocation->m_Buffer, (void*)bufferAllocation->m_DeviceMemoryAllocation->GetHandle(), bufferAllocation->m_MemoryPropertyFlags, bufferAllocation->m_BufferUsageFlags, (int32)bufferAllocation->m_SubAllocations.size(), (int32)bufferAllocation->m_Allocator.GetNumFreeBlocks(), (int32)bufferAllocation->m_UsedSize, bufferAllocation->m_MaxSize);
                 
                 if (poolSizeIndex == (int32)PoolSizes::SizesCount)
                 {
@@ -542,23 +728,7 @@ void VulkanResourceHeapManager::DestroyResourceAllocations()
 
 void VulkanResourceHeapManager::ReleaseFreedResources(bool immediately)
 {
-    ReleaseFreedResources(true);
-    for(auto& usedAllocations:m_UsedBufferAllocations)
-    {
-        for(int32 index=(int32)usedAllocations.size()-1;index>=0;--index)
-        {
-            VulkanSubBufferAllocator* bufferAllocation = usedAllocations[index];
-            if(!bufferAllocation->JoinFreeBlocks())
-            {
-                MLOG("Suballocation(s) for Buffer %p were not released.", (void*)bufferAllocation->m_Buffer);
-            }
-            bufferAllocation->Destroy(m_VulkanDevice);
-            m_VulkanDevice->GetMemoryManager().Free(bufferAllocation->m_DeviceMemoryAllocation);
-            delete bufferAllocation;
-        }
-        usedAllocations.clear();
-    }
-
+    // 只释放已经完全空闲的buffer，仍在使用的由DestroyResourceAllocations处理
     for(auto& freeAllocation:m_FreeBufferAllocations)
     {
         for(int32 index=0;index<freeAllocation.size();++index)
@@ -583,11 +753,7 @@ VulkanSubResourceAllocator::VulkanSubResourceAllocator(VulkanResourceHeapManager
     , m_UsedSize(0)
 {
     m_MaxSize = (uint32)deviceMemoryAllocation->GetSize();
-
-    VulkanRange fullRange;
-    fullRange.offset = 0;
-    fullRange.size   = m_MaxSize;
-    m_FreeList.push_back(fullRange);
+    m_Allocator.Init(m_MaxSize);
 }
 
 
@@ -600,46 +766,50 @@ VulkanSubResourceAllocator::~VulkanSubResourceAllocator()
 VulkanResourceSubAllocation* VulkanSubResourceAllocator::TryAllocateNoLocking(uint32 size, uint32 alignment, const char* file, uint32 line)
 {
     m_Alignment = MMath::Max(m_Alignment, alignment);
-    for (int32 index = 0; index < m_FreeList.size(); ++index)
-    {
-        VulkanRange& entry         = m_FreeList[index];
-        uint32 allocatedOffset     = entry.offset;
-        uint32 alignedOffset       = Align(entry.offset, m_Alignment);
-        uint32 alignmentAdjustment = alignedOffset - entry.offset;
-        uint32 allocatedSize       = alignmentAdjustment + size;
 
-        if (allocatedSize <= entry.size)
-        {
-            if (allocatedSize < entry.size)
-            {
-                entry.size   -= allocatedSize;
-                entry.offset += allocatedSize;
-            }
-            else {
-                m_FreeList.erase(m_FreeList.begin() + index);
-            }
-            m_UsedSize += allocatedSize;
-            VulkanResourceSubAllocation* newSubAllocation = CreateSubAllocation(size, alignedOffset, allocatedSize, allocatedOffset);
-            m_SubAllocations.push_back(newSubAllocation);
-            return newSubAllocation;
-        }
+    TLSFAllocator::Allocation allocation;
+    if (!m_Allocator.Allocate(size, m_Alignment, allocation)) {
+        return nullptr;
     }
-    
-    return nullptr;
+
+    m_UsedSize += allocation.size;
+    VulkanResourceSubAllocation* newSubAllocation = CreateSubAllocation(size, allocation.alignedOffset, allocation.size, allocation.offset);
+    newSubAllocation->m_AllocatorBlock = allocation.block;
+    newSubAllocation->m_AllocatorSlot  = (uint32)m_SubAllocations.size();
+    newSubAllocation->m_File           = file;
+    newSubAllocation->m_Line           = line;
+    m_SubAllocations.push_back(newSubAllocation);
+    m_Owner->GetVulkanDevice()->GetMemoryManager().AddTagUsage(file, line, allocation.size);
+    return newSubAllocation;
+}
+
+void VulkanSubResourceAllocator::ReleaseSubAllocation(VulkanResourceSubAllocation* subAllocation)
+{
+    uint32 slot = subAllocation->m_AllocatorSlot;
+    if (slot >= m_SubAllocations.size() || m_SubAllocations[slot] != subAllocation) {
+        MLOGE("Suballocation not found in allocator.");
+        return;
+    }
+
+    // 与末尾交换后移除，避免vector中间删除
+    m_SubAllocations[slot] = m_SubAllocations.back();
+    m_SubAllocations[slot]->m_AllocatorSlot = slot;
+    m_SubAllocations.pop_back();
+
+    m_Allocator.Free(subAllocation->m_AllocatorBlock);
+    m_UsedSize -= subAllocation->m_AllocationSize;
+    m_Owner->GetVulkanDevice()->GetMemoryManager().RemoveTagUsage(subAllocation->m_File, subAllocation->m_Line, subAllocation->m_AllocationSize);
 }
 
 bool VulkanSubResourceAllocator::JoinFreeBlocks()
 {
-    VulkanRange::JoinConsecutiveRanges(m_FreeList);
-    if (m_FreeList.size() == 1)
+    // 空闲块在释放时已经合并，这里只检查是否完全空闲
+    if (m_SubAllocations.size() == 0)
     {
-        if (m_SubAllocations.size() == 0)
-        {
-            if (m_UsedSize != 0 || m_FreeList[0].offset != 0 || m_FreeList[0].size != m_MaxSize) {
-                MLOG("Resource Suballocation leak, should have %d free, only have %d; missing %d bytes", m_MaxSize, m_FreeList[0].size, m_MaxSize - m_FreeList[0].size);
-            }
-            return true;
+        if (m_UsedSize != 0 || !m_Allocator.IsEmpty() || m_Allocator.GetNumFreeBlocks() != 1) {
+            MLOG("Resource Suballocation leak, should have %d free, only have %d; missing %d bytes", m_MaxSize, m_MaxSize - m_Allocator.GetUsedSize(), m_Allocator.GetUsedSize());
         }
+        return true;
     }
     
     return false;
@@ -679,25 +849,7 @@ VulkanResourceSubAllocation* VulkanSubBufferAllocator::CreateSubAllocation(uint3
 
 void VulkanSubBufferAllocator::Release(VulkanBufferSubAllocation* subAllocation)
 {
-    bool released = false;
-    for (int32 index = 0; index < m_SubAllocations.size(); ++index)
-    {
-        if (m_SubAllocations[index] == subAllocation)
-        {
-            released = true;
-            m_SubAllocations.erase(m_SubAllocations.begin() + index);
-            break;
-        }
-    }
-    
-    if (released)
-    {
-        VulkanRange newFree;
-        newFree.offset = subAllocation->m_AllocationOffset;
-        newFree.size   = subAllocation->m_AllocationSize;
-        m_FreeList.push_back(newFree);
-        m_UsedSize -= subAllocation->m_AllocationSize;
-    }
+    ReleaseSubAllocation(subAllocation);
     
     if (JoinFreeBlocks()) {
         m_Owner->ReleaseBuffer(this);
@@ -716,6 +868,8 @@ VulkanDeviceMemoryAllocation::VulkanDeviceMemoryAllocation()
 	, m_IsCoherent(false)
 	, m_IsCached(false)
 	, m_FreedBySystem(false)
+	, m_File(nullptr)
+	, m_Line(0)
 {
 
 }
@@ -776,10 +930,7 @@ VulkanResourceHeapPage::VulkanResourceHeapPage(VulkanResourceHeap* owner, Vulkan
 m_Owner(owner),m_DeviceMemoryAllocation(deviceMemoryAllocation),m_MaxSize(0),m_UsedSize(0),m_PeakNumAllocations(0),m_FrameFreed(0),m_ID(id)
 {
     m_MaxSize = (uint32)m_DeviceMemoryAllocation->GetSize();
-    VulkanRange fullRange;
-    fullRange.offset = 0;
-    fullRange.size = m_MaxSize;
-    m_FreeList.push_back(fullRange);
+    m_Allocator.Init(m_MaxSize);
 }
 
 VulkanResourceHeapPage::~VulkanResourceHeapPage()
@@ -792,21 +943,25 @@ VulkanResourceHeapPage::~VulkanResourceHeapPage()
 
 void VulkanResourceHeapPage::ReleaseAllocation(VulkanResourceAllocation* allocation)
 {
-    auto it = std::find(m_ResourceAllocations.begin(),m_ResourceAllocations.end(),allocation);
-    if(it!=m_ResourceAllocations.end())
+    uint32 slot = allocation->m_PageSlot;
+    if(slot>=m_ResourceAllocations.size()||m_ResourceAllocations[slot]!=allocation)
     {
-        m_ResourceAllocations.erase(it);
-        VulkanRange newFree;
-        newFree.offset = allocation->m_AllocationOffset;
-        newFree.size = allocation->m_AllocationSize;
-        m_FreeList.push_back(newFree);
+        MLOGE("Allocation not found in page %d.", m_ID);
+        return;
     }
 
-    m_UsedSize -=   allocation->m_AllocationSize;
-    if(m_UsedSize<0)
+    // 与末尾交换后移除，空闲块由TLSF在释放时直接与相邻块合并
+    m_ResourceAllocations[slot] = m_ResourceAllocations.back();
+    m_ResourceAllocations[slot]->m_PageSlot = slot;
+    m_ResourceAllocations.pop_back();
+    m_Allocator.Free(allocation->m_AllocatorBlock);
+
+    if(m_UsedSize<allocation->m_AllocationSize)
     {
         MLOGE("Used size less than zero.");
     }
+    m_UsedSize -=   allocation->m_AllocationSize;
+    m_Owner->GetOwner()->GetVulkanDevice()->GetMemoryManager().RemoveTagUsage(allocation->m_File, allocation->m_Line, allocation->m_AllocationSize);
 
     if (JoinFreeBlocks()) 
     {
@@ -817,54 +972,37 @@ void VulkanResourceHeapPage::ReleaseAllocation(VulkanResourceAllocation* allocat
 
 VulkanResourceAllocation* VulkanResourceHeapPage::TryAllocate(uint32 size, uint32 alignment, const char* file, uint32 line)
 {
-    for(int32 index=0;index<m_FreeList.size();++index)
+    TLSFAllocator::Allocation allocation;
+    if(!m_Allocator.Allocate(size,alignment,allocation))
     {
-        VulkanRange& entry = m_FreeList[index];
-        uint32 allocateOffset = entry.offset;
-        uint32 alignedOffset = Align(entry.offset, alignment);
-        uint32 aligmentAdjustment = alignedOffset- entry.offset;
-        //padding + require size
-        uint32 allocatedSize = aligmentAdjustment+size;
-
-        if(allocatedSize<=entry.size)
-        {
-            if(allocatedSize<entry.size)
-            {
-                entry.size -= allocatedSize;
-                entry.offset+=allocatedSize;
-            } 
-            else 
-            {
-                m_FreeList.erase(m_FreeList.begin()+index);
-            }
-            m_UsedSize +=allocatedSize;
-            VulkanResourceAllocation* newResourceAllication = new VulkanResourceAllocation(this,m_DeviceMemoryAllocation,size,alignedOffset,allocatedSize,allocateOffset,file,line);
-            m_ResourceAllocations.push_back(newResourceAllication);
-            m_PeakNumAllocations = MMath::Max((uint32)m_PeakNumAllocations,(uint32)m_ResourceAllocations.size());
-            return newResourceAllication;
-        }
+        return nullptr;
     }
-    return nullptr;
+
+    m_UsedSize +=allocation.size;
+    VulkanResourceAllocation* newResourceAllication = new VulkanResourceAllocation(this,m_DeviceMemoryAllocation,size,allocation.alignedOffset,allocation.size,allocation.offset,file,line);
+    newResourceAllication->m_AllocatorBlock = allocation.block;
+    newResourceAllication->m_PageSlot       = (uint32)m_ResourceAllocations.size();
+    newResourceAllication->m_Alignment      = alignment;
+    m_ResourceAllocations.push_back(newResourceAllication);
+    m_PeakNumAllocations = MMath::Max((uint32)m_PeakNumAllocations,(uint32)m_ResourceAllocations.size());
+    m_Owner->GetOwner()->GetVulkanDevice()->GetMemoryManager().AddTagUsage(file, line, allocation.size);
+    return newResourceAllication;
 }
 
 bool VulkanResourceHeapPage::JoinFreeBlocks()
 {
-    VulkanRange::JoinConsecutiveRanges(m_FreeList);
-    //mark, why m_FreeList size must be 1
-    if(m_FreeList.size()==1)
+    // 空闲块在释放时已经合并，这里只检查page是否完全空闲
+    if(m_ResourceAllocations.size()==0)
     {
-        if(m_ResourceAllocations.size()==0)
+        if(m_UsedSize>0)
         {
-            if(m_UsedSize>0)
-            {
-                MLOG("Memory leak, used size=%d",(int32)m_UsedSize);
-            }
-            if(m_FreeList[0].offset!=0||m_FreeList[0].size!=m_MaxSize)
-            {
-                MLOGE("Memory leak, should have %d free, only have %d; missing %d bytes", m_MaxSize, m_FreeList[0].size, m_MaxSize - m_FreeList[0].size);
-            }
-            return true;
+            MLOG("Memory leak, used size=%d",(int32)m_UsedSize);
         }
+        if(!m_Allocator.IsEmpty()||m_Allocator.GetNumFreeBlocks()!=1)
+        {
+            MLOGE("Memory leak, should have %d free, only have %d; missing %d bytes", m_MaxSize, m_MaxSize - m_Allocator.GetUsedSize(), m_Allocator.GetUsedSize());
+        }
+        return true;
     }
     return false;
 }
@@ -926,7 +1064,7 @@ void VulkanResourceHeap::FreePage(VulkanResourceHeapPage *page)
         if(m_UsedBufferPages[i]==page)
         {
             removed = true;
-            m_UsedBufferPages.erase(m_UsedImagePages.begin()+i);
+            m_UsedBufferPages.erase(m_UsedBufferPages.begin()+i);
             break;
         }
     }
@@ -936,7 +1074,7 @@ void VulkanResourceHeap::FreePage(VulkanResourceHeapPage *page)
         if(m_UsedImagePages[i]==page)
         {
             removed=true;
-            m_UsedImagePages.erase(m_UsedBufferPages.begin()+i);
+            m_UsedImagePages.erase(m_UsedImagePages.begin()+i);
             break;
         }
     }
@@ -962,6 +1100,28 @@ void VulkanResourceHeap::ReleaseFreedPages(bool immediately)
 }
 
 
+void VulkanResourceHeap::GetStats(VulkanResourceHeapStats& outStats) const
+{
+    auto AddPages = [&](const std::vector<VulkanResourceHeapPage*>& pages)
+    {
+        for (int32 index = 0; index < pages.size(); ++index)
+        {
+            const VulkanResourceHeapPage* page = pages[index];
+            outStats.numPages         += 1;
+            outStats.numAllocations   += (uint32)page->m_ResourceAllocations.size();
+            outStats.numFreeBlocks    += page->m_Allocator.GetNumFreeBlocks();
+            outStats.residentBytes    += page->m_MaxSize;
+            outStats.usedBytes        += page->m_UsedSize;
+            outStats.largestFreeBytes += page->m_Allocator.GetLargestFreeBlock();
+        }
+    };
+
+    AddPages(m_UsedBufferPages);
+    AddPages(m_UsedImagePages);
+    AddPages(m_FreePages);
+    outStats.numFreePages += (uint32)m_FreePages.size();
+}
+
 #if MONKEY_DEBUG
 void VulkanResourceHeap::DumpMemory()
 {
@@ -978,7 +1138,7 @@ void VulkanResourceHeap::DumpMemory()
             subAllocUsedMemory      += usedPages[index]->m_UsedSize;
             subAllocAllocatedMemory += usedPages[index]->m_MaxSize;
             numSubAllocations       += (uint32)usedPages[index]->m_ResourceAllocations.size();
-            MLOG("\t\t%d: ID %4d %4d suballocs, %4d free chunks (%d used/%d free/%d max) DeviceMemory %p", index, usedPages[index]->GetID(), (int32)usedPages[index]->m_ResourceAllocations.size(), (int32)usedPages[index]->m_FreeList.size(), usedPages[index]->m_UsedSize, usedPages[index]->m_MaxSize - usedPages[index]->m_UsedSize, usedPages[index]->m_MaxSize, (void*)usedPages[index]->m_DeviceMemoryAllocation->GetHandle());
+            MLOG("\t\t%d: ID %4d %4d suballocs, %4d free chunks (%d used/%d free/%d max) DeviceMemory %p", index, usedPages[index]->GetID(), (int32)usedPages[index]->m_ResourceAllocations.size(), (int32)usedPages[index]->m_Allocator.GetNumFreeBlocks(), usedPages[index]->m_UsedSize, usedPages[index]->m_MaxSize - usedPages[index]->m_UsedSize, usedPages[index]->m_MaxSize, (void*)usedPages[index]->m_DeviceMemoryAllocation->GetHandle());
         }
         
         MLOG("%d Suballocations for Used/Total: %d/%d = %.2f%%", numSubAllocations, (int32)subAllocUsedMemory, (int32)subAllocAllocatedMemory, subAllocAllocatedMemory > 0 ? 100.0f * (float)subAllocUsedMemory / (float)subAllocAllocatedMemory : 0.0f);
@@ -1026,11 +1186,36 @@ VulkanResourceAllocation* VulkanResourceHeap::AllocateResource(Type type, uint32
         }
     }
 
+    VulkanDeviceMemoryManager& memoryManager = m_Owner->GetVulkanDevice()->GetMemoryManager();
     uint32 allocationSize = MMath::Max(size,targetDefualtPageSize);
-    VulkanDeviceMemoryAllocation* deviceMemoryAllocation = m_Owner->GetVulkanDevice()->GetMemoryManager().Alloc(true,allocationSize,m_MemoryTypeIndex,nullptr,file,line);
+
+    // 预算紧张时先归还空page，仍然不够就只按资源大小分配，不再预留整页
+    if(memoryManager.IsOverBudget(m_MemoryTypeIndex,allocationSize))
+    {
+        m_Owner->ReleaseFreedPages();
+        if(memoryManager.IsOverBudget(m_MemoryTypeIndex,allocationSize))
+        {
+            allocationSize = size;
+        }
+    }
+
+    VulkanDeviceMemoryAllocation* deviceMemoryAllocation = memoryManager.Alloc(true,allocationSize,m_MemoryTypeIndex,nullptr,file,line);
     if(!deviceMemoryAllocation&&size<allocationSize)
     {
-        deviceMemoryAllocation = m_Owner->GetVulkanDevice()->GetMemoryManager().Alloc(false,size,m_MemoryTypeIndex,nullptr,file,line);
+        allocationSize = size;
+        deviceMemoryAllocation = memoryManager.Alloc(true,allocationSize,m_MemoryTypeIndex,nullptr,file,line);
+    }
+
+    // 驱动分配失败时归还所有heap的空page再试一次，仍失败由上层换用其它内存类型
+    if(!deviceMemoryAllocation)
+    {
+        m_Owner->ReleaseFreedPages();
+        deviceMemoryAllocation = memoryManager.Alloc(true,allocationSize,m_MemoryTypeIndex,nullptr,file,line);
+    }
+
+    if(!deviceMemoryAllocation)
+    {
+        return nullptr;
     }
 
     VulkanResourceHeapPage* newPage = new VulkanResourceHeapPage(this,deviceMemoryAllocation,m_PageIDCounter);
@@ -1041,13 +1226,14 @@ VulkanResourceAllocation* VulkanResourceHeap::AllocateResource(Type type, uint32
     m_PeakPageSize = MMath::Max(m_PeakPageSize,allocationSize);
     if(mapAllocation)
     {
+        // page常驻映射，子分配直接通过偏移拿到指针
         deviceMemoryAllocation->Map(allocationSize,0);
     }   
     return newPage->Allocate(size,  alignment,file,  line);
 }
 
 VulkanResourceHeapManager::VulkanResourceHeapManager(VulkanDevice* device)
-:m_VulkanDevice(device),m_DeviceMemoryManager(&device->GetMemoryManager())
+:m_VulkanDevice(device),m_DeviceMemoryManager(&device->GetMemoryManager()),m_NumBufferAllocations(0),m_NumImageAllocations(0)
 {
 
 }
@@ -1081,7 +1267,7 @@ void VulkanResourceHeapManager::Init()
         }
         for(int32 index=(int32)outTypeIndices.size()-1;index>=1;--index)
         {
-            if(memoryProperties.memoryTypes[index].propertyFlags!=memoryProperties.memoryTypes[0].propertyFlags)
+            if(memoryProperties.memoryTypes[outTypeIndices[index]].propertyFlags!=memoryProperties.memoryTypes[outTypeIndices[0]].propertyFlags)
             {
                 outTypeIndices.erase(outTypeIndices.begin()+index);
             }
@@ -1097,15 +1283,17 @@ void VulkanResourceHeapManager::Init()
         VkDeviceSize heapSize = memoryProperties.memoryHeaps[heapIndex].size;
         VkDeviceSize pageSize = MMath::Min<VkDeviceSize>(heapSize/8,GPU_ONLY_HEAP_PAGE_SIZE);
         m_ResourceTypeHeaps[typeIndices[index]] = new VulkanResourceHeap(this, typeIndices[index], uint32(pageSize));
-        m_ResourceTypeHeaps[typeIndices[index]]->m_IsHostCachedSupported      = ((memoryProperties.memoryTypes[index].propertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)      == VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
-        m_ResourceTypeHeaps[typeIndices[index]]->m_IsLazilyAllocatedSupported = ((memoryProperties.memoryTypes[index].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) == VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+        m_ResourceTypeHeaps[typeIndices[index]]->m_IsHostCachedSupported      = ((memoryProperties.memoryTypes[typeIndices[index]].propertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)      == VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        m_ResourceTypeHeaps[typeIndices[index]]->m_IsLazilyAllocatedSupported = ((memoryProperties.memoryTypes[typeIndices[index]].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) == VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
       }  
     }
 
     {
         uint32 typeIndex = 0;
         VERIFYVULKANRESULT(memoryManager.GetMemoryTypeFromProperties(typeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &typeIndex));
-        m_ResourceTypeHeaps[typeIndex] = new VulkanResourceHeap(this, typeIndex, STAGING_HEAP_PAGE_SIZE);
+        if (!m_ResourceTypeHeaps[typeIndex]) {
+            m_ResourceTypeHeaps[typeIndex] = new VulkanResourceHeap(this, typeIndex, STAGING_HEAP_PAGE_SIZE);
+        }
     }
     
     {
@@ -1123,7 +1311,23 @@ void VulkanResourceHeapManager::Init()
         else {
             MLOG("No Memory Type found supporting VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT!");
         }
-        m_ResourceTypeHeaps[typeIndex] = new VulkanResourceHeap(this, typeIndex, STAGING_HEAP_PAGE_SIZE);
+        if (!m_ResourceTypeHeaps[typeIndex]) {
+            m_ResourceTypeHeaps[typeIndex] = new VulkanResourceHeap(this, typeIndex, STAGING_HEAP_PAGE_SIZE);
+        }
+    }
+
+    // 其余类型按需使用，保证任何typeIndex都有对应的heap
+    for (uint32 typeIndex = 0; typeIndex < memoryProperties.memoryTypeCount; ++typeIndex)
+    {
+        if (m_ResourceTypeHeaps[typeIndex]) {
+            continue;
+        }
+        const VkMemoryType& memoryType = memoryProperties.memoryTypes[typeIndex];
+        bool isDeviceLocal = (memoryType.propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) == VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        VkDeviceSize pageSize = MMath::Min<VkDeviceSize>(memoryProperties.memoryHeaps[memoryType.heapIndex].size / 8, isDeviceLocal ? GPU_ONLY_HEAP_PAGE_SIZE : STAGING_HEAP_PAGE_SIZE);
+        m_ResourceTypeHeaps[typeIndex] = new VulkanResourceHeap(this, typeIndex, uint32(pageSize));
+        m_ResourceTypeHeaps[typeIndex]->m_IsHostCachedSupported      = ((memoryType.propertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)      == VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        m_ResourceTypeHeaps[typeIndex]->m_IsLazilyAllocatedSupported = ((memoryType.propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) == VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
     }
 }
 
@@ -1180,6 +1384,13 @@ VulkanResourceAllocation* VulkanResourceHeapManager::AllocateBufferMemory(const
         allocation = m_ResourceTypeHeaps[typeIndex]->AllocateResource(VulkanResourceHeap::Type::Buffer, uint32(memoryReqs.size), uint32(memoryReqs.alignment), canMapped, file, line);
     }
 
+    if (allocation) {
+        m_NumBufferAllocations += 1;
+    }
+    else {
+        MLOGE("Failed allocate buffer memory, MemSize %d, MemPropertyFlags %u, %s(%d)", (uint32)memoryReqs.size, (uint32)memoryPropertyFlags, file, line);
+    }
+
     return allocation;
 }
 
@@ -1203,8 +1414,61 @@ VulkanResourceAllocation* VulkanResourceHeapManager::AllocateImageMemory(const V
         canMapped  = (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
         allocation = m_ResourceTypeHeaps[typeIndex]->AllocateResource(VulkanResourceHeap::Type::Image, uint32(memoryReqs.size), uint32(memoryReqs.alignment), canMapped, file, line);
     }
+
+    if (allocation) {
+        m_NumImageAllocations += 1;
+    }
+    else {
+        MLOGE("Failed allocate image memory, MemSize %d, MemPropertyFlags %u, %s(%d)", (uint32)memoryReqs.size, (uint32)memoryPropertyFlags, file, line);
+    }
     
     return allocation;
 
 }
 
+
+void VulkanResourceHeapManager::ReleaseFreedPages()
+{
+    for (int32 index = 0; index < m_ResourceTypeHeaps.size(); ++index)
+    {
+        if (m_ResourceTypeHeaps[index]) {
+            m_ResourceTypeHeaps[index]->ReleaseFreedPages(false);
+        }
+    }
+}
+
+
+void VulkanResourceHeapManager::GetStats(VulkanResourceHeapStats& outStats) const
+{
+    for (int32 index = 0; index < m_ResourceTypeHeaps.size(); ++index)
+    {
+        if (m_ResourceTypeHeaps[index]) {
+            m_ResourceTypeHeaps[index]->GetStats(outStats);
+        }
+    }
+}
+
+
+void VulkanResourceHeapManager::PrintStats()
+{
+    uint32 numPages   = 0;
+    uint32 numLive    = 0;
+    uint64 usedMemory = 0;
+    for (int32 index = 0; index < m_ResourceTypeHeaps.size(); ++index)
+    {
+        VulkanResourceHeap* heap = m_ResourceTypeHeaps[index];
+        if (!heap) {
+            continue;
+        }
+        numPages   += heap->m_PageIDCounter;
+        numLive    += (uint32)(heap->m_UsedBufferPages.size() + heap->m_UsedImagePages.size() + heap->m_FreePages.size());
+        usedMemory += heap->m_UsedMemory;
+    }
+
+    // 每个子分配原本都要一次vkAllocateMemory，现在只有新建page时才会调用
+    uint32 numAllocations = m_NumBufferAllocations + m_NumImageAllocations;
+    uint32 numSaved       = numAllocations > numPages ? numAllocations - numPages : 0;
+    MLOG("Resource heap stats : %d buffer + %d image suballocations, %d pages created (%d live, %.2f MB), %d vkAllocateMemory calls saved", m_NumBufferAllocations, m_NumImageAllocations, numPages, numLive, (float)((double)usedMemory / 1024.0 / 1024.0), numSaved);
+    MLOG("Device memory stats : %d allocations, peak %d, max %d", m_DeviceMemoryManager->GetNumAllocations(), m_DeviceMemoryManager->GetPeakNumAllocations(), m_VulkanDevice->GetLimits().maxMemoryAllocationCount);
+}
+
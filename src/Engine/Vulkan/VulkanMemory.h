@@ -2,6 +2,7 @@
 #include "Common/Common.h"
 #include "Common/Log.h"
 #include "HAL/ThreadSafeCounter.h"
+#include "Utils/TLSFAllocator.h"
 
 #include "Vulkan/VulkanRHI.h"
 #include "VulkanPlatform.h"
@@ -9,7 +10,8 @@
 
 #include <memory>
 #include <vector>
-#include <winnt.h>
+#include <map>
+#include <string>
 
 class VulkanDevice;
 class VulkanDeviceMemoryManager;
@@ -19,6 +21,8 @@ class VulkanResourceHeapManager;
 class VulkanBufferSubAllocation;
 class VulkanSubBufferAllocator;
 class VulkanSubResourceAllocator;
+class VulkanResourceAllocation;
+class VulkanResourceDefragmenter;
 
 class RefCount
 {
@@ -63,18 +67,6 @@ public:
 };
 
 
-struct VulkanRange
-{
-    uint32 offset;
-    uint32 size;
-    static void JoinConsecutiveRanges(std::vector<VulkanRange>& ranges);
-    FORCE_INLINE bool operator<(const VulkanRange& vulkanRange) const
-    {
-        return offset<vulkanRange.offset;
-    }
-};
-
-
 class VulkanDeviceMemoryAllocation
 {
 public:
@@ -119,6 +111,16 @@ public:
 		return m_MemoryTypeIndex;
 	}
 
+	FORCE_INLINE const char* GetFile() const
+	{
+		return m_File;
+	}
+
+	FORCE_INLINE uint32 GetLine() const
+	{
+		return m_Line;
+	}
+
 protected:
 	virtual ~VulkanDeviceMemoryAllocation();
 
@@ -133,6 +135,8 @@ protected:
 	bool            m_IsCoherent;
 	bool            m_IsCached;
 	bool            m_FreedBySystem;
+	const char*     m_File;
+	uint32          m_Line;
 
 };
 
@@ -152,6 +156,32 @@ class VulkanDeviceMemoryManager
 #endif
     uint64 GetTotalMemory(bool gpu) const;
 
+    // 从VK_EXT_memory_budget刷新各heap的预算与用量，不支持时按heap大小估算。
+    // 查询开销较大，每帧调用一次，两次刷新之间按本管理器的分配与释放估算用量。
+    void UpdateBudget();
+
+    // 在memoryTypeIndex所在heap上再分配size字节是否会超出预算
+    bool IsOverBudget(uint32 memoryTypeIndex, VkDeviceSize size) const;
+
+    VkDeviceSize GetHeapBudget(uint32 heapIndex) const;
+
+    VkDeviceSize GetHeapUsage(uint32 heapIndex) const;
+
+    // 以JSON输出当前各heap与各分配位置(file:line)的用量，内容与顺序固定，便于不同版本之间diff
+    std::string GetMemoryReport();
+
+    bool WriteMemoryReport(const std::string& filepath);
+
+    // 按分配位置(file:line)统计资源实际占用的大小，由heap page与buffer子分配器在分配与释放时调用
+    void AddTagUsage(const char* file, uint32 line, VkDeviceSize size);
+
+    void RemoveTagUsage(const char* file, uint32 line, VkDeviceSize size);
+
+    FORCE_INLINE bool HasMemoryBudget() const
+    {
+        return m_HasMemoryBudget;
+    }
+
     FORCE_INLINE bool HasUnifiedMemory() const
     {
         return m_HasUnifiedMemory;
@@ -162,6 +192,16 @@ class VulkanDeviceMemoryManager
         return m_MemoryProperties.memoryTypeCount;
     }
 
+    FORCE_INLINE uint32 GetNumAllocations() const
+    {
+        return m_NumAllocations;
+    }
+
+    FORCE_INLINE uint32 GetPeakNumAllocations() const
+    {
+        return m_PeakNumAllocations;
+    }
+
 
     FORCE_INLINE VkResult GetMemoryTypeFromProperties(uint32 typeBits, VkMemoryPropertyFlags properties, uint32* outTypeIndex)
     {
@@ -219,6 +259,10 @@ protected:
             : totalSize(0)
             , usedSize(0)
             , peakSize(0)
+            , budget(0)
+            , usage(0)
+            , peakUsage(0)
+            , usedSizeAtBudget(0)
         {
             
         }
@@ -226,10 +270,35 @@ protected:
         VkDeviceSize totalSize;
         VkDeviceSize usedSize;
         VkDeviceSize peakSize;
+        // 驱动报告的预算与本进程用量，usage包含不经过本管理器的分配(swapchain等)
+        VkDeviceSize budget;
+        VkDeviceSize usage;
+        VkDeviceSize peakUsage;
+        // 查询预算时的usedSize，两次查询之间用usedSize的变化估算usage
+        VkDeviceSize usedSizeAtBudget;
         std::vector<VulkanDeviceMemoryAllocation*> allocations;
     };
+
+    struct TagInfo
+    {
+        TagInfo()
+            : count(0)
+            , size(0)
+            , peakSize(0)
+            , totalCount(0)
+        {
+
+        }
+
+        uint32       count;
+        VkDeviceSize size;
+        VkDeviceSize peakSize;
+        uint32       totalCount;
+    };
     
     void SetupAndPrintMemInfo();
+
+    static std::string GetTag(const char* file, uint32 line);
     
 protected:
 
@@ -239,15 +308,62 @@ protected:
     bool                             m_HasUnifiedMemory;
     uint32                           m_NumAllocations;
     uint32                           m_PeakNumAllocations;
+    bool                             m_HasMemoryBudget;
     std::vector<HeapInfo>            m_HeapInfos;
+    std::map<std::string, TagInfo>   m_TagInfos;
+};
+
+// 碎片整理时由资源持有者实现，负责在新的分配上重建资源。没有设置mover的分配不会被移动。
+// 持有者在移动过程中销毁时，需要自行清理新旧资源并把相关分配的mover置空。
+class VulkanResourceMover
+{
+public:
+    virtual ~VulkanResourceMover()
+    {
+
+    }
+
+    // 在newAllocation上创建并绑定新资源，把旧资源的拷贝录制到cmdBuffer；返回false表示该资源不能移动
+    virtual bool BeginMove(VkCommandBuffer cmdBuffer, VulkanResourceAllocation* newAllocation) = 0;
+
+    // 拷贝已经完成，切换到新资源并持有newAllocation，旧资源暂不销毁
+    virtual void CommitMove(VulkanResourceAllocation* newAllocation) = 0;
+
+    // 引用旧资源的帧都已结束，销毁旧资源并释放oldAllocation
+    virtual void FinishMove(VulkanResourceAllocation* oldAllocation) = 0;
+};
+
+struct VulkanResourceHeapStats
+{
+    uint32  numPages = 0;
+    uint32  numFreePages = 0;
+    uint32  numAllocations = 0;
+    uint32  numFreeBlocks = 0;
+    uint64  residentBytes = 0;
+    uint64  usedBytes = 0;
+    uint64  largestFreeBytes = 0;
+
+    // 空闲空间中不能被最大空闲块利用的比例，按page累加
+    FORCE_INLINE float GetFragmentation() const
+    {
+        uint64 freeBytes = residentBytes - usedBytes;
+        return freeBytes > 0 ? 1.0f - (float)((double)largestFreeBytes / (double)freeBytes) : 0.0f;
+    }
+
+    FORCE_INLINE float GetOccupancy() const
+    {
+        return residentBytes > 0 ? (float)((double)usedBytes / (double)residentBytes) : 0.0f;
+    }
 };
 
 class VulkanResourceAllocation: public RefCount
 {
-     VulkanResourceAllocation(VulkanResourceHeapPage* owner, VulkanDeviceMemoryAllocation* deviceMemoryAllocation, uint32 requestedSize, uint32 alignedOffset, uint32 allocationSize, uint32 allocationOffset, const char* file, uint32 line);
+private:
+    VulkanResourceAllocation(VulkanResourceHeapPage* owner, VulkanDeviceMemoryAllocation* deviceMemoryAllocation, uint32 requestedSize, uint32 alignedOffset, uint32 allocationSize, uint32 allocationOffset, const char* file, uint32 line);
     
     virtual ~VulkanResourceAllocation();
 
+public:
     void BindBuffer(VulkanDevice* device,VkBuffer buffer);
     void BindImage(VulkanDevice* device,VkImage image);
 
@@ -279,6 +395,11 @@ class VulkanResourceAllocation: public RefCount
     {
         return m_DeviceMemoryAllocation->GetMemoryTypeIndex();
     }
+
+    FORCE_INLINE VulkanDeviceMemoryAllocation* GetDeviceMemoryAllocation() const
+    {
+        return m_DeviceMemoryAllocation;
+    }
     
     FORCE_INLINE void FlushMappedMemory()
     {
@@ -289,8 +410,34 @@ class VulkanResourceAllocation: public RefCount
     {
         m_DeviceMemoryAllocation->InvalidateMappedMemory(m_AllocationOffset, m_AllocationSize);
     }
+
+    FORCE_INLINE uint32 GetAlignment() const
+    {
+        return m_Alignment;
+    }
+
+    FORCE_INLINE VulkanResourceHeapPage* GetPage() const
+    {
+        return m_Owner;
+    }
+
+    FORCE_INLINE void SetMover(VulkanResourceMover* mover)
+    {
+        m_Mover = mover;
+    }
+
+    FORCE_INLINE VulkanResourceMover* GetMover() const
+    {
+        return m_Mover;
+    }
+
+    FORCE_INLINE bool IsMoving() const
+    {
+        return m_Moving;
+    }
 private:
     friend class VulkanResourceHeapPage;
+    friend class VulkanResourceDefragmenter;
     bool JoinFreeBlocks();
 private:
     VulkanResourceHeapPage*         m_Owner;
@@ -298,7 +445,14 @@ private:
     uint32                          m_AllocationOffset;
     uint32                          m_RequestedSize;
     uint32                          m_AlignedOffset;
+    uint32                          m_AllocatorBlock;
+    uint32                          m_PageSlot;
+    uint32                          m_Alignment;
     VulkanDeviceMemoryAllocation*   m_DeviceMemoryAllocation;
+    VulkanResourceMover*            m_Mover;
+    bool                            m_Moving;
+    const char*                     m_File;
+    uint32                          m_Line;
 };
 
 
@@ -329,17 +483,34 @@ public:
     {
         return m_ID;
     }
+
+    FORCE_INLINE uint32 GetUsedSize() const
+    {
+        return m_UsedSize;
+    }
+
+    FORCE_INLINE uint32 GetMaxSize() const
+    {
+        return m_MaxSize;
+    }
+
+    FORCE_INLINE bool IsMapped() const
+    {
+        return m_DeviceMemoryAllocation->IsMapped();
+    }
     
 protected:
     bool JoinFreeBlocks();
     
     friend class VulkanResourceHeap;
+    friend class VulkanResourceHeapManager;
+    friend class VulkanResourceDefragmenter;
 protected:
 
     VulkanResourceHeap*                     m_Owner;
     VulkanDeviceMemoryAllocation*           m_DeviceMemoryAllocation;
     std::vector<VulkanResourceAllocation*>  m_ResourceAllocations;
-    std::vector<VulkanRange>                m_FreeList;
+    TLSFAllocator                           m_Allocator;
     
     uint32                                  m_MaxSize;
     uint32                                  m_UsedSize;
@@ -382,6 +553,8 @@ public:
         return m_MemoryTypeIndex;
     }
 
+    void GetStats(VulkanResourceHeapStats& outStats) const;
+
 #if MONKEY_DEBUG
     void DumpMemory();
 #endif
@@ -389,6 +562,7 @@ protected:
     VulkanResourceAllocation* AllocateResource(Type type, uint32 size, uint32 alignment, bool mapAllocation, const char* file, uint32 line);
 
     friend class VulkanResourceHeapManager;
+    friend class VulkanResourceDefragmenter;
 protected:
     VulkanResourceHeapManager* m_Owner;
     uint32                     m_MemoryTypeIndex;
@@ -417,8 +591,13 @@ public:
     
     void ReleaseBuffer(VulkanSubBufferAllocator* bufferAllocator);
     
+    // 把所有heap中已经完全空闲的page归还给驱动
     void ReleaseFreedPages();
 
+    void PrintStats();
+
+    void GetStats(VulkanResourceHeapStats& outStats) const;
+
 #if MONKEY_DEBUG
     void DumpMemory();
 #endif
@@ -432,6 +611,8 @@ public:
         return m_VulkanDevice;
     }
 protected:
+    friend class VulkanResourceDefragmenter;
+
     void ReleaseFreedResources(bool immediately);
     
     void DestroyResourceAllocations();
@@ -505,6 +686,8 @@ protected:
     //mark, what is subbufferallocator
     std::vector<VulkanSubBufferAllocator*>  m_UsedBufferAllocations[(int32)PoolSizes::SizesCount + 1];
     std::vector<VulkanSubBufferAllocator*>  m_FreeBufferAllocations[(int32)PoolSizes::SizesCount + 1];
+    uint32                                  m_NumBufferAllocations;
+    uint32                                  m_NumImageAllocations;
 };
 
 class VulkanResourceSubAllocation : public RefCount
@@ -521,11 +704,18 @@ public:
     {
         return m_RequestedSize;
     }
+protected:
+    friend class VulkanSubResourceAllocator;
+
 protected:
     uint32 m_RequestedSize;
     uint32 m_AlignedOffset;
     uint32 m_AllocationSize;
     uint32 m_AllocationOffset;
+    uint32 m_AllocatorBlock;
+    uint32 m_AllocatorSlot;
+    const char* m_File;
+    uint32 m_Line;
     
 };
 
@@ -562,6 +752,8 @@ public:
     protected:
     bool JoinFreeBlocks();
 
+    void ReleaseSubAllocation(VulkanResourceSubAllocation* subAllocation);
+
 
 protected:
     VulkanResourceHeapManager* m_Owner;
@@ -572,7 +764,7 @@ protected:
     uint32                                      m_Alignment;
     uint32                                      m_FrameFreed;
     int64                                       m_UsedSize;
-    std::vector<VulkanRange>                    m_FreeList;
+    TLSFAllocator                               m_Allocator;
     std::vector<VulkanResourceSubAllocation*>   m_SubAllocations;
 };
 
@@ -8,7 +8,7 @@
 
 #include "RHIDefinitions.h"
 #include "Vulkan/VulkanGlobals.h"
-#include "Vulkan/Windows/VulkanWindowsPlatform.h"
+#include "Vulkan/VulkanPlatform.h"
 #include "VulkanRHI.h"
 #include "VulkanPlatform.h"
 #include "VulkanDevice.h"
@@ -215,6 +215,8 @@ static FORCE_INLINE VkFormat VEToVkFormat(VertexElementType Type)
 		return VK_FORMAT_R32G32B32A32_SFLOAT;
 	case VET_URGB10A2N:
 		return VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+	case VET_UInt3:
+		return VK_FORMAT_R32G32B32_UINT;
 	default:
 		break;
 	}
@@ -264,6 +266,8 @@ static FORCE_INLINE uint32 ElementTypeToSize(VertexElementType type)
 		return 8;
 	case VET_URGB10A2N:
 		return 4;
+	case VET_UInt3:
+		return 12;
 	default:
 		return 0;
 	};
@@ -1,5 +1,5 @@
 #include "Vulkan/VulkanGlobals.h"
-#include "Vulkan/Windows/VulkanWindowsPlatform.h"
+#include "Vulkan/VulkanPlatform.h"
 #include "VulkanDevice.h"
 #include "VulkanQueue.h"
 #include "VulkanMemory.h"
@@ -25,6 +25,13 @@ VulkanSwapChain::VulkanSwapChain(VkInstance instance, std::shared_ptr<VulkanDevi
 	, m_LockToVsync(lockToVsync)
 	, m_PresentID(0)
 {
+    if (!VulkanPlatform::SupportsSurface())
+    {
+        m_Device->SetupPresentQueue(VK_NULL_HANDLE);
+        CreateOffscreen(outPixelFormat, width, height, outDesiredNumBackBuffers, outImages);
+        return;
+    }
+
     VulkanPlatform::CreateSurface(instance,&m_Surface);
     m_Device->SetupPresentQueue(m_Surface);
     
@@ -217,18 +224,101 @@ VulkanSwapChain::VulkanSwapChain(VkInstance instance, std::shared_ptr<VulkanDevi
     *outDesiredNumBackBuffers = numSwapChainImages;
 	m_BackBufferCount = numSwapChainImages;
 
+	CreateSemaphores(numSwapChainImages);
+
+    m_PresentID   = 0;
+	m_ColorFormat = currFormat.format;
+    MLOG("SwapChain: Backbuffer:%d Format:%d ColorSpace:%d Size:%dx%d Present:%d", m_SwapChainInfo.minImageCount, m_SwapChainInfo.imageFormat, m_SwapChainInfo.imageColorSpace, m_SwapChainInfo.imageExtent.width, m_SwapChainInfo.imageExtent.height, m_SwapChainInfo.presentMode);
+}
+
+void VulkanSwapChain::CreateSemaphores(int32 count)
+{
 	// 创建Fence
-	m_ImageAcquiredSemaphore.resize(numSwapChainImages);
-	for (int32 index = 0; index < (int32)numSwapChainImages; ++index)
+	m_ImageAcquiredSemaphore.resize(count);
+	for (int32 index = 0; index < count; ++index)
 	{
 		VkSemaphoreCreateInfo createInfo;
 		ZeroVulkanStruct(createInfo, VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO);
 		VERIFYVULKANRESULT(vkCreateSemaphore(m_Device->GetInstanceHandle(), &createInfo, VULKAN_CPU_ALLOCATOR, &m_ImageAcquiredSemaphore[index]));
 	}
+}
 
-    m_PresentID   = 0;
-	m_ColorFormat = currFormat.format;
-    MLOG("SwapChain: Backbuffer:%d Format:%d ColorSpace:%d Size:%dx%d Present:%d", m_SwapChainInfo.minImageCount, m_SwapChainInfo.imageFormat, m_SwapChainInfo.imageColorSpace, m_SwapChainInfo.imageExtent.width, m_SwapChainInfo.imageExtent.height, m_SwapChainInfo.presentMode);
+void VulkanSwapChain::CreateOffscreen(PixelFormat& outPixelFormat, uint32 width, uint32 height, uint32* outDesiredNumBackBuffers, std::vector<VkImage>& outImages)
+{
+	VkDevice device = m_Device->GetInstanceHandle();
+
+	// 优先使用请求的格式，不能作为color attachment时退回RGBA8
+	VkFormatProperties formatProps;
+	if (outPixelFormat != PF_Unknown && G_PixelFormats[outPixelFormat].supported)
+	{
+		vkGetPhysicalDeviceFormatProperties(m_Device->GetPhysicalHandle(), (VkFormat)G_PixelFormats[outPixelFormat].platformFormat, &formatProps);
+		if ((formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT) == 0)
+		{
+			MLOG("Requested PixelFormat %d can't be used as offscreen backbuffer, falling back to PF_R8G8B8A8", (uint32)outPixelFormat);
+			outPixelFormat = PF_R8G8B8A8;
+		}
+	}
+	else
+	{
+		outPixelFormat = PF_R8G8B8A8;
+	}
+
+	m_ColorFormat     = (VkFormat)G_PixelFormats[outPixelFormat].platformFormat;
+	m_BackBufferCount = MMath::Max(*outDesiredNumBackBuffers, 2u);
+
+	// 与真实swapchain保持一致，DemoBase等上层代码无需区分
+	ZeroVulkanStruct(m_SwapChainInfo, VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR);
+	m_SwapChainInfo.minImageCount		= m_BackBufferCount;
+	m_SwapChainInfo.imageFormat			= m_ColorFormat;
+	m_SwapChainInfo.imageColorSpace		= VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+	m_SwapChainInfo.imageExtent.width	= width;
+	m_SwapChainInfo.imageExtent.height	= height;
+	m_SwapChainInfo.imageUsage			= VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	m_SwapChainInfo.preTransform		= VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+	m_SwapChainInfo.imageArrayLayers	= 1;
+	m_SwapChainInfo.imageSharingMode	= VK_SHARING_MODE_EXCLUSIVE;
+	m_SwapChainInfo.presentMode			= VK_PRESENT_MODE_IMMEDIATE_KHR;
+	m_SwapChainInfo.compositeAlpha		= VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+
+	m_OffscreenImages.resize(m_BackBufferCount);
+	m_OffscreenMemories.resize(m_BackBufferCount);
+	for (int32 index = 0; index < m_BackBufferCount; ++index)
+	{
+		VkImageCreateInfo imageCreateInfo;
+		ZeroVulkanStruct(imageCreateInfo, VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO);
+		imageCreateInfo.imageType     = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format        = m_ColorFormat;
+		imageCreateInfo.extent        = { width, height, 1 };
+		imageCreateInfo.mipLevels     = 1;
+		imageCreateInfo.arrayLayers   = 1;
+		imageCreateInfo.samples       = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling        = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.usage         = m_SwapChainInfo.imageUsage;
+		imageCreateInfo.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VERIFYVULKANRESULT(vkCreateImage(device, &imageCreateInfo, VULKAN_CPU_ALLOCATOR, &m_OffscreenImages[index]));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, m_OffscreenImages[index], &memReqs);
+
+		uint32 memoryTypeIndex = 0;
+		VERIFYVULKANRESULT(m_Device->GetMemoryManager().GetMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeIndex));
+
+		VkMemoryAllocateInfo allocInfo;
+		ZeroVulkanStruct(allocInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
+		allocInfo.allocationSize  = memReqs.size;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+		VERIFYVULKANRESULT(vkAllocateMemory(device, &allocInfo, VULKAN_CPU_ALLOCATOR, &m_OffscreenMemories[index]));
+		VERIFYVULKANRESULT(vkBindImageMemory(device, m_OffscreenImages[index], m_OffscreenMemories[index], 0));
+	}
+
+	outImages = m_OffscreenImages;
+	*outDesiredNumBackBuffers = m_BackBufferCount;
+
+	CreateSemaphores(m_BackBufferCount);
+
+	m_PresentID = 0;
+	MLOG("Offscreen SwapChain: Backbuffer:%d Format:%d Size:%dx%d", m_BackBufferCount, m_ColorFormat, width, height);
 }
 
 VulkanSwapChain::~VulkanSwapChain()
@@ -238,9 +328,18 @@ VulkanSwapChain::~VulkanSwapChain()
 	for (int32 index = 0; index < m_ImageAcquiredSemaphore.size(); ++index) {
 		vkDestroySemaphore(m_Device->GetInstanceHandle(), m_ImageAcquiredSemaphore[index], VULKAN_CPU_ALLOCATOR);
 	}
-    
-	vkDestroySwapchainKHR(device, m_SwapChain, VULKAN_CPU_ALLOCATOR);
-    vkDestroySurfaceKHR(m_Instance, m_Surface, VULKAN_CPU_ALLOCATOR);
+
+	for (int32 index = 0; index < m_OffscreenImages.size(); ++index) {
+		vkDestroyImage(device, m_OffscreenImages[index], VULKAN_CPU_ALLOCATOR);
+		vkFreeMemory(device, m_OffscreenMemories[index], VULKAN_CPU_ALLOCATOR);
+	}
+
+	if (m_SwapChain != VK_NULL_HANDLE) {
+		vkDestroySwapchainKHR(device, m_SwapChain, VULKAN_CPU_ALLOCATOR);
+	}
+	if (m_Surface != VK_NULL_HANDLE) {
+		vkDestroySurfaceKHR(m_Instance, m_Surface, VULKAN_CPU_ALLOCATOR);
+	}
 }
 
 
@@ -251,6 +350,22 @@ int32 VulkanSwapChain::AcquireImageIndex(VkSemaphore* outSemaphore)
 	const int32 prev  = m_SemaphoreIndex;
 
 	m_SemaphoreIndex  = (m_SemaphoreIndex + 1) % m_ImageAcquiredSemaphore.size();
+
+	// 离屏模式轮流使用backbuffer，用一次空提交signal semaphore，保持与真实swapchain相同的同步流程
+	if (IsOffscreen())
+	{
+		VkSubmitInfo submitInfo;
+		ZeroVulkanStruct(submitInfo, VK_STRUCTURE_TYPE_SUBMIT_INFO);
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores    = &m_ImageAcquiredSemaphore[m_SemaphoreIndex];
+		VERIFYVULKANRESULT(vkQueueSubmit(m_Device->GetGraphicsQueue()->GetHandle(), 1, &submitInfo, VK_NULL_HANDLE));
+
+		m_NumAcquireCalls   += 1;
+		*outSemaphore       = m_ImageAcquiredSemaphore[m_SemaphoreIndex];
+		m_CurrentImageIndex = (m_CurrentImageIndex + 1) % m_BackBufferCount;
+		return m_CurrentImageIndex;
+	}
+
 	VkResult result   = vkAcquireNextImageKHR(device, m_SwapChain, MAX_uint64, m_ImageAcquiredSemaphore[m_SemaphoreIndex], VK_NULL_HANDLE, &imageIndex);
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
@@ -277,6 +392,23 @@ VulkanSwapChain::SwapStatus VulkanSwapChain::Present(std::shared_ptr<VulkanQueue
         return SwapStatus::Healthy;
     }
     m_PresentID +=1;
+
+    // 离屏模式没有present，只需要消耗掉渲染完成的semaphore
+    if (IsOffscreen())
+    {
+        VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+        VkSubmitInfo submitInfo;
+        ZeroVulkanStruct(submitInfo, VK_STRUCTURE_TYPE_SUBMIT_INFO);
+        submitInfo.waitSemaphoreCount = doneSemaphore == nullptr ? 0 : 1;
+        submitInfo.pWaitSemaphores    = doneSemaphore;
+        submitInfo.pWaitDstStageMask  = &waitStageMask;
+        VERIFYVULKANRESULT(vkQueueSubmit(presentQueue->GetHandle(), 1, &submitInfo, VK_NULL_HANDLE));
+
+        m_NumPresentCalls += 1;
+        return SwapStatus::Healthy;
+    }
+
     VkPresentInfoKHR createInfo;
     ZeroVulkanStruct(createInfo,VK_STRUCTURE_TYPE_PRESENT_INFO_KHR);
 
@@ -312,6 +444,12 @@ void VulkanDevice::SetupPresentQueue(VkSurfaceKHR surface)
 		return;
 	}
 
+	// 离屏模式没有surface，直接使用图形队列
+	if (surface == VK_NULL_HANDLE) {
+		m_PresentQueue = m_GfxQueue;
+		return;
+	}
+
 	const auto SupportsPresent = [surface](VkPhysicalDevice physicalDevice, std::shared_ptr<VulkanQueue> queue)
 	{
 		VkBool32 supportsPresent = VK_FALSE;
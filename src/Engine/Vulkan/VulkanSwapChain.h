@@ -66,6 +66,17 @@ public:
 		return m_ColorFormat;
 	}
 
+	// 没有surface时backbuffer是普通的离屏image，Present不会输出到屏幕
+	FORCE_INLINE bool IsOffscreen() const
+	{
+		return m_SwapChain == VK_NULL_HANDLE;
+	}
+
+
+protected:
+    void CreateOffscreen(PixelFormat& outPixelFormat, uint32 width, uint32 height, uint32* outDesiredNumBackBuffers, std::vector<VkImage>& outImages);
+
+    void CreateSemaphores(int32 count);
 
 protected:
     friend class VulkanViewport;
@@ -79,6 +90,8 @@ protected:
     int32       m_BackBufferCount;
     std::shared_ptr<VulkanDevice> m_Device;
     std::vector<VkSemaphore> m_ImageAcquiredSemaphore;
+    std::vector<VkImage>        m_OffscreenImages;
+    std::vector<VkDeviceMemory> m_OffscreenMemories;
 
    	int32							m_CurrentImageIndex;
 	int32							m_SemaphoreIndex;
@@ -98,7 +98,7 @@ private:
 
     void Draw(float time, float delta)
     {
-
+        int32 bufferIndex = DemoBase::AcquireBackbufferIndex();
 
         bool hovered = UpdateUI(time, delta);
         if (!hovered)
@@ -107,7 +107,13 @@ private:
         }
 
         UpdateUniformBuffers(time, delta);
-        int32 bufferIndex = DemoBase::AcquireBackbufferIndex();
+
+        // 其余command buffer可能还在GPU上执行，只重新录制刚获取到的这个
+        if (m_CommandBufferDirty[bufferIndex])
+        {
+            RecordCommandBuffer(bufferIndex);
+        }
+
         DemoBase::Present(bufferIndex);
     }
 
@@ -136,14 +142,28 @@ private:
 
         m_GUI->EndFrame();
 
-        if (m_GUI->Update())
+        if (m_GUI->Update(GetFrameIndex()))
         {
-            SetupCommandBuffers();
+            MarkCommandBuffersDirty();
         }
 
         return hovered;
     }
+    void MarkCommandBuffersDirty()
+    {
+        m_CommandBufferDirty.assign(m_CommandBuffers.size(), true);
+    }
+
     void SetupCommandBuffers()
+    {
+        m_CommandBufferDirty.resize(m_CommandBuffers.size());
+        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
+        {
+            RecordCommandBuffer(i);
+        }
+    }
+
+    void RecordCommandBuffer(int32 i)
     {
         VkCommandBufferBeginInfo cmdBeginInfo;
         ZeroVulkanStruct(cmdBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
@@ -164,7 +184,6 @@ private:
         renderPassBeginInfo.renderArea.extent.width  = m_FrameWidth;
         renderPassBeginInfo.renderArea.extent.height = m_FrameHeight;
 
-        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
         {
             renderPassBeginInfo.framebuffer = m_FrameBuffers[i];
 
@@ -207,6 +226,8 @@ private:
             vkCmdEndRenderPass(m_CommandBuffers[i]);
             VERIFYVULKANRESULT(vkEndCommandBuffer(m_CommandBuffers[i]));
         }
+
+        m_CommandBufferDirty[i] = false;
     }
 
     void CreateDescriptorSet()
@@ -411,13 +432,12 @@ private:
 
     void LoadAssets()
     {
-        vk_demo::DVKCommandBuffer* cmdBuffer = vk_demo::DVKCommandBuffer::Create(m_VulkanDevice,m_CommandPool);
-        m_Model = vk_demo::DVKModel::LoadFromFile(   
+        m_Model = vk_demo::DVKModel::LoadFromFileAsync(
             "assets/models/suzanne.obj",
             m_VulkanDevice,
-            cmdBuffer,
+            m_Uploader,
             { VertexAttribute::VA_Position, VertexAttribute::VA_Normal });
-        delete cmdBuffer;
+        m_Uploader->WaitIdle();
     }
 
     void DestroyAssets()
@@ -450,6 +470,7 @@ private:
     VkDescriptorSet                 m_DescriptorSet = VK_NULL_HANDLE;
 
     ImageGUIContext*                m_GUI = nullptr;
+    std::vector<bool>               m_CommandBufferDirty;
 };
 
 std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
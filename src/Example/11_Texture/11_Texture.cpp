@@ -9,6 +9,7 @@
 #include "Demo/DVKUtils.h"
 #include "Demo/DVKCamera.h"
 #include "Demo/DVKModel.h"
+#include "Demo/DVKUploadQueue.h"
 #include "Demo/DVKPipeline.h"
 #include "Math/Vector3.h"
 #include "Math/Vector4.h"
@@ -105,8 +106,8 @@ private:
 
     void Draw(float time, float delta)
     {
-
         int32 bufferIndex = DemoBase::AcquireBackbufferIndex();
+
         bool hovered = UpdateUI(time, delta);
         if (!hovered)
         {
@@ -114,7 +115,13 @@ private:
         }
 
         UpdateUniformBuffers(time, delta);
-      
+
+        // 其余command buffer可能还在GPU上执行，只重新录制刚获取到的这个
+        if (m_CommandBufferDirty[bufferIndex])
+        {
+            RecordCommandBuffer(bufferIndex);
+        }
+
         DemoBase::Present(bufferIndex);
     }
 
@@ -151,14 +158,28 @@ private:
 
         m_GUI->EndFrame();
 
-        if (m_GUI->Update())
+        if (m_GUI->Update(GetFrameIndex()))
         {
-            SetupCommandBuffers();
+            MarkCommandBuffersDirty();
         }
 
         return hovered;
     }
+    void MarkCommandBuffersDirty()
+    {
+        m_CommandBufferDirty.assign(m_CommandBuffers.size(), true);
+    }
+
     void SetupCommandBuffers()
+    {
+        m_CommandBufferDirty.resize(m_CommandBuffers.size());
+        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
+        {
+            RecordCommandBuffer(i);
+        }
+    }
+
+    void RecordCommandBuffer(int32 i)
     {
         VkCommandBufferBeginInfo cmdBeginInfo;
         ZeroVulkanStruct(cmdBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
@@ -179,7 +200,6 @@ private:
         renderPassBeginInfo.renderArea.extent.width  = m_FrameWidth;
         renderPassBeginInfo.renderArea.extent.height = m_FrameHeight;
 
-        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
         {
             renderPassBeginInfo.framebuffer = m_FrameBuffers[i];
 
@@ -216,6 +236,8 @@ private:
             vkCmdEndRenderPass(m_CommandBuffers[i]);
             VERIFYVULKANRESULT(vkEndCommandBuffer(m_CommandBuffers[i]));
         }
+
+        m_CommandBufferDirty[i] = false;
     }
 
     void CreateDescriptorSet()
@@ -437,23 +459,22 @@ private:
 
     void LoadAssets()
     {
-        vk_demo::DVKCommandBuffer* cmdBuffer = vk_demo::DVKCommandBuffer::Create(m_VulkanDevice,m_CommandPool);
-        
-        m_Model = vk_demo::DVKModel::LoadFromFile(
+        // 模型与贴图都记录到DemoBase的uploader，最后一次性提交
+        vk_demo::DVKUploadQueue* uploader = m_Uploader;
+
+        m_Model = vk_demo::DVKModel::LoadFromFileAsync(
             "assets/models/head.obj",
             m_VulkanDevice,
-            cmdBuffer,
+            uploader,
             { VertexAttribute::VA_Position, VertexAttribute::VA_UV0, VertexAttribute::VA_Normal, VertexAttribute::VA_Tangent }
         );
 
+        m_TexDiffuse       = vk_demo::DVKTexture::Create2D("assets/textures/head_diffuse.jpg", m_VulkanDevice, uploader);
+        m_TexNormal        = vk_demo::DVKTexture::Create2D("assets/textures/head_normal.jpg", m_VulkanDevice, uploader);
+        m_TexCurvature     = vk_demo::DVKTexture::Create2D("assets/textures/curvatureLUT.png", m_VulkanDevice, uploader);
+        m_TexPreIntegrated = vk_demo::DVKTexture::Create2D("assets/textures/preIntegratedLUT.png", m_VulkanDevice, uploader);
 
-
-        m_TexDiffuse       = vk_demo::DVKTexture::Create2D("assets/textures/head_diffuse.jpg", m_VulkanDevice, cmdBuffer);
-        m_TexNormal        = vk_demo::DVKTexture::Create2D("assets/textures/head_normal.jpg", m_VulkanDevice, cmdBuffer);
-        m_TexCurvature     = vk_demo::DVKTexture::Create2D("assets/textures/curvatureLUT.png", m_VulkanDevice, cmdBuffer);
-        m_TexPreIntegrated = vk_demo::DVKTexture::Create2D("assets/textures/preIntegratedLUT.png", m_VulkanDevice, cmdBuffer);            
-        
-        delete cmdBuffer;
+        uploader->WaitIdle();
     }
 
     void DestroyAssets()
@@ -496,6 +517,7 @@ private:
     VkDescriptorSet                 m_DescriptorSet = VK_NULL_HANDLE;
 
     ImageGUIContext*                m_GUI = nullptr;
+    std::vector<bool>               m_CommandBufferDirty;
 };
 
 std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
@@ -117,10 +117,8 @@ private:
 
     void Draw(float time, float delta)
     {
-
         int32 bufferIndex = DemoBase::AcquireBackbufferIndex();
 
-  
         bool hovered = UpdateUI(time, delta);
         if (!hovered)
         {
@@ -128,7 +126,13 @@ private:
         }
 
         UpdateUniformBuffers(time, delta);
-      
+
+        // 其余command buffer可能还在GPU上执行，只重新录制刚获取到的这个
+        if (m_CommandBufferDirty[bufferIndex])
+        {
+            RecordCommandBuffer(bufferIndex);
+        }
+
         DemoBase::Present(bufferIndex);
     }
 
@@ -152,14 +156,28 @@ private:
 
         m_GUI->EndFrame();
 
-        if (m_GUI->Update())
+        if (m_GUI->Update(GetFrameIndex()))
         {
            // SetupCommandBuffers();
         }
 
         return hovered;
     }
+    void MarkCommandBuffersDirty()
+    {
+        m_CommandBufferDirty.assign(m_CommandBuffers.size(), true);
+    }
+
     void SetupCommandBuffers()
+    {
+        m_CommandBufferDirty.resize(m_CommandBuffers.size());
+        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
+        {
+            RecordCommandBuffer(i);
+        }
+    }
+
+    void RecordCommandBuffer(int32 i)
     {
         VkCommandBufferBeginInfo cmdBeginInfo;
         ZeroVulkanStruct(cmdBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
@@ -180,7 +198,6 @@ private:
         renderPassBeginInfo.renderArea.extent.width  = m_FrameWidth;
         renderPassBeginInfo.renderArea.extent.height = m_FrameHeight;
 
-        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
         {
             renderPassBeginInfo.framebuffer = m_FrameBuffers[i];
 
@@ -226,6 +243,8 @@ private:
             vkCmdEndRenderPass(m_CommandBuffers[i]);
             VERIFYVULKANRESULT(vkEndCommandBuffer(m_CommandBuffers[i]));
         }
+
+        m_CommandBufferDirty[i] = false;
     }
 
     void CreateDescriptorSet()
@@ -353,8 +372,8 @@ private:
 
         m_ViewProjBuffer->CopyFrom(&m_ViewProjData, sizeof(ViewProjectionBlock));
         // m_ParamBuffer->CopyFrom(&m_ParamData, sizeof(ParamBlock));
-        //why we need to do here
-        SetupCommandBuffers();
+        // 模型矩阵通过push constants录制在command buffer中，每帧都要重新录制
+        MarkCommandBuffersDirty();
     }
 
     void CreateUniformBuffers()
@@ -422,16 +441,13 @@ private:
 
     void LoadAssets()
     {
-        vk_demo::DVKCommandBuffer* cmdBuffer = vk_demo::DVKCommandBuffer::Create(m_VulkanDevice,m_CommandPool);
-        
-          m_Model = vk_demo::DVKModel::LoadFromFile(
+        m_Model = vk_demo::DVKModel::LoadFromFileAsync(
             "assets/models/Room/miniHouse_FBX.FBX",
             m_VulkanDevice,
-            cmdBuffer,
+            m_Uploader,
             { VertexAttribute::VA_Position, VertexAttribute::VA_UV0, VertexAttribute::VA_Normal }
         );
-        
-        delete cmdBuffer;
+        m_Uploader->WaitIdle();
     }
 
     void DestroyAssets()
@@ -470,6 +486,7 @@ private:
     VkDescriptorSet                 m_DescriptorSet = VK_NULL_HANDLE;
 
     ImageGUIContext*                m_GUI = nullptr;
+    std::vector<bool>               m_CommandBufferDirty;
 };
 
 std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
@@ -14,6 +14,7 @@
 #include "Math/Vector4.h"
 #include "Math/Matrix4x4.h"
 #include "Utils/Alignment.h"
+#include "Utils/CPUProfiler.h"
 #include <vector>
 #include "Demo/ImageGUIContext.h"
 #include "Vulkan/RHIDefinitions.h"
@@ -27,6 +28,8 @@ public:
     DynamicUniformBufferModule(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
         : DemoBase(width, height, title, cmdLine)
     {
+        // uniform按帧分片，每帧只重新录制获取到的command buffer
+        m_FrameSliced = true;
 
     }
 
@@ -122,6 +125,8 @@ private:
         }
 
         UpdateUniformBuffers(time, delta);
+        // 只重新录制当前image的command buffer，其余可能仍在GPU上执行
+        RecordCommandBuffer(bufferIndex);
       
         DemoBase::Present(bufferIndex);
     }
@@ -163,15 +168,23 @@ private:
 
         m_GUI->EndFrame();
 
-        if (m_GUI->Update())
-        {
-           // SetupCommandBuffers();
-        }
+        // 已等待当前帧的fence，GUI写入该帧独占的slice，当前image的command buffer每帧都会重新录制
+        m_GUI->Update(GetFrameIndex());
 
         return hovered;
     }
     void SetupCommandBuffers()
     {
+        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
+        {
+            RecordCommandBuffer(i);
+        }
+    }
+
+    void RecordCommandBuffer(int32 i)
+    {
+        CPU_PROFILE_SCOPE("RecordCommandBuffer");
+
         VkCommandBufferBeginInfo cmdBeginInfo;
         ZeroVulkanStruct(cmdBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
 
@@ -195,62 +208,63 @@ private:
         uint32 modelAlign = Align(sizeof(ModelBlock), alignment);
         uint32 colorAlign = Align(sizeof(ColorBlock), alignment);
 
-        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
-        {
-            renderPassBeginInfo.framebuffer = m_FrameBuffers[i];
+        // 每个在途帧使用独立的uniform区域
+        uint32 viewProjOffset = GetFrameSliceOffset(Align(sizeof(ViewProjectionBlock), alignment));
+        uint32 modelOffset    = GetFrameSliceOffset(m_ModelDatas.size());
+        uint32 colorOffset    = GetFrameSliceOffset(m_ColorDatas.size());
 
-            VERIFYVULKANRESULT(vkBeginCommandBuffer(m_CommandBuffers[i], &cmdBeginInfo));
-            vkCmdBeginRenderPass(m_CommandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        renderPassBeginInfo.framebuffer = m_FrameBuffers[i];
 
-            VkViewport viewport = {};
-            viewport.x        = 0;
-            viewport.y        = m_FrameHeight;
-            viewport.width    = m_FrameWidth;
-            viewport.height   = -(float)m_FrameHeight;    // flip y axis
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
+        VERIFYVULKANRESULT(vkBeginCommandBuffer(m_CommandBuffers[i], &cmdBeginInfo));
+        vkCmdBeginRenderPass(m_CommandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-            VkRect2D scissor = {};
-            scissor.extent.width  = m_FrameWidth;
-            scissor.extent.height = m_FrameHeight;
-            scissor.offset.x      = 0;
-            scissor.offset.y      = 0;
+        VkViewport viewport = {};
+        viewport.x        = 0;
+        viewport.y        = m_FrameHeight;
+        viewport.width    = m_FrameWidth;
+        viewport.height   = -(float)m_FrameHeight;    // flip y axis
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
 
-            vkCmdSetViewport(m_CommandBuffers[i], 0, 1, &viewport);
-            vkCmdSetScissor(m_CommandBuffers[i], 0, 1, &scissor);
+        VkRect2D scissor = {};
+        scissor.extent.width  = m_FrameWidth;
+        scissor.extent.height = m_FrameHeight;
+        scissor.offset.x      = 0;
+        scissor.offset.y      = 0;
 
-            vkCmdBindPipeline(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline->pipeline);
-            
+        vkCmdSetViewport(m_CommandBuffers[i], 0, 1, &viewport);
+        vkCmdSetScissor(m_CommandBuffers[i], 0, 1, &scissor);
 
-            for (int32 meshIndex = 0; meshIndex < m_Model->meshes.size(); ++meshIndex)
-            {
-                uint32 dynamicOffsets[2] = {
-                    meshIndex * modelAlign,
-                    meshIndex * colorAlign
-                };
-                vkCmdBindDescriptorSets(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline->pipelineLayout, 0, 1, &m_DescriptorSet, 0, dynamicOffsets);
-                m_Model->meshes[meshIndex]->BindDrawCmd(m_CommandBuffers[i]);
-            }
-
-            m_GUI->BindDrawCmd(m_CommandBuffers[i], m_RenderPass);
+        vkCmdBindPipeline(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline->pipeline);
+        
 
-            vkCmdEndRenderPass(m_CommandBuffers[i]);
-            VERIFYVULKANRESULT(vkEndCommandBuffer(m_CommandBuffers[i]));
+        for (int32 meshIndex = 0; meshIndex < m_Model->meshes.size(); ++meshIndex)
+        {
+            uint32 dynamicOffsets[3] = {
+                viewProjOffset,
+                modelOffset + meshIndex * modelAlign,
+                colorOffset + meshIndex * colorAlign
+            };
+            vkCmdBindDescriptorSets(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline->pipelineLayout, 0, 1, &m_DescriptorSet, 3, dynamicOffsets);
+            m_Model->meshes[meshIndex]->BindDrawCmd(m_CommandBuffers[i]);
         }
+
+        m_GUI->BindDrawCmd(m_CommandBuffers[i], m_RenderPass);
+
+        vkCmdEndRenderPass(m_CommandBuffers[i]);
+        VERIFYVULKANRESULT(vkEndCommandBuffer(m_CommandBuffers[i]));
     }
 
     void CreateDescriptorSet()
     {
-        VkDescriptorPoolSize poolSizes[2];
-        poolSizes[0].type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount = 1;
-        poolSizes[1].type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-        poolSizes[1].descriptorCount = 2;
+        VkDescriptorPoolSize poolSizes[1];
+        poolSizes[0].type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        poolSizes[0].descriptorCount = 3;
 
 
         VkDescriptorPoolCreateInfo descriptorPoolInfo;
         ZeroVulkanStruct(descriptorPoolInfo, VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO);
-        descriptorPoolInfo.poolSizeCount = 2;
+        descriptorPoolInfo.poolSizeCount = 1;
         descriptorPoolInfo.pPoolSizes    = poolSizes;
         descriptorPoolInfo.maxSets       = 1;
         VERIFYVULKANRESULT(vkCreateDescriptorPool(m_Device, &descriptorPoolInfo, VULKAN_CPU_ALLOCATOR, &m_DescriptorPool));
@@ -265,15 +279,19 @@ private:
 
         VkWriteDescriptorSet writeDescriptorSet;
 
+        VkDescriptorBufferInfo bufferInfo;
+        bufferInfo.buffer = m_ViewProjBuffer->buffer;
+        bufferInfo.offset = 0;
+        bufferInfo.range  = sizeof(ViewProjectionBlock);
+
         ZeroVulkanStruct(writeDescriptorSet, VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET);
         writeDescriptorSet.dstSet          = m_DescriptorSet;
         writeDescriptorSet.descriptorCount = 1;
-        writeDescriptorSet.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        writeDescriptorSet.pBufferInfo     = &(m_ViewProjBuffer->descriptor);
+        writeDescriptorSet.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        writeDescriptorSet.pBufferInfo     = &bufferInfo;
         writeDescriptorSet.dstBinding      = 0;
         vkUpdateDescriptorSets(m_Device, 1, &writeDescriptorSet, 0, nullptr);
 
-        VkDescriptorBufferInfo bufferInfo;
         bufferInfo.buffer = m_ModelBuffer->buffer;
         bufferInfo.offset = 0;
         bufferInfo.range  = sizeof(ModelBlock);
@@ -349,7 +367,7 @@ private:
     {
         VkDescriptorSetLayoutBinding layoutBindings[3] = { };
         layoutBindings[0].binding            = 0;
-        layoutBindings[0].descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        layoutBindings[0].descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         layoutBindings[0].descriptorCount    = 1;
         layoutBindings[0].stageFlags         = VK_SHADER_STAGE_VERTEX_BIT;
         layoutBindings[0].pImmutableSamplers = nullptr;
@@ -402,18 +420,18 @@ private:
                 ModelBlock* modelBlock = (ModelBlock*)(m_ModelDatas.data() + modelAlign * i);
                 modelBlock->model.AppendRotation(45.0f * delta, Vector3::UpVector);
             }
-            m_ModelBuffer->CopyFrom(m_ModelDatas.data(), m_ModelBuffer->size);
         }
 
         m_ViewProjData.view = m_ViewCamera.GetView();
         m_ViewProjData.projection = m_ViewCamera.GetProjection();
 
-        m_ViewProjBuffer->CopyFrom(&m_ViewProjData, sizeof(ViewProjectionBlock));
-
-        m_ColorBuffer->CopyFrom(m_ColorDatas.data(), m_ColorBuffer->size);
-        // m_ParamBuffer->CopyFrom(&m_ParamData, sizeof(ParamBlock));
-        //why we need to do here
-        SetupCommandBuffers();
+        // 写入当前帧槽位对应的区域，不会覆盖GPU正在读取的数据
+        uint8* viewProjPtr = (uint8*)m_ViewProjBuffer->mapped + GetFrameSliceOffset(Align(sizeof(ViewProjectionBlock), alignment));
+        uint8* modelPtr    = (uint8*)m_ModelBuffer->mapped + GetFrameSliceOffset(m_ModelDatas.size());
+        uint8* colorPtr    = (uint8*)m_ColorBuffer->mapped + GetFrameSliceOffset(m_ColorDatas.size());
+        memcpy(viewProjPtr, &m_ViewProjData, sizeof(ViewProjectionBlock));
+        memcpy(modelPtr, m_ModelDatas.data(), m_ModelDatas.size());
+        memcpy(colorPtr, m_ColorDatas.data(), m_ColorDatas.size());
     }
 
     void CreateUniformBuffers()
@@ -436,12 +454,14 @@ private:
             modelBlock->model = m_Model->meshes[i]->linkNode->GetGlobalMatrix();
         }
 
+        // 每个在途帧一份数据
+        uint32 numFrames = GetNumFramesInFlight();
+
         m_ModelBuffer = vk_demo::DVKBuffer::CreateBuffer(
             m_VulkanDevice,
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            m_ModelDatas.size(),
-            m_ModelDatas.data()
+            m_ModelDatas.size() * numFrames
         );
         m_ModelBuffer->Map();
 
@@ -449,8 +469,7 @@ private:
             m_VulkanDevice,
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            sizeof(ViewProjectionBlock),
-            &(m_ViewProjData)
+            Align(sizeof(ViewProjectionBlock), alignment) * numFrames
         );
         m_ViewProjBuffer->Map();
 
@@ -469,8 +488,7 @@ private:
             m_VulkanDevice,
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            m_ColorDatas.size(),
-            m_ColorDatas.data()
+            m_ColorDatas.size() * numFrames
         );
         m_ColorBuffer->Map();
 
@@ -511,16 +529,13 @@ private:
 
     void LoadAssets()
     {
-        vk_demo::DVKCommandBuffer* cmdBuffer = vk_demo::DVKCommandBuffer::Create(m_VulkanDevice,m_CommandPool);
-        
-         m_Model = vk_demo::DVKModel::LoadFromFile(
+        m_Model = vk_demo::DVKModel::LoadFromFileAsync(
             "assets/models/Room/miniHouse_FBX.FBX",
             m_VulkanDevice,
-            cmdBuffer,
+            m_Uploader,
             { VertexAttribute::VA_Position, VertexAttribute::VA_UV0, VertexAttribute::VA_Normal }
         );
-        
-        delete cmdBuffer;
+        m_Uploader->WaitIdle();
     }
 
     void DestroyAssets()
@@ -9,6 +9,7 @@
 #include "Demo/DVKUtils.h"
 #include "Demo/DVKCamera.h"
 #include "Demo/DVKModel.h"
+#include "Demo/DVKFrustumCuller.h"
 #include "Demo/DVKPipeline.h"
 #include "Math/Vector3.h"
 #include "Math/Vector4.h"
@@ -130,6 +131,13 @@ private:
         }
 
         UpdateUniformBuffers(time, delta);
+        UpdateVisibility();
+
+        // 其余command buffer可能还在GPU上执行，只重新录制刚获取到的这个
+        if (m_CommandBufferDirty[bufferIndex])
+        {
+            RecordCommandBuffer(bufferIndex);
+        }
       
         DemoBase::Present(bufferIndex);
     }
@@ -146,6 +154,9 @@ private:
 
             ImGui::Checkbox("AutoRotate", &m_AutoRotate);
 
+            ImGui::Checkbox("Culling", &m_Culling);
+            ImGui::Text("Visible:%d/%d", m_VisibleList.count, (int32)m_Model->meshes.size());
+
             bool debug = m_ParamData.debug != 0;
             ImGui::Checkbox("Debug", &debug);
             m_ParamData.debug = debug ? 1 : 0;
@@ -158,14 +169,28 @@ private:
 
         m_GUI->EndFrame();
 
-        if (m_GUI->Update())
+        if (m_GUI->Update(GetFrameIndex()))
         {
-            SetupCommandBuffers();
+            MarkCommandBuffersDirty();
         }
 
         return hovered;
     }
+    void MarkCommandBuffersDirty()
+    {
+        m_CommandBufferDirty.assign(m_CommandBuffers.size(), true);
+    }
+
     void SetupCommandBuffers()
+    {
+        m_CommandBufferDirty.resize(m_CommandBuffers.size());
+        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
+        {
+            RecordCommandBuffer(i);
+        }
+    }
+
+    void RecordCommandBuffer(int32 i)
     {
         VkCommandBufferBeginInfo cmdBeginInfo;
         ZeroVulkanStruct(cmdBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
@@ -189,8 +214,6 @@ private:
         uint32 alignment  = m_VulkanDevice->GetLimits().minUniformBufferOffsetAlignment;
         uint32 modelAlign = Align(sizeof(ModelBlock), alignment);
 
-
-        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
         {
             renderPassBeginInfo.framebuffer = m_FrameBuffers[i];
 
@@ -217,8 +240,9 @@ private:
             vkCmdBindPipeline(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline->pipeline);
             
 
-            for (int32 meshIndex = 0; meshIndex < m_Model->meshes.size(); ++meshIndex)
+            for (int32 visibleIndex = 0; visibleIndex < m_VisibleList.count; ++visibleIndex)
             {
+                int32 meshIndex = m_VisibleList[visibleIndex];
                 uint32 dynamicOffsets[1] = {
                     meshIndex * modelAlign,
                 };
@@ -231,6 +255,8 @@ private:
             vkCmdEndRenderPass(m_CommandBuffers[i]);
             VERIFYVULKANRESULT(vkEndCommandBuffer(m_CommandBuffers[i]));
         }
+
+        m_CommandBufferDirty[i] = false;
     }
 
     void CreateDescriptorSet()
@@ -413,6 +439,35 @@ private:
         //SetupCommandBuffers();
     }
 
+    // 模型矩阵每帧可能旋转，先更新世界空间包围盒再剔除，可见的mesh变化时所有command buffer都要重新录制
+    void UpdateVisibility()
+    {
+        if (m_Culling)
+        {
+            uint32 alignment  = m_VulkanDevice->GetLimits().minUniformBufferOffsetAlignment;
+            uint32 modelAlign = Align(sizeof(ModelBlock), alignment);
+
+            m_CullingBounds.Resize(m_Model->meshes.size());
+            for (int32 i = 0; i < m_Model->meshes.size(); ++i)
+            {
+                ModelBlock* modelBlock = (ModelBlock*)(m_ModelDatas.data() + modelAlign * i);
+                m_CullingBounds.SetBox(i, m_Model->meshes[i]->bounding, modelBlock->model);
+            }
+
+            m_Frustum.Set(m_ViewCamera.GetViewProjection());
+            vk_demo::DVKFrustumCuller::Cull(m_Frustum, m_CullingBounds, m_VisibleList);
+        }
+        else
+        {
+            m_VisibleList.SetAllVisible(m_Model->meshes.size());
+        }
+
+        if (m_VisibleList.changed)
+        {
+            MarkCommandBuffersDirty();
+        }
+    }
+
     void CreateUniformBuffers()
     {
          uint32 alignment  = m_VulkanDevice->GetLimits().minUniformBufferOffsetAlignment;
@@ -424,6 +479,7 @@ private:
             ModelBlock* modelBlock = (ModelBlock*)(m_ModelDatas.data() + modelAlign * i);
             modelBlock->model = m_Model->meshes[i]->linkNode->GetGlobalMatrix();
         }
+        m_VisibleList.SetAllVisible(m_Model->meshes.size());
 
          m_ModelBuffer = vk_demo::DVKBuffer::CreateBuffer(
             m_VulkanDevice,
@@ -569,11 +625,16 @@ private:
             for (int32 j = 0; j < mesh->primitives.size(); ++j)
             {
                 vk_demo::DVKPrimitive* primitive = mesh->primitives[j];
-                primitive->vertexBuffer = vk_demo::DVKVertexBuffer::Create(m_VulkanDevice, cmdBuffer, primitive->vertices, m_Model->attributes);
-                primitive->indexBuffer  = vk_demo::DVKIndexBuffer::Create(m_VulkanDevice, cmdBuffer, primitive->indices);
+                primitive->vertexBuffer = vk_demo::DVKVertexBuffer::Create(m_VulkanDevice, m_Uploader, primitive->vertices, m_Model->attributes);
+                primitive->indexBuffer  = vk_demo::DVKIndexBuffer::Create(m_VulkanDevice, m_Uploader, primitive->indices);
             }
         }
 
+        // -defrag时允许搬迁，command buffer里记录的是旧的buffer handle
+        m_Model->SetMovable(true, [this]() {
+            MarkCommandBuffersDirty();
+        });
+
         // 加载贴图
         m_Texture = vk_demo::DVKTexture::Create2DArray(
             {
@@ -597,6 +658,7 @@ private:
         );
 
         delete cmdBuffer;
+        m_Uploader->WaitIdle();
     }
 
     void DestroyAssets()
@@ -614,6 +676,12 @@ private:
     std::vector<uint8>              m_ModelDatas;
     vk_demo::DVKBuffer*             m_ModelBuffer = nullptr;
 
+    bool                            m_Culling = true;
+    vk_demo::DVKFrustum             m_Frustum;
+    vk_demo::DVKCullingBounds       m_CullingBounds;
+    vk_demo::DVKVisibleList         m_VisibleList;
+    std::vector<bool>               m_CommandBufferDirty;
+
     ParamBlock                      m_ParamData;
     vk_demo::DVKBuffer*             m_ParamBuffer = nullptr;
 
@@ -1,7 +1,7 @@
 target("14_TextureArray")
 set_kind("binary")
-add_files("/*.cpp","../LaunchWindows.cpp")
+add_files("/*.cpp",launch_file)
 add_links(links_list)
 add_includedirs(include_dir_list, "$(projectdir)/src/Engine")
-add_ldflags("-subsystem:windows")
+add_ldflags(ldflags_list)
 add_deps("Vulkan")
@@ -124,10 +124,8 @@ private:
 
     void Draw(float time, float delta)
     {
-
         int32 bufferIndex = DemoBase::AcquireBackbufferIndex();
 
-  
         bool hovered = UpdateUI(time, delta);
         if (!hovered)
         {
@@ -135,7 +133,13 @@ private:
         }
 
         UpdateUniformBuffers(time, delta);
-      
+
+        // 其余command buffer可能还在GPU上执行，只重新录制刚获取到的这个
+        if (m_CommandBufferDirty[bufferIndex])
+        {
+            RecordCommandBuffer(bufferIndex);
+        }
+
         DemoBase::Present(bufferIndex);
     }
 
@@ -158,14 +162,28 @@ private:
 
         m_GUI->EndFrame();
 
-        if (m_GUI->Update())
+        if (m_GUI->Update(GetFrameIndex()))
         {
-            SetupCommandBuffers();
+            MarkCommandBuffersDirty();
         }
 
         return hovered;
     }
+    void MarkCommandBuffersDirty()
+    {
+        m_CommandBufferDirty.assign(m_CommandBuffers.size(), true);
+    }
+
     void SetupCommandBuffers()
+    {
+        m_CommandBufferDirty.resize(m_CommandBuffers.size());
+        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
+        {
+            RecordCommandBuffer(i);
+        }
+    }
+
+    void RecordCommandBuffer(int32 i)
     {
          VkCommandBufferBeginInfo cmdBeginInfo;
         ZeroVulkanStruct(cmdBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
@@ -204,7 +222,6 @@ private:
         scissor.offset.y      = 0;
 
 
-        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
         {
             renderPassBeginInfo.framebuffer = m_FrameBuffers[i];
 
@@ -273,6 +290,8 @@ private:
             vkCmdEndRenderPass(m_CommandBuffers[i]);
             VERIFYVULKANRESULT(vkEndCommandBuffer(m_CommandBuffers[i]));
         }
+
+        m_CommandBufferDirty[i] = false;
     }
 
     void CreateDescriptorSet()
@@ -519,10 +538,10 @@ private:
     void LoadAssets()
     {
         vk_demo::DVKCommandBuffer* cmdBuffer = vk_demo::DVKCommandBuffer::Create(m_VulkanDevice,m_CommandPool);
-        m_Model = vk_demo::DVKModel::LoadFromFile(
+        m_Model = vk_demo::DVKModel::LoadFromFileAsync(
             "assets/models/plane_z.obj",
             m_VulkanDevice,
-            cmdBuffer,
+            m_Uploader,
             {
                 VertexAttribute::VA_Position,
                 VertexAttribute::VA_UV0
@@ -557,6 +576,7 @@ private:
         m_TexOrigin = vk_demo::DVKTexture::Create2D("assets/textures/game0.jpg", m_VulkanDevice, cmdBuffer);
         m_Tex3DLut  = vk_demo::DVKTexture::Create3D(VK_FORMAT_R8G8B8A8_UNORM, lutRGBA, lutSize * lutSize * 4 * lutSize, lutSize, lutSize, lutSize, m_VulkanDevice, cmdBuffer);
         delete cmdBuffer;
+        m_Uploader->WaitIdle();
     }
 
     void DestroyAssets()
@@ -598,6 +618,7 @@ private:
     VkDescriptorSet                 m_DescriptorSet3 = VK_NULL_HANDLE;
 
     ImageGUIContext*                m_GUI = nullptr;
+    std::vector<bool>               m_CommandBufferDirty;
 };
 
 std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
@@ -10,6 +10,7 @@
 #include "Demo/DVKUtils.h"
 #include "Demo/DVKCamera.h"
 #include "Demo/DVKModel.h"
+#include "Demo/DVKFrustumCuller.h"
 #include "Demo/DVKPipeline.h"
 #include "Math/Vector3.h"
 #include "Math/Vector4.h"
@@ -136,6 +137,13 @@ private:
         }
 
         UpdateUniformBuffers(time, delta);
+        UpdateVisibility();
+
+        // 其余command buffer可能还在GPU上执行，只重新录制刚获取到的这个
+        if (m_CommandBufferDirty[bufferIndex])
+        {
+            RecordCommandBuffer(bufferIndex);
+        }
       
         DemoBase::Present(bufferIndex);
     }
@@ -151,6 +159,9 @@ private:
 
             ImGui::SliderFloat("DebugLut", &m_LutDebugData.bias, 0.0f, 1.0f);
 
+            ImGui::Checkbox("Culling", &m_Culling);
+            ImGui::Text("Visible:%d/%d", m_VisibleList.count, (int32)m_Model->meshes.size());
+
             ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
             ImGui::End();
         }
@@ -159,14 +170,28 @@ private:
 
         m_GUI->EndFrame();
 
-        if (m_GUI->Update())
+        if (m_GUI->Update(GetFrameIndex()))
         {
-            SetupCommandBuffers();
+            MarkCommandBuffersDirty();
         }
 
         return hovered;
     }
+    void MarkCommandBuffersDirty()
+    {
+        m_CommandBufferDirty.assign(m_CommandBuffers.size(), true);
+    }
+
     void SetupCommandBuffers()
+    {
+        m_CommandBufferDirty.resize(m_CommandBuffers.size());
+        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
+        {
+            RecordCommandBuffer(i);
+        }
+    }
+
+    void RecordCommandBuffer(int32 i)
     {
          VkCommandBufferBeginInfo cmdBeginInfo;
         ZeroVulkanStruct(cmdBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
@@ -204,8 +229,6 @@ private:
         scissor.offset.x      = 0;
         scissor.offset.y      = 0;
 
-
-        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
         {
             renderPassBeginInfo.framebuffer = m_FrameBuffers[i];
 
@@ -221,9 +244,9 @@ private:
             vkCmdSetScissor(m_CommandBuffers[i], 0, 1, &scissor);
             vkCmdBindPipeline(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline0->pipeline);
             vkCmdBindDescriptorSets(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline0->pipelineLayout, 0, m_DescriptorSet0->descriptorSets.size(), m_DescriptorSet0->descriptorSets.data(), 0, nullptr);
-            for (int32 meshIndex = 0; meshIndex < m_Model->meshes.size(); ++meshIndex)
+            for (int32 visibleIndex = 0; visibleIndex < m_VisibleList.count; ++visibleIndex)
             {
-                m_Model->meshes[meshIndex]->BindDrawCmd(m_CommandBuffers[i]);
+                m_Model->meshes[m_VisibleList[visibleIndex]]->BindDrawCmd(m_CommandBuffers[i]);
             }
 
 
@@ -236,9 +259,9 @@ private:
             vkCmdSetScissor(m_CommandBuffers[i], 0, 1, &scissor);
             vkCmdBindPipeline(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline1->pipeline);
             vkCmdBindDescriptorSets(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline1->pipelineLayout, 0, m_DescriptorSet1->descriptorSets.size(), m_DescriptorSet1->descriptorSets.data(), 0, nullptr);
-            for (int32 meshIndex = 0; meshIndex < m_Model->meshes.size(); ++meshIndex)
+            for (int32 visibleIndex = 0; visibleIndex < m_VisibleList.count; ++visibleIndex)
             {
-                m_Model->meshes[meshIndex]->BindDrawCmd(m_CommandBuffers[i]);
+                m_Model->meshes[m_VisibleList[visibleIndex]]->BindDrawCmd(m_CommandBuffers[i]);
             }
 
             // 2
@@ -250,9 +273,9 @@ private:
             vkCmdSetScissor(m_CommandBuffers[i], 0, 1, &scissor);
             vkCmdBindPipeline(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline2->pipeline);
            vkCmdBindDescriptorSets(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline2->pipelineLayout, 0, m_DescriptorSet2->descriptorSets.size(), m_DescriptorSet2->descriptorSets.data(), 0, nullptr);
-            for (int32 meshIndex = 0; meshIndex < m_Model->meshes.size(); ++meshIndex)
+            for (int32 visibleIndex = 0; visibleIndex < m_VisibleList.count; ++visibleIndex)
             {
-                m_Model->meshes[meshIndex]->BindDrawCmd(m_CommandBuffers[i]);
+                m_Model->meshes[m_VisibleList[visibleIndex]]->BindDrawCmd(m_CommandBuffers[i]);
             }
 
             // 3
@@ -264,9 +287,9 @@ private:
             vkCmdSetScissor(m_CommandBuffers[i], 0, 1, &scissor);
             vkCmdBindPipeline(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline3->pipeline);
             vkCmdBindDescriptorSets(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline3->pipelineLayout, 0, m_DescriptorSet2->descriptorSets.size(), m_DescriptorSet3->descriptorSets.data(), 0, nullptr);
-            for (int32 meshIndex = 0; meshIndex < m_Model->meshes.size(); ++meshIndex)
+            for (int32 visibleIndex = 0; visibleIndex < m_VisibleList.count; ++visibleIndex)
             {
-                m_Model->meshes[meshIndex]->BindDrawCmd(m_CommandBuffers[i]);
+                m_Model->meshes[m_VisibleList[visibleIndex]]->BindDrawCmd(m_CommandBuffers[i]);
             }
 
             m_GUI->BindDrawCmd(m_CommandBuffers[i], m_RenderPass);
@@ -274,6 +297,8 @@ private:
             vkCmdEndRenderPass(m_CommandBuffers[i]);
             VERIFYVULKANRESULT(vkEndCommandBuffer(m_CommandBuffers[i]));
         }
+
+        m_CommandBufferDirty[i] = false;
     }
 
     void CreateDescriptorSet()
@@ -281,23 +306,27 @@ private:
          m_DescriptorSet0 = m_ShaderTexture->AllocateDescriptorSet();
          m_DescriptorSet0->WriteBuffer("uboMVP", m_MVPBuffer); 
          m_DescriptorSet0->WriteImage("diffuseMap", m_TexOrigin);
+         m_DescriptorSet0->Flush();
 
         m_DescriptorSet1 = m_ShaderLut->AllocateDescriptorSet();
         m_DescriptorSet1->WriteBuffer("uboMVP", m_MVPBuffer);
         m_DescriptorSet1->WriteImage("diffuseMap", m_TexOrigin);
         m_DescriptorSet1->WriteImage("lutMap", m_Tex3DLut);
+        m_DescriptorSet1->Flush();
 
         m_DescriptorSet2 = m_ShaderLutDebug0->AllocateDescriptorSet();
         m_DescriptorSet2->WriteBuffer("uboMVP", m_MVPBuffer);
         m_DescriptorSet2->WriteImage("diffuseMap", m_TexOrigin);
         m_DescriptorSet2->WriteImage("lutMap", m_Tex3DLut);
         m_DescriptorSet2->WriteBuffer("uboLutDebug", m_LutDebugBuffer);
+        m_DescriptorSet2->Flush();
 
         m_DescriptorSet3 = m_ShaderLutDebug1->AllocateDescriptorSet();
         m_DescriptorSet3->WriteBuffer("uboMVP", m_MVPBuffer);
         m_DescriptorSet3->WriteImage("diffuseMap", m_TexOrigin);
         m_DescriptorSet3->WriteImage("lutMap", m_Tex3DLut);
         m_DescriptorSet3->WriteBuffer("uboLutDebug", m_LutDebugBuffer);
+        m_DescriptorSet3->Flush();
 
     }
 
@@ -397,6 +426,25 @@ private:
         m_LutDebugBuffer->CopyFrom(&m_LutDebugData, sizeof(LutDebugBlock));
     }
 
+    // 可见的mesh变化时所有command buffer都要重新录制
+    void UpdateVisibility()
+    {
+        if (m_Culling)
+        {
+            m_Frustum.Set(m_ViewCamera.GetViewProjection());
+            vk_demo::DVKFrustumCuller::Cull(m_Frustum, m_CullingBounds, m_VisibleList);
+        }
+        else
+        {
+            m_VisibleList.SetAllVisible(m_CullingBounds.count);
+        }
+
+        if (m_VisibleList.changed)
+        {
+            MarkCommandBuffersDirty();
+        }
+    }
+
     void CreateUniformBuffers()
     {
         vk_demo::DVKBoundingBox bounds = m_Model->rootNode->GetBounds();
@@ -410,6 +458,14 @@ private:
         m_ViewCamera.Perspective(PI / 4, GetWidth(), GetHeight(), 0.1f, 1500.0f);
         m_ViewCamera.SetPosition(boundCenter);
 
+        // 模型矩阵不变，世界空间包围盒只需计算一次
+        m_CullingBounds.Resize(m_Model->meshes.size());
+        for (int32 i = 0; i < m_Model->meshes.size(); ++i)
+        {
+            m_CullingBounds.SetBox(i, m_Model->meshes[i]->bounding, m_MVPData.model);
+        }
+        m_VisibleList.SetAllVisible(m_CullingBounds.count);
+
         m_MVPBuffer = vk_demo::DVKBuffer::CreateBuffer(
             m_VulkanDevice,
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
@@ -477,15 +533,20 @@ private:
         );
 
         vk_demo::DVKCommandBuffer* cmdBuffer = vk_demo::DVKCommandBuffer::Create(m_VulkanDevice,m_CommandPool);
-        m_Model = vk_demo::DVKModel::LoadFromFile(
+        m_Model = vk_demo::DVKModel::LoadFromFileAsync(
             "assets/models/plane_z.obj",
             m_VulkanDevice,
-            cmdBuffer,
+            m_Uploader,
             {
                 VertexAttribute::VA_Position,
                 VertexAttribute::VA_UV0
             }
         );
+
+        // -defrag时允许搬迁，command buffer里记录的是旧的buffer handle
+        m_Model->SetMovable(true, [this]() {
+            MarkCommandBuffersDirty();
+        });
         // 64mb
         // map image0 -> image1
         int32 lutSize  = 256;
@@ -515,6 +576,7 @@ private:
         m_TexOrigin = vk_demo::DVKTexture::Create2D("assets/textures/game0.jpg", m_VulkanDevice, cmdBuffer);
         m_Tex3DLut  = vk_demo::DVKTexture::Create3D(VK_FORMAT_R8G8B8A8_UNORM, lutRGBA, lutSize * lutSize * 4 * lutSize, lutSize, lutSize, lutSize, m_VulkanDevice, cmdBuffer);
         delete cmdBuffer;
+        m_Uploader->WaitIdle();
     }
 
     void DestroyAssets()
@@ -538,6 +600,12 @@ private:
     MVPBlock                        m_MVPData;
     vk_demo::DVKBuffer*             m_MVPBuffer;
 
+    bool                            m_Culling = true;
+    vk_demo::DVKFrustum             m_Frustum;
+    vk_demo::DVKCullingBounds       m_CullingBounds;
+    vk_demo::DVKVisibleList         m_VisibleList;
+    std::vector<bool>               m_CommandBufferDirty;
+
     LutDebugBlock                   m_LutDebugData;
     vk_demo::DVKBuffer*             m_LutDebugBuffer = nullptr;
 
@@ -109,10 +109,8 @@ private:
 
     void Draw(float time, float delta)
     {
-
         int32 bufferIndex = DemoBase::AcquireBackbufferIndex();
 
-  
         bool hovered = UpdateUI(time, delta);
         if (!hovered)
         {
@@ -120,7 +118,13 @@ private:
         }
 
         UpdateUniformBuffers(time, delta);
-      
+
+        // 其余command buffer可能还在GPU上执行，只重新录制刚获取到的这个
+        if (m_CommandBufferDirty[bufferIndex])
+        {
+            RecordCommandBuffer(bufferIndex);
+        }
+
         DemoBase::Present(bufferIndex);
     }
 
@@ -150,14 +154,28 @@ private:
 
         m_GUI->EndFrame();
 
-        if (m_GUI->Update())
+        if (m_GUI->Update(GetFrameIndex()))
         {
-            SetupCommandBuffers();
+            MarkCommandBuffersDirty();
         }
 
         return hovered;
     }
+    void MarkCommandBuffersDirty()
+    {
+        m_CommandBufferDirty.assign(m_CommandBuffers.size(), true);
+    }
+
     void SetupCommandBuffers()
+    {
+        m_CommandBufferDirty.resize(m_CommandBuffers.size());
+        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
+        {
+            RecordCommandBuffer(i);
+        }
+    }
+
+    void RecordCommandBuffer(int32 i)
     {
           VkCommandBufferBeginInfo cmdBeginInfo;
         ZeroVulkanStruct(cmdBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
@@ -201,7 +219,6 @@ private:
         uint32 alignment  = m_VulkanDevice->GetLimits().minUniformBufferOffsetAlignment;
         uint32 modelAlign = Align(sizeof(ModelBlock), alignment);
 
-        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
         {
             renderPassBeginInfo.framebuffer = m_FrameBuffers[i];
 
@@ -239,6 +256,8 @@ private:
             vkCmdEndRenderPass(m_CommandBuffers[i]);
             VERIFYVULKANRESULT(vkEndCommandBuffer(m_CommandBuffers[i]));
         }
+
+        m_CommandBufferDirty[i] = false;
     }
 
     void CreateDescriptorSet()
@@ -250,6 +269,7 @@ private:
         m_DescriptorSet0 = m_Shader0->AllocateDescriptorSet();
         m_DescriptorSet0->WriteBuffer("uboViewProj", m_ViewProjBuffer);
         m_DescriptorSet0->WriteBuffer("uboModel",    &m_ModelBufferInfo);
+        m_DescriptorSet0->Flush();
 
         m_DescriptorSets.resize(m_AttachsColor.size());
         for (int32 i = 0; i < m_DescriptorSets.size(); ++i)
@@ -259,6 +279,7 @@ private:
             m_DescriptorSets[i]->WriteImage("inputNormal", m_AttachsNormal[i]);
             m_DescriptorSets[i]->WriteImage("inputDepth", m_AttachsDepth[i]);
             m_DescriptorSets[i]->WriteBuffer("param", m_DebugBuffer);
+            m_DescriptorSets[i]->Flush();
         }
 
     }
@@ -666,13 +687,10 @@ private:
             "assets/shaders/17_InputAttachments/quad.frag.spv"
         );
 
-        vk_demo::DVKCommandBuffer* cmdBuffer = vk_demo::DVKCommandBuffer::Create(m_VulkanDevice,m_CommandPool);
-
-
-        m_Model = vk_demo::DVKModel::LoadFromFile(
+        m_Model = vk_demo::DVKModel::LoadFromFileAsync(
             "assets/models/Room/miniHouse_FBX.FBX",
             m_VulkanDevice,
-            cmdBuffer,
+            m_Uploader,
 m_Shader0->perVertexAttributes
         );
         // quad model
@@ -688,13 +706,14 @@ m_Shader0->perVertexAttributes
 
         m_Quad = vk_demo::DVKModel::Create(
             m_VulkanDevice,
-            cmdBuffer,
+            m_Uploader,
             vertices,
             indices,
             m_Shader1->perVertexAttributes
         );
 
-        delete cmdBuffer;
+        // 两个模型的拷贝一起提交
+        m_Uploader->WaitIdle();
     }
 
     void DestroyAssets()
@@ -741,6 +760,7 @@ private:
     DVKTextureArray                 m_AttachsNormal;
 
     ImageGUIContext*                m_GUI = nullptr;
+    std::vector<bool>               m_CommandBufferDirty;
 };
 
 std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
@@ -10,6 +10,7 @@
 #include "Demo/DVKCommand.h"
 #include "Demo/DVKUtils.h"
 #include "Demo/DVKCamera.h"
+#include "Demo/DVKGPUProfiler.h"
 #include "Demo/DVKModel.h"
 #include "Demo/DVKPipeline.h"
 #include "Math/Math.h"
@@ -17,6 +18,7 @@
 #include "Math/Vector4.h"
 #include "Math/Matrix4x4.h"
 #include "Utils/Alignment.h"
+#include "Utils/CPUProfiler.h"
 #include <vector>
 #include "Demo/ImageGUIContext.h"
 #include "Vulkan/RHIDefinitions.h"
@@ -33,7 +35,8 @@ public:
     DeferredShadingDemo(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
         : DemoBase(width, height, title, cmdLine)
     {
-
+        // uniform按帧分片，每帧只重新录制获取到的command buffer
+        m_FrameSliced = true;
     }
 
     virtual ~DeferredShadingDemo()
@@ -141,6 +144,9 @@ private:
         }
 
         UpdateUniformBuffers(time, delta);
+
+        // 每帧重新录制，GPU计时与界面顶点都按帧更新
+        RecordCommandBuffer(bufferIndex);
       
         DemoBase::Present(bufferIndex);
     }
@@ -183,20 +189,29 @@ private:
             ImGui::End();
         }
 
+        m_GPUProfiler->DrawOverlay();
+
         bool hovered = ImGui::IsAnyWindowHovered() || ImGui::IsAnyItemHovered() || ImGui::IsRootWindowOrAnyChildHovered();
 
         m_GUI->EndFrame();
 
-        if (m_GUI->Update())
-        {
-            SetupCommandBuffers();
-        }
+        m_GUI->Update(GetFrameIndex());
 
         return hovered;
     }
     void SetupCommandBuffers()
     {
-          VkCommandBufferBeginInfo cmdBeginInfo;
+        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
+        {
+            RecordCommandBuffer(i);
+        }
+    }
+
+    void RecordCommandBuffer(int32 i)
+    {
+        CPU_PROFILE_SCOPE("RecordCommandBuffer");
+
+        VkCommandBufferBeginInfo cmdBeginInfo;
         ZeroVulkanStruct(cmdBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
 
        VkClearValue clearValues[5];
@@ -241,11 +256,19 @@ private:
         uint32 alignment  = m_VulkanDevice->GetLimits().minUniformBufferOffsetAlignment;
         uint32 modelAlign = Align(sizeof(ModelBlock), alignment);
 
-        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
+        // 绑定当前帧的uniform分片
+        int32 frameIndex = GetFrameIndex();
+        vk_demo::DVKDescriptorSet* descriptorSet0 = m_DescriptorSets0[frameIndex];
+        vk_demo::DVKDescriptorSet* descriptorSet1 = m_DescriptorSets[frameIndex * m_AttachsColor.size() + i];
+
+        renderPassBeginInfo.framebuffer = m_FrameBuffers[i];
+
+        VERIFYVULKANRESULT(vkBeginCommandBuffer(m_CommandBuffers[i], &cmdBeginInfo));
+        m_GPUProfiler->BeginRecord(m_CommandBuffers[i], i);
+
         {
-            renderPassBeginInfo.framebuffer = m_FrameBuffers[i];
+            vk_demo::DVKGPUScope frameScope(m_GPUProfiler, m_CommandBuffers[i], "Frame");
 
-            VERIFYVULKANRESULT(vkBeginCommandBuffer(m_CommandBuffers[i], &cmdBeginInfo));
             vkCmdBeginRenderPass(m_CommandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
             vkCmdSetViewport(m_CommandBuffers[i], 0, 1, &viewport);
@@ -253,11 +276,13 @@ private:
 
             // pass0
             {
+                vk_demo::DVKGPUScope scope(m_GPUProfiler, m_CommandBuffers[i], "GBuffer", true);
+
                 vkCmdBindPipeline(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline0->pipeline);
                 for (int32 meshIndex = 0; meshIndex < m_Model->meshes.size(); ++meshIndex)
                 {
                     uint32 offset = meshIndex * modelAlign;
-                    vkCmdBindDescriptorSets(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline0->pipelineLayout, 0, m_DescriptorSet0->descriptorSets.size(), m_DescriptorSet0->descriptorSets.data(), 1, &offset);
+                    vkCmdBindDescriptorSets(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline0->pipelineLayout, 0, descriptorSet0->descriptorSets.size(), descriptorSet0->descriptorSets.data(), 1, &offset);
                     m_Model->meshes[meshIndex]->BindDrawCmd(m_CommandBuffers[i]);
                 }
             }
@@ -266,19 +291,25 @@ private:
 
             // pass1
             {
+                vk_demo::DVKGPUScope scope(m_GPUProfiler, m_CommandBuffers[i], "Lighting", true);
+
                 vkCmdBindPipeline(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline1->pipeline);
-                vkCmdBindDescriptorSets(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline1->pipelineLayout, 0, m_DescriptorSets[i]->descriptorSets.size(), m_DescriptorSets[i]->descriptorSets.data(), 0, nullptr);
+                vkCmdBindDescriptorSets(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline1->pipelineLayout, 0, descriptorSet1->descriptorSets.size(), descriptorSet1->descriptorSets.data(), 0, nullptr);
                 for (int32 meshIndex = 0; meshIndex < m_Quad->meshes.size(); ++meshIndex)
                 {
                     m_Quad->meshes[meshIndex]->BindDrawCmd(m_CommandBuffers[i]);
                 }
             }
 
-            m_GUI->BindDrawCmd(m_CommandBuffers[i], m_RenderPass, 1);
+            {
+                vk_demo::DVKGPUScope scope(m_GPUProfiler, m_CommandBuffers[i], "GUI");
+                m_GUI->BindDrawCmd(m_CommandBuffers[i], m_RenderPass, 1);
+            }
 
             vkCmdEndRenderPass(m_CommandBuffers[i]);
-            VERIFYVULKANRESULT(vkEndCommandBuffer(m_CommandBuffers[i]));
         }
+
+        VERIFYVULKANRESULT(vkEndCommandBuffer(m_CommandBuffers[i]));
     }
 
     void CreateDescriptorSet()
@@ -287,19 +318,40 @@ private:
         m_ModelBufferInfo.offset = 0;
         m_ModelBufferInfo.range  = sizeof(ModelBlock);
 
-        m_DescriptorSet0 = m_Shader0->AllocateDescriptorSet();
-        m_DescriptorSet0->WriteBuffer("uboViewProj", m_ViewProjBuffer);
-        m_DescriptorSet0->WriteBuffer("uboModel",    &m_ModelBufferInfo);
+        // 每个在途帧一份，分别指向uniform buffer中该帧的分片
+        int32 numFrames = GetNumFramesInFlight();
+        int32 numImages = m_AttachsColor.size();
 
-        m_DescriptorSets.resize(m_AttachsColor.size());
-        for (int32 i = 0; i < m_DescriptorSets.size(); ++i)
+        m_DescriptorSets0.resize(numFrames);
+        m_DescriptorSets.resize(numFrames * numImages);
+        for (int32 frame = 0; frame < numFrames; ++frame)
         {
-            m_DescriptorSets[i] = m_Shader1->AllocateDescriptorSet();
-            m_DescriptorSets[i]->WriteImage("inputColor", m_AttachsColor[i]);
-            m_DescriptorSets[i]->WriteImage("inputNormal", m_AttachsNormal[i]);
-            m_DescriptorSets[i]->WriteImage("inputDepth", m_AttachsDepth[i]);
-            m_DescriptorSets[i]->WriteImage("inputPosition", m_AttachsPosition[i]);
-            m_DescriptorSets[i]->WriteBuffer("lightDatas", m_LightBuffer);
+            VkDescriptorBufferInfo viewProjInfo;
+            viewProjInfo.buffer = m_ViewProjBuffer->buffer;
+            viewProjInfo.offset = frame * m_ViewProjAlign;
+            viewProjInfo.range  = sizeof(ViewProjectionBlock);
+
+            VkDescriptorBufferInfo lightInfo;
+            lightInfo.buffer = m_LightBuffer->buffer;
+            lightInfo.offset = frame * m_LightAlign;
+            lightInfo.range  = sizeof(LightDataBlock);
+
+            m_DescriptorSets0[frame] = m_Shader0->AllocateDescriptorSet();
+            m_DescriptorSets0[frame]->WriteBuffer("uboViewProj", &viewProjInfo);
+            m_DescriptorSets0[frame]->WriteBuffer("uboModel",    &m_ModelBufferInfo);
+            m_DescriptorSets0[frame]->Flush();
+
+            for (int32 i = 0; i < numImages; ++i)
+            {
+                vk_demo::DVKDescriptorSet* descriptorSet = m_Shader1->AllocateDescriptorSet();
+                descriptorSet->WriteImage("inputColor", m_AttachsColor[i]);
+                descriptorSet->WriteImage("inputNormal", m_AttachsNormal[i]);
+                descriptorSet->WriteImage("inputDepth", m_AttachsDepth[i]);
+                descriptorSet->WriteImage("inputPosition", m_AttachsPosition[i]);
+                descriptorSet->WriteBuffer("lightDatas", &lightInfo);
+                descriptorSet->Flush();
+                m_DescriptorSets[frame * numImages + i] = descriptorSet;
+            }
         }
 
     }
@@ -349,7 +401,11 @@ private:
         delete m_Pipeline0;
         delete m_Pipeline1;
 
-        delete m_DescriptorSet0;
+        for (int32 i = 0; i < m_DescriptorSets0.size(); ++i)
+        {
+            delete m_DescriptorSets0[i];
+        }
+        m_DescriptorSets0.clear();
         for (int32 i = 0; i < m_DescriptorSets.size(); ++i)
         {
             vk_demo::DVKDescriptorSet* descriptorSet = m_DescriptorSets[i];
@@ -367,7 +423,7 @@ private:
         
         m_ViewProjData.view = m_ViewCamera.GetView();
         m_ViewProjData.projection = m_ViewCamera.GetProjection();
-        m_ViewProjBuffer->CopyFrom(&m_ViewProjData, sizeof(ViewProjectionBlock));
+        memcpy((uint8*)m_ViewProjBuffer->mapped + GetFrameSliceOffset(m_ViewProjAlign), &m_ViewProjData, sizeof(ViewProjectionBlock));
 
         for(int32 i=0;i<NUM_LIGHTS;++i)
         {
@@ -376,7 +432,7 @@ private:
             m_LightDatas.lights[i].position.y = m_LightInfos.position[i].y + bias*m_LightInfos.direction[i].y*500.0f;
             m_LightDatas.lights[i].position.z = m_LightInfos.position[i].z + bias*m_LightInfos.direction[i].z*500.0f;
         }
-        m_LightBuffer->CopyFrom(&m_LightDatas, sizeof(LightDataBlock));
+        memcpy((uint8*)m_LightBuffer->mapped + GetFrameSliceOffset(m_LightAlign), &m_LightDatas, sizeof(LightDataBlock));
     }
     
     void CreateAttachments()
@@ -696,20 +752,24 @@ private:
             m_LightInfos.speed[i] = 1.0f + MMath::RandRange(0.0f, 5.0f);
         
         }
+
+        // 每个在途帧一个分片，UpdateUniformBuffers只写当前帧的分片
+        uint32 numFrames = GetNumFramesInFlight();
+        m_LightAlign     = Align(sizeof(LightDataBlock), alignment);
+        m_ViewProjAlign  = Align(sizeof(ViewProjectionBlock), alignment);
+
         m_LightBuffer = vk_demo::DVKBuffer::CreateBuffer(
             m_VulkanDevice,
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            sizeof(LightDataBlock),
-            &(m_LightDatas)
+            m_LightAlign * numFrames
         );
         m_LightBuffer->Map();
         m_ViewProjBuffer = vk_demo::DVKBuffer::CreateBuffer(
             m_VulkanDevice,
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            sizeof(ViewProjectionBlock),
-            &(m_ViewProjData)
+            m_ViewProjAlign * numFrames
         );
         m_ViewProjBuffer->Map();
 
@@ -763,14 +823,13 @@ private:
             "assets/shaders/18_DeferredShading/quad.frag.spv"
         );
 
-        vk_demo::DVKCommandBuffer* cmdBuffer = vk_demo::DVKCommandBuffer::Create(m_VulkanDevice,m_CommandPool);
 
 
          // scene model
-        m_Model = vk_demo::DVKModel::LoadFromFile(
+        m_Model = vk_demo::DVKModel::LoadFromFileAsync(
             "assets/models/Room/miniHouse_FBX.FBX",
             m_VulkanDevice,
-            cmdBuffer,
+            m_Uploader,
             m_Shader0->perVertexAttributes
         );
 
@@ -787,13 +846,18 @@ private:
 
         m_Quad = vk_demo::DVKModel::Create(
             m_VulkanDevice,
-            cmdBuffer,
+            m_Uploader,
             vertices,
             indices,
             m_Shader1->perVertexAttributes
         );
 
-        delete cmdBuffer;
+        // 两个模型的拷贝一起提交
+        m_Uploader->WaitIdle();
+
+        // -defrag时允许搬迁，每帧都会重新录制获取到的command buffer，不需要回调
+        m_Model->SetMovable(true);
+        m_Quad->SetMovable(true);
     }
 
     void DestroyAssets()
@@ -822,11 +886,13 @@ private:
 
     vk_demo::DVKBuffer*             m_ViewProjBuffer = nullptr;
     ViewProjectionBlock             m_ViewProjData;
+    uint32                          m_ViewProjAlign = 0;
 
 
     vk_demo::DVKBuffer*             m_LightBuffer = nullptr;
     LightDataBlock                  m_LightDatas;
     LightSpawnBlock                 m_LightInfos;
+    uint32                          m_LightAlign = 0;
 
 
     vk_demo::DVKModel*              m_Model = nullptr;
@@ -834,7 +900,7 @@ private:
 
     vk_demo::DVKGfxPipeline*        m_Pipeline0 = nullptr;
     vk_demo::DVKShader*             m_Shader0 = nullptr;
-    vk_demo::DVKDescriptorSet*      m_DescriptorSet0 = nullptr;
+    DVKDescriptorSetArray           m_DescriptorSets0;
 
     vk_demo::DVKGfxPipeline*        m_Pipeline1 = nullptr;
     vk_demo::DVKShader*             m_Shader1 = nullptr;
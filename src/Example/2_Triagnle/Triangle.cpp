@@ -15,7 +15,6 @@
 #include "vulkan/vulkan_core.h"
 
 #include <cstring>
-#include <minwinbase.h>
 #include <stdint.h>
 #include <vector>
 
@@ -104,9 +104,10 @@ private:
 
     void Draw(float time, float delta)
     {
+        // 等待该帧槽位的fence之后才能改写uniform buffer
+        int32 bufferIndex = DemoBase::AcquireBackbufferIndex();
         m_ViewCamera.Update(time, delta);
         UpdateUniformBuffers(time, delta);
-        int32 bufferIndex = DemoBase::AcquireBackbufferIndex();
         DemoBase::Present(bufferIndex);
     }
 
@@ -9,6 +9,8 @@
 #include "Demo/DVKUtils.h"
 #include "Demo/DVKCamera.h"
 #include "Demo/DVKModel.h"
+#include "Demo/DVKLODSelector.h"
+#include "Demo/DVKMeshSimplifier.h"
 
 #include "Math/Vector3.h"
 #include "Math/Vector4.h"
@@ -27,7 +29,19 @@ public:
     TriangleModule(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
         : DemoBase(width, height, title, cmdLine)
     {
-
+        // -quantize 顶点使用压缩格式加载
+        // -lod=N    导入时生成N级LOD，按屏幕空间误差选择
+        for (int32 i = 0; i < cmdLine.size(); ++i)
+        {
+            if (cmdLine[i] == "-quantize")
+            {
+                m_Quantize = true;
+            }
+            else if (cmdLine[i].find("-lod=") == 0)
+            {
+                vk_demo::DVKMeshSimplifier::lodCount = MMath::Clamp(atoi(cmdLine[i].c_str() + 5), 0, (int32)vk_demo::DVKMeshSimplifier::MaxLODs);
+            }
+        }
     }
 
     virtual ~TriangleModule()
@@ -95,11 +109,13 @@ private:
         Matrix4x4 model;
         Matrix4x4 view;
         Matrix4x4 projection;
+        Vector4   dequantizeOffset;
+        Vector4   dequantizeScale;
     };
 
     void Draw(float time, float delta)
     {
-
+        int32 bufferIndex = DemoBase::AcquireBackbufferIndex();
 
         bool hovered = UpdateUI(time, delta);
         if (!hovered)
@@ -108,7 +124,14 @@ private:
         }
 
         UpdateUniformBuffers(time, delta);
-        int32 bufferIndex = DemoBase::AcquireBackbufferIndex();
+        UpdateLODs();
+
+        // 其余command buffer可能还在GPU上执行，只重新录制刚获取到的这个
+        if (m_CommandBufferDirty[bufferIndex])
+        {
+            RecordCommandBuffer(bufferIndex);
+        }
+
         DemoBase::Present(bufferIndex);
     }
 
@@ -123,10 +146,18 @@ private:
 
             ImGui::Checkbox("AutoRotate", &m_AutoRotate);
 
+            if (m_LODCount > 1)
+            {
+                ImGui::Checkbox("LOD", &vk_demo::DVKLODSelector::enabled);
+                ImGui::SliderFloat("PixelError", &vk_demo::DVKLODSelector::pixelError, 0.1f, 16.0f);
+                ImGui::SliderInt("ForceLOD", &vk_demo::DVKLODSelector::forceLOD, -1, m_LODCount - 1);
+                ImGui::Text("Tri:%d -> %d (-%.1f%%)", (int32)vk_demo::DVKLODSelector::frameBaseTriangles, (int32)vk_demo::DVKLODSelector::frameTriangles, vk_demo::DVKLODSelector::GetReduction() * 100.0f);
+            }
+
             for (int32 i = 0; i < m_Model->meshes.size(); ++i)
             {
                 vk_demo::DVKMesh* mesh = m_Model->meshes[i];
-                ImGui::Text("%-20s Tri:%d", mesh->linkNode->name.c_str(), mesh->triangleCount);
+                ImGui::Text("%-20s LOD:%d Tri:%d", mesh->linkNode->name.c_str(), mesh->lodIndex, mesh->GetTriangleCount(mesh->lodIndex));
             }
 
             ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
@@ -137,14 +168,28 @@ private:
 
         m_GUI->EndFrame();
 
-        if (m_GUI->Update())
+        if (m_GUI->Update(GetFrameIndex()))
         {
-            SetupCommandBuffers();
+            MarkCommandBuffersDirty();
         }
 
         return hovered;
     }
+    void MarkCommandBuffersDirty()
+    {
+        m_CommandBufferDirty.assign(m_CommandBuffers.size(), true);
+    }
+
     void SetupCommandBuffers()
+    {
+        m_CommandBufferDirty.resize(m_CommandBuffers.size());
+        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
+        {
+            RecordCommandBuffer(i);
+        }
+    }
+
+    void RecordCommandBuffer(int32 i)
     {
         VkCommandBufferBeginInfo cmdBeginInfo;
         ZeroVulkanStruct(cmdBeginInfo, VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO);
@@ -165,7 +210,6 @@ private:
         renderPassBeginInfo.renderArea.extent.width  = m_FrameWidth;
         renderPassBeginInfo.renderArea.extent.height = m_FrameHeight;
 
-        for (int32 i = 0; i < m_CommandBuffers.size(); ++i)
         {
             renderPassBeginInfo.framebuffer = m_FrameBuffers[i];
 
@@ -207,6 +251,8 @@ private:
 
             VERIFYVULKANRESULT(vkEndCommandBuffer(m_CommandBuffers[i]));
         }
+
+        m_CommandBufferDirty[i] = false;
     }
 
     void CreateDescriptorSet()
@@ -335,7 +381,7 @@ private:
         ZeroVulkanStruct(shaderStages[0], VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO);
         ZeroVulkanStruct(shaderStages[1], VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO);
         shaderStages[0].stage  = VK_SHADER_STAGE_VERTEX_BIT;
-        shaderStages[0].module = vk_demo::LoadSPIPVShader(m_Device, "assets/shaders/9_LoadMesh/mesh.vert.spv");
+        shaderStages[0].module = vk_demo::LoadSPIPVShader(m_Device, m_Quantize ? "assets/shaders/9_LoadMesh/mesh_quantized.vert.spv" : "assets/shaders/9_LoadMesh/mesh.vert.spv");
         shaderStages[0].pName  = "main";
         shaderStages[1].stage  = VK_SHADER_STAGE_FRAGMENT_BIT;
         shaderStages[1].module = vk_demo::LoadSPIPVShader(m_Device, "assets/shaders/9_LoadMesh/mesh.frag.spv");
@@ -409,6 +455,23 @@ private:
         }
     }
 
+    // LOD变化后所有command buffer都要重新录制，由Draw在获取到image后逐个录制
+    void UpdateLODs()
+    {
+        vk_demo::DVKLODSelector::BeginFrame();
+
+        bool changed = false;
+        for (int32 i = 0; i < m_Model->meshes.size(); ++i)
+        {
+            changed = vk_demo::DVKLODSelector::Select(m_Model->meshes[i], m_MVPDatas[i].model, m_ViewCamera, (float)m_FrameHeight) || changed;
+        }
+
+        if (changed)
+        {
+            MarkCommandBuffersDirty();
+        }
+    }
+
     void CreateUniformBuffers()
     {
         vk_demo::DVKBoundingBox bounds = m_Model->rootNode->GetBounds();
@@ -422,6 +485,10 @@ private:
         {
             m_MVPDatas[i].model.AppendRotation(180,Vector3::UpVector);
 
+            vk_demo::DVKMesh* mesh = m_Model->meshes[i];
+            m_MVPDatas[i].dequantizeOffset = Vector4(mesh->dequantizeOffset, 0.0f);
+            m_MVPDatas[i].dequantizeScale  = Vector4(mesh->dequantizeScale, 1.0f);
+
             m_MVPBuffers[i] = vk_demo::DVKBuffer::CreateBuffer(m_VulkanDevice,VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,sizeof(UBOData),&(m_MVPDatas[i]));
             m_MVPBuffers[i]->Map();
@@ -459,13 +526,18 @@ private:
 
     void LoadAssets()
     {
-        vk_demo::DVKCommandBuffer* cmdBuffer = vk_demo::DVKCommandBuffer::Create(m_VulkanDevice,m_CommandPool);
-        m_Model = vk_demo::DVKModel::LoadFromFile(   
+        m_Model = vk_demo::DVKModel::LoadFromFileAsync(
             "assets/models/suzanne.obj",
             m_VulkanDevice,
-            cmdBuffer,
-            { VertexAttribute::VA_Position, VertexAttribute::VA_Normal });
-        delete cmdBuffer;
+            m_Uploader,
+            { VertexAttribute::VA_Position, VertexAttribute::VA_Normal },
+            m_Quantize ? vk_demo::DVKVertexQuantization::Compact() : vk_demo::DVKVertexQuantization());
+        m_Uploader->WaitIdle();
+
+        for (int32 i = 0; i < m_Model->meshes.size(); ++i)
+        {
+            m_LODCount = MMath::Max(m_LODCount, m_Model->meshes[i]->GetLODCount());
+        }
     }
 
     void DestroyAssets()
@@ -480,6 +552,8 @@ private:
 
     bool                            m_AutoRotate = false;
     bool                            m_Ready = false;
+    bool                            m_Quantize = false;
+    int32                           m_LODCount = 1;
 
     std::vector<UBOData>            m_MVPDatas;
     DVKBuffers                      m_MVPBuffers;
@@ -494,6 +568,7 @@ private:
     VkDescriptorSets                m_DescriptorSets;
 
     ImageGUIContext*                m_GUI = nullptr;
+    std::vector<bool>               m_CommandBufferDirty;
 };
 
 std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
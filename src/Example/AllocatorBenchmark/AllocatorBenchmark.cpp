@@ -0,0 +1,399 @@
+#include "Common/Common.h"
+#include "Common/Log.h"
+
+#include "Application/AppModuleBase.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "Math/Math.h"
+#include "Utils/Alignment.h"
+#include "Utils/TLSFAllocator.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+// 显存子分配器的CPU压力测试，不需要GPU。
+// AllocatorBenchmark [-seed=N] [-operations=N] [-live=N] [-pagesize=MB]
+// 用固定种子生成随机的分配/释放序列，分别在旧的first-fit空闲列表与TLSF上回放，
+// 校验分配结果不重叠、全部释放后能合并回整页，并统计耗时与碎片情况。
+class AllocatorBenchmarkModule : public AppModuleBase
+{
+public:
+    AllocatorBenchmarkModule(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
+        : AppModuleBase(width, height, title)
+    {
+        for (int32 i = 1; i < cmdLine.size(); ++i)
+        {
+            if (cmdLine[i].find("-seed=") == 0)
+            {
+                m_Seed = (uint32)atoi(cmdLine[i].c_str() + 6);
+            }
+            else if (cmdLine[i].find("-operations=") == 0)
+            {
+                m_Operations = MMath::Max(atoi(cmdLine[i].c_str() + 12), 1);
+            }
+            else if (cmdLine[i].find("-live=") == 0)
+            {
+                m_TargetLive = MMath::Max(atoi(cmdLine[i].c_str() + 6), 1);
+            }
+            else if (cmdLine[i].find("-pagesize=") == 0)
+            {
+                m_PageSize = (uint32)MMath::Clamp(atoi(cmdLine[i].c_str() + 10), 1, 2048) * 1024 * 1024;
+            }
+        }
+    }
+
+    virtual ~AllocatorBenchmarkModule()
+    {
+
+    }
+
+    virtual bool PreInit() override
+    {
+        return true;
+    }
+
+    virtual bool Init() override
+    {
+        MLOG("AllocatorBenchmark : seed %u, %d operations, ~%d live allocations, page %uMB", m_Seed, m_Operations, m_TargetLive, m_PageSize / 1024 / 1024);
+
+        GenerateTrace();
+
+        FirstFitFreeList firstFit;
+        TLSFFreeList     tlsf;
+        Replay("first-fit", firstFit);
+        Replay("tlsf", tlsf);
+
+        Engine::Get()->RequestExit(true);
+        return true;
+    }
+
+    virtual void Exist() override
+    {
+
+    }
+
+    virtual void Loop(float time, float delta) override
+    {
+
+    }
+
+private:
+
+    struct TraceOp
+    {
+        bool    allocate;
+        uint32  id;
+        uint32  size;
+        uint32  alignment;
+    };
+
+    struct Result
+    {
+        uint32  offset;
+        uint32  alignedOffset;
+        uint32  size;
+        uint32  block;
+    };
+
+    // 与修改前VulkanResourceHeapPage一致：first-fit查找，释放后排序并合并相邻区间
+    struct FirstFitFreeList
+    {
+        struct Range
+        {
+            uint32 offset;
+            uint32 size;
+
+            bool operator<(const Range& other) const
+            {
+                return offset < other.offset;
+            }
+        };
+
+        std::vector<Range> freeList;
+
+        void Init(uint32 size)
+        {
+            freeList.clear();
+            freeList.push_back({ 0, size });
+        }
+
+        bool Allocate(uint32 size, uint32 alignment, Result& outResult)
+        {
+            for (int32 index = 0; index < freeList.size(); ++index)
+            {
+                Range& entry         = freeList[index];
+                uint32 alignedOffset = Align(entry.offset, alignment);
+                uint32 allocatedSize = alignedOffset - entry.offset + size;
+                if (allocatedSize <= entry.size)
+                {
+                    outResult.offset        = entry.offset;
+                    outResult.alignedOffset = alignedOffset;
+                    outResult.size          = allocatedSize;
+                    outResult.block         = 0;
+                    if (allocatedSize < entry.size)
+                    {
+                        entry.size   -= allocatedSize;
+                        entry.offset += allocatedSize;
+                    }
+                    else
+                    {
+                        freeList.erase(freeList.begin() + index);
+                    }
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void Free(const Result& result)
+        {
+            freeList.push_back({ result.offset, result.size });
+            std::sort(freeList.begin(), freeList.end());
+            for (int32 index = (int32)freeList.size() - 1; index > 0; --index)
+            {
+                Range& current = freeList[index];
+                Range& prev    = freeList[index - 1];
+                if (prev.offset + prev.size == current.offset)
+                {
+                    prev.size += current.size;
+                    freeList.erase(freeList.begin() + index);
+                }
+            }
+        }
+
+        uint32 GetNumFreeBlocks() const
+        {
+            return (uint32)freeList.size();
+        }
+
+        bool IsCompact(uint32 size) const
+        {
+            return freeList.size() == 1 && freeList[0].offset == 0 && freeList[0].size == size;
+        }
+    };
+
+    struct TLSFFreeList
+    {
+        TLSFAllocator allocator;
+
+        void Init(uint32 size)
+        {
+            allocator.Init(size);
+        }
+
+        bool Allocate(uint32 size, uint32 alignment, Result& outResult)
+        {
+            TLSFAllocator::Allocation allocation;
+            if (!allocator.Allocate(size, alignment, allocation))
+            {
+                return false;
+            }
+            outResult.offset        = allocation.offset;
+            outResult.alignedOffset = allocation.alignedOffset;
+            outResult.size          = allocation.size;
+            outResult.block         = allocation.block;
+            return true;
+        }
+
+        void Free(const Result& result)
+        {
+            allocator.Free(result.block);
+        }
+
+        uint32 GetNumFreeBlocks() const
+        {
+            return allocator.GetNumFreeBlocks();
+        }
+
+        bool IsCompact(uint32 size) const
+        {
+            return allocator.IsEmpty() && allocator.GetNumFreeBlocks() == 1 && allocator.Validate();
+        }
+    };
+
+    // 与平台无关的随机数，保证不同平台回放同一序列
+    uint32 NextRandom()
+    {
+        m_RandomState ^= m_RandomState << 13;
+        m_RandomState ^= m_RandomState >> 17;
+        m_RandomState ^= m_RandomState << 5;
+        return m_RandomState;
+    }
+
+    // 大小分布参考实际场景：大量小的uniform/顶点数据，少量纹理与大buffer
+    void GenerateTrace()
+    {
+        static const uint32 alignments[] = { 16, 64, 256, 4096, 65536 };
+
+        m_RandomState = m_Seed * 2654435761u + 1;
+        m_Trace.clear();
+        m_Trace.reserve(m_Operations);
+
+        std::vector<uint32> live;
+        uint32 nextID = 0;
+        for (int32 i = 0; i < m_Operations; ++i)
+        {
+            // 存活数量低于目标时偏向分配，高于时偏向释放
+            uint32 allocChance = live.size() < m_TargetLive ? 70 : 30;
+            if (live.size() == 0 || NextRandom() % 100 < allocChance)
+            {
+                uint32 bucket = NextRandom() % 100;
+                uint32 size   = 0;
+                if (bucket < 73) {
+                    size = 64 + NextRandom() % (16 * 1024);
+                }
+                else if (bucket < 98) {
+                    size = 16 * 1024 + NextRandom() % (256 * 1024);
+                }
+                else {
+                    size = 256 * 1024 + NextRandom() % (4 * 1024 * 1024);
+                }
+
+                TraceOp op;
+                op.allocate  = true;
+                op.id        = nextID++;
+                op.size      = size;
+                op.alignment = alignments[NextRandom() % 5];
+                m_Trace.push_back(op);
+                live.push_back(op.id);
+            }
+            else
+            {
+                uint32 index = NextRandom() % live.size();
+
+                TraceOp op;
+                op.allocate  = false;
+                op.id        = live[index];
+                op.size      = 0;
+                op.alignment = 0;
+                m_Trace.push_back(op);
+
+                live[index] = live.back();
+                live.pop_back();
+            }
+        }
+
+        // 最后全部释放，检查能否合并回整页
+        for (int32 i = 0; i < live.size(); ++i)
+        {
+            TraceOp op;
+            op.allocate  = false;
+            op.id        = live[i];
+            op.size      = 0;
+            op.alignment = 0;
+            m_Trace.push_back(op);
+        }
+
+        m_NumAllocations = nextID;
+    }
+
+    static bool CheckOverlap(const std::vector<Result>& results, const std::vector<uint8>& valid)
+    {
+        std::vector<std::pair<uint32, uint32>> ranges;
+        for (int32 i = 0; i < results.size(); ++i)
+        {
+            if (valid[i]) {
+                ranges.push_back(std::make_pair(results[i].offset, results[i].offset + results[i].size));
+            }
+        }
+
+        std::sort(ranges.begin(), ranges.end());
+        for (int32 i = 1; i < ranges.size(); ++i)
+        {
+            if (ranges[i - 1].second > ranges[i].first) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename FreeList>
+    void Replay(const char* name, FreeList& freeList)
+    {
+        std::vector<Result> results(m_NumAllocations);
+        std::vector<uint8>  valid(m_NumAllocations, 0);
+
+        freeList.Init(m_PageSize);
+
+        int32  failed       = 0;
+        uint32 peakFree     = 0;
+        uint64 sumFree      = 0;
+        int32  samples      = 0;
+        bool   correct      = true;
+        double allocTime    = 0.0;
+        double freeTime     = 0.0;
+        int32  numAllocs    = 0;
+        int32  numFrees     = 0;
+
+        for (int32 i = 0; i < m_Trace.size(); ++i)
+        {
+            const TraceOp& op = m_Trace[i];
+            if (op.allocate)
+            {
+                double beginTime = GenericPlatformTime::Seconds();
+                bool success = freeList.Allocate(op.size, op.alignment, results[op.id]);
+                allocTime += GenericPlatformTime::Seconds() - beginTime;
+                numAllocs += 1;
+
+                if (!success) {
+                    failed += 1;
+                    continue;
+                }
+
+                const Result& result = results[op.id];
+                if (!IsAligned(result.alignedOffset, op.alignment) || result.alignedOffset + op.size != result.offset + result.size) {
+                    correct = false;
+                }
+                valid[op.id] = 1;
+            }
+            else if (valid[op.id])
+            {
+                double beginTime = GenericPlatformTime::Seconds();
+                freeList.Free(results[op.id]);
+                freeTime += GenericPlatformTime::Seconds() - beginTime;
+                numFrees += 1;
+                valid[op.id] = 0;
+            }
+
+            if (i % 1024 == 0)
+            {
+                uint32 numFree = freeList.GetNumFreeBlocks();
+                peakFree = MMath::Max(peakFree, numFree);
+                sumFree += numFree;
+                samples += 1;
+            }
+
+            if (i % 8192 == 0 && !CheckOverlap(results, valid)) {
+                correct = false;
+            }
+        }
+
+        correct = correct && freeList.IsCompact(m_PageSize);
+
+        MLOG("  %-10s: alloc %.1fns, free %.1fns, %d failed, free blocks avg %.1f peak %u, %s",
+            name,
+            numAllocs > 0 ? allocTime * 1000000000.0 / numAllocs : 0.0,
+            numFrees > 0 ? freeTime * 1000000000.0 / numFrees : 0.0,
+            failed,
+            samples > 0 ? (double)sumFree / samples : 0.0,
+            peakFree,
+            correct ? "validate passed" : "VALIDATE FAILED"
+        );
+    }
+
+private:
+    std::vector<TraceOp>    m_Trace;
+    uint32                  m_NumAllocations = 0;
+    uint32                  m_RandomState = 1;
+
+    uint32                  m_Seed = 1024;
+    int32                   m_Operations = 200000;
+    uint32                  m_TargetLive = 2000;
+    uint32                  m_PageSize = 256 * 1024 * 1024;
+};
+
+std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
+{
+    return std::make_shared<AllocatorBenchmarkModule>(800, 600, "AllocatorBenchmark", cmdLine);
+}
@@ -0,0 +1,228 @@
+#include "Common/Common.h"
+#include "Common/Log.h"
+
+#include "Application/AppModuleBase.h"
+#include "Demo/DVKModel.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "Math/Math.h"
+#include "Math/Vector3.h"
+#include "Math/Quat.h"
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+
+// 动画通道采样的微基准：N个角色 x M根骨骼，每根骨骼一条位移和一条旋转通道。
+// AnimBenchmark [-characters=N] [-bones=M] [-keys=K] [-frames=F]
+// 对比旧的线性查找、随机跳转(二分查找)、顺序播放(cursor缓存)以及重采样后的等间隔索引。
+class AnimBenchmarkModule : public AppModuleBase
+{
+public:
+    struct BoneTrack
+    {
+        vk_demo::DVKAnimChannel<Vector3>  position;
+        vk_demo::DVKAnimChannel<Quat>     rotation;
+    };
+
+    AnimBenchmarkModule(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
+        : AppModuleBase(width, height, title)
+    {
+        for (int32 i = 1; i < cmdLine.size(); ++i)
+        {
+            if (cmdLine[i].find("-characters=") == 0)
+            {
+                m_NumCharacters = MMath::Max(atoi(cmdLine[i].c_str() + 12), 1);
+            }
+            else if (cmdLine[i].find("-bones=") == 0)
+            {
+                m_NumBones = MMath::Max(atoi(cmdLine[i].c_str() + 7), 1);
+            }
+            else if (cmdLine[i].find("-keys=") == 0)
+            {
+                m_NumKeys = MMath::Max(atoi(cmdLine[i].c_str() + 6), 3);
+            }
+            else if (cmdLine[i].find("-frames=") == 0)
+            {
+                m_NumFrames = MMath::Max(atoi(cmdLine[i].c_str() + 8), 1);
+            }
+        }
+    }
+
+    virtual ~AnimBenchmarkModule()
+    {
+
+    }
+
+    virtual bool PreInit() override
+    {
+        return true;
+    }
+
+    virtual bool Init() override
+    {
+        MMath::RandInit(1024);
+
+        std::vector<BoneTrack> tracks(m_NumCharacters * m_NumBones);
+        for (int32 i = 0; i < tracks.size(); ++i)
+        {
+            CreateTrack(tracks[i]);
+        }
+
+        float duration = m_NumKeys / 30.0f;
+
+        // 顺序播放，每个角色有不同的起始相位
+        std::vector<float> sequential(m_NumFrames * m_NumCharacters);
+        // 随机跳转，cursor基本不命中
+        std::vector<float> random(m_NumFrames * m_NumCharacters);
+        for (int32 frame = 0; frame < m_NumFrames; ++frame)
+        {
+            for (int32 c = 0; c < m_NumCharacters; ++c)
+            {
+                float phase = duration * c / m_NumCharacters;
+                sequential[frame * m_NumCharacters + c] = std::fmod(phase + frame / 60.0f, duration);
+                random[frame * m_NumCharacters + c]     = MMath::FRand() * duration;
+            }
+        }
+
+        double linearTime = Run(tracks, sequential, true);
+        double seekTime   = Run(tracks, random, false);
+        double cursorTime = Run(tracks, sequential, false);
+
+        int32 numKeys = 0;
+        for (int32 i = 0; i < tracks.size(); ++i)
+        {
+            tracks[i].position.Resample(30.0f);
+            tracks[i].rotation.Resample(30.0f);
+            numKeys += (int32)tracks[i].position.keys.size();
+        }
+        double uniformTime = Run(tracks, sequential, false);
+
+        MLOG("AnimBenchmark : %d characters x %d bones, %d keys, %d frames", m_NumCharacters, m_NumBones, m_NumKeys, m_NumFrames);
+        MLOG("  linear scan     : %.3fms, %.1fns/sample", linearTime * 1000.0, PerSample(linearTime));
+        MLOG("  random seek     : %.3fms, %.1fns/sample", seekTime * 1000.0, PerSample(seekTime));
+        MLOG("  cursor          : %.3fms, %.1fns/sample (x%.1f)", cursorTime * 1000.0, PerSample(cursorTime), cursorTime > 0.0 ? linearTime / cursorTime : 0.0);
+        MLOG("  uniform resample: %.3fms, %.1fns/sample (x%.1f), %d keys per channel", uniformTime * 1000.0, PerSample(uniformTime), uniformTime > 0.0 ? linearTime / uniformTime : 0.0, numKeys / (int32)tracks.size());
+        MLOG("  checksum %f", m_Checksum);
+
+        Engine::Get()->RequestExit(true);
+        return true;
+    }
+
+    virtual void Exist() override
+    {
+
+    }
+
+    virtual void Loop(float time, float delta) override
+    {
+
+    }
+
+private:
+
+    // 30fps附近带抖动的关键帧，模拟非等间隔的导入数据
+    void CreateTrack(BoneTrack& track)
+    {
+        track.position.keys.resize(m_NumKeys);
+        track.position.values.resize(m_NumKeys);
+        track.rotation.keys.resize(m_NumKeys);
+        track.rotation.values.resize(m_NumKeys);
+
+        for (int32 i = 0; i < m_NumKeys; ++i)
+        {
+            float jitter = (i == 0 || i == m_NumKeys - 1) ? 0.0f : (MMath::FRand() - 0.5f) * 0.01f;
+            float key    = i / 30.0f + jitter;
+
+            track.position.keys[i]   = key;
+            track.position.values[i] = Vector3(MMath::FRand(), MMath::FRand(), MMath::FRand());
+            track.rotation.keys[i]   = key;
+            track.rotation.values[i] = Quat(Vector3(0, 1, 0), MMath::FRand() * PI);
+        }
+
+        track.position.UpdateSampling();
+        track.rotation.UpdateSampling();
+    }
+
+    // 旧版GetValue的线性查找
+    template <class ValueType>
+    static void LinearGetValue(const vk_demo::DVKAnimChannel<ValueType>& channel, float key, ValueType& outPrevValue, ValueType& outNextValue, float& outAlpha)
+    {
+        const std::vector<float>& keys = channel.keys;
+
+        int32 frameIndex = 0;
+        for (int32 i = 0; i < keys.size() - 1; ++i)
+        {
+            if (key <= keys[i + 1])
+            {
+                frameIndex = i;
+                break;
+            }
+        }
+
+        outPrevValue = channel.values[frameIndex + 0];
+        outNextValue = channel.values[frameIndex + 1];
+        outAlpha = (key - keys[frameIndex + 0]) / (keys[frameIndex + 1] - keys[frameIndex + 0]);
+    }
+
+    double Run(std::vector<BoneTrack>& tracks, const std::vector<float>& times, bool linear)
+    {
+        Vector3 prevPos;
+        Vector3 nextPos;
+        Quat    prevRot;
+        Quat    nextRot;
+        float   alpha = 0.0f;
+        float   sum   = 0.0f;
+
+        double beginTime = GenericPlatformTime::Seconds();
+
+        for (int32 frame = 0; frame < m_NumFrames; ++frame)
+        {
+            for (int32 c = 0; c < m_NumCharacters; ++c)
+            {
+                float time = times[frame * m_NumCharacters + c];
+                BoneTrack* bones = tracks.data() + c * m_NumBones;
+                for (int32 b = 0; b < m_NumBones; ++b)
+                {
+                    if (linear)
+                    {
+                        LinearGetValue(bones[b].position, time, prevPos, nextPos, alpha);
+                        sum += alpha;
+                        LinearGetValue(bones[b].rotation, time, prevRot, nextRot, alpha);
+                        sum += alpha;
+                    }
+                    else
+                    {
+                        bones[b].position.GetValue(time, prevPos, nextPos, alpha);
+                        sum += alpha;
+                        bones[b].rotation.GetValue(time, prevRot, nextRot, alpha);
+                        sum += alpha;
+                    }
+                }
+            }
+        }
+
+        double elapsed = GenericPlatformTime::Seconds() - beginTime;
+        // 防止循环被优化掉
+        m_Checksum += sum;
+        return elapsed;
+    }
+
+    double PerSample(double seconds) const
+    {
+        double numSamples = 2.0 * m_NumFrames * m_NumCharacters * m_NumBones;
+        return seconds * 1000000000.0 / numSamples;
+    }
+
+private:
+    int32   m_NumCharacters = 100;
+    int32   m_NumBones = 64;
+    int32   m_NumKeys = 300;
+    int32   m_NumFrames = 120;
+    double  m_Checksum = 0.0;
+};
+
+std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
+{
+    return std::make_shared<AnimBenchmarkModule>(800, 600, "AnimBenchmark", cmdLine);
+}
@@ -0,0 +1,7 @@
+target("AnimBenchmark")
+set_kind("binary")
+add_files("/*.cpp",launch_file)
+add_links(links_list)
+add_includedirs(include_dir_list, "$(projectdir)/src/Engine")
+add_ldflags(ldflags_list)
+add_deps("Vulkan")
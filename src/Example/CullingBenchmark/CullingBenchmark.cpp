@@ -0,0 +1,170 @@
+#include "Common/Common.h"
+#include "Common/Log.h"
+
+#include "Application/AppModuleBase.h"
+#include "Demo/DVKCamera.h"
+#include "Demo/DVKFrustumCuller.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "HAL/ThreadPool.h"
+#include "Math/Math.h"
+#include "Math/MathSIMD.h"
+#include "Math/Vector3.h"
+
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdlib>
+#include <algorithm>
+
+// 在CPU上对随机分布的包围盒做视锥剔除，对比标量、SIMD与多线程的耗时，并检查三者结果一致。
+// CullingBenchmark [-count=N] [-iterations=N] [-views=N]
+// 包围盒均匀分布在边长1000的立方体中，相机位于中心附近随机朝向，远平面500。
+class CullingBenchmarkModule : public AppModuleBase
+{
+public:
+    struct Mode
+    {
+        const char*                         name;
+        bool                                simd;
+        bool                                parallel;
+        vk_demo::DVKFrustumCuller::Shape    shape;
+    };
+
+    CullingBenchmarkModule(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
+        : AppModuleBase(width, height, title)
+    {
+        for (int32 i = 1; i < cmdLine.size(); ++i)
+        {
+            if (cmdLine[i].find("-count=") == 0)
+            {
+                m_Count = MMath::Max(atoi(cmdLine[i].c_str() + 7), 1);
+            }
+            else if (cmdLine[i].find("-iterations=") == 0)
+            {
+                m_Iterations = MMath::Max(atoi(cmdLine[i].c_str() + 12), 1);
+            }
+            else if (cmdLine[i].find("-views=") == 0)
+            {
+                m_Views = MMath::Max(atoi(cmdLine[i].c_str() + 7), 1);
+            }
+        }
+    }
+
+    virtual ~CullingBenchmarkModule()
+    {
+
+    }
+
+    virtual bool PreInit() override
+    {
+        return true;
+    }
+
+    virtual bool Init() override
+    {
+        MLOG("CullingBenchmark : %d boxes, %d iterations, %d views, %d worker threads, SIMD %s", m_Count, m_Iterations, m_Views, ThreadPool::Get().GetNumThreads(), PLATFORM_MATH_SIMD ? "on" : "off");
+
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+        std::uniform_real_distribution<float> extent(0.1f, 10.0f);
+
+        vk_demo::DVKCullingBounds bounds;
+        bounds.Resize(m_Count);
+        for (int32 i = 0; i < m_Count; ++i)
+        {
+            Vector3 center(position(random), position(random), position(random));
+            Vector3 size(extent(random), extent(random), extent(random));
+            bounds.SetBox(i, center - size, center + size);
+        }
+
+        std::uniform_real_distribution<float> offset(-50.0f, 50.0f);
+        std::vector<vk_demo::DVKFrustum> frustums(m_Views);
+        for (int32 i = 0; i < m_Views; ++i)
+        {
+            vk_demo::DVKCamera camera;
+            camera.Perspective(PI / 4, 1280.0f, 720.0f, 1.0f, 500.0f);
+            camera.SetPosition(offset(random), offset(random), offset(random));
+            camera.LookAt(position(random), position(random), position(random));
+            frustums[i].Set(camera.GetViewProjection());
+        }
+
+        const Mode modes[] = {
+            { "box scalar",        false, false, vk_demo::DVKFrustumCuller::Shape_Box    },
+            { "box simd",          true,  false, vk_demo::DVKFrustumCuller::Shape_Box    },
+            { "box simd parallel", true,  true,  vk_demo::DVKFrustumCuller::Shape_Box    },
+            { "sphere scalar",     false, false, vk_demo::DVKFrustumCuller::Shape_Sphere },
+            { "sphere simd",       true,  false, vk_demo::DVKFrustumCuller::Shape_Sphere },
+        };
+
+        // 以标量结果为准
+        std::vector<std::vector<int32>> references[2];
+        references[0].resize(m_Views);
+        references[1].resize(m_Views);
+
+        MLOG("  %-20s : %10s %10s %10s %8s", "mode", "time", "Mboxes/s", "visible", "match");
+        for (int32 i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i)
+        {
+            const Mode& mode = modes[i];
+            vk_demo::DVKFrustumCuller::simd              = mode.simd;
+            vk_demo::DVKFrustumCuller::parallel          = mode.parallel;
+            vk_demo::DVKFrustumCuller::parallelThreshold = mode.parallel ? 0 : MAX_int32;
+
+            vk_demo::DVKVisibleList visible;
+            uint64 numVisible = 0;
+            bool   match      = true;
+            double time       = 0.0;
+
+            for (int32 view = 0; view < m_Views; ++view)
+            {
+                // 第一次用于分配内存与检查结果，不计时
+                vk_demo::DVKFrustumCuller::Cull(frustums[view], bounds, visible, mode.shape);
+
+                std::vector<int32>& reference = references[mode.shape][view];
+                if (!mode.simd && !mode.parallel)
+                {
+                    reference.assign(visible.indices.begin(), visible.indices.begin() + visible.count);
+                }
+                else
+                {
+                    match = match && (int32)reference.size() == visible.count && std::equal(reference.begin(), reference.end(), visible.indices.begin());
+                }
+                numVisible += visible.count;
+
+                double beginTime = GenericPlatformTime::Seconds();
+                for (int32 iteration = 0; iteration < m_Iterations; ++iteration)
+                {
+                    vk_demo::DVKFrustumCuller::Cull(frustums[view], bounds, visible, mode.shape);
+                }
+                time += (GenericPlatformTime::Seconds() - beginTime) / m_Iterations;
+            }
+
+            time /= m_Views;
+            MLOG("  %-20s : %8.3fms %10.1f %10d %8s", mode.name, time * 1000.0, time > 0.0 ? m_Count / time / 1000000.0 : 0.0, (int32)(numVisible / m_Views), match ? "yes" : "NO");
+        }
+
+        vk_demo::DVKFrustumCuller::PrintStats();
+
+        Engine::Get()->RequestExit(true);
+        return true;
+    }
+
+    virtual void Exist() override
+    {
+
+    }
+
+    virtual void Loop(float time, float delta) override
+    {
+
+    }
+
+private:
+    int32   m_Count = 100000;
+    int32   m_Iterations = 100;
+    int32   m_Views = 16;
+};
+
+std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
+{
+    return std::make_shared<CullingBenchmarkModule>(800, 600, "CullingBenchmark", cmdLine);
+}
@@ -0,0 +1,256 @@
+#include "Common/Common.h"
+#include "Common/Log.h"
+
+#include "Demo/DemoBase.h"
+#include "Demo/DVKBuffer.h"
+#include "Demo/DVKCommand.h"
+#include "Demo/DVKDescriptorAllocator.h"
+#include "Demo/DVKShader.h"
+#include "Demo/DVKTexture.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+// descriptor更新的CPU耗时，结果换算为每1000次descriptor写入的耗时。
+// DescriptorBenchmark [-sets=N] [-iterations=N] [-transient=N]
+// 对比按名字逐个写入并立即提交(原来的方式)、按句柄写入后合并提交、按句柄写入后走模板提交。
+// 最后模拟N帧临时descriptor set的分配，每帧数量在sets~3*sets之间变化，检查分配器没有失败。
+class DescriptorBenchmarkModule : public DemoBase
+{
+public:
+    DescriptorBenchmarkModule(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
+        : DemoBase(width, height, title, cmdLine)
+    {
+        for (int32 i = 1; i < cmdLine.size(); ++i)
+        {
+            if (cmdLine[i].find("-sets=") == 0)
+            {
+                m_NumSets = MMath::Max(atoi(cmdLine[i].c_str() + 6), 1);
+            }
+            else if (cmdLine[i].find("-iterations=") == 0)
+            {
+                m_Iterations = MMath::Max(atoi(cmdLine[i].c_str() + 12), 1);
+            }
+            else if (cmdLine[i].find("-transient=") == 0)
+            {
+                m_TransientFrames = MMath::Max(atoi(cmdLine[i].c_str() + 11), 1);
+            }
+        }
+    }
+
+    virtual ~DescriptorBenchmarkModule()
+    {
+
+    }
+
+    virtual bool PreInit() override
+    {
+        return true;
+    }
+
+    virtual bool Init() override
+    {
+        DemoBase::Setup();
+        DemoBase::Prepare();
+
+        CreateResources();
+
+        MLOG("DescriptorBenchmark : %d sets x %d descriptors, %d iterations, update template %s",
+            m_NumSets,
+            (int32)m_Shader->setLayoutsInfo.handles.size(),
+            m_Iterations,
+            m_Shader->updateTemplates.size() > 0 ? "supported" : "not supported"
+        );
+
+        Benchmark("by name", false, false);
+        Benchmark("batched", true, false);
+        Benchmark("template", true, true);
+        TransientBenchmark();
+
+        DestroyResources();
+
+        Engine::Get()->RequestExit(true);
+        return true;
+    }
+
+    virtual void Exist() override
+    {
+        DemoBase::Release();
+    }
+
+    virtual void Loop(float time, float delta) override
+    {
+
+    }
+
+private:
+
+    void CreateResources()
+    {
+        m_Shader = vk_demo::DVKShader::Create(
+            m_VulkanDevice,
+            "assets/shaders/16_OptimizeShaderAndLayout/debug1.vert.spv",
+            "assets/shaders/16_OptimizeShaderAndLayout/debug1.frag.spv"
+        );
+
+        m_Buffer = vk_demo::DVKBuffer::CreateBuffer(
+            m_VulkanDevice,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            256
+        );
+
+        uint8 pixel[4] = { 255, 255, 255, 255 };
+        vk_demo::DVKCommandBuffer* cmdBuffer = vk_demo::DVKCommandBuffer::Create(m_VulkanDevice, m_CommandPool);
+        m_Texture = vk_demo::DVKTexture::Create2D(pixel, 4, VK_FORMAT_R8G8B8A8_UNORM, 1, 1, m_VulkanDevice, cmdBuffer);
+        delete cmdBuffer;
+
+        m_DescriptorSets.resize(m_NumSets);
+        for (int32 i = 0; i < m_NumSets; ++i)
+        {
+            m_DescriptorSets[i] = m_Shader->AllocateDescriptorSet();
+        }
+    }
+
+    void DestroyResources()
+    {
+        for (int32 i = 0; i < m_DescriptorSets.size(); ++i)
+        {
+            delete m_DescriptorSets[i];
+        }
+        m_DescriptorSets.clear();
+
+        delete m_Texture;
+        delete m_Buffer;
+        delete m_Shader;
+    }
+
+    void WriteAll(vk_demo::DVKDescriptorSet* descriptorSet, bool byHandle)
+    {
+        const std::vector<vk_demo::DVKDescriptorSetLayoutsInfo::BindInfo>& handles = m_Shader->setLayoutsInfo.handles;
+        for (auto it = m_Shader->setLayoutsInfo.paramsMap.begin(); it != m_Shader->setLayoutsInfo.paramsMap.end(); ++it)
+        {
+            bool isImage = handles[it->second.handle].descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            if (byHandle)
+            {
+                if (isImage) {
+                    descriptorSet->WriteImage(it->second.handle, m_Texture);
+                }
+                else {
+                    descriptorSet->WriteBuffer(it->second.handle, m_Buffer);
+                }
+            }
+            else
+            {
+                // 与修改前一致：每次写入都按名字查找并单独提交一次
+                if (isImage) {
+                    descriptorSet->WriteImage(it->first, m_Texture);
+                }
+                else {
+                    descriptorSet->WriteBuffer(it->first, m_Buffer);
+                }
+                descriptorSet->Flush();
+            }
+        }
+
+        if (byHandle)
+        {
+            descriptorSet->Flush();
+        }
+    }
+
+    void Benchmark(const char* name, bool byHandle, bool useTemplate)
+    {
+        if (useTemplate && m_Shader->updateTemplates.size() == 0)
+        {
+            MLOG("  %-8s : skipped", name);
+            return;
+        }
+
+        // 不使用模板时清空set上的模板，Flush退回vkUpdateDescriptorSets
+        for (int32 i = 0; i < m_DescriptorSets.size(); ++i)
+        {
+            m_DescriptorSets[i]->updateTemplates = useTemplate ? m_Shader->updateTemplates : std::vector<VkDescriptorUpdateTemplate>();
+        }
+
+        // 预热一次，保证所有descriptor都已写过
+        for (int32 i = 0; i < m_DescriptorSets.size(); ++i)
+        {
+            WriteAll(m_DescriptorSets[i], byHandle);
+        }
+
+        double beginTime = GenericPlatformTime::Seconds();
+        for (int32 iteration = 0; iteration < m_Iterations; ++iteration)
+        {
+            for (int32 i = 0; i < m_DescriptorSets.size(); ++i)
+            {
+                WriteAll(m_DescriptorSets[i], byHandle);
+            }
+        }
+        double totalTime = GenericPlatformTime::Seconds() - beginTime;
+
+        double numWrites = (double)m_Iterations * m_DescriptorSets.size() * m_Shader->setLayoutsInfo.paramsMap.size();
+        MLOG("  %-8s : %.2fus per 1k descriptor updates", name, totalTime * 1000000.0 / numWrites * 1000.0);
+    }
+
+    void TransientBenchmark()
+    {
+        std::vector<vk_demo::DVKDescriptorSet*> transientSets(m_NumSets * 3);
+        for (int32 i = 0; i < transientSets.size(); ++i)
+        {
+            transientSets[i] = m_Shader->CreateTransientDescriptorSet();
+        }
+
+        uint32 numFailures = m_DescriptorAllocator->numFailures;
+        int64  numSets     = 0;
+
+        double beginTime = GenericPlatformTime::Seconds();
+        for (int32 frame = 0; frame < m_TransientFrames; ++frame)
+        {
+            // 没有提交GPU工作，直接按帧槽位回收
+            m_DescriptorAllocator->BeginFrame(frame % m_NumFramesInFlight);
+
+            int32 count = m_NumSets * (1 + frame % 3);
+            for (int32 i = 0; i < count; ++i)
+            {
+                if (transientSets[i]->AllocateTransient(m_DescriptorAllocator))
+                {
+                    WriteAll(transientSets[i], true);
+                }
+            }
+            numSets += count;
+        }
+        double totalTime = GenericPlatformTime::Seconds() - beginTime;
+
+        for (int32 i = 0; i < transientSets.size(); ++i)
+        {
+            delete transientSets[i];
+        }
+
+        MLOG("  %-8s : %d frames, %.2fus per set, %d pools, %d grows, %d failures",
+            "transient",
+            m_TransientFrames,
+            totalTime * 1000000.0 / MMath::Max(numSets, (int64)1),
+            (int32)m_DescriptorAllocator->allPools.size(),
+            m_DescriptorAllocator->numGrows,
+            m_DescriptorAllocator->numFailures - numFailures
+        );
+    }
+
+private:
+    vk_demo::DVKShader*                     m_Shader = nullptr;
+    vk_demo::DVKBuffer*                     m_Buffer = nullptr;
+    vk_demo::DVKTexture*                    m_Texture = nullptr;
+    std::vector<vk_demo::DVKDescriptorSet*> m_DescriptorSets;
+
+    int32                                   m_NumSets = 256;
+    int32                                   m_Iterations = 100;
+    int32                                   m_TransientFrames = 300;
+};
+
+std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
+{
+    return std::make_shared<DescriptorBenchmarkModule>(800, 600, "DescriptorBenchmark", cmdLine);
+}
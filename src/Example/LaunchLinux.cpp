@@ -0,0 +1,19 @@
+#include "Common/Common.h"
+#include "Common/Log.h"
+#include "Launch/Launch.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+std::vector<std::string> g_CmdLine;
+
+int main(int argc, char* argv[])
+{
+    for (int32 i = 0; i < argc; ++i)
+    {
+        g_CmdLine.push_back(argv[i]);
+    }
+
+    return GuardedMain(g_CmdLine);
+}
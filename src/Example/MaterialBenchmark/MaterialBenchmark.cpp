@@ -0,0 +1,246 @@
+#include "Common/Common.h"
+#include "Common/Log.h"
+
+#include "Demo/DemoBase.h"
+#include "Demo/DVKMaterial.h"
+#include "Demo/DVKShader.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "Math/Matrix4x4.h"
+#include "Math/Vector3.h"
+#include "Math/Vector4.h"
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+// material per-object uniform上传的CPU耗时，结果换算为每个object的耗时。
+// MaterialBenchmark [-objects=N] [-iterations=N]
+// 模拟N帧绘制，前一半帧每帧objects~3*objects个object，后一半每帧16*objects个，迫使ring buffer扩容。
+// 每帧检查global uniform在同一个set内只上传一次、local uniform每个object各自一份，
+// 最后再走几帧空帧，检查扩容后换下的descriptor set都已回收。
+class MaterialBenchmarkModule : public DemoBase
+{
+public:
+    MaterialBenchmarkModule(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
+        : DemoBase(width, height, title, cmdLine)
+    {
+        // 按帧槽位回收ring buffer，需要多个在途帧
+        m_FrameSliced = true;
+
+        for (int32 i = 1; i < cmdLine.size(); ++i)
+        {
+            if (cmdLine[i].find("-objects=") == 0)
+            {
+                m_NumObjects = MMath::Max(atoi(cmdLine[i].c_str() + 9), 1);
+            }
+            else if (cmdLine[i].find("-iterations=") == 0)
+            {
+                m_Iterations = MMath::Max(atoi(cmdLine[i].c_str() + 12), 2);
+            }
+        }
+    }
+
+    virtual ~MaterialBenchmarkModule()
+    {
+
+    }
+
+    virtual bool PreInit() override
+    {
+        return true;
+    }
+
+    virtual bool Init() override
+    {
+        DemoBase::Setup();
+        DemoBase::Prepare();
+
+        CreateResources();
+
+        MLOG("MaterialBenchmark : %d objects, %d frames, %d frames in flight", m_NumObjects, m_Iterations, GetNumFramesInFlight());
+
+        Benchmark();
+
+        DestroyResources();
+
+        Engine::Get()->RequestExit(true);
+        return true;
+    }
+
+    virtual void Exist() override
+    {
+        DemoBase::Release();
+    }
+
+    virtual void Loop(float time, float delta) override
+    {
+
+    }
+
+private:
+
+    struct ViewProjectionBlock
+    {
+        Matrix4x4 view;
+        Matrix4x4 projection;
+    };
+
+    struct ModelBlock
+    {
+        Matrix4x4 model;
+    };
+
+    struct ColorBlock
+    {
+        Vector4 color;
+    };
+
+    void CreateResources()
+    {
+        // 13_DynamicUniformBuffer的shader：binding0为view/projection，binding1为model，binding2为color
+        m_Shader = vk_demo::DVKShader::Create(
+            m_VulkanDevice,
+            true,
+            "assets/shaders/13_DynamicUniformBuffer/obj.vert.spv",
+            "assets/shaders/13_DynamicUniformBuffer/obj.frag.spv"
+        );
+
+        m_Material = vk_demo::DVKMaterial::Create(m_VulkanDevice, m_RenderPass, m_PipelineCache, m_Shader);
+    }
+
+    void DestroyResources()
+    {
+        // 删除最后一个material时会输出ring buffer的统计
+        delete m_Material;
+        m_Material = nullptr;
+
+        delete m_Shader;
+        m_Shader = nullptr;
+    }
+
+    void BeginFrame(int32 frame)
+    {
+        // 没有提交GPU工作，直接按帧槽位回收，与DemoBase::AcquireBackbufferIndex中的顺序一致
+        int32 frameIndex = frame % GetNumFramesInFlight();
+        vk_demo::DVKDescriptorSetPool::BeginFrame(frameIndex);
+        vk_demo::DVKMaterial::BeginRingBufferFrame(frameIndex);
+        m_Material->BeginFrame();
+    }
+
+    int32 ValidateFrame(int32 numObjects)
+    {
+        int32 viewProjIndex = m_Material->uniformBuffers["uboViewProj"].dynamicIndex;
+        int32 modelIndex    = m_Material->uniformBuffers["uboModel"].dynamicIndex;
+
+        if (m_Material->perObjectIndexes.size() != numObjects)
+        {
+            return 1;
+        }
+
+        int32 numErrors = 0;
+        for (int32 i = 1; i < numObjects; ++i)
+        {
+            const uint32* prevOffsets = m_Material->globalOffsets.data() + m_Material->perObjectIndexes[i - 1];
+            const uint32* offsets     = m_Material->globalOffsets.data() + m_Material->perObjectIndexes[i];
+
+            // set切换说明ring buffer换了buffer，global uniform需要在新buffer中重新上传
+            if (m_Material->perObjectSets[i] != m_Material->perObjectSets[i - 1])
+            {
+                continue;
+            }
+
+            if (offsets[viewProjIndex] != prevOffsets[viewProjIndex] || offsets[modelIndex] == prevOffsets[modelIndex])
+            {
+                numErrors += 1;
+            }
+        }
+
+        return numErrors;
+    }
+
+    void Benchmark()
+    {
+        ViewProjectionBlock viewProjData;
+        viewProjData.view.SetIdentity();
+        viewProjData.projection.SetIdentity();
+
+        ModelBlock modelData;
+        ColorBlock colorData;
+        colorData.color.Set(1.0f, 1.0f, 1.0f, 1.0f);
+
+        int32  numErrors      = 0;
+        int32  maxRetiredSets = 0;
+        int64  numObjects     = 0;
+        uint64 maxFrameBytes  = 0;
+        double totalTime      = 0;
+
+        for (int32 frame = 0; frame < m_Iterations; ++frame)
+        {
+            int32 count = frame < m_Iterations / 2 ? m_NumObjects * (1 + frame % 3) : m_NumObjects * 16;
+
+            double beginTime = GenericPlatformTime::Seconds();
+
+            BeginFrame(frame);
+
+            viewProjData.view.SetPosition(Vector3(0, 0, (float)frame));
+            m_Material->SetGlobalUniform("uboViewProj", &viewProjData, sizeof(ViewProjectionBlock));
+
+            for (int32 i = 0; i < count; ++i)
+            {
+                modelData.model.SetIdentity();
+                modelData.model.SetPosition(Vector3((float)i, 0, 0));
+                colorData.color.x = (float)(i % 256) / 255.0f;
+
+                m_Material->BeginObject();
+                m_Material->SetLocalUniform("uboModel", &modelData, sizeof(ModelBlock));
+                m_Material->SetLocalUniform("uboColor", &colorData, sizeof(ColorBlock));
+                m_Material->EndObject();
+            }
+
+            m_Material->EndFrame();
+
+            totalTime += GenericPlatformTime::Seconds() - beginTime;
+
+            numErrors     += ValidateFrame(count);
+            numObjects    += count;
+            maxRetiredSets = MMath::Max(maxRetiredSets, (int32)m_Material->retiredSets.size());
+            maxFrameBytes  = MMath::Max(maxFrameBytes, vk_demo::DVKMaterial::GetFrameUploadBytes());
+        }
+
+        // 在途帧全部完成之后，扩容换下的set都应该已经回收
+        for (int32 frame = m_Iterations; frame < m_Iterations + GetNumFramesInFlight() + 1; ++frame)
+        {
+            BeginFrame(frame);
+            m_Material->EndFrame();
+        }
+        int32 numLeakedSets = (int32)m_Material->retiredSets.size();
+
+        MLOG("  %-8s : %.3fus per object, %lluKB peak frame upload, %d max retired sets",
+            "upload",
+            totalTime * 1000000.0 / MMath::Max(numObjects, (int64)1),
+            maxFrameBytes / 1024,
+            maxRetiredSets
+        );
+
+        if (numErrors == 0 && numLeakedSets == 0)
+        {
+            MLOG("  %-8s : passed", "validate");
+        }
+        else
+        {
+            MLOGE("  %-8s : failed, %d invalid offsets, %d retired sets not released", "validate", numErrors, numLeakedSets);
+        }
+    }
+
+private:
+    vk_demo::DVKShader*                     m_Shader = nullptr;
+    vk_demo::DVKMaterial*                   m_Material = nullptr;
+
+    int32                                   m_NumObjects = 4096;
+    int32                                   m_Iterations = 300;
+};
+
+std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
+{
+    return std::make_shared<MaterialBenchmarkModule>(800, 600, "MaterialBenchmark", cmdLine);
+}
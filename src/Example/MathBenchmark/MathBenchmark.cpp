@@ -0,0 +1,268 @@
+#include "Common/Common.h"
+#include "Common/Log.h"
+
+#include "Application/AppModuleBase.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "Math/Math.h"
+#include "Math/Vector4.h"
+#include "Math/Matrix4x4.h"
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+// 矩阵运算的SIMD后端校验与微基准。
+// MathBenchmark [-count=N] [-iterations=N]
+// 先用随机矩阵对比SIMD与标量实现的误差，再分别统计矩阵乘法、求逆以及批量变换的耗时。
+class MathBenchmarkModule : public AppModuleBase
+{
+public:
+    MathBenchmarkModule(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
+        : AppModuleBase(width, height, title)
+    {
+        for (int32 i = 1; i < cmdLine.size(); ++i)
+        {
+            if (cmdLine[i].find("-count=") == 0)
+            {
+                m_Count = MMath::Max(atoi(cmdLine[i].c_str() + 7), 1);
+            }
+            else if (cmdLine[i].find("-iterations=") == 0)
+            {
+                m_Iterations = MMath::Max(atoi(cmdLine[i].c_str() + 12), 1);
+            }
+        }
+    }
+
+    virtual ~MathBenchmarkModule()
+    {
+
+    }
+
+    virtual bool PreInit() override
+    {
+        return true;
+    }
+
+    virtual bool Init() override
+    {
+        MMath::RandInit(1024);
+
+#if PLATFORM_MATH_SSE
+        MLOG("MathBenchmark : SSE%s", PLATFORM_MATH_FMA ? " + FMA" : "");
+#elif PLATFORM_MATH_NEON
+        MLOG("MathBenchmark : NEON");
+#else
+        MLOG("MathBenchmark : scalar only");
+#endif
+
+        m_Matrices.resize(m_Count);
+        m_Results.resize(m_Count);
+        m_Vectors.resize(m_Count);
+        m_Transformed.resize(m_Count);
+        for (int32 i = 0; i < m_Count; ++i)
+        {
+            m_Matrices[i] = RandomTransform();
+            m_Vectors[i]  = Vector4(RandRange(), RandRange(), RandRange(), 1.0f);
+        }
+
+        Validate();
+
+        BenchmarkMultiply();
+        BenchmarkInverse();
+        BenchmarkTransform();
+
+        MLOG("  checksum %f", m_Checksum);
+
+        Engine::Get()->RequestExit(true);
+        return true;
+    }
+
+    virtual void Exist() override
+    {
+
+    }
+
+    virtual void Loop(float time, float delta) override
+    {
+
+    }
+
+private:
+
+    static float RandRange()
+    {
+        return MMath::FRand() * 2.0f - 1.0f;
+    }
+
+    // 缩放、旋转、平移组合的变换矩阵，与场景与骨骼中的矩阵接近，保证可逆
+    static Matrix4x4 RandomTransform()
+    {
+        Matrix4x4 matrix;
+        matrix.SetIdentity();
+        matrix.AppendScale(Vector3(0.5f + MMath::FRand(), 0.5f + MMath::FRand(), 0.5f + MMath::FRand()));
+        matrix.AppendRotation(MMath::FRand() * 360.0f, Vector3(RandRange(), RandRange(), RandRange() + 2.0f).GetSafeNormal());
+        matrix.AppendTranslation(Vector3(RandRange(), RandRange(), RandRange()) * 100.0f);
+        return matrix;
+    }
+
+    static float MaxError(const float* a, const float* b, int32 count)
+    {
+        float error = 0.0f;
+        for (int32 i = 0; i < count; ++i)
+        {
+            error = MMath::Max(error, MMath::Abs(a[i] - b[i]) / (1.0f + MMath::Abs(a[i])));
+        }
+        return error;
+    }
+
+    void Validate()
+    {
+        float multiplyError  = 0.0f;
+        float inverseError   = 0.0f;
+        float transformError = 0.0f;
+
+        Matrix4x4 expected;
+        Matrix4x4 actual;
+        for (int32 i = 0; i < m_Count; ++i)
+        {
+            const Matrix4x4& a = m_Matrices[i];
+            const Matrix4x4& b = m_Matrices[(i + 1) % m_Count];
+
+            MMath::VectorMatrixMultiplyScalar(&expected, &a, &b);
+            MMath::VectorMatrixMultiply(&actual, &a, &b);
+            multiplyError = MMath::Max(multiplyError, MaxError(&expected.m[0][0], &actual.m[0][0], 16));
+
+            MMath::VectorMatrixInverseScalar(&expected, &a);
+            MMath::VectorMatrixInverse(&actual, &a);
+            inverseError = MMath::Max(inverseError, MaxError(&expected.m[0][0], &actual.m[0][0], 16));
+
+            Vector4 expectedVec;
+            MMath::VectorTransformVectorScalar(&expectedVec, &m_Vectors[i], &a);
+            Vector4 actualVec = a.TransformVector4(m_Vectors[i]);
+            transformError = MMath::Max(transformError, MaxError(&expectedVec.x, &actualVec.x, 4));
+        }
+
+        // 乘法与变换只有FMA带来的舍入差异，求逆的运算顺序不同，误差稍大
+        bool passed = multiplyError < 1.e-5f && transformError < 1.e-5f && inverseError < 1.e-3f;
+        if (passed)
+        {
+            MLOG("  validate passed : multiply %g, inverse %g, transform %g", multiplyError, inverseError, transformError);
+        }
+        else
+        {
+            MLOGE("  validate failed : multiply %g, inverse %g, transform %g", multiplyError, inverseError, transformError);
+        }
+    }
+
+    void BenchmarkMultiply()
+    {
+        double beginTime = GenericPlatformTime::Seconds();
+        for (int32 iter = 0; iter < m_Iterations; ++iter)
+        {
+            for (int32 i = 0; i < m_Count; ++i)
+            {
+                MMath::VectorMatrixMultiplyScalar(&m_Results[i], &m_Matrices[i], &m_Matrices[(i + 1) % m_Count]);
+            }
+        }
+        double scalarTime = GenericPlatformTime::Seconds() - beginTime;
+        Accumulate();
+
+        beginTime = GenericPlatformTime::Seconds();
+        for (int32 iter = 0; iter < m_Iterations; ++iter)
+        {
+            for (int32 i = 0; i < m_Count; ++i)
+            {
+                MMath::VectorMatrixMultiply(&m_Results[i], &m_Matrices[i], &m_Matrices[(i + 1) % m_Count]);
+            }
+        }
+        double simdTime = GenericPlatformTime::Seconds() - beginTime;
+        Accumulate();
+
+        Report("multiply", scalarTime, simdTime, m_Count);
+    }
+
+    void BenchmarkInverse()
+    {
+        double beginTime = GenericPlatformTime::Seconds();
+        for (int32 iter = 0; iter < m_Iterations; ++iter)
+        {
+            for (int32 i = 0; i < m_Count; ++i)
+            {
+                MMath::VectorMatrixInverseScalar(&m_Results[i], &m_Matrices[i]);
+            }
+        }
+        double scalarTime = GenericPlatformTime::Seconds() - beginTime;
+        Accumulate();
+
+        beginTime = GenericPlatformTime::Seconds();
+        for (int32 iter = 0; iter < m_Iterations; ++iter)
+        {
+            for (int32 i = 0; i < m_Count; ++i)
+            {
+                MMath::VectorMatrixInverse(&m_Results[i], &m_Matrices[i]);
+            }
+        }
+        double simdTime = GenericPlatformTime::Seconds() - beginTime;
+        Accumulate();
+
+        Report("inverse", scalarTime, simdTime, m_Count);
+    }
+
+    void BenchmarkTransform()
+    {
+        const Matrix4x4& matrix = m_Matrices[0];
+
+        double beginTime = GenericPlatformTime::Seconds();
+        for (int32 iter = 0; iter < m_Iterations; ++iter)
+        {
+            for (int32 i = 0; i < m_Count; ++i)
+            {
+                MMath::VectorTransformVectorScalar(&m_Transformed[i], &m_Vectors[i], &matrix);
+            }
+        }
+        double scalarTime = GenericPlatformTime::Seconds() - beginTime;
+        m_Checksum += m_Transformed[m_Count / 2].x;
+
+        beginTime = GenericPlatformTime::Seconds();
+        for (int32 iter = 0; iter < m_Iterations; ++iter)
+        {
+            matrix.TransformVectors(m_Vectors.data(), m_Transformed.data(), m_Count);
+        }
+        double simdTime = GenericPlatformTime::Seconds() - beginTime;
+        m_Checksum += m_Transformed[m_Count / 2].x;
+
+        Report("batch transform", scalarTime, simdTime, m_Count);
+    }
+
+    // 防止结果被优化掉
+    void Accumulate()
+    {
+        m_Checksum += m_Results[m_Count / 2].m[3][0];
+    }
+
+    void Report(const char* name, double scalarTime, double simdTime, int32 count)
+    {
+        double numOps = (double)count * m_Iterations;
+        MLOG("  %-16s: scalar %.2fns, simd %.2fns (x%.2f)",
+            name,
+            scalarTime * 1000000000.0 / numOps,
+            simdTime * 1000000000.0 / numOps,
+            simdTime > 0.0 ? scalarTime / simdTime : 0.0
+        );
+    }
+
+private:
+    std::vector<Matrix4x4>  m_Matrices;
+    std::vector<Matrix4x4>  m_Results;
+    std::vector<Vector4>    m_Vectors;
+    std::vector<Vector4>    m_Transformed;
+
+    int32                   m_Count = 4096;
+    int32                   m_Iterations = 200;
+    double                  m_Checksum = 0.0;
+};
+
+std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
+{
+    return std::make_shared<MathBenchmarkModule>(800, 600, "MathBenchmark", cmdLine);
+}
@@ -0,0 +1,223 @@
+#include "Common/Common.h"
+#include "Common/Log.h"
+
+#include "Application/AppModuleBase.h"
+#include "Demo/DVKModel.h"
+#include "Demo/DVKMeshCook.h"
+#include "Demo/DVKMeshOptimizer.h"
+#include "Demo/DVKMeshSimplifier.h"
+#include "Demo/DVKUploadQueue.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "Vulkan/RHIDefinitions.h"
+#include "Vulkan/VulkanDevice.h"
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+// 离线cook模型，并对比Assimp与cooked文件的加载耗时。
+// MeshCooker [-iterations=N] [-attributes=position,uv0,normal,...] [-quantize] [-meshopt] [-lod=N] [model ...]
+// 不指定模型时cook示例中用到的所有模型。-meshopt时做顶点cache/overdraw重排，运行demo时需同样带-meshopt才会命中。
+// -lod=N时每个mesh额外生成N级简化的LOD。
+class MeshCookerModule : public AppModuleBase
+{
+public:
+    struct CookJob
+    {
+        std::string                     filename;
+        std::vector<VertexAttribute>    attributes;
+    };
+
+    MeshCookerModule(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
+        : AppModuleBase(width, height, title)
+    {
+        std::vector<VertexAttribute> attributes = { VertexAttribute::VA_Position, VertexAttribute::VA_UV0, VertexAttribute::VA_Normal };
+
+        for (int32 i = 1; i < cmdLine.size(); ++i)
+        {
+            if (cmdLine[i].find("-iterations=") == 0)
+            {
+                m_Iterations = MMath::Max(atoi(cmdLine[i].c_str() + 12), 1);
+            }
+            else if (cmdLine[i].find("-attributes=") == 0)
+            {
+                attributes = ParseAttributes(cmdLine[i].substr(12));
+            }
+            else if (cmdLine[i] == "-quantize")
+            {
+                m_Quantization = vk_demo::DVKVertexQuantization::Compact();
+            }
+            else if (cmdLine[i] == "-meshopt")
+            {
+                vk_demo::DVKMeshOptimizer::enabled = true;
+            }
+            else if (cmdLine[i].find("-lod=") == 0)
+            {
+                vk_demo::DVKMeshSimplifier::lodCount = MMath::Clamp(atoi(cmdLine[i].c_str() + 5), 0, (int32)vk_demo::DVKMeshSimplifier::MaxLODs);
+            }
+        }
+
+        for (int32 i = 1; i < cmdLine.size(); ++i)
+        {
+            if (cmdLine[i].size() > 0 && cmdLine[i][0] != '-')
+            {
+                m_Jobs.push_back({ cmdLine[i], attributes });
+            }
+        }
+
+        if (m_Jobs.size() == 0)
+        {
+            m_Jobs.push_back({ "assets/models/suzanne.obj", { VertexAttribute::VA_Position, VertexAttribute::VA_Normal } });
+            m_Jobs.push_back({ "assets/models/head.obj", { VertexAttribute::VA_Position, VertexAttribute::VA_UV0, VertexAttribute::VA_Normal, VertexAttribute::VA_Tangent } });
+            m_Jobs.push_back({ "assets/models/plane_z.obj", { VertexAttribute::VA_Position, VertexAttribute::VA_UV0, VertexAttribute::VA_Normal } });
+            m_Jobs.push_back({ "assets/models/scene1.obj", { VertexAttribute::VA_Position, VertexAttribute::VA_UV0, VertexAttribute::VA_Normal } });
+            m_Jobs.push_back({ "assets/models/Room/miniHouse_FBX.FBX", { VertexAttribute::VA_Position, VertexAttribute::VA_UV0, VertexAttribute::VA_Normal } });
+        }
+    }
+
+    virtual ~MeshCookerModule()
+    {
+
+    }
+
+    virtual bool PreInit() override
+    {
+        return true;
+    }
+
+    virtual bool Init() override
+    {
+        for (int32 i = 0; i < m_Jobs.size(); ++i)
+        {
+            CookJob& job = m_Jobs[i];
+            if (!vk_demo::DVKMeshCook::Cook(job.filename, job.attributes, m_Quantization))
+            {
+                MLOGE("Failed cook : %s", job.filename.c_str());
+                continue;
+            }
+            Benchmark(job);
+        }
+
+        vk_demo::DVKMeshCook::PrintStats();
+        vk_demo::DVKMeshOptimizer::PrintStats();
+        vk_demo::DVKMeshSimplifier::PrintStats();
+
+        Engine::Get()->RequestExit(true);
+        return true;
+    }
+
+    virtual void Exist() override
+    {
+
+    }
+
+    virtual void Loop(float time, float delta) override
+    {
+
+    }
+
+private:
+
+    static std::vector<VertexAttribute> ParseAttributes(const std::string& list)
+    {
+        std::vector<VertexAttribute> attributes;
+        size_t start = 0;
+        while (start <= list.size())
+        {
+            size_t end = list.find(',', start);
+            if (end == std::string::npos)
+            {
+                end = list.size();
+            }
+
+            VertexAttribute attribute = VertexAttributeFromName(list.substr(start, end - start));
+            if (attribute != VertexAttribute::VA_None)
+            {
+                attributes.push_back(attribute);
+            }
+
+            start = end + 1;
+        }
+        return attributes;
+    }
+
+    static VertexAttribute VertexAttributeFromName(const std::string& name)
+    {
+        if (name == "position")   return VertexAttribute::VA_Position;
+        if (name == "uv0")        return VertexAttribute::VA_UV0;
+        if (name == "uv1")        return VertexAttribute::VA_UV1;
+        if (name == "normal")     return VertexAttribute::VA_Normal;
+        if (name == "tangent")    return VertexAttribute::VA_Tangent;
+        if (name == "color")      return VertexAttribute::VA_Color;
+        if (name == "skinweight") return VertexAttribute::VA_SkinWeight;
+        if (name == "skinindex")  return VertexAttribute::VA_SkinIndex;
+        if (name == "skinpack")   return VertexAttribute::VA_SkinPack;
+        return VertexAttribute::VA_None;
+    }
+
+    void Benchmark(const CookJob& job)
+    {
+        std::shared_ptr<VulkanDevice> vulkanDevice = GetVulkanRHI()->GetDevice();
+
+        // 只统计CPU侧加载
+        double assimpTime = 0.0;
+        double cookedTime = 0.0;
+        for (int32 i = 0; i < m_Iterations; ++i)
+        {
+            double beginTime = GenericPlatformTime::Seconds();
+            delete vk_demo::DVKModel::LoadFromAssimp(job.filename, vulkanDevice, nullptr, job.attributes, m_Quantization);
+            assimpTime += GenericPlatformTime::Seconds() - beginTime;
+
+            beginTime = GenericPlatformTime::Seconds();
+            delete vk_demo::DVKMeshCook::Load(job.filename, vulkanDevice, nullptr, job.attributes, m_Quantization);
+            cookedTime += GenericPlatformTime::Seconds() - beginTime;
+        }
+
+        // 包含上传到device local buffer
+        vk_demo::DVKUploadQueue* uploader = vk_demo::DVKUploadQueue::Create(vulkanDevice);
+
+        double beginTime = GenericPlatformTime::Seconds();
+        vk_demo::DVKModel* model = vk_demo::DVKModel::LoadFromAssimp(job.filename, vulkanDevice, uploader, job.attributes, m_Quantization);
+        uploader->WaitIdle();
+        double assimpUploadTime = GenericPlatformTime::Seconds() - beginTime;
+        delete model;
+
+        beginTime = GenericPlatformTime::Seconds();
+        model = vk_demo::DVKMeshCook::Load(job.filename, vulkanDevice, uploader, job.attributes, m_Quantization);
+        uploader->WaitIdle();
+        double cookedUploadTime = GenericPlatformTime::Seconds() - beginTime;
+
+        uint64 vertexBytes      = 0;
+        uint64 floatVertexBytes = 0;
+        if (model)
+        {
+            model->GetVertexMemory(vertexBytes, floatVertexBytes);
+        }
+        delete model;
+
+        delete uploader;
+
+        assimpTime = assimpTime / m_Iterations * 1000.0;
+        cookedTime = cookedTime / m_Iterations * 1000.0;
+        MLOG("%s : assimp %.3fms, cooked %.3fms (x%.1f), with upload assimp %.3fms, cooked %.3fms, vertex %.1fKB (float %.1fKB)",
+            job.filename.c_str(),
+            assimpTime,
+            cookedTime,
+            cookedTime > 0.0 ? assimpTime / cookedTime : 0.0,
+            assimpUploadTime * 1000.0,
+            cookedUploadTime * 1000.0,
+            vertexBytes / 1024.0,
+            floatVertexBytes / 1024.0
+        );
+    }
+
+private:
+    std::vector<CookJob>                m_Jobs;
+    int32                               m_Iterations = 5;
+    vk_demo::DVKVertexQuantization      m_Quantization;
+};
+
+std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
+{
+    return std::make_shared<MeshCookerModule>(800, 600, "MeshCooker", cmdLine);
+}
@@ -0,0 +1,355 @@
+#include "Common/Common.h"
+#include "Common/Log.h"
+
+#include "Application/AppModuleBase.h"
+#include "Demo/DVKMeshOptimizer.h"
+#include "Demo/FileManager.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "Math/Math.h"
+
+#include "assimp/Importer.hpp"
+#include "assimp/scene.h"
+#include "assimp/postprocess.h"
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include <tuple>
+#include <filesystem>
+
+// 在CPU上模拟post-transform cache，对比导入阶段重排前后的ACMR/ATVR。
+// MeshOptimizerBenchmark [-cache=N] [-iterations=N] [model ...]
+// 不指定模型时遍历assets/models下所有obj/fbx。
+// 依次统计：原始顺序、只做cache重排、cache+overdraw重排、完整流程(再加vertex fetch重排)。
+// 开始前用随机网格(一半以退化三角形开头)校验重排结果是三角形的一个排列，加载的模型同样逐个校验。
+class MeshOptimizerBenchmarkModule : public AppModuleBase
+{
+public:
+    struct MeshData
+    {
+        std::vector<float>  positions;
+        std::vector<uint32> indices;
+    };
+
+    struct Result
+    {
+        uint64  triangles = 0;
+        uint64  vertices = 0;
+        uint64  transformed[4] = {};
+        double  time = 0.0;
+    };
+
+    MeshOptimizerBenchmarkModule(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
+        : AppModuleBase(width, height, title)
+    {
+        for (int32 i = 1; i < cmdLine.size(); ++i)
+        {
+            if (cmdLine[i].find("-cache=") == 0)
+            {
+                m_CacheSize = MMath::Max(atoi(cmdLine[i].c_str() + 7), 3);
+            }
+            else if (cmdLine[i].find("-iterations=") == 0)
+            {
+                m_Iterations = MMath::Max(atoi(cmdLine[i].c_str() + 12), 1);
+            }
+            else if (cmdLine[i].size() > 0 && cmdLine[i][0] != '-')
+            {
+                m_Files.push_back(cmdLine[i]);
+            }
+        }
+    }
+
+    virtual ~MeshOptimizerBenchmarkModule()
+    {
+
+    }
+
+    virtual bool PreInit() override
+    {
+        return true;
+    }
+
+    virtual bool Init() override
+    {
+        if (m_Files.size() == 0)
+        {
+            CollectModels("assets/models");
+        }
+
+        MLOG("MeshOptimizerBenchmark : %d models, cache %d, %d iterations", (int32)m_Files.size(), m_CacheSize, m_Iterations);
+
+        Validate();
+
+        MLOG("  %-48s : %8s %8s | %-23s | %-23s | %-23s | %-23s | %s", "model", "tris", "verts", "original ACMR/ATVR", "cache", "cache+overdraw", "full", "time");
+
+        Result total;
+        for (int32 i = 0; i < m_Files.size(); ++i)
+        {
+            Result result;
+            if (!Benchmark(m_Files[i], result))
+            {
+                MLOGE("Failed load : %s", m_Files[i].c_str());
+                continue;
+            }
+
+            Print(m_Files[i], result);
+
+            total.triangles += result.triangles;
+            total.vertices  += result.vertices;
+            total.time      += result.time;
+            for (int32 j = 0; j < 4; ++j)
+            {
+                total.transformed[j] += result.transformed[j];
+            }
+        }
+
+        Print("total", total);
+
+        if (m_NumInvalidMeshes > 0)
+        {
+            MLOGE("  %d meshes lost or duplicated triangles", m_NumInvalidMeshes);
+        }
+
+        Engine::Get()->RequestExit(true);
+        return true;
+    }
+
+    virtual void Exist() override
+    {
+
+    }
+
+    virtual void Loop(float time, float delta) override
+    {
+
+    }
+
+private:
+
+    // 三角形旋转到最小索引在前(保持绕序)后排序比较，两组索引包含相同的三角形时返回true
+    static bool IsTrianglePermutation(const uint32* a, const uint32* b, uint32 indexCount)
+    {
+        auto Collect = [indexCount](const uint32* indices)
+        {
+            std::vector<std::tuple<uint32, uint32, uint32>> triangles(indexCount / 3);
+            for (uint32 i = 0; i < triangles.size(); ++i)
+            {
+                const uint32* t = indices + i * 3;
+                int32 first = t[0] <= t[1] && t[0] <= t[2] ? 0 : (t[1] <= t[2] ? 1 : 2);
+                triangles[i] = std::make_tuple(t[first], t[(first + 1) % 3], t[(first + 2) % 3]);
+            }
+            std::sort(triangles.begin(), triangles.end());
+            return triangles;
+        };
+        return Collect(a) == Collect(b);
+    }
+
+    void Validate()
+    {
+        const int32 numTrials = 200;
+
+        srand(1234);
+        int32 failed = 0;
+        for (int32 trial = 0; trial < numTrials; ++trial)
+        {
+            uint32 vertexCount   = 64 + rand() % 1024;
+            uint32 triangleCount = 256 + rand() % 4096;
+
+            std::vector<float> positions(vertexCount * 3);
+            for (uint32 i = 0; i < positions.size(); ++i)
+            {
+                positions[i] = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+            }
+
+            // 局部相邻的索引，接近真实网格的顶点复用
+            std::vector<uint32> indices(triangleCount * 3);
+            for (uint32 i = 0; i < indices.size(); ++i)
+            {
+                uint32 center = (uint32)((uint64)i * vertexCount / indices.size());
+                indices[i] = (center + rand() % 16) % vertexCount;
+            }
+
+            // 一半的网格以退化三角形开头
+            if (trial % 2 == 0)
+            {
+                indices[1] = indices[0];
+            }
+
+            std::vector<uint32> cacheIndices(indices.size());
+            vk_demo::DVKMeshOptimizer::OptimizeVertexCache(cacheIndices.data(), indices.data(), (uint32)indices.size(), vertexCount, m_CacheSize);
+
+            std::vector<uint32> overdrawIndices(indices.size());
+            vk_demo::DVKMeshOptimizer::OptimizeOverdraw(overdrawIndices.data(), cacheIndices.data(), (uint32)indices.size(), positions.data(), 3, vertexCount, 1.05f, m_CacheSize);
+
+            bool valid = IsTrianglePermutation(indices.data(), cacheIndices.data(), (uint32)indices.size()) && IsTrianglePermutation(indices.data(), overdrawIndices.data(), (uint32)indices.size());
+            failed += valid ? 0 : 1;
+        }
+
+        if (failed == 0)
+        {
+            MLOG("  validate passed : %d random meshes", numTrials);
+        }
+        else
+        {
+            MLOGE("  validate failed : %d/%d random meshes lost or duplicated triangles", failed, numTrials);
+        }
+    }
+
+    void CollectModels(const std::string& directory)
+    {
+        std::error_code error;
+        std::string root = FileManager::GetFilePath("");
+        for (auto it = std::filesystem::recursive_directory_iterator(root + directory, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+        {
+            if (!it->is_regular_file())
+            {
+                continue;
+            }
+
+            std::string extension = it->path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            if (extension == ".obj" || extension == ".fbx")
+            {
+                m_Files.push_back(it->path().string().substr(root.size()));
+            }
+        }
+        std::sort(m_Files.begin(), m_Files.end());
+    }
+
+    // 与导入时一致：三角化并合并重复顶点
+    bool LoadMeshes(const std::string& filename, std::vector<MeshData>& outMeshes)
+    {
+        uint32 dataSize = 0;
+        uint8* dataPtr  = nullptr;
+        if (!FileManager::ReadFile(filename, dataPtr, dataSize))
+        {
+            return false;
+        }
+
+        std::string extension = filename.substr(filename.find_last_of('.') + 1);
+
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFileFromMemory(dataPtr, dataSize, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices, extension.c_str());
+        delete[] dataPtr;
+
+        if (!scene)
+        {
+            return false;
+        }
+
+        for (uint32 i = 0; i < scene->mNumMeshes; ++i)
+        {
+            const aiMesh* aiMesh = scene->mMeshes[i];
+
+            MeshData mesh;
+            for (uint32 j = 0; j < aiMesh->mNumVertices; ++j)
+            {
+                mesh.positions.push_back(aiMesh->mVertices[j].x);
+                mesh.positions.push_back(aiMesh->mVertices[j].y);
+                mesh.positions.push_back(aiMesh->mVertices[j].z);
+            }
+            for (uint32 j = 0; j < aiMesh->mNumFaces; ++j)
+            {
+                if (aiMesh->mFaces[j].mNumIndices != 3)
+                {
+                    continue;
+                }
+                mesh.indices.push_back(aiMesh->mFaces[j].mIndices[0]);
+                mesh.indices.push_back(aiMesh->mFaces[j].mIndices[1]);
+                mesh.indices.push_back(aiMesh->mFaces[j].mIndices[2]);
+            }
+
+            if (mesh.indices.size() > 0)
+            {
+                outMeshes.push_back(mesh);
+            }
+        }
+
+        return true;
+    }
+
+    bool Benchmark(const std::string& filename, Result& result)
+    {
+        std::vector<MeshData> meshes;
+        if (!LoadMeshes(filename, meshes))
+        {
+            return false;
+        }
+
+        for (int32 i = 0; i < meshes.size(); ++i)
+        {
+            MeshData& mesh     = meshes[i];
+            uint32 vertexCount = (uint32)mesh.positions.size() / 3;
+            uint32 indexCount  = (uint32)mesh.indices.size();
+
+            vk_demo::DVKMeshOptimizer::CacheStats stats = vk_demo::DVKMeshOptimizer::AnalyzeVertexCache(mesh.indices.data(), indexCount, vertexCount, m_CacheSize);
+            result.triangles      += stats.triangles;
+            result.vertices       += stats.vertices;
+            result.transformed[0] += stats.transformed;
+
+            std::vector<uint32> cacheIndices(indexCount);
+            vk_demo::DVKMeshOptimizer::OptimizeVertexCache(cacheIndices.data(), mesh.indices.data(), indexCount, vertexCount, m_CacheSize);
+            result.transformed[1] += vk_demo::DVKMeshOptimizer::AnalyzeVertexCache(cacheIndices.data(), indexCount, vertexCount, m_CacheSize).transformed;
+
+            std::vector<uint32> overdrawIndices(indexCount);
+            vk_demo::DVKMeshOptimizer::OptimizeOverdraw(overdrawIndices.data(), cacheIndices.data(), indexCount, mesh.positions.data(), 3, vertexCount, 1.05f, m_CacheSize);
+            result.transformed[2] += vk_demo::DVKMeshOptimizer::AnalyzeVertexCache(overdrawIndices.data(), indexCount, vertexCount, m_CacheSize).transformed;
+
+            if (!IsTrianglePermutation(mesh.indices.data(), overdrawIndices.data(), indexCount))
+            {
+                MLOGE("  %s mesh %d : reordered triangles do not match the input", filename.c_str(), i);
+                m_NumInvalidMeshes += 1;
+            }
+
+            // 完整流程计时，重复多次取平均
+            std::vector<float>  vertices;
+            std::vector<uint32> indices;
+            double beginTime = GenericPlatformTime::Seconds();
+            for (int32 iteration = 0; iteration < m_Iterations; ++iteration)
+            {
+                vertices = mesh.positions;
+                indices  = mesh.indices;
+                vk_demo::DVKMeshOptimizer::Optimize(vertices, indices, 3, 0);
+            }
+            result.time += (GenericPlatformTime::Seconds() - beginTime) / m_Iterations;
+            result.transformed[3] += vk_demo::DVKMeshOptimizer::AnalyzeVertexCache(indices.data(), indexCount, vertexCount, m_CacheSize).transformed;
+        }
+
+        return true;
+    }
+
+    void Print(const std::string& name, const Result& result)
+    {
+        double triangles = (double)MMath::Max<uint64>(result.triangles, 1);
+        double vertices  = (double)MMath::Max<uint64>(result.vertices, 1);
+
+        char columns[4][32];
+        for (int32 i = 0; i < 4; ++i)
+        {
+            snprintf(columns[i], sizeof(columns[i]), "%.3f / %.3f", result.transformed[i] / triangles, result.transformed[i] / vertices);
+        }
+
+        MLOG("  %-48s : %8d %8d | %-23s | %-23s | %-23s | %-23s | %.2fms",
+            name.c_str(),
+            (int32)result.triangles,
+            (int32)result.vertices,
+            columns[0],
+            columns[1],
+            columns[2],
+            columns[3],
+            result.time * 1000.0
+        );
+    }
+
+private:
+    std::vector<std::string>    m_Files;
+    int32                       m_CacheSize = vk_demo::DVKMeshOptimizer::DefaultCacheSize;
+    int32                       m_Iterations = 3;
+    int32                       m_NumInvalidMeshes = 0;
+};
+
+std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
+{
+    return std::make_shared<MeshOptimizerBenchmarkModule>(800, 600, "MeshOptimizerBenchmark", cmdLine);
+}
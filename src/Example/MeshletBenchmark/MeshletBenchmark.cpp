@@ -0,0 +1,305 @@
+#include "Common/Common.h"
+#include "Common/Log.h"
+
+#include "Application/AppModuleBase.h"
+#include "Demo/DVKMeshlet.h"
+#include "Demo/DVKMeshOptimizer.h"
+#include "Demo/FileManager.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "Math/Math.h"
+#include "Math/Vector3.h"
+
+#include "assimp/Importer.hpp"
+#include "assimp/scene.h"
+#include "assimp/postprocess.h"
+
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdlib>
+#include <algorithm>
+#include <filesystem>
+
+// 在CPU上划分meshlet，统计划分速度、簇的填充率以及法线锥的背面剔除率。
+// MeshletBenchmark [-vertices=N] [-triangles=N] [-iterations=N] [-views=N] [model ...]
+// 不指定模型时遍历assets/models下所有obj/fbx，与导入时一致先经DVKMeshOptimizer重排。
+// 剔除率为包围球外随机方向的相机下，整簇被剔除的三角形占比。
+class MeshletBenchmarkModule : public AppModuleBase
+{
+public:
+    struct MeshData
+    {
+        std::vector<float>  positions;
+        std::vector<uint32> indices;
+    };
+
+    struct Result
+    {
+        uint64  triangles = 0;
+        uint64  meshlets = 0;
+        uint64  meshletVertices = 0;
+        uint64  culledTriangles = 0;
+        uint64  testedTriangles = 0;
+        double  time = 0.0;
+    };
+
+    MeshletBenchmarkModule(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
+        : AppModuleBase(width, height, title)
+    {
+        for (int32 i = 1; i < cmdLine.size(); ++i)
+        {
+            if (cmdLine[i].find("-vertices=") == 0)
+            {
+                m_MaxVertices = MMath::Clamp(atoi(cmdLine[i].c_str() + 10), 3, 255);
+            }
+            else if (cmdLine[i].find("-triangles=") == 0)
+            {
+                m_MaxTriangles = MMath::Max(atoi(cmdLine[i].c_str() + 11), 1);
+            }
+            else if (cmdLine[i].find("-iterations=") == 0)
+            {
+                m_Iterations = MMath::Max(atoi(cmdLine[i].c_str() + 12), 1);
+            }
+            else if (cmdLine[i].find("-views=") == 0)
+            {
+                m_Views = MMath::Max(atoi(cmdLine[i].c_str() + 7), 1);
+            }
+            else if (cmdLine[i].size() > 0 && cmdLine[i][0] != '-')
+            {
+                m_Files.push_back(cmdLine[i]);
+            }
+        }
+    }
+
+    virtual ~MeshletBenchmarkModule()
+    {
+
+    }
+
+    virtual bool PreInit() override
+    {
+        return true;
+    }
+
+    virtual bool Init() override
+    {
+        if (m_Files.size() == 0)
+        {
+            CollectModels("assets/models");
+        }
+
+        MLOG("MeshletBenchmark : %d models, %d vertices, %d triangles per meshlet, %d iterations, %d views", (int32)m_Files.size(), m_MaxVertices, m_MaxTriangles, m_Iterations, m_Views);
+        MLOG("  %-48s : %8s %8s | %8s %8s | %10s %10s | %s", "model", "tris", "meshlets", "verts", "tris", "time", "Mtris/s", "cone culled");
+
+        Result total;
+        for (int32 i = 0; i < m_Files.size(); ++i)
+        {
+            Result result;
+            if (!Benchmark(m_Files[i], result))
+            {
+                MLOGE("Failed load : %s", m_Files[i].c_str());
+                continue;
+            }
+
+            Print(m_Files[i], result);
+
+            total.triangles       += result.triangles;
+            total.meshlets        += result.meshlets;
+            total.meshletVertices += result.meshletVertices;
+            total.culledTriangles += result.culledTriangles;
+            total.testedTriangles += result.testedTriangles;
+            total.time            += result.time;
+        }
+
+        Print("total", total);
+
+        Engine::Get()->RequestExit(true);
+        return true;
+    }
+
+    virtual void Exist() override
+    {
+
+    }
+
+    virtual void Loop(float time, float delta) override
+    {
+
+    }
+
+private:
+
+    void CollectModels(const std::string& directory)
+    {
+        std::error_code error;
+        std::string root = FileManager::GetFilePath("");
+        for (auto it = std::filesystem::recursive_directory_iterator(root + directory, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+        {
+            if (!it->is_regular_file())
+            {
+                continue;
+            }
+
+            std::string extension = it->path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            if (extension == ".obj" || extension == ".fbx")
+            {
+                m_Files.push_back(it->path().string().substr(root.size()));
+            }
+        }
+        std::sort(m_Files.begin(), m_Files.end());
+    }
+
+    // 与导入时一致：三角化并合并重复顶点
+    bool LoadMeshes(const std::string& filename, std::vector<MeshData>& outMeshes)
+    {
+        uint32 dataSize = 0;
+        uint8* dataPtr  = nullptr;
+        if (!FileManager::ReadFile(filename, dataPtr, dataSize))
+        {
+            return false;
+        }
+
+        std::string extension = filename.substr(filename.find_last_of('.') + 1);
+
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFileFromMemory(dataPtr, dataSize, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices, extension.c_str());
+        delete[] dataPtr;
+
+        if (!scene)
+        {
+            return false;
+        }
+
+        for (uint32 i = 0; i < scene->mNumMeshes; ++i)
+        {
+            const aiMesh* aiMesh = scene->mMeshes[i];
+
+            MeshData mesh;
+            for (uint32 j = 0; j < aiMesh->mNumVertices; ++j)
+            {
+                mesh.positions.push_back(aiMesh->mVertices[j].x);
+                mesh.positions.push_back(aiMesh->mVertices[j].y);
+                mesh.positions.push_back(aiMesh->mVertices[j].z);
+            }
+            for (uint32 j = 0; j < aiMesh->mNumFaces; ++j)
+            {
+                if (aiMesh->mFaces[j].mNumIndices != 3)
+                {
+                    continue;
+                }
+                mesh.indices.push_back(aiMesh->mFaces[j].mIndices[0]);
+                mesh.indices.push_back(aiMesh->mFaces[j].mIndices[1]);
+                mesh.indices.push_back(aiMesh->mFaces[j].mIndices[2]);
+            }
+
+            if (mesh.indices.size() > 0)
+            {
+                vk_demo::DVKMeshOptimizer::Optimize(mesh.positions, mesh.indices, 3, 0);
+                outMeshes.push_back(mesh);
+            }
+        }
+
+        return true;
+    }
+
+    bool Benchmark(const std::string& filename, Result& result)
+    {
+        std::vector<MeshData> meshes;
+        if (!LoadMeshes(filename, meshes))
+        {
+            return false;
+        }
+
+        // 所有mesh共用一组相机，位于模型包围球半径的3倍处
+        Vector3 boundsMin( MAX_FLT,  MAX_FLT,  MAX_FLT);
+        Vector3 boundsMax(-MAX_FLT, -MAX_FLT, -MAX_FLT);
+        for (int32 i = 0; i < meshes.size(); ++i)
+        {
+            for (int32 j = 0; j < meshes[i].positions.size(); j += 3)
+            {
+                Vector3 position(meshes[i].positions[j + 0], meshes[i].positions[j + 1], meshes[i].positions[j + 2]);
+                boundsMin = Vector3(MMath::Min(boundsMin.x, position.x), MMath::Min(boundsMin.y, position.y), MMath::Min(boundsMin.z, position.z));
+                boundsMax = Vector3(MMath::Max(boundsMax.x, position.x), MMath::Max(boundsMax.y, position.y), MMath::Max(boundsMax.z, position.z));
+            }
+        }
+
+        Vector3 center = (boundsMin + boundsMax) * 0.5f;
+        float   radius = (boundsMax - boundsMin).Size() * 0.5f;
+
+        std::mt19937 random(1);
+        std::normal_distribution<float> distribution(0.0f, 1.0f);
+        std::vector<Vector3> cameras(m_Views);
+        for (int32 i = 0; i < m_Views; ++i)
+        {
+            Vector3 direction(distribution(random), distribution(random), distribution(random));
+            if (!direction.Normalize())
+            {
+                direction = Vector3(0.0f, 0.0f, 1.0f);
+            }
+            cameras[i] = center + direction * (radius * 3.0f);
+        }
+
+        for (int32 i = 0; i < meshes.size(); ++i)
+        {
+            MeshData& mesh     = meshes[i];
+            uint32 vertexCount = (uint32)mesh.positions.size() / 3;
+            uint32 indexCount  = (uint32)mesh.indices.size();
+
+            // 重复多次取平均
+            vk_demo::DVKMeshletData data;
+            double beginTime = GenericPlatformTime::Seconds();
+            for (int32 iteration = 0; iteration < m_Iterations; ++iteration)
+            {
+                vk_demo::DVKMeshletBuilder::Build(data, mesh.indices.data(), indexCount, mesh.positions.data(), 3, vertexCount, m_MaxVertices, m_MaxTriangles);
+            }
+            result.time += (GenericPlatformTime::Seconds() - beginTime) / m_Iterations;
+
+            result.triangles       += indexCount / 3;
+            result.meshlets        += data.meshlets.size();
+            result.meshletVertices += data.vertices.size();
+
+            for (int32 j = 0; j < cameras.size(); ++j)
+            {
+                for (int32 k = 0; k < data.meshlets.size(); ++k)
+                {
+                    if (vk_demo::DVKMeshletBuilder::IsBackfacing(data.spheres[k], data.cones[k], cameras[j]))
+                    {
+                        result.culledTriangles += data.meshlets[k].triangleCount;
+                    }
+                }
+                result.testedTriangles += indexCount / 3;
+            }
+        }
+
+        return true;
+    }
+
+    void Print(const std::string& name, const Result& result)
+    {
+        double meshlets = (double)MMath::Max<uint64>(result.meshlets, 1);
+
+        MLOG("  %-48s : %8d %8d | %8.1f %8.1f | %8.2fms %10.2f | %.1f%%",
+            name.c_str(),
+            (int32)result.triangles,
+            (int32)result.meshlets,
+            result.meshletVertices / meshlets,
+            result.triangles / meshlets,
+            result.time * 1000.0,
+            result.time > 0.0 ? result.triangles / result.time / 1000000.0 : 0.0,
+            result.testedTriangles > 0 ? result.culledTriangles * 100.0 / result.testedTriangles : 0.0
+        );
+    }
+
+private:
+    std::vector<std::string>    m_Files;
+    int32                       m_MaxVertices = vk_demo::DVKMeshletBuilder::MaxVertices;
+    int32                       m_MaxTriangles = vk_demo::DVKMeshletBuilder::MaxTriangles;
+    int32                       m_Iterations = 3;
+    int32                       m_Views = 64;
+};
+
+std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
+{
+    return std::make_shared<MeshletBenchmarkModule>(800, 600, "MeshletBenchmark", cmdLine);
+}
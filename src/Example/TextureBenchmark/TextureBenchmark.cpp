@@ -0,0 +1,209 @@
+#include "Common/Common.h"
+#include "Common/Log.h"
+
+#include "Demo/DemoBase.h"
+#include "Demo/DVKCommand.h"
+#include "Demo/DVKTexture.h"
+#include "Demo/DVKUploadQueue.h"
+#include "Demo/FileManager.h"
+#include "GenericPlatform/GenericPlatformTime.h"
+#include "HAL/ThreadPool.h"
+#include "Loader/ImageLoader.h"
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+// 纹理数组与cubemap的端到端加载耗时。
+// TextureBenchmark [-iterations=N] [-cube=a,b,c,d,e,f] [-array=a,b,...]
+// 对比逐层串行解码、cmdBuffer路径(并行解码)与uploader路径(并行解码直接写入staging)。
+class TextureBenchmarkModule : public DemoBase
+{
+public:
+    TextureBenchmarkModule(int32 width, int32 height, const char* title, const std::vector<std::string>& cmdLine)
+        : DemoBase(width, height, title, cmdLine)
+    {
+        m_CubeFiles = {
+            "assets/textures/terrain/snow.jpg",
+            "assets/textures/terrain/terrain.jpg",
+            "assets/textures/terrain/rocks.jpg",
+            "assets/textures/terrain/lava.jpg",
+            "assets/textures/terrain/mosaic-red.jpg",
+            "assets/textures/terrain/mosaic-green.jpg"
+        };
+
+        m_ArrayFiles = {
+            "assets/textures/terrain/snow.jpg",
+            "assets/textures/terrain/terrain.jpg",
+            "assets/textures/terrain/rocks.jpg",
+            "assets/textures/terrain/lava.jpg",
+            "assets/textures/terrain/snow_normal.jpg",
+            "assets/textures/terrain/terrain_normal.jpg",
+            "assets/textures/terrain/rocks_normal.jpg",
+            "assets/textures/terrain/lava_normal.jpg",
+            "assets/textures/terrain/mosaic-red.jpg",
+            "assets/textures/terrain/mosaic-green.jpg",
+            "assets/textures/terrain/mosaic-blue.jpg",
+            "assets/textures/terrain/mosaic-white.jpg"
+        };
+
+        for (int32 i = 1; i < cmdLine.size(); ++i)
+        {
+            if (cmdLine[i].find("-iterations=") == 0)
+            {
+                m_Iterations = MMath::Max(atoi(cmdLine[i].c_str() + 12), 1);
+            }
+            else if (cmdLine[i].find("-cube=") == 0)
+            {
+                m_CubeFiles = SplitList(cmdLine[i].substr(6));
+            }
+            else if (cmdLine[i].find("-array=") == 0)
+            {
+                m_ArrayFiles = SplitList(cmdLine[i].substr(7));
+            }
+        }
+    }
+
+    virtual ~TextureBenchmarkModule()
+    {
+
+    }
+
+    virtual bool PreInit() override
+    {
+        return true;
+    }
+
+    virtual bool Init() override
+    {
+        DemoBase::Setup();
+        DemoBase::Prepare();
+
+        MLOG("TextureBenchmark : %d worker threads, %d iterations", ThreadPool::Get().GetNumThreads(), m_Iterations);
+
+        Benchmark("cube", m_CubeFiles, true);
+        Benchmark("array", m_ArrayFiles, false);
+
+        Engine::Get()->RequestExit(true);
+        return true;
+    }
+
+    virtual void Exist() override
+    {
+        DemoBase::Release();
+    }
+
+    virtual void Loop(float time, float delta) override
+    {
+
+    }
+
+private:
+
+    static std::vector<std::string> SplitList(const std::string& list)
+    {
+        std::vector<std::string> result;
+        size_t start = 0;
+        while (start < list.size())
+        {
+            size_t end = list.find(',', start);
+            if (end == std::string::npos)
+            {
+                end = list.size();
+            }
+            if (end > start)
+            {
+                result.push_back(list.substr(start, end - start));
+            }
+            start = end + 1;
+        }
+        return result;
+    }
+
+    // 旧的加载方式：逐层读取文件、解码，再拷贝到staging
+    static double SerialDecode(const std::vector<std::string>& filenames, bool hdr)
+    {
+        double beginTime = GenericPlatformTime::Seconds();
+
+        std::vector<uint8> staging;
+        for (int32 i = 0; i < filenames.size(); ++i)
+        {
+            uint32 dataSize = 0;
+            uint8* dataPtr  = nullptr;
+            if (!FileManager::ReadFile(filenames[i], dataPtr, dataSize))
+            {
+                MLOGE("Failed load image : %s", filenames[i].c_str());
+                return 0.0;
+            }
+
+            int32 comp   = 0;
+            int32 width  = 0;
+            int32 height = 0;
+            uint8* data  = hdr ?
+                (uint8*)StbImage::LoadFloatFromMemory(dataPtr, dataSize, &width, &height, &comp, 4) :
+                StbImage::LoadFromMemory(dataPtr, dataSize, &width, &height, &comp, 4);
+
+            delete[] dataPtr;
+
+            if (data)
+            {
+                uint32 size = width * height * 4 * (hdr ? 4 : 1);
+                staging.resize(size * filenames.size());
+                memcpy(staging.data() + size * i, data, size);
+                StbImage::Free(data);
+            }
+        }
+
+        return GenericPlatformTime::Seconds() - beginTime;
+    }
+
+    void Benchmark(const char* name, const std::vector<std::string>& filenames, bool cube)
+    {
+        double serialTime   = 0.0;
+        double cmdTime      = 0.0;
+        double uploaderTime = 0.0;
+
+        for (int32 i = 0; i < m_Iterations; ++i)
+        {
+            serialTime += SerialDecode(filenames, cube);
+
+            vk_demo::DVKCommandBuffer* cmdBuffer = vk_demo::DVKCommandBuffer::Create(m_VulkanDevice, m_CommandPool);
+            double beginTime = GenericPlatformTime::Seconds();
+            vk_demo::DVKTexture* texture = cube ?
+                vk_demo::DVKTexture::CreateCube(filenames, m_VulkanDevice, cmdBuffer) :
+                vk_demo::DVKTexture::Create2DArray(filenames, m_VulkanDevice, cmdBuffer);
+            cmdTime += GenericPlatformTime::Seconds() - beginTime;
+            delete texture;
+            delete cmdBuffer;
+
+            vk_demo::DVKUploadQueue* uploader = vk_demo::DVKUploadQueue::Create(m_VulkanDevice);
+            beginTime = GenericPlatformTime::Seconds();
+            texture = cube ?
+                vk_demo::DVKTexture::CreateCube(filenames, m_VulkanDevice, uploader) :
+                vk_demo::DVKTexture::Create2DArray(filenames, m_VulkanDevice, uploader);
+            uploader->WaitIdle();
+            uploaderTime += GenericPlatformTime::Seconds() - beginTime;
+            delete texture;
+            delete uploader;
+        }
+
+        // 串行解码只统计CPU部分，另外两项包含GPU上传与mipmap生成
+        MLOG("  %-6s %2d layers : serial decode %.2fms, cmdBuffer %.2fms, uploader %.2fms",
+            name,
+            (int32)filenames.size(),
+            serialTime / m_Iterations * 1000.0,
+            cmdTime / m_Iterations * 1000.0,
+            uploaderTime / m_Iterations * 1000.0
+        );
+    }
+
+private:
+    std::vector<std::string>    m_CubeFiles;
+    std::vector<std::string>    m_ArrayFiles;
+    int32                       m_Iterations = 3;
+};
+
+std::shared_ptr<AppModuleBase> CreateAppMode(const std::vector<std::string>& cmdLine)
+{
+    return std::make_shared<TextureBenchmarkModule>(800, 600, "TextureBenchmark", cmdLine);
+}
@@ -0,0 +1,39 @@
+#version 450
+
+// -quantize时使用：位置为snorm16，法线为八面体编码的snorm16x2
+layout (location = 0) in vec4 inPosition;
+layout (location = 1) in vec2 inNormal;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 modelMatrix;
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec4 dequantizeOffset;
+	vec4 dequantizeScale;
+} uboMVP;
+
+layout (location = 0) out vec3 outNormal;
+
+out gl_PerVertex 
+{
+    vec4 gl_Position;   
+};
+
+vec3 DecodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0) {
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
+
+void main() 
+{
+	vec3 position = inPosition.xyz * uboMVP.dequantizeScale.xyz + uboMVP.dequantizeOffset.xyz;
+	mat3 normalMatrix = transpose(inverse(mat3(uboMVP.modelMatrix)));
+	vec3 normal = normalize(normalMatrix * DecodeOctahedral(inNormal));
+	outNormal   = normal;
+	gl_Position = uboMVP.projectionMatrix * uboMVP.viewMatrix * uboMVP.modelMatrix * vec4(position, 1.0);
+}
@@ -11,8 +11,20 @@ include_dir_list = {
 }
 
 
-links_list={"User32","Gdi32","shell32","Advapi32"}
-add_defines("PLATFORM_WINDOWS","NOMINMAX","MONKEY_DEBUG","_WINDOWS")
+if is_plat("linux") then
+    -- 无窗口的离屏平台，使用系统的vulkan loader，可配合lavapipe运行
+    links_list={"vulkan","dl","pthread"}
+    ldflags_list={}
+    launch_file="../LaunchLinux.cpp"
+    engine_files={"./src/Engine/**.cpp|**/Windows/**.cpp"}
+    add_defines("PLATFORM_LINUX","MONKEY_DEBUG")
+else
+    links_list={"User32","Gdi32","shell32","Advapi32"}
+    ldflags_list={"-subsystem:windows"}
+    launch_file="../LaunchWindows.cpp"
+    engine_files={"./src/Engine/**.cpp|**/Linux/**.cpp"}
+    add_defines("PLATFORM_WINDOWS","NOMINMAX","MONKEY_DEBUG","_WINDOWS")
+end
 
 target("imgui")
      set_kind("static")
@@ -50,11 +62,15 @@ add_requires("SPIRV-Cross")
 
 target("Vulkan")
     set_kind("static")
-    add_files("./src/Engine/**.cpp","./src/Engine/**.cpp")
+    add_files(engine_files)
     add_includedirs(include_dir_list, "$(projectdir)/src/Engine")
     add_deps("imgui")
     add_packages("assimp","SPIRV-Cross")
-    add_links(links_list,"$(projectdir)/external/vulkan/windows/lib/vulkan-1")
+    if is_plat("windows") then
+        add_links(links_list,"$(projectdir)/external/vulkan/windows/lib/vulkan-1")
+    else
+        add_links(links_list)
+    end
         --copy resource file to build directory
 target_end()
 